@@ -0,0 +1,77 @@
+//-------------------------------------------------------------------------------------------------------
+//  DualMonoFDN.cpp
+//  Feedverb's left and right FDNs as two lanes of one LaneFDN.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "DualMonoFDN.h"
+
+static const float DELAYS_IN_MS[DUAL_MONO_NUM_CHANNELS] = { 11.3, 23.5, 53.9, 78.3, 99.1, 133.4, 175.9, 238.9 };
+
+/*--------------------------------------------------------------------*/
+DualMonoFDN::DualMonoFDN()
+{
+    _spread = 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DualMonoFDN::getDelaysInMilliseconds(int channel, float spread, float* delaysInMs)
+{
+    for (int i = 0; i < DUAL_MONO_NUM_CHANNELS; i++)
+        delaysInMs[i] = DELAYS_IN_MS[i] + (channel == 1 ? spread * DUAL_MONO_SPREAD_IN_MS : 0.0f);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DualMonoFDN::init(float sampleRate)
+{
+    _lanes.init(sampleRate, DUAL_MONO_MAX_DELAY_IN_MS, DUAL_MONO_NUM_CHANNELS, 2);
+    setSpread(_spread);
+}
+
+void DualMonoFDN::reset()
+{
+    _lanes.reset();
+}
+
+void DualMonoFDN::setSampleRate(float sampleRate)
+{
+    _lanes.setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DualMonoFDN::setDecayInSeconds(float decayInSeconds)
+{
+    _lanes.setDecayInSeconds(decayInSeconds);
+}
+
+void DualMonoFDN::setDampingFrequency(float frequency)
+{
+    _lanes.setDampingFrequency(frequency);
+}
+
+void DualMonoFDN::setSpread(float spread)
+{
+    _spread = spread;
+    float delaysInMs[DUAL_MONO_NUM_CHANNELS];
+    for (int channel = 0; channel < 2; channel++) {
+        getDelaysInMilliseconds(channel, spread, delaysInMs);
+        _lanes.setDelaysInMilliseconds(channel, delaysInMs);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DualMonoFDN::processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++) {
+        float inputs[2] = { inL[i], inR[i] };
+        float outputs[2];
+        _lanes.processAudio(inputs, outputs);
+        outL[i] = outputs[0];
+        outR[i] = outputs[1];
+    }
+}
+/*--------------------------------------------------------------------*/
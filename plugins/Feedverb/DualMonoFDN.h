@@ -0,0 +1,40 @@
+//-------------------------------------------------------------------------------------------------------
+//  DualMonoFDN.h
+//  Feedverb's left and right FDNs: two mono feedback delay networks with the same eight lines,
+//  run as two lanes of one LaneFDN so the pair costs about as much as a single FDN. The right
+//  FDN's delays sit up to DUAL_MONO_SPREAD_IN_MS above the left ones; at zero spread both
+//  lanes share their delays and every read is a single vector load.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "LaneFDN.h"
+
+#define DUAL_MONO_NUM_CHANNELS 8
+#define DUAL_MONO_MAX_DELAY_IN_MS 300.0         // longest line, spread included
+#define DUAL_MONO_SPREAD_IN_MS 1.0              // right delays at full spread, above the left ones
+
+//-------------------------------------------------------------------------------------------------------
+class DualMonoFDN {
+
+	// Left FDN in lane 0, right FDN in lane 1
+	LaneFDN _lanes;
+	float _spread;
+
+public:
+
+	DualMonoFDN();
+
+	// Delays of the left (channel 0) or right (channel 1) FDN at the given spread
+	static void getDelaysInMilliseconds(int channel, float spread, float* delaysInMs);
+
+	void init(float sampleRate);
+	void reset();
+	void setSampleRate(float sampleRate);
+	void setDecayInSeconds(float decayInSeconds);
+	void setDampingFrequency(float frequency);
+	void setSpread(float spread);
+
+	// Wet output only, numSamples per channel
+	void processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples);
+};
@@ -11,7 +11,6 @@
 #include <math.h>
 
 /*--------------------------------------------------------------------*/
-#define MAX_DIFFUSER_DELAY_LENGHTS 300.0
 #define MAX_COMB_FILTER_LENGTH_IN_MS 100.0
 #define MAX_PREDELAY_VALUE_IN_MS 300.0
 #define MAX_AP_FILTER_LENGTH_IN_MS 50.0
@@ -22,9 +21,9 @@
 //#define MAX_COMB_FILTER_DELAY_IN_MS 43.3
 //#define MIN_AP_FILTER_DELAY_IN_MS 1.1
 //#define MAX_AP_FILTER_DELAY_IN_MS 4.7
-#define STEREO_SPREAD_COEFFICIENT_IN_MS 1.0
 #define NUM_PRESETS 5
-#define DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN	8
+#define MIN_DAMPING_FREQUENCY 200.0
+#define MAX_DAMPING_FREQUENCY 20000.0
 
 /*--------------------------------------------------------------------*/
 
@@ -37,7 +36,7 @@ Feedverb::Feedverb(audioMasterCallback audioMaster)
     setNumInputs(2);		// stereo in
     setNumOutputs(2);		// stereo out
     setUniqueID('vMis');	// identify    
-    //InitPlugin();
+    InitPlugin();
 }
 /*--------------------------------------------------------------------*/
 
@@ -60,14 +59,33 @@ void Feedverb::InitPlugin()
     int sampleRate = getSampleRate();
 
     /*.......................................*/
-    //// init FDN
-    //fdnverb_fdnLeft = new FDN(1, DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, 1);
-    //fdnverb_fdnRight = new FDN(1, DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, 1);
-    //fdnverb_fdnLeft->init(MAX_DIFFUSER_DELAY_LENGHTS, sampleRate);
-    //fdnverb_fdnRight->init(MAX_DIFFUSER_DELAY_LENGHTS, sampleRate);
-    //float delayLenghts[DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN] = {11.3, 23.5, 53.9, 78.3, 99.1, 133.4, 175.9, 238.9};
-    //fdnverb_fdnLeft->setDiffuserDelayLengths(delayLenghts);
-    //fdnverb_fdnRight->setDiffuserDelayLengths(delayLenghts);
+    // parameters of the "Default" preset
+    rev_wet = 0.2;
+    rev_decay = 1.0;
+    rev_smearing = 0.7;
+    rev_damping = 0.5;
+    rev_preDelay = 10;
+    rev_modRate = 1.0;
+    rev_modDepth = 0.3;
+    rev_spread = 0.3;
+    rev_lpfFreq = 1.0;
+    rev_hpfFreq = 0.0;
+
+    /*.......................................*/
+    // init FDN: left and right as two lanes of one engine
+    fdnverb_fdn.init(sampleRate);
+    fdnverb_fdn.setSpread(rev_spread);
+    fdnverb_fdn.setDecayInSeconds(rev_decay);
+    updateDamping();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// damping from 0 (MAX_DAMPING_FREQUENCY) to 1 (MIN_DAMPING_FREQUENCY), log scale
+void Feedverb::updateDamping()
+{
+    float frequency = exp(log(MAX_DAMPING_FREQUENCY) + rev_damping * (log(MIN_DAMPING_FREQUENCY) - log(MAX_DAMPING_FREQUENCY)));
+    fdnverb_fdn.setDampingFrequency(frequency);
 }
 /*--------------------------------------------------------------------*/
 
@@ -79,7 +97,7 @@ void Feedverb::setSampleRate(float sampleRate)
     AudioEffect::setSampleRate(sampleRate);
 
     // Call setSampleRate on every needed module
-    fdnverb_fdnLeft->setSampleRate(sampleRate);
+    fdnverb_fdn.setSampleRate(sampleRate);
 }
 /*--------------------------------------------------------------------*/
 
@@ -184,10 +202,13 @@ void Feedverb::processReplacing(float** inputs, float** outputs, VstInt32 sample
     float* outL = outputs[0]; // buffer output left
     float* outR = outputs[1]; // buffer output right
 
-    // Cycle over the sample frames number
-    for (int i = 0; i < sampleFrames; i++) {       
-        fdnverb_fdnLeft->processAudio(inL, outL);
-        fdnverb_fdnRight->processAudio(inR, outR);        
+    // Both FDNs in one pass, wet signal straight into the outputs
+    fdnverb_fdn.processBlock(inL, inR, outL, outR, sampleFrames);
+
+    // Mix in the dry signal
+    for (int i = 0; i < sampleFrames; i++) {
+        outL[i] = outL[i] * rev_wet + inL[i] * (1.0 - rev_wet);
+        outR[i] = outR[i] * rev_wet + inR[i] * (1.0 - rev_wet);
     }
 }
 /*--------------------------------------------------------------------*/
@@ -208,6 +229,7 @@ void Feedverb::setParameter(VstInt32 index, float value)
     case Param_decay:
     {
         rev_decay = value * MAX_REVERB_DECAY_IN_SECONDS;
+        fdnverb_fdn.setDecayInSeconds(rev_decay);
         break;
     }
     case Param_smearing:
@@ -218,6 +240,7 @@ void Feedverb::setParameter(VstInt32 index, float value)
     case Param_damping:
     {
         rev_damping = value;
+        updateDamping();
         break;
     }
     case Param_lpfFreq:
@@ -248,6 +271,7 @@ void Feedverb::setParameter(VstInt32 index, float value)
     case Param_spread:
     {
         rev_spread = value;
+        fdnverb_fdn.setSpread(rev_spread);
         break;
     }
     default:
@@ -511,8 +535,6 @@ bool Feedverb::getVendorString(char* name)
  ------------------------------------------------------------------------------------------------------------ */
 Feedverb::~Feedverb()
 {
-    fdnverb_fdnLeft->~FDN();
-    fdnverb_fdnRight->~FDN();
 }
 
 
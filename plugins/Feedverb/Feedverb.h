@@ -7,7 +7,7 @@
 
 #pragma once
 #include <stdio.h>
-#include "FDN.h"
+#include "DualMonoFDN.h"
 #include "../vstsdk2.4/public.sdk/source/vst2.x/audioeffectx.h"
 #include <math.h>
 
@@ -51,13 +51,13 @@ class Feedverb : public AudioEffectX {
 	// Reverb User Parameters
 	float rev_wet, rev_smearing, rev_decay, rev_damping, rev_lpfFreq, rev_hpfFreq, rev_preDelay, rev_modRate, rev_modDepth, rev_spread;
 
-	// FDN
-	FDN* fdnverb_fdnLeft;
-	FDN* fdnverb_fdnRight;
+	// Left and right FDNs, two lanes of one engine
+	DualMonoFDN fdnverb_fdn;
 
 	
 	void InitPlugin();
 	void InitPresets();
+	void updateDamping();
 
 public:
 
@@ -0,0 +1,252 @@
+//-------------------------------------------------------------------------------------------------------
+//  CombBank.cpp
+//  Lowpass-feedback comb filters processed together with SSE, on one input or on a stereo pair.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "CombBank.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+/*--------------------------------------------------------------------*/
+CombBank::CombBank()
+{
+    _buffer = nullptr;
+    _bufferLength = 0;
+    _bufferMask = 0;
+    _writeIndex = 0;
+    _allocatedFloats = 0;
+    _arena = nullptr;
+    _laneCapacity = COMB_BANK_LANES;
+    _numLanes = COMB_BANK_LANES;
+    _sampleRate = 0.0;
+    _maxDelayInMs = 0.0;
+    _decayInSeconds = 1.0;
+    _damping = 0.0;
+    _dampingFrequency = 0.0;
+    for (int l = 0; l < COMB_BANK_MAX_LANES; l++) {
+        _delayInMs[l] = 0.0;
+        _delayInSamples[l] = 1;
+        _feedback[l] = 0.0;
+        _filterState[l] = 0.0;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+CombBank::~CombBank()
+{
+    if (_arena == nullptr)
+        _mm_free(_buffer);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Longest delay, rounded up to a power of two
+int CombBank::getBufferLength(float sampleRate, float maxDelayInMs)
+{
+    int minLength = (int)(maxDelayInMs * 0.001 * sampleRate) + 2;
+    int length = 1;
+    while (length < minLength)
+        length <<= 1;
+    return length;
+}
+
+size_t CombBank::getMemorySize(float sampleRate, float maxDelayInMs, int numLanes)
+{
+    int lanes = numLanes > COMB_BANK_LANES ? COMB_BANK_MAX_LANES : COMB_BANK_LANES;
+    return getBufferLength(sampleRate, maxDelayInMs) * lanes * sizeof(float) + ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Grow the interleaved buffer when needed; existing content is not preserved
+void CombBank::reserveFloats(size_t numFloats)
+{
+    if (numFloats <= _allocatedFloats)
+        return;
+    if (_arena != nullptr)
+        _buffer = _arena->allocateFloats(numFloats);
+    else {
+        _mm_free(_buffer);
+        _buffer = (float*)_mm_malloc(numFloats * sizeof(float), ARENA_ALIGNMENT);
+    }
+    _allocatedFloats = numFloats;
+}
+
+void CombBank::reserve(float maxSampleRate, float maxDelayInMs, int numLanes)
+{
+    int lanes = numLanes > COMB_BANK_LANES ? COMB_BANK_MAX_LANES : COMB_BANK_LANES;
+    reserveFloats((size_t)getBufferLength(maxSampleRate, maxDelayInMs) * lanes);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Size the interleaved delay lines; only allocates when the reserved buffer is too small
+void CombBank::init(float sampleRate, float maxDelayInMs, int numLanes)
+{
+    _laneCapacity = numLanes > COMB_BANK_LANES ? COMB_BANK_MAX_LANES : COMB_BANK_LANES;
+    _numLanes = _laneCapacity;
+    _maxDelayInMs = maxDelayInMs;
+    _sampleRate = sampleRate;
+
+    int length = getBufferLength(sampleRate, maxDelayInMs);
+    reserveFloats((size_t)length * _laneCapacity);
+    _bufferLength = length;
+    _bufferMask = length - 1;
+    reset();
+    setDelaysInMilliseconds(_delayInMs);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::reset()
+{
+    memset(_buffer, 0, _bufferLength * _laneCapacity * sizeof(float));
+    memset(_filterState, 0, sizeof(_filterState));
+    _writeIndex = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Rows keep their stride of _laneCapacity, so the lanes that stay active keep their tails. Narrowing
+// just stops the upper lanes. Widening starts each upper lane from the tail of the lane
+// COMB_BANK_LANES below it, which runs the same comb on the other input, rather than from silence
+// or from what it held when it was last active.
+void CombBank::setNumLanes(int numLanes)
+{
+    numLanes = numLanes > COMB_BANK_LANES && _laneCapacity == COMB_BANK_MAX_LANES ? COMB_BANK_MAX_LANES : COMB_BANK_LANES;
+    if (numLanes > _numLanes) {
+        for (int position = 0; position < _bufferLength; position++) {
+            float* row = _buffer + position * _laneCapacity;
+            memcpy(row + COMB_BANK_LANES, row, COMB_BANK_LANES * sizeof(float));
+        }
+        memcpy(_filterState + COMB_BANK_LANES, _filterState, COMB_BANK_LANES * sizeof(float));
+    }
+    _numLanes = numLanes;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::setSampleRate(float sampleRate)
+{
+    int numLanes = _numLanes;
+    init(sampleRate, _maxDelayInMs, _laneCapacity);
+    _numLanes = numLanes;
+    setDelaysInMilliseconds(_delayInMs);
+    setDampingFrequency(_dampingFrequency);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::setDelaysInMilliseconds(const float* delaysInMs)
+{
+    for (int l = 0; l < _numLanes; l++) {
+        _delayInMs[l] = delaysInMs[l] > _maxDelayInMs ? _maxDelayInMs : delaysInMs[l];
+        int delay = (int)(_delayInMs[l] * 0.001 * _sampleRate + 0.5);
+        _delayInSamples[l] = delay < 1 ? 1 : delay;
+    }
+    updateFeedback();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::setDecayInSeconds(float decayInSeconds)
+{
+    _decayInSeconds = decayInSeconds;
+    updateFeedback();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// One-pole lowpass in the feedback path: s = (1 - d) * y + d * s
+void CombBank::setDampingFrequency(float frequency)
+{
+    _dampingFrequency = frequency;
+    _damping = frequency > 0.0 ? exp(-2.0 * M_PI * frequency / _sampleRate) : 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Each comb loses 60 dB over the decay time: g = 10^(-3 * delay / T60)
+void CombBank::updateFeedback()
+{
+    for (int l = 0; l < _numLanes; l++) {
+        if (_decayInSeconds <= 0.0 || _sampleRate <= 0.0)
+            _feedback[l] = 0.0;
+        else
+            _feedback[l] = pow(10.0, -3.0 * _delayInSamples[l] / (_decayInSeconds * _sampleRate));
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Advance every active lane by one sample. The first half of the lanes is fed inputFirstHalf,
+// the second half inputSecondHalf; each half's output sum is returned separately.
+inline void CombBank::processRow(float inputFirstHalf, float inputSecondHalf, float* outputFirstHalf, float* outputSecondHalf)
+{
+    // Gather the delayed sample of every lane
+    alignas(16) float delayed[COMB_BANK_MAX_LANES];
+    for (int l = 0; l < _numLanes; l++)
+        delayed[l] = _buffer[((_writeIndex - _delayInSamples[l]) & _bufferMask) * _laneCapacity + l];
+
+    // Lowpass, feedback and write back, four lanes at a time
+    int half = _numLanes / 2;
+    __m128 damp = _mm_set1_ps(_damping);
+    __m128 undamp = _mm_set1_ps(1.0f - _damping);
+    __m128 sum[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+    __m128 x[2] = { _mm_set1_ps(inputFirstHalf), _mm_set1_ps(inputSecondHalf) };
+    float* row = _buffer + _writeIndex * _laneCapacity;
+    for (int l = 0; l < _numLanes; l += 4) {
+        int h = l < half ? 0 : 1;
+        __m128 y = _mm_load_ps(delayed + l);
+        __m128 state = _mm_add_ps(_mm_mul_ps(y, undamp), _mm_mul_ps(_mm_load_ps(_filterState + l), damp));
+        _mm_store_ps(_filterState + l, state);
+        _mm_store_ps(row + l, _mm_add_ps(x[h], _mm_mul_ps(state, _mm_load_ps(_feedback + l))));
+        sum[h] = _mm_add_ps(sum[h], y);
+    }
+    _writeIndex = (_writeIndex + 1) & _bufferMask;
+
+    // Horizontal sums of the two halves
+    for (int h = 0; h < 2; h++) {
+        sum[h] = _mm_add_ps(sum[h], _mm_movehl_ps(sum[h], sum[h]));
+        sum[h] = _mm_add_ss(sum[h], _mm_shuffle_ps(sum[h], sum[h], 1));
+    }
+    *outputFirstHalf = _mm_cvtss_f32(sum[0]);
+    *outputSecondHalf = _mm_cvtss_f32(sum[1]);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float CombBank::processAudio(float input)
+{
+    float first, second;
+    processRow(input, input, &first, &second);
+    return first + second;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::processBlock(const float* input, float* output, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+        output[i] = processAudio(input[i]);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::processStereo(float inputL, float inputR, float* outputL, float* outputR)
+{
+    processRow(inputL, inputR, outputL, outputR);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CombBank::processStereoBlock(const float* inputL, const float* inputR, float* outputL, float* outputR, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+        processRow(inputL[i], inputR[i], outputL + i, outputR + i);
+}
+/*--------------------------------------------------------------------*/
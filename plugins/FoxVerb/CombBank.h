@@ -0,0 +1,78 @@
+//-------------------------------------------------------------------------------------------------------
+//  CombBank.h
+//  Lowpass-feedback comb filters processed together with SSE. The delay lines share one
+//  interleaved buffer (one row of lanes per time step), so each sample's writes are vector
+//  stores and only the reads are gathered per lane. A bank runs either COMB_BANK_LANES combs
+//  on one input, or 2 * COMB_BANK_LANES combs with the left input in the first half of the
+//  lanes and the right input in the second half (one 64-byte row per time step).
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "Arena.h"
+
+#define COMB_BANK_LANES 8
+#define COMB_BANK_MAX_LANES 16
+
+//-------------------------------------------------------------------------------------------------------
+class CombBank {
+
+	// Interleaved delay lines: _buffer[position * COMB_BANK_LANES + lane]
+	float* _buffer;
+	int _bufferLength;
+	int _bufferMask;
+	int _writeIndex;
+	size_t _allocatedFloats;
+	Arena* _arena;
+	int _laneCapacity;
+	int _numLanes;
+
+	float _sampleRate;
+	float _maxDelayInMs;
+	float _decayInSeconds;
+	float _delayInMs[COMB_BANK_MAX_LANES];
+	int _delayInSamples[COMB_BANK_MAX_LANES];
+
+	// Per-lane feedback gains and lowpass states, shared damping coefficient
+	alignas(16) float _feedback[COMB_BANK_MAX_LANES];
+	alignas(16) float _filterState[COMB_BANK_MAX_LANES];
+	float _damping;
+	float _dampingFrequency;
+
+	void updateFeedback();
+	static int getBufferLength(float sampleRate, float maxDelayInMs);
+	void reserveFloats(size_t numFloats);
+	void processRow(float inputFirstHalf, float inputSecondHalf, float* outputFirstHalf, float* outputSecondHalf);
+
+public:
+
+	CombBank();
+	~CombBank();
+
+	// Carve the delay lines out of the given arena instead of the heap (call before init)
+	void setArena(Arena* arena) { _arena = arena; }
+	static size_t getMemorySize(float sampleRate, float maxDelayInMs, int numLanes);
+
+	// Allocate up front for the highest sample rate, so init / setSampleRate below it never allocate
+	void reserve(float maxSampleRate, float maxDelayInMs, int numLanes);
+
+	// Allocate for up to numLanes lanes (COMB_BANK_LANES or COMB_BANK_MAX_LANES)
+	void init(float sampleRate, float maxDelayInMs, int numLanes = COMB_BANK_LANES);
+	void reset();
+	// Change the number of active lanes within the allocated capacity, without clearing the tails
+	void setNumLanes(int numLanes);
+	int getNumLanes() { return _numLanes; }
+	void setSampleRate(float sampleRate);
+	// One delay per active lane
+	void setDelaysInMilliseconds(const float* delaysInMs);
+	void setDecayInSeconds(float decayInSeconds);
+	void setDampingFrequency(float frequency);
+
+	// Feed the same input to every comb and return the sum of their outputs
+	float processAudio(float input);
+	void processBlock(const float* input, float* output, int numSamples);
+
+	// Feed left / right to the first / second half of the lanes and return each half's sum
+	void processStereo(float inputL, float inputR, float* outputL, float* outputR);
+	void processStereoBlock(const float* inputL, const float* inputR, float* outputL, float* outputR, int numSamples);
+};
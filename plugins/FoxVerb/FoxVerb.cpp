@@ -9,6 +9,7 @@
 #define _USE_MATH_DEFINES
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 /*--------------------------------------------------------------------*/
 #define MAX_COMB_FILTER_LENGTH_IN_MS 100.0
@@ -23,18 +24,31 @@
 //#define MAX_AP_FILTER_DELAY_IN_MS 4.7
 #define STEREO_SPREAD_COEFFICIENT_IN_MS 1.0
 #define NUM_PRESETS 5
+#define OVERSAMPLING_2X_CUTOFF_RATIO 0.2    // cutoff / sample rate above which the output filters run at 2x
+#define OVERSAMPLING_4X_CUTOFF_RATIO 0.35   // cutoff / sample rate above which the output filters run at 4x
+#define FILTER_BLOCK_SIZE MAX_OVERSAMPLER_BLOCK_SIZE
 /*--------------------------------------------------------------------*/
 
 
 /*--------------------------------------------------------------------*/
 // Reverb class constructor
-FoxVerb::FoxVerb(audioMasterCallback audioMaster)
+FoxVerb::FoxVerb(audioMasterCallback audioMaster, float maxSampleRate)
     : AudioEffectX(audioMaster, NUM_PRESETS, Param_Count) // n program, n parameters
 {
+    this->maxSampleRate = maxSampleRate;
     setNumInputs(2);		// stereo in
     setNumOutputs(2);		// stereo out
     setUniqueID('vMis');	// identify    
+    programsAreChunks();	// state is saved with getChunk/setChunk
+    setInitialDelay(HalfBandOversampler::getFactorLatency(MAX_OVERSAMPLING_FACTOR)); // output oversampler round trip
     InitPlugin();
+
+#ifdef FOX_CAPTURE
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    captureLog.startFromEnvironment("FoxVerb", 2, 2, Param_Count, getSampleRate(), parameters);
+#endif
 }
 /*--------------------------------------------------------------------*/
 
@@ -52,24 +66,60 @@ void FoxVerb::InitPlugin()
     /*.......................................*/
     // initialize reverb plug-in parameters
     InitPresets();
+    rev_stereoMode = FreeverbStereoMode::Stereo;
+
+#ifdef FOX_STAGE_PROFILING
+    stageProfiler.addStage("reverb");
+    stageProfiler.addStage("filters");
+#endif
+
+    /*.......................................*/
+    // the DSP objects are built by the first resume, at the host's sample rate
+    Reverb = nullptr;
+    outputLPF = nullptr;
+    outputHPF = nullptr;
+    tremolo = nullptr;
+    outputOversampler = nullptr;
+    filterSampleRate = 0.0;
+    _dspReady = false;
+    _releaseOnSuspend = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Build every DSP object at the current sample rate. Runs in resume(), never on the audio thread.
+void FoxVerb::allocateDSP()
+{
+    if (_dspReady)
+        return;
 
     // get current sample rate
     int currSampleRate = getSampleRate();
 
+    /*.......................................*/
+    // reserve the memory of every DSP object in one region, sized for the highest supported rate
+    if (currSampleRate > maxSampleRate)
+        maxSampleRate = currSampleRate;
+    dspArena.reserve(getArenaSize(maxSampleRate));
+
     /*.......................................*/
     // init Reverb
-    Reverb = new Freeverb();
-    Reverb->init(currSampleRate, rev_wet, rev_decay, rev_damping, rev_smearing, rev_spread, rev_preDelay);
+    Reverb = dspArena.create<VectorFreeverb>();
+    Reverb->setArena(&dspArena);
+    Reverb->reserve(maxSampleRate);
+    float dampingFrequency = mapValueIntoRange(1.0 - rev_damping, MIN_LPF_FREQUENCY, MAX_LPF_FREQUENCY);
+    Reverb->init(currSampleRate, rev_wet, rev_decay, dampingFrequency, rev_smearing, rev_spread, rev_preDelay);
+    Reverb->setStereoMode(rev_stereoMode);
 
     /*.......................................*/
     // init Output LPF filter
-    outputLPF = new LPFButterworth;
+    outputLPF = dspArena.create<LPFButterworth>();
     outputLPF->init(currSampleRate);
     outputLPF->setCutoffFrequency(rev_lpfFreq);
 
     /*.......................................*/
     // init Output HPF filter
-    outputHPF = new HPFButterworth;
+    outputHPF = dspArena.create<HPFButterworth>();
     outputHPF->init(currSampleRate);
     outputHPF->setCutoffFrequency(rev_hpfFreq);
 
@@ -81,24 +131,141 @@ void FoxVerb::InitPlugin()
 
     /*.......................................*/
     // init tremolo
-    tremolo = new Tremolo;
+    tremolo = dspArena.create<Tremolo>();
     modWaveform = OscillatorType::Sine;
     tremolo->init(currSampleRate, modWaveform, rev_modRate, rev_modDepth);
+
+    /*.......................................*/
+    // init output oversampler at the latency reported by the constructor, so that automated cutoffs
+    // switch factors while processing
+    outputOversampler = dspArena.create<HalfBandOversampler>();
+    outputOversampler->init(2);
+    outputOversampler->setMaxFactor(MAX_OVERSAMPLING_FACTOR);
+    filterSampleRate = currSampleRate;
+    updateOversampling();
+    _dspReady = true;
+
+    // bring the new objects up to date with every parameter changed since construction
+    parameterChanges.mark(parameterChanges.getHistory());
+    applyParameterChanges();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FoxVerb::releaseDSP()
+{
+    if (!_dspReady)
+        return;
+
+    // the objects go away with the arena, parameters and presets stay
+    _dspReady = false;
+    dspArena.release();
+    Reverb = nullptr;
+    outputLPF = nullptr;
+    outputHPF = nullptr;
+    tremolo = nullptr;
+    outputOversampler = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Bytes of DSP state carved out of the arena at the given sample rate. The Butterworth filters
+// and the tremolo come from the core library and keep any internal buffers of their own.
+size_t FoxVerb::getArenaSize(float sampleRate)
+{
+    return sizeof(VectorFreeverb) + VectorFreeverb::getMemorySize(sampleRate)
+        + sizeof(LPFButterworth) + sizeof(HPFButterworth) + sizeof(Tremolo)
+        + sizeof(HalfBandOversampler)
+        + 5 * ARENA_OBJECT_OVERHEAD + ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Run the output filter section oversampled only when a cutoff gets close to Nyquist, where the
+// bilinear transform warps the Butterworth responses differently at each sample rate.
+// Returns true when the factor changed and both filters were redesigned. Every factor runs padded
+// to the 4x latency, so a change takes effect at the next block.
+bool FoxVerb::updateOversampling()
+{
+    float sampleRate = getSampleRate();
+    float ratio = (rev_lpfFreq > rev_hpfFreq ? rev_lpfFreq : rev_hpfFreq) / sampleRate;
+    int factor = 1;
+    if (ratio > OVERSAMPLING_4X_CUTOFF_RATIO)
+        factor = 4;
+    else if (ratio > OVERSAMPLING_2X_CUTOFF_RATIO)
+        factor = 2;
+
+    outputOversampler->setFactor(factor);
+    float oversampledRate = sampleRate * outputOversampler->getFactor();
+    if (oversampledRate == filterSampleRate)
+        return false;
+
+    filterSampleRate = oversampledRate;
+    outputLPF->setSampleRate(filterSampleRate);
+    outputLPF->setCutoffFrequency(rev_lpfFreq);
+    outputHPF->setSampleRate(filterSampleRate);
+    outputHPF->setCutoffFrequency(rev_hpfFreq);
+    tremolo->setSampleRate(filterSampleRate);
+    return true;
 }
 /*--------------------------------------------------------------------*/
 
 /*--------------------------------------------------------------------*/
 // replace the "setSampleRate" method with user-defined one
+// The reverb's delay lines are reserved for maxSampleRate, so below it only lengths and
+// coefficients change. Hosts often repeat the current rate around transport start: nothing to do then.
 void FoxVerb::setSampleRate(float sampleRate)
 {
+    if (sampleRate == getSampleRate())
+        return;
+
+    CAPTURE_SAMPLE_RATE(captureLog, sampleRate);
+
     // Call AudioEffect "setSampleRate" method
     AudioEffect::setSampleRate(sampleRate);
 
+    // Nothing built yet: the first resume allocates at this rate
+    if (!_dspReady)
+        return;
+
     // Call setSampleRate on every needed module
     Reverb->setSampleRate(sampleRate);
-    tremolo->setSampleRate(sampleRate);
-    outputLPF->setSampleRate(sampleRate);
-    outputHPF->setSampleRate(sampleRate);
+
+    // Filters and tremolo run at the oversampled rate
+    filterSampleRate = 0.0;
+    updateOversampling();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Blocks of any size are processed in FILTER_BLOCK_SIZE chunks: the size is only recorded
+void FoxVerb::setBlockSize(VstInt32 blockSize)
+{
+    CAPTURE_BLOCK_SIZE(captureLog, blockSize);
+    AudioEffect::setBlockSize(blockSize);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The host turns processing on: build the DSP objects if they don't exist yet and apply the
+// changes made while suspended
+void FoxVerb::resume()
+{
+    CAPTURE_RESUME(captureLog);
+    allocateDSP();
+    if (!parameterChanges.isOpen())
+        applyParameterChanges();
+    AudioEffectX::resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FoxVerb::suspend()
+{
+    CAPTURE_SUSPEND(captureLog);
+    AudioEffectX::suspend();
+    if (_releaseOnSuspend)
+        releaseDSP();
 }
 /*--------------------------------------------------------------------*/
 
@@ -200,6 +367,21 @@ void FoxVerb::InitPresets()
   ------------------------------------------------------------------------------------------------------------ */
 void FoxVerb::processReplacing(float** inputs, float** outputs, VstInt32 sampleFrames)
 {
+    REALTIME_SCOPE("FoxVerb::processReplacing");
+    CAPTURE_INPUT(captureLog, inputs, sampleFrames);
+
+    // Parameter changes made since the last block take effect here, never in the middle of one
+    if (parameterChanges.beginBlock())
+        applyParameterChanges();
+
+    // Called before the first resume: nothing to process with
+    if (!_dspReady) {
+        memset(outputs[0], 0, sampleFrames * sizeof(float));
+        memset(outputs[1], 0, sampleFrames * sizeof(float));
+        CAPTURE_OUTPUT(captureLog, outputs, sampleFrames);
+        return;
+    }
+
     // Extract input and output buffers
     float* inL = inputs[0]; // buffer input left
     float* inR = inputs[1]; // buffer input right
@@ -207,40 +389,57 @@ void FoxVerb::processReplacing(float** inputs, float** outputs, VstInt32 sampleF
     float* outL = outputs[0]; // buffer output left
     float* outR = outputs[1]; // buffer output right
 
-    // Cycle over the sample frames number
-    for (int i = 0; i < sampleFrames; i++) {
+    // Cycle over the sample frames in chunks of FILTER_BLOCK_SIZE samples
+    for (int start = 0; start < sampleFrames; start += FILTER_BLOCK_SIZE) {
 
-        // Create arrays for Reverb processing
-        float rev_inputs[2] = { inL[i],  inR[i] };
-        float rev_outputs[2] = { 0.0, 0.0 };
+        int numSamples = sampleFrames - start < FILTER_BLOCK_SIZE ? sampleFrames - start : FILTER_BLOCK_SIZE;
+        float* blockInL = inL + start;
+        float* blockInR = inR + start;
+        float* blockOutL = outL + start;
+        float* blockOutR = outR + start;
 
         // Process Reverb
-        Reverb->processAudio(rev_inputs, rev_outputs);
+        {
+            PROFILE_STAGE(stageProfiler, Stage_reverb);
+            Reverb->processBlock(blockInL, blockInR, blockOutL, blockOutR, numSamples);
+        }
 
-        // Unpack output array
-        float outputL = rev_outputs[0];
-        float outputR = rev_outputs[1];
+        // Output filter section, oversampled when a cutoff is close to Nyquist
+        PROFILE_STAGE(stageProfiler, Stage_filters);
+        int oversampledFrames;
+        float* oversampledL = outputOversampler->upsample(0, blockOutL, numSamples, &oversampledFrames);
+        float* oversampledR = outputOversampler->upsample(1, blockOutR, numSamples, &oversampledFrames);
 
-        // Chorus 
-        //outputL = chorus->processAudio(outputL);
-        //outputR = chorus->processAudio(outputR);        
+        for (int i = 0; i < oversampledFrames; i++) {
 
-        // Output LPF processing
-        outputL = outputLPF->processAudio(outputL);
-        outputR = outputLPF->processAudio(outputR);
+            float outputL = oversampledL[i];
+            float outputR = oversampledR[i];
 
-        // Output HPF processing
-        outputL = outputHPF->processAudio(outputL);
-        outputR = outputHPF->processAudio(outputR);
+            // Chorus 
+            //outputL = chorus->processAudio(outputL);
+            //outputR = chorus->processAudio(outputR);        
 
-        //// Tremolo processing
-        outputL = tremolo->processAudio(outputL);
-        outputR = tremolo->processAudio(outputR);
+            // Output LPF processing
+            outputL = outputLPF->processAudio(outputL);
+            outputR = outputLPF->processAudio(outputR);
 
-        // Stereo spread processing + output allocation
-        outL[i] = outputL;
-        outR[i] = outputR;
+            // Output HPF processing
+            outputL = outputHPF->processAudio(outputL);
+            outputR = outputHPF->processAudio(outputR);
+
+            //// Tremolo processing
+            outputL = tremolo->processAudio(outputL);
+            outputR = tremolo->processAudio(outputR);
+
+            oversampledL[i] = outputL;
+            oversampledR[i] = outputR;
+        }
+
+        // Back to the host rate + output allocation
+        outputOversampler->downsample(0, blockOutL, numSamples);
+        outputOversampler->downsample(1, blockOutR, numSamples);
     }
+    CAPTURE_OUTPUT(captureLog, outputs, sampleFrames);
 }
 /*--------------------------------------------------------------------*/
 
@@ -266,89 +465,164 @@ float FoxVerb::mapValueOutsideRange(float value, float minValue, float maxValue)
   // set reverb parameters values
 void FoxVerb::setParameter(VstInt32 index, float value)
 {
+    REALTIME_SCOPE("FoxVerb::setParameter");
+
+    // store the value and mark what it invalidates, the next block applies it
     switch (index) {
     case Param_wet:
     {
         rev_wet = value;
-        Reverb->setReverbWet(rev_wet);
+        parameterChanges.mark(Dirty_wet);
         break;
     }
     case Param_decay:
     {
         rev_decay = value * MAX_REVERB_DECAY_IN_SECONDS;
-        Reverb->setReverbDecayInSeconds(rev_decay);
+        parameterChanges.mark(Dirty_decay);
         break;
     }
     case Param_smearing:
     {
         rev_smearing = value;
-        Reverb->setReverbSmearing(rev_smearing);
+        parameterChanges.mark(Dirty_smearing);
         break;
     }
     case Param_damping:
     {
         rev_damping = value;
-        float dampingFrequency = mapValueIntoRange(1.0 - rev_damping, MIN_LPF_FREQUENCY, MAX_LPF_FREQUENCY);
-        Reverb->setReverbDampingFrequency(dampingFrequency);
+        parameterChanges.mark(Dirty_damping);
         break;
     }
     case Param_lpfFreq:
     {
         rev_lpfFreq = exp(mapValueIntoRange(value, MIN_LPF_FREQUENCY_LOG, MAX_LPF_FREQUENCY_LOG));
-        outputLPF->setCutoffFrequency(rev_lpfFreq);
+        parameterChanges.mark(Dirty_lpf);
         break;
     }
     case Param_hpfFreq:
     {
         rev_hpfFreq = exp(mapValueIntoRange(value, MIN_HPF_FREQUENCY_LOG, MAX_HPF_FREQUENCY_LOG));
-        outputHPF->setCutoffFrequency(rev_hpfFreq);
+        parameterChanges.mark(Dirty_hpf);
         break;
     }
     case Param_preDelay:
     {
         rev_preDelay = value * MAX_PREDELAY_VALUE_IN_MS;
-        Reverb->setReverbPreDelayInMilliseconds(rev_preDelay);
+        parameterChanges.mark(Dirty_preDelay);
         break;
     }
     case Param_ModRate:
     {
         rev_modRate = mapValueIntoRange(value, MIN_MOD_RATE_IN_HZ, MAX_MOD_RATE_IN_HZ);
-        //chorus->setModRate(rev_modRate);
-        tremolo->setModRate(rev_modRate);
-        /*for (int i = 0; i < NUM_ALLPASS_FILTERS_IN; i++) {
-            apFiltersL_input[i].setModRate(rev_modRate);
-            apFiltersR_input[i].setModRate(rev_modRate);
-        }*/
-        /*for (int i = 0; i < NUM_ALLPASS_FILTERS_OUT; i++) {
-            apFiltersL_output[i].setModRate(rev_modRate);
-            apFiltersR_output[i].setModRate(rev_modRate);
-        }*/
+        parameterChanges.mark(Dirty_modRate);
         break;
     }
     case Param_ModDepth:
     {
         rev_modDepth = value;
-        //chorus->setModDepth(rev_modDepth);
-        tremolo->setModDepth(rev_modDepth);
-        /*for (int i = 0; i < NUM_ALLPASS_FILTERS_IN; i++) {
-            apFiltersL_input[i].setModDepth(rev_modDepth);
-            apFiltersR_input[i].setModDepth(rev_modDepth);
-        }*/
-        /*for (int i = 0; i < NUM_ALLPASS_FILTERS_OUT; i++) {
-            apFiltersL_output[i].setModDepth(rev_modDepth);
-            apFiltersR_output[i].setModDepth(rev_modDepth);
-        }*/
+        parameterChanges.mark(Dirty_modDepth);
         break;
     }
     case Param_spread:
     {
         rev_spread = value;
-        Reverb->setReverbSpread(rev_spread);
+        parameterChanges.mark(Dirty_spread);
+        break;
+    }
+    case Param_stereoMode:
+    {
+        rev_stereoMode = value < 0.5 ? FreeverbStereoMode::Stereo : FreeverbStereoMode::Mid;
+        parameterChanges.mark(Dirty_stereoMode);
         break;
     }
     default:
         break;
     }
+
+    // after the mark: a capture that records the change at a block start has it applied there too
+    CAPTURE_PARAMETER(captureLog, index, value);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// recompute each quantity invalidated since the last call, once, at the start of a block or on resume
+void FoxVerb::applyParameterChanges()
+{
+    // without DSP objects the changes stay pending, allocateDSP applies them
+    if (!_dspReady)
+        return;
+
+    uint32_t dirty = parameterChanges.take();
+    if (dirty == 0)
+        return;
+
+    if (dirty & Dirty_wet)
+        Reverb->setReverbWet(rev_wet);
+
+    if (dirty & Dirty_decay)
+        Reverb->setReverbDecayInSeconds(rev_decay);
+
+    if (dirty & Dirty_smearing)
+        Reverb->setReverbSmearing(rev_smearing);
+
+    if (dirty & Dirty_damping) {
+        float dampingFrequency = mapValueIntoRange(1.0 - rev_damping, MIN_LPF_FREQUENCY, MAX_LPF_FREQUENCY);
+        Reverb->setReverbDampingFrequency(dampingFrequency);
+    }
+
+    if (dirty & Dirty_preDelay)
+        Reverb->setReverbPreDelayInMilliseconds(rev_preDelay);
+
+    if (dirty & Dirty_spread)
+        Reverb->setReverbSpread(rev_spread);
+
+    if (dirty & Dirty_stereoMode)
+        Reverb->setStereoMode(rev_stereoMode);
+
+    // a new oversampling factor already redesigns both filters with the current cutoffs
+    if ((dirty & (Dirty_lpf | Dirty_hpf)) && !updateOversampling()) {
+        if (dirty & Dirty_lpf)
+            outputLPF->setCutoffFrequency(rev_lpfFreq);
+        if (dirty & Dirty_hpf)
+            outputHPF->setCutoffFrequency(rev_hpfFreq);
+    }
+
+    if (dirty & Dirty_modRate)
+        tremolo->setModRate(rev_modRate);
+
+    if (dirty & Dirty_modDepth)
+        tremolo->setModDepth(rev_modDepth);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FoxVerb::beginParameterChanges()
+{
+    parameterChanges.begin();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FoxVerb::commitParameterChanges()
+{
+    parameterChanges.end();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// the host brackets program loads with these, its setParameter calls are then applied by one block
+bool FoxVerb::beginSetProgram()
+{
+    beginParameterChanges();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool FoxVerb::endSetProgram()
+{
+    commitParameterChanges();
+    return true;
 }
 /*--------------------------------------------------------------------*/
 
@@ -408,6 +682,11 @@ float FoxVerb::getParameter(VstInt32 index)
         param = rev_spread;
         break;
     }
+    case Param_stereoMode:
+    {
+        param = rev_stereoMode == FreeverbStereoMode::Stereo ? 0.0 : 1.0;
+        break;
+    }
     default:
         break;
     }
@@ -449,6 +728,9 @@ void FoxVerb::getParameterLabel(VstInt32 index, char* label)
     case Param_spread:
         vst_strncpy(label, "", kVstMaxParamStrLen);
         break;
+    case Param_stereoMode:
+        vst_strncpy(label, "", kVstMaxParamStrLen);
+        break;
     default:
         break;
     }
@@ -490,6 +772,9 @@ void FoxVerb::getParameterDisplay(VstInt32 index, char* text)
     case Param_spread:
         float2string(rev_spread * 10, text, kVstMaxParamStrLen);
         break;
+    case Param_stereoMode:
+        vst_strncpy(text, rev_stereoMode == FreeverbStereoMode::Stereo ? "Stereo" : "Mid", kVstMaxParamStrLen);
+        break;
     default:
         break;
     }
@@ -531,6 +816,9 @@ void FoxVerb::getParameterName(VstInt32 index, char* text)
     case Param_spread:
         vst_strncpy(text, "Spread", kVstMaxParamStrLen);
         break;
+    case Param_stereoMode:
+        vst_strncpy(text, "Mode", kVstMaxParamStrLen);
+        break;
     default:
         break;
     }
@@ -543,13 +831,15 @@ void FoxVerb::getParameterName(VstInt32 index, char* text)
  ------------------------------------------------------------------------------------------------------------ */
 void FoxVerb::setProgram(VstInt32 program)
 {
+    REALTIME_SCOPE("FoxVerb::setProgram");
     // Call the current implementation of "setProgram"
     AudioEffect::setProgram(program);
 
     // Create an instante of ReverbPresets with current preset
     ReverbPresets* cp = &rev_presets[curProgram];
 
-    // Set each parameter
+    // Set each parameter, recomputing once at the end
+    beginParameterChanges();
     setParameter(Param_wet, cp->rev_wet);
     setParameter(Param_decay, cp->rev_decay / MAX_REVERB_DECAY_IN_SECONDS);
     setParameter(Param_damping, cp->rev_damping);
@@ -560,6 +850,7 @@ void FoxVerb::setProgram(VstInt32 program)
     setParameter(Param_lpfFreq, mapValueOutsideRange(log(cp->rev_lpfFreq), MIN_LPF_FREQUENCY_LOG, MAX_LPF_FREQUENCY_LOG));
     setParameter(Param_hpfFreq, mapValueOutsideRange(log(cp->rev_hpfFreq), MIN_HPF_FREQUENCY_LOG, MAX_HPF_FREQUENCY_LOG));
     setParameter(Param_ModRate, mapValueOutsideRange(cp->rev_modRate, MIN_MOD_RATE_IN_HZ, MAX_MOD_RATE_IN_HZ));
+    commitParameterChanges();
 }
 /*--------------------------------------------------------------------*/
 
@@ -585,6 +876,51 @@ bool FoxVerb::getProgramNameIndexed(VstInt32 category, VstInt32 index, char* tex
 /*--------------------------------------------------------------------*/
 
 
+/* ------------------------------------------------------------------------------------------------------------
+ ---------------------------------------------  STATE  --------------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+
+/*--------------------------------------------------------------------*/
+// serialize the whole state, the same chunk serves banks and single presets
+VstInt32 FoxVerb::getChunk(void** data, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+
+    return stateChunk.write(data, "FoxVerb", curProgram, parameters, Param_Count, nullptr, 0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// restore a chunk with a single transaction: each derived quantity is recomputed once
+VstInt32 FoxVerb::setChunk(void* data, VstInt32 byteSize, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    int32_t program = curProgram;
+
+    // sessions saved before the state went into chunks hold a VST parameter program or bank
+    if (!StateChunk::read(data, byteSize, "FoxVerb", &program, parameters, Param_Count, nullptr, 0)
+        && !StateChunk::readParameterBank(data, byteSize, cEffect.uniqueID, &program, parameters, Param_Count))
+        return 0;
+
+    beginParameterChanges();
+
+    // only select the program: the stored values override the preset ones
+    if (program >= 0 && program < NUM_PRESETS)
+        AudioEffect::setProgram(program);
+
+    for (int p = 0; p < Param_Count; p++)
+        setParameter(p, parameters[p]);
+
+    commitParameterChanges();
+    return 1;
+}
+/*--------------------------------------------------------------------*/
+
+
 /* ------------------------------------------------------------------------------------------------------------
  ---------------------------------------------  NAME  ---------------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
@@ -606,24 +942,45 @@ bool FoxVerb::getVendorString(char* name)
 /*--------------------------------------------------------------------*/
 
 /* ------------------------------------------------------------------------------------------------------------
- ------------------------------------------  DESTRUCTOR  ------------------------------------------------------
+ ----------------------------------------  HOST REQUESTS  -----------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
-FoxVerb::~FoxVerb()
+/*--------------------------------------------------------------------*/
+VstInt32 FoxVerb::canDo(char* text)
 {
-    //Free Reverb
-    Reverb->~Freeverb();
-
-    // destroy chorus
-    //chorus->~ModDelay();
-
-    // destroy lpf
-    outputLPF->~LPFButterworth();
-
-    // destroy hpf
-    outputHPF->~HPFButterworth();
-
-    // destroy tremolo
-    tremolo->~Tremolo();
+    if (strcmp(text, RELEASE_ON_SUSPEND_CAN_DO) == 0)
+        return 1;
+#ifdef FOX_STAGE_PROFILING
+    if (strcmp(text, PROFILER_CAN_DO) == 0)
+        return 1;
+#endif
+    return AudioEffectX::canDo(text);
 }
+/*--------------------------------------------------------------------*/
 
+/*--------------------------------------------------------------------*/
+// Release on suspend: lArg2 enables it. Stage statistics: lArg2 is the stage index, ptrArg a
+// StageStats to fill.
+VstIntPtr FoxVerb::vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg)
+{
+    if (lArg == RELEASE_ON_SUSPEND_VENDOR_OPCODE) {
+        CAPTURE_RELEASE_ON_SUSPEND(captureLog, lArg2 != 0);
+        _releaseOnSuspend = lArg2 != 0;
+        return 1;
+    }
+#ifdef FOX_STAGE_PROFILING
+    if (lArg == PROFILER_VENDOR_OPCODE)
+        return stageProfiler.getStats((int)lArg2, (StageStats*)ptrArg) ? 1 : 0;
+#endif
+    return AudioEffectX::vendorSpecific(lArg, lArg2, ptrArg, floatArg);
+}
+/*--------------------------------------------------------------------*/
 
+/* ------------------------------------------------------------------------------------------------------------
+ ------------------------------------------  DESTRUCTOR  ------------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+FoxVerb::~FoxVerb()
+{
+    // Free reverb, filters, tremolo and oversampler in one go
+    releaseDSP();
+    delete[] rev_presets;
+}
@@ -11,7 +11,15 @@
 #include "HPFButterworth.h"
 #include "LPFButterworth.h"
 #include "Tremolo.h"
-#include "Freeverb.h"
+#include "VectorFreeverb.h"
+#include "HalfBandOversampler.h"
+#include "Arena.h"
+#include "RealtimeCheck.h"
+#include "StageProfiler.h"
+#include "CaptureLog.h"
+#include "ParameterChanges.h"
+#include "StateChunk.h"
+#include "HostRequests.h"
 #include "../vstsdk2.4/public.sdk/source/vst2.x/audioeffectx.h"
 #include <math.h>
 
@@ -23,6 +31,11 @@
 #define MAX_HPF_FREQUENCY 17000.0
 #define MIN_HPF_FREQUENCY 10.0
 
+// Highest sample rate the buffers are reserved for; rates up to it switch without allocating
+#ifndef MAX_SUPPORTED_SAMPLE_RATE
+#define MAX_SUPPORTED_SAMPLE_RATE 192000.0
+#endif
+
 using namespace std;
 
 // declare enum for reverb's parameters
@@ -37,9 +50,32 @@ enum EfxParameter {
 	Param_hpfFreq,
 	Param_ModRate,
 	Param_ModDepth,
+	Param_stereoMode,
 	Param_Count
 };
 
+// Stages of processReplacing timed by the profiler
+enum EfxStage {
+	Stage_reverb = 0,
+	Stage_filters,
+	Stage_Count
+};
+
+// Derived state invalidated by parameter changes, recomputed once per transaction
+enum EfxDirtyFlag {
+	Dirty_wet = 1 << 0,
+	Dirty_decay = 1 << 1,
+	Dirty_preDelay = 1 << 2,
+	Dirty_damping = 1 << 3,
+	Dirty_spread = 1 << 4,
+	Dirty_smearing = 1 << 5,
+	Dirty_lpf = 1 << 6,
+	Dirty_hpf = 1 << 7,
+	Dirty_modRate = 1 << 8,
+	Dirty_modDepth = 1 << 9,
+	Dirty_stereoMode = 1 << 10
+};
+
 // Declare class Reverb
 class FoxVerb;
 
@@ -61,6 +97,13 @@ class FoxVerb : public AudioEffectX {
 	const float MAX_HPF_FREQUENCY_LOG = log(MAX_HPF_FREQUENCY);
 	const float MIN_HPF_FREQUENCY_LOG = log(MIN_HPF_FREQUENCY);
 
+	// Memory for all the DSP objects and buffers of this instance
+	Arena dspArena;
+	float maxSampleRate;
+	// DSP objects exist from the first resume() until a releasing suspend()
+	bool _dspReady;
+	bool _releaseOnSuspend;
+
 	// Initialize ReverbPresets instance
 	ReverbPresets* rev_presets;
 
@@ -68,7 +111,8 @@ class FoxVerb : public AudioEffectX {
 	float rev_wet, rev_smearing, rev_decay, rev_damping, rev_lpfFreq, rev_hpfFreq, rev_preDelay, rev_modRate, rev_modDepth, rev_spread;
 
 	// Freeverb
-	Freeverb* Reverb;
+	VectorFreeverb* Reverb;
+	FreeverbStereoMode rev_stereoMode;
 
 	// OscillatorType
 	OscillatorType modWaveform;
@@ -85,7 +129,29 @@ class FoxVerb : public AudioEffectX {
 	// Tremolo
 	Tremolo* tremolo;
 
+	// Oversampler wrapping the output filter section
+	HalfBandOversampler* outputOversampler;
+	float filterSampleRate;
+
+	// Pending updates of the open parameter transaction
+	ParameterChanges parameterChanges;
+
+	// Buffer handed to the host by getChunk
+	StateChunk stateChunk;
+
+#ifdef FOX_STAGE_PROFILING
+	StageProfiler stageProfiler;
+#endif
+#ifdef FOX_CAPTURE
+	CaptureLog captureLog;
+#endif
+
 	void InitPlugin();
+	bool updateOversampling();
+	void applyParameterChanges();
+	void allocateDSP();
+	void releaseDSP();
+	size_t getArenaSize(float sampleRate);
 	float mapValueIntoRange(float value, float minvalue, float maxValue);
 	float mapValueOutsideRange(float value, float minValue, float maxValue);
 	void InitPresets();
@@ -93,7 +159,7 @@ class FoxVerb : public AudioEffectX {
 public:
 
 
-	FoxVerb(audioMasterCallback audioMaster);
+	FoxVerb(audioMasterCallback audioMaster, float maxSampleRate = MAX_SUPPORTED_SAMPLE_RATE);
 	~FoxVerb();
 
 	// Processing
@@ -106,9 +172,25 @@ public:
 	virtual void getParameterDisplay(VstInt32 index, char* text) override;
 	virtual void getParameterName(VstInt32 index, char* text) override;
 	virtual void setSampleRate(float sampleRate) override;
+	virtual void setBlockSize(VstInt32 blockSize) override;
+	virtual void resume() override;
+	virtual void suspend() override;
 	virtual void setProgram(VstInt32 program) override;
 	virtual void getProgramName(char* name) override;
 	virtual bool getProgramNameIndexed(VstInt32 category, VstInt32 index, char* text) override;
+
+	// Parameter transactions: the changes made in between are applied together, by the first block
+	// after the commit
+	void beginParameterChanges();
+	void commitParameterChanges();
+	virtual bool beginSetProgram() override;
+	virtual bool endSetProgram() override;
+
+	// Whole state in one binary chunk
+	virtual VstInt32 getChunk(void** data, bool isPreset = false) override;
+	virtual VstInt32 setChunk(void* data, VstInt32 byteSize, bool isPreset = false) override;
+	virtual VstInt32 canDo(char* text) override;
+	virtual VstIntPtr vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg) override;
 };
 
 
@@ -0,0 +1,433 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFreeverb.cpp
+//  Freeverb with Jezar's tuning and gains. The combs of both channels run as one interleaved
+//  16-lane CombBank, or as the left channel's 8-lane half in mid mode.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "VectorFreeverb.h"
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+/*--------------------------------------------------------------------*/
+#define FREEVERB_MAX_COMB_LENGTH_IN_MS 40.0     // longest comb with full spread: 1640 / 44.1 kHz = 37.2 ms
+#define FREEVERB_MAX_AP_LENGTH_IN_MS 15.0       // longest allpass with full spread: 579 / 44.1 kHz = 13.1 ms
+#define FREEVERB_MAX_PREDELAY_IN_MS 300.0
+#define FREEVERB_TUNING_SAMPLE_RATE 44100.0     // rate the delays below are given at
+#define FREEVERB_STEREO_SPREAD 23               // samples the right delays sit above the left ones at full spread
+#define FREEVERB_FIXED_GAIN 0.015               // input gain
+#define FREEVERB_SCALE_WET 3.0
+#define FREEVERB_ALLPASS_FEEDBACK 0.5
+#define FREEVERB_SMEARING_RANGE 0.4             // smearing 0..1 moves the allpass feedback over 0.3..0.7
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Jezar's delays in samples at FREEVERB_TUNING_SAMPLE_RATE
+static const int COMB_TUNINGS[COMB_BANK_LANES] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+static const int ALLPASS_TUNINGS[FREEVERB_NUM_ALLPASS] = { 556, 441, 341, 225 };
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+FreeverbAllPass::FreeverbAllPass()
+{
+    _buffer = nullptr;
+    _bufferLength = 0;
+    _allocatedLength = 0;
+    _arena = nullptr;
+    _index = 0;
+    _delayInSamples = 1;
+    _gain = 0.0;
+}
+
+FreeverbAllPass::~FreeverbAllPass()
+{
+    releaseFloats(_arena, _buffer);
+}
+
+// The buffer is only replaced when it has to grow
+void FreeverbAllPass::reserve(int maxDelayInSamples)
+{
+    if (maxDelayInSamples + 1 <= _allocatedLength)
+        return;
+    releaseFloats(_arena, _buffer);
+    _buffer = allocateFloats(_arena, maxDelayInSamples + 1);
+    _allocatedLength = maxDelayInSamples + 1;
+}
+
+void FreeverbAllPass::init(int maxDelayInSamples)
+{
+    reserve(maxDelayInSamples);
+    _bufferLength = maxDelayInSamples + 1;
+    reset();
+}
+
+void FreeverbAllPass::reset()
+{
+    memset(_buffer, 0, _bufferLength * sizeof(float));
+    _index = 0;
+}
+
+void FreeverbAllPass::setDelayInSamples(int delayInSamples)
+{
+    if (delayInSamples < 1)
+        delayInSamples = 1;
+    if (delayInSamples > _bufferLength - 1)
+        delayInSamples = _bufferLength - 1;
+    _delayInSamples = delayInSamples;
+}
+
+float FreeverbAllPass::processAudio(float input)
+{
+    int readIndex = _index - _delayInSamples;
+    if (readIndex < 0)
+        readIndex += _bufferLength;
+    float delayed = _buffer[readIndex];
+    _buffer[_index] = input + _gain * delayed;
+    if (++_index >= _bufferLength)
+        _index = 0;
+    return delayed - input;
+}
+
+void FreeverbAllPass::processBlock(float* buffer, int numSamples)
+{
+    float* delayLine = _buffer;
+    int length = _bufferLength;
+    int index = _index;
+    int readIndex = index - _delayInSamples;
+    if (readIndex < 0)
+        readIndex += length;
+    float gain = _gain;
+
+    for (int i = 0; i < numSamples; i++) {
+        float delayed = delayLine[readIndex];
+        float input = buffer[i];
+        delayLine[index] = input + gain * delayed;
+        buffer[i] = delayed - input;
+        if (++index >= length)
+            index = 0;
+        if (++readIndex >= length)
+            readIndex = 0;
+    }
+    _index = index;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VectorFreeverb::VectorFreeverb()
+{
+    _sampleRate = 0.0;
+    _wet = 0.0;
+    _decayInSeconds = 1.0;
+    _dampingFrequency = 0.0;
+    _smearing = 0.0;
+    _spread = 0.0;
+    _preDelayInMs = 0.0;
+    _stereoMode = FreeverbStereoMode::Stereo;
+    _arena = nullptr;
+    _preDelay = nullptr;
+    _preDelayLength = 0;
+    _preDelayCapacity = 0;
+    _preDelayIndex = 0;
+    _preDelayInSamples = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VectorFreeverb::~VectorFreeverb()
+{
+    releaseFloats(_arena, _preDelay);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::setArena(Arena* arena)
+{
+    _arena = arena;
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].setArena(arena);
+        _allPassR[i].setArena(arena);
+    }
+    _combs.setArena(arena);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Bytes of delay lines allocated by init at the given sample rate
+size_t VectorFreeverb::getMemorySize(float sampleRate)
+{
+    size_t preDelayLength = (size_t)(FREEVERB_MAX_PREDELAY_IN_MS * 0.001 * sampleRate) + FREEVERB_MAX_BLOCK_SIZE;
+    size_t allPassLength = (size_t)(FREEVERB_MAX_AP_LENGTH_IN_MS * 0.001 * sampleRate) + 1;
+    int numAllPasses = 2 * FREEVERB_NUM_ALLPASS;
+    return preDelayLength * sizeof(float) + ARENA_ALIGNMENT
+        + numAllPasses * (allPassLength * sizeof(float) + ARENA_ALIGNMENT)
+        + CombBank::getMemorySize(sampleRate, FREEVERB_MAX_COMB_LENGTH_IN_MS, COMB_BANK_MAX_LANES);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::init(float sampleRate, float wet, float decayInSeconds, float dampingFrequency, float smearing, float spread, float preDelayInMs)
+{
+    _sampleRate = sampleRate;
+    _wet = wet;
+    _decayInSeconds = decayInSeconds;
+    _dampingFrequency = dampingFrequency;
+    _smearing = smearing;
+    _spread = spread;
+    _preDelayInMs = preDelayInMs;
+    allocate();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The pre-delay ring only grows; a smaller sample rate keeps using the larger buffer
+void VectorFreeverb::reservePreDelay(int length)
+{
+    if (length <= _preDelayCapacity)
+        return;
+    releaseFloats(_arena, _preDelay);
+    _preDelay = allocateFloats(_arena, length);
+    _preDelayCapacity = length;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::reserve(float maxSampleRate)
+{
+    reservePreDelay((int)(FREEVERB_MAX_PREDELAY_IN_MS * 0.001 * maxSampleRate) + FREEVERB_MAX_BLOCK_SIZE);
+    int maxAllPassLength = (int)(FREEVERB_MAX_AP_LENGTH_IN_MS * 0.001 * maxSampleRate);
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].reserve(maxAllPassLength);
+        _allPassR[i].reserve(maxAllPassLength);
+    }
+    _combs.reserve(maxSampleRate, FREEVERB_MAX_COMB_LENGTH_IN_MS, COMB_BANK_MAX_LANES);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Size every delay line for the current sample rate and apply the parameters
+void VectorFreeverb::allocate()
+{
+    // Room for the longest pre-delay plus one block, so a block can be written before its delayed span is read
+    _preDelayLength = (int)(FREEVERB_MAX_PREDELAY_IN_MS * 0.001 * _sampleRate) + FREEVERB_MAX_BLOCK_SIZE;
+    reservePreDelay(_preDelayLength);
+    memset(_preDelay, 0, _preDelayLength * sizeof(float));
+    _preDelayIndex = 0;
+
+    int maxAllPassLength = (int)(FREEVERB_MAX_AP_LENGTH_IN_MS * 0.001 * _sampleRate);
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].init(maxAllPassLength);
+        _allPassR[i].init(maxAllPassLength);
+    }
+    _combs.init(_sampleRate, FREEVERB_MAX_COMB_LENGTH_IN_MS, COMB_BANK_MAX_LANES);
+    _combs.setNumLanes(_stereoMode == FreeverbStereoMode::Stereo ? COMB_BANK_MAX_LANES : COMB_BANK_LANES);
+
+    updateDelays();
+    updateSmearing();
+    setReverbDecayInSeconds(_decayInSeconds);
+    setReverbDampingFrequency(_dampingFrequency);
+    setReverbPreDelayInMilliseconds(_preDelayInMs);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The tunings scale with the sample rate; the right channel's delays sit the stereo spread higher
+void VectorFreeverb::updateDelays()
+{
+    float offset = _spread * FREEVERB_STEREO_SPREAD;
+    float tuningToMs = 1000.0 / FREEVERB_TUNING_SAMPLE_RATE;
+    float tuningToSamples = _sampleRate / FREEVERB_TUNING_SAMPLE_RATE;
+
+    // Stereo lanes: left combs first, then the right ones
+    float combDelays[COMB_BANK_MAX_LANES];
+    for (int l = 0; l < COMB_BANK_LANES; l++) {
+        combDelays[l] = COMB_TUNINGS[l] * tuningToMs;
+        combDelays[COMB_BANK_LANES + l] = (COMB_TUNINGS[l] + offset) * tuningToMs;
+    }
+    _combs.setDelaysInMilliseconds(combDelays);
+
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].setDelayInSamples((int)(ALLPASS_TUNINGS[i] * tuningToSamples + 0.5));
+        _allPassR[i].setDelayInSamples((int)((ALLPASS_TUNINGS[i] + offset) * tuningToSamples + 0.5));
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Smearing 0.5 is Freeverb's own allpass feedback
+void VectorFreeverb::updateSmearing()
+{
+    float gain = FREEVERB_ALLPASS_FEEDBACK + (_smearing - 0.5) * FREEVERB_SMEARING_RANGE;
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].setGain(gain);
+        _allPassR[i].setGain(gain);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::setSampleRate(float sampleRate)
+{
+    _sampleRate = sampleRate;
+    allocate();
+}
+
+void VectorFreeverb::setReverbWet(float wet)
+{
+    _wet = wet;
+}
+
+void VectorFreeverb::setReverbDecayInSeconds(float decayInSeconds)
+{
+    _decayInSeconds = decayInSeconds;
+    _combs.setDecayInSeconds(_decayInSeconds);
+}
+
+void VectorFreeverb::setReverbDampingFrequency(float dampingFrequency)
+{
+    _dampingFrequency = dampingFrequency;
+    _combs.setDampingFrequency(_dampingFrequency);
+}
+
+void VectorFreeverb::setReverbSmearing(float smearing)
+{
+    _smearing = smearing;
+    updateSmearing();
+}
+
+void VectorFreeverb::setReverbSpread(float spread)
+{
+    _spread = spread;
+    updateDelays();
+}
+
+void VectorFreeverb::setReverbPreDelayInMilliseconds(float preDelayInMs)
+{
+    _preDelayInMs = preDelayInMs;
+    int delay = (int)(_preDelayInMs * 0.001 * _sampleRate);
+    int maxDelay = _preDelayLength - FREEVERB_MAX_BLOCK_SIZE;
+    _preDelayInSamples = delay > maxDelay ? maxDelay : delay;
+}
+
+// Switching only changes the active lanes of the comb bank, so it does not allocate
+void VectorFreeverb::setStereoMode(FreeverbStereoMode mode)
+{
+    if (mode == _stereoMode)
+        return;
+    _stereoMode = mode;
+    _combs.setNumLanes(_stereoMode == FreeverbStereoMode::Stereo ? COMB_BANK_MAX_LANES : COMB_BANK_LANES);
+    updateDelays();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::processAudio(float* in, float* out)
+{
+    // Pre-delay of the mono input
+    _preDelay[_preDelayIndex] = (in[0] + in[1]) * FREEVERB_FIXED_GAIN;
+    int readIndex = _preDelayIndex - _preDelayInSamples;
+    if (readIndex < 0)
+        readIndex += _preDelayLength;
+    float x = _preDelay[readIndex];
+    if (++_preDelayIndex >= _preDelayLength)
+        _preDelayIndex = 0;
+
+    // Parallel combs, both channels in one pass, or the left ones for both
+    float yL, yR;
+    if (_stereoMode == FreeverbStereoMode::Stereo)
+        _combs.processStereo(x, x, &yL, &yR);
+    else
+        yL = yR = _combs.processAudio(x);
+
+    // Allpasses in series
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        yL = _allPassL[i].processAudio(yL);
+        yR = _allPassR[i].processAudio(yR);
+    }
+
+    // Wet / dry mix
+    out[0] = _wet * FREEVERB_SCALE_WET * yL + (1.0 - _wet) * in[0];
+    out[1] = _wet * FREEVERB_SCALE_WET * yR + (1.0 - _wet) * in[1];
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Copy a span into / out of a ring buffer with at most two contiguous copies
+static void copyIntoRing(float* ring, int ringLength, int index, const float* source, int numSamples)
+{
+    int firstPart = ringLength - index < numSamples ? ringLength - index : numSamples;
+    memcpy(ring + index, source, firstPart * sizeof(float));
+    memcpy(ring, source + firstPart, (numSamples - firstPart) * sizeof(float));
+}
+
+static void copyFromRing(const float* ring, int ringLength, int index, float* destination, int numSamples)
+{
+    int firstPart = ringLength - index < numSamples ? ringLength - index : numSamples;
+    memcpy(destination, ring + index, firstPart * sizeof(float));
+    memcpy(destination + firstPart, ring, (numSamples - firstPart) * sizeof(float));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Output = wetGain * wet + dryGain * dry, four samples at a time
+static void mixWetDry(const float* wet, const float* dry, float* output, float wetGain, float dryGain, int numSamples)
+{
+    __m128 wetGainV = _mm_set1_ps(wetGain);
+    __m128 dryGainV = _mm_set1_ps(dryGain);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 w = _mm_mul_ps(_mm_loadu_ps(wet + i), wetGainV);
+        __m128 d = _mm_mul_ps(_mm_loadu_ps(dry + i), dryGainV);
+        _mm_storeu_ps(output + i, _mm_add_ps(w, d));
+    }
+    for (; i < numSamples; i++)
+        output[i] = wetGain * wet[i] + dryGain * dry[i];
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::processChunk(const float* inL, const float* inR, float* outL, float* outR, int numSamples)
+{
+    // Mono input with Freeverb's input gain
+    for (int i = 0; i < numSamples; i++)
+        _block[i] = (inL[i] + inR[i]) * FREEVERB_FIXED_GAIN;
+
+    // Pre-delay: write the block, then read back the delayed span
+    copyIntoRing(_preDelay, _preDelayLength, _preDelayIndex, _block, numSamples);
+    int readIndex = _preDelayIndex - _preDelayInSamples;
+    if (readIndex < 0)
+        readIndex += _preDelayLength;
+    copyFromRing(_preDelay, _preDelayLength, readIndex, _block, numSamples);
+    _preDelayIndex += numSamples;
+    if (_preDelayIndex >= _preDelayLength)
+        _preDelayIndex -= _preDelayLength;
+
+    // Parallel combs, both channels in one pass, or the left ones for both
+    if (_stereoMode == FreeverbStereoMode::Stereo)
+        _combs.processStereoBlock(_block, _block, _wetL, _wetR, numSamples);
+    else {
+        _combs.processBlock(_block, _wetL, numSamples);
+        memcpy(_wetR, _wetL, numSamples * sizeof(float));
+    }
+
+    // Allpasses in series, one stage over the whole block at a time
+    for (int i = 0; i < FREEVERB_NUM_ALLPASS; i++) {
+        _allPassL[i].processBlock(_wetL, numSamples);
+        _allPassR[i].processBlock(_wetR, numSamples);
+    }
+
+    // Wet / dry mix (in place safe: each output sample only reads the same input index)
+    mixWetDry(_wetL, inL, outL, _wet * FREEVERB_SCALE_WET, 1.0 - _wet, numSamples);
+    mixWetDry(_wetR, inR, outR, _wet * FREEVERB_SCALE_WET, 1.0 - _wet, numSamples);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFreeverb::processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples)
+{
+    for (int start = 0; start < numSamples; start += FREEVERB_MAX_BLOCK_SIZE) {
+        int chunk = numSamples - start < FREEVERB_MAX_BLOCK_SIZE ? numSamples - start : FREEVERB_MAX_BLOCK_SIZE;
+        processChunk(inL + start, inR + start, outL + start, outR + start, chunk);
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,115 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFreeverb.h
+//  Freeverb with Jezar's tuning and gains: pre-delay, the mono input into eight lowpass-feedback
+//  combs and four series allpasses per channel, the right channel's delays spread above the left
+//  ones. The combs of both channels run as one interleaved 16-lane CombBank; the cheaper mid mode
+//  runs only the left eight and feeds their sum to both allpass chains, whose tunings still differ
+//  by the spread.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "CombBank.h"
+
+#define FREEVERB_NUM_ALLPASS 4
+#define FREEVERB_MAX_BLOCK_SIZE 256
+
+// Comb bank layout
+enum class FreeverbStereoMode {
+	Stereo = 0,		// 8 combs per channel, L and R interleaved in one 16-lane bank
+	Mid				// the left 8 combs only, stereo from the allpass chains (half the comb CPU)
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Freeverb's allpass: v[n] = x[n] + g * v[n - D], y[n] = v[n - D] - x[n]
+class FreeverbAllPass {
+
+	float* _buffer;
+	int _bufferLength;
+	int _allocatedLength;
+	Arena* _arena;
+	int _index;
+	int _delayInSamples;
+	float _gain;
+
+public:
+
+	FreeverbAllPass();
+	~FreeverbAllPass();
+
+	void setArena(Arena* arena) { _arena = arena; }
+	void reserve(int maxDelayInSamples);
+	void init(int maxDelayInSamples);
+	void reset();
+	void setDelayInSamples(int delayInSamples);
+	void setGain(float gain) { _gain = gain; }
+	float processAudio(float input);
+	void processBlock(float* buffer, int numSamples);
+};
+
+//-------------------------------------------------------------------------------------------------------
+class VectorFreeverb {
+
+	// Reverb parameters
+	float _sampleRate;
+	float _wet;
+	float _decayInSeconds;
+	float _dampingFrequency;
+	float _smearing;
+	float _spread;
+	float _preDelayInMs;
+	FreeverbStereoMode _stereoMode;
+	Arena* _arena;
+
+	// Pre-delay line of the mono input
+	float* _preDelay;
+	int _preDelayLength;
+	int _preDelayCapacity;
+	int _preDelayIndex;
+	int _preDelayInSamples;
+
+	// Allpasses per channel, comb bank shared by both channels
+	FreeverbAllPass _allPassL[FREEVERB_NUM_ALLPASS];
+	FreeverbAllPass _allPassR[FREEVERB_NUM_ALLPASS];
+	CombBank _combs;
+
+	// Scratch buffers for block processing
+	float _block[FREEVERB_MAX_BLOCK_SIZE];
+	float _wetL[FREEVERB_MAX_BLOCK_SIZE];
+	float _wetR[FREEVERB_MAX_BLOCK_SIZE];
+
+	void reservePreDelay(int length);
+	void allocate();
+	void processChunk(const float* inL, const float* inR, float* outL, float* outR, int numSamples);
+	void updateDelays();
+	void updateSmearing();
+
+public:
+
+	VectorFreeverb();
+	~VectorFreeverb();
+
+	// Carve every delay line out of the given arena instead of the heap (call before init)
+	void setArena(Arena* arena);
+	static size_t getMemorySize(float sampleRate);
+
+	// Allocate up front for the highest sample rate, so init / setSampleRate below it never allocate
+	void reserve(float maxSampleRate);
+
+	void init(float sampleRate, float wet, float decayInSeconds, float dampingFrequency, float smearing, float spread, float preDelayInMs);
+	void setSampleRate(float sampleRate);
+	void setReverbWet(float wet);
+	void setReverbDecayInSeconds(float decayInSeconds);
+	void setReverbDampingFrequency(float dampingFrequency);
+	void setReverbSmearing(float smearing);
+	void setReverbSpread(float spread);
+	void setReverbPreDelayInMilliseconds(float preDelayInMs);
+	void setStereoMode(FreeverbStereoMode mode);
+	FreeverbStereoMode getStereoMode() { return _stereoMode; }
+
+	// Process one stereo frame: in[2] -> out[2]
+	void processAudio(float* in, float* out);
+
+	// Process a block of any length, stage by stage in chunks of FREEVERB_MAX_BLOCK_SIZE
+	void processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples);
+};
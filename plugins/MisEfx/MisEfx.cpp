@@ -9,6 +9,7 @@
 #define _USE_MATH_DEFINES
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "constants.h"
 
 /*--------------------------------------------------------------------*/
@@ -22,10 +23,17 @@
 #define EARLYREFL_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
 #define DIFFUSER_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
 #define FEEDBACK_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
+#ifndef DELAY_TABLE_MODE
+#define DELAY_TABLE_MODE false                  // true: delay sets read DelayRandom's precomputed table
+#endif
 #define OUTPUT_LPF_TYPE LPFilterType::Shelving
 #define DAMPING_LPF_TYPE LPFilterType::Vicanek
 #define OUTPUT_HPF_TYPE HPFilterType::Shelving
 #define DIFFUSION_LOGIC DiffuserDelayLogic::Doubled
+#ifndef DIFFUSION_ENGINE
+#define DIFFUSION_ENGINE DiffusionEngine::Chain
+#endif
+#define FDN_DIFFUSION_STEPS (DIFFUSION_ENGINE == DiffusionEngine::Velvet ? 0 : NUMBER_OF_DIFFUSION_STEPS)
 #define MIN_DAMPING_FREQUENCY 200.0
 #define MAX_DAMPING_FREQUENCY 20000.0
 #define MAX_MOD_RATE 5.0
@@ -33,6 +41,10 @@
 #define HPF_FILTER_MIN_FREQ 40.0
 #define LPF_FILTER_MAX_FREQ 20000.0
 #define HPF_FILTER_MAX_FREQ 7000.0
+#define FDN_BLOCK_SIZE VECTOR_FDN_BLOCK_SIZE
+#ifndef FEEDBACK_MATRIX_TYPE
+#define FEEDBACK_MATRIX_TYPE FeedbackMatrixType::Householder
+#endif
 /*--------------------------------------------------------------------*/
 
 const float MIN_DAMPING_FREQUENCY_LOG = log(MIN_DAMPING_FREQUENCY);
@@ -42,13 +54,22 @@ const float LPF_FILTER_MIN_FREQ_LOG = log(LPF_FILTER_MIN_FREQ);
 
 /*--------------------------------------------------------------------*/
 // Reverb class constructor
-Feedverb::Feedverb(audioMasterCallback audioMaster)
+Feedverb::Feedverb(audioMasterCallback audioMaster, float maxSampleRate)
     : AudioEffectX(audioMaster, NUM_PRESETS, Param_Count) // n program, n parameters
 {
+    _maxSampleRate = maxSampleRate;
     setNumInputs(2);		// stereo in
-    setNumOutputs(2);		// stereo out
+    setNumOutputs(NUM_REVERB_OUTPUTS);	// stereo or surround out
     setUniqueID('vMis');	// identify
+    programsAreChunks();	// state is saved with getChunk/setChunk
     InitPlugin();
+
+#ifdef FOX_CAPTURE
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    captureLog.startFromEnvironment("Feedverb", 2, NUM_REVERB_OUTPUTS, Param_Count, getSampleRate(), parameters);
+#endif
 }
 /*--------------------------------------------------------------------*/
 
@@ -70,31 +91,61 @@ void Feedverb::InitPlugin()
     // get current sample rate
     int sampleRate = getSampleRate();
 
+    // reserve the memory of every DSP object in one region, sized for the highest supported rate
+    if (sampleRate > _maxSampleRate)
+        _maxSampleRate = sampleRate;
+    size_t arenaSize = sizeof(VectorFDN) + ARENA_OBJECT_OVERHEAD
+        + VectorFDN::getMemorySize(DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, FDN_DIFFUSION_STEPS, DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, _maxSampleRate, MULTIRATE_MAX_FACTOR);
+    if (DIFFUSION_ENGINE == DiffusionEngine::Velvet)
+        arenaSize += sizeof(VelvetDiffuser) + ARENA_OBJECT_OVERHEAD + VelvetDiffuser::getMemorySize(_maxSampleRate);
+    dspArena.reserve(arenaSize);
+
+#ifdef FOX_STAGE_PROFILING
+    stageProfiler.addStage("fdn");
+#endif
+
     fdnver_modFeed = 0.4;
     fdnver_modRate = 0.0;
     fdnver_modDepth = 0.0;
     fdnver_mix = 0.5;
     updateMix();
     fdnver_roomSize = 0.5;
+    fdnver_early = 0.0;
+    _delaySeed = DEFAULT_DELAY_SEED;
     fdnver_highfreq = 0.6;    
     fdnver_modMix = 0.5;
     fdnver_spread = 1.0;
     fdnver_freqDamp = 0.5;
-    fdnver_lowfreq = MAX_LPF_FREQUENCY;
+    fdnver_lowfreq = LPF_FILTER_MAX_FREQ;
     fdnver_stereoSpread = 0.5;
     fdnver_decay = 0.2;
     fdnver_lpftype = 0.61;
-    fdnver_highfreq = MIN_HPF_FREQUENCY;
+    fdnver_highfreq = HPF_FILTER_MIN_FREQ;
 
     /*.......................................*/
     // Create FDN objects
-    fdnver_FDN = new FDN(2, DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, 2, NUMBER_OF_DIFFUSION_STEPS, 1);
+    fdnver_FDN = dspArena.create<VectorFDN>(DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, FEEDBACK_MATRIX_TYPE, FDN_DIFFUSION_STEPS);
+    fdnver_FDN->setArena(&dspArena);
+    fdnver_FDN->setMaxDecimationFactor(MULTIRATE_MAX_FACTOR);
+    fdnver_FDN->setDelayTableMode(DELAY_TABLE_MODE);
+    fdnver_FDN->setNumOutputs(NUM_REVERB_OUTPUTS);
+    fdnver_FDN->reserve(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, _maxSampleRate);
+
+    // Velvet diffuser, before the room size draws its taps
+    fdnver_diffuser = nullptr;
+    if (DIFFUSION_ENGINE == DiffusionEngine::Velvet) {
+        fdnver_diffuser = dspArena.create<VelvetDiffuser>();
+        fdnver_diffuser->setArena(&dspArena);
+        fdnver_diffuser->setDelayTableMode(DELAY_TABLE_MODE);
+        fdnver_diffuser->reserve(_maxSampleRate);
+        fdnver_diffuser->init(sampleRate);
+    }
 
     // Initialize objects (allocate delay lines)
     fdnver_FDN->initialize(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, sampleRate);
 
     // Set room size
-    fdnver_FDN->setRoomSize(fdnver_roomSize, DIFFUSION_LOGIC, DIFFUSER_DELAY_DISTRIBUTION, FEEDBACK_DELAY_DISTRIBUTION);
+    updateRoomSize();
 
     // Set decay
     fdnver_FDN->setDecayInSeconds(fdnver_decay * MAX_REVERB_DECAY_IN_SECONDS);
@@ -116,8 +167,14 @@ void Feedverb::InitPlugin()
     // stereo spread
     fdnver_FDN->setStereoSpread(fdnver_stereoSpread);
 
+    // early reflections: the diffused input, at the host rate
+    fdnver_FDN->setEarlyLevel(fdnver_early);
+
     // output mixing mode
     fdnver_FDN->setMixMode(MixMode::First);    
+
+    // LFE low pass
+    surroundOutputs.setSampleRate(sampleRate);
 }
 
 /*--------------------------------------------------------------------*/
@@ -127,15 +184,71 @@ void Feedverb::updateMix() {
     _dry = cos(fdnver_mix * M_PI * 0.5);
 }
 
+// Draw the FDN's delays for the current room size from the seed
+void Feedverb::drawDelaySet() {
+    fdnver_FDN->setSeed(_delaySeed);
+    fdnver_FDN->setRoomSize(fdnver_roomSize, DIFFUSION_LOGIC, DIFFUSER_DELAY_DISTRIBUTION, FEEDBACK_DELAY_DISTRIBUTION);
+}
+
+void Feedverb::updateRoomSize() {
+    drawDelaySet();
+
+    // the velvet filters follow the room size too
+    uint32_t roomSeed = DelayRandom::deriveSeed(_delaySeed, fdnver_roomSize, 0);
+    if (fdnver_diffuser) {
+        fdnver_diffuser->setSeed(roomSeed);
+        fdnver_diffuser->setLengthInMilliseconds(VELVET_MIN_LENGTH_IN_MS + fdnver_roomSize * (VELVET_MAX_LENGTH_IN_MS - VELVET_MIN_LENGTH_IN_MS));
+    }
+}
+
 /*--------------------------------------------------------------------*/
 // replace the "setSampleRate" method with user-defined one
+// Hosts often repeat the current rate around transport start: nothing to do then.
+// The FDN and the diffuser are reserved for _maxSampleRate and don't allocate below it, so the
+// rate may change from the audio thread without suspending.
 void Feedverb::setSampleRate(float sampleRate)
 {
+    if (sampleRate == getSampleRate())
+        return;
+
+    CAPTURE_SAMPLE_RATE(captureLog, sampleRate);
+
     // Call AudioEffect "setSampleRate" method
     AudioEffect::setSampleRate(sampleRate);
 
     // Call setSampleRate on every needed module
     fdnver_FDN->setSampleRate(sampleRate);
+    if (fdnver_diffuser)
+        fdnver_diffuser->setSampleRate(sampleRate);
+    surroundOutputs.setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Blocks of any size are processed sample by sample: the size is only recorded
+void Feedverb::setBlockSize(VstInt32 blockSize)
+{
+    CAPTURE_BLOCK_SIZE(captureLog, blockSize);
+    AudioEffect::setBlockSize(blockSize);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The DSP objects live as long as the instance: resume only applies the changes made while suspended
+void Feedverb::resume()
+{
+    CAPTURE_RESUME(captureLog);
+    if (!parameterChanges.isOpen())
+        applyParameterChanges();
+    AudioEffectX::resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Feedverb::suspend()
+{
+    CAPTURE_SUSPEND(captureLog);
+    AudioEffectX::suspend();
 }
 /*--------------------------------------------------------------------*/
 
@@ -233,28 +346,43 @@ void Feedverb::setSampleRate(float sampleRate)
   ------------------------------------------------------------------------------------------------------------ */
 void Feedverb::processReplacing(float** inputs, float** outputs, VstInt32 sampleFrames)
 {
-    // Extract input and output buffers
+    REALTIME_SCOPE("Feedverb::processReplacing");
+    CAPTURE_INPUT(captureLog, inputs, sampleFrames);
+
+    // Parameter changes made since the last block take effect here, never in the middle of one
+    if (parameterChanges.beginBlock())
+        applyParameterChanges();
+
+    // Extract input buffers, outputs are NUM_REVERB_OUTPUTS buffers
     float* inL = inputs[0]; // buffer input left
     float* inR = inputs[1]; // buffer input right
 
-    float* outL = outputs[0]; // buffer output left
-    float* outR = outputs[1]; // buffer output right
-    
-    // Cycle over the sample frames number
-    for (int i = 0; i < sampleFrames; i++) {      
-        float input[2]  = { inL[i], inR[i] };
-        float output[2] = {0.0, 0.0};
+    PROFILE_STAGE(stageProfiler, Stage_fdn);
+
+    // Cycle over the sample frames in chunks of FDN_BLOCK_SIZE samples
+    for (int start = 0; start < sampleFrames; start += FDN_BLOCK_SIZE) {
 
-        fdnver_FDN->processAudio(input, output);
-        //float yn = chorus->processAudio(inL[i]);
-        //output[0] = modDel->processAudio(inL[i]);
-        //output[1] = modDel->processAudio(inR[i]);
+        int numSamples = sampleFrames - start < FDN_BLOCK_SIZE ? sampleFrames - start : FDN_BLOCK_SIZE;
 
-        outL[i] = output[0] * _wet + inL[i] * _dry;
-        outR[i] = output[1] * _wet + inR[i] * _dry;
-        //outL[i] = yn * _wet + inL[i] * _dry;
-        //outR[i] = yn * _wet + inR[i] * _dry;
+        // Velvet diffusion, then the FDN, which decimates its tank itself and adds no latency
+        const float* fdnInL = inL + start;
+        const float* fdnInR = inR + start;
+        float diffusedL[FDN_BLOCK_SIZE], diffusedR[FDN_BLOCK_SIZE];
+        if (fdnver_diffuser) {
+            fdnver_diffuser->processBlock(fdnInL, fdnInR, diffusedL, diffusedR, numSamples);
+            fdnInL = diffusedL;
+            fdnInR = diffusedR;
+        }
+        float wetBuffers[NUM_REVERB_OUTPUTS][FDN_BLOCK_SIZE];
+        float* wet[NUM_REVERB_OUTPUTS];
+        for (int c = 0; c < NUM_REVERB_OUTPUTS; c++)
+            wet[c] = wetBuffers[c];
+        fdnver_FDN->processBlock(fdnInL, fdnInR, wet, numSamples);
+
+        // Dry signal on the stereo pair, the LFE from both
+        surroundOutputs.mix(wet, inL + start, inR + start, _wet, _dry, outputs, start, numSamples);
     }
+    CAPTURE_OUTPUT(captureLog, outputs, sampleFrames);
 }
 /*--------------------------------------------------------------------*/
 
@@ -265,58 +393,157 @@ void Feedverb::processReplacing(float** inputs, float** outputs, VstInt32 sample
   // set reverb parameters values
 void Feedverb::setParameter(VstInt32 index, float value)
 {
+    REALTIME_SCOPE("Feedverb::setParameter");
+
+    // store the value and mark what it invalidates, the next block applies it
     switch (index) {
     case Param_mix: {
         fdnver_mix = value;   
-        updateMix();
+        parameterChanges.mark(Dirty_mix);
         break;
     }    
     case Param_roomSize: {
         fdnver_roomSize = value;
-        fdnver_FDN->setRoomSize(fdnver_roomSize, DIFFUSION_LOGIC, DIFFUSER_DELAY_DISTRIBUTION, FEEDBACK_DELAY_DISTRIBUTION);
+        parameterChanges.mark(Dirty_roomSize);
         break;
     }
     case Param_decay: {
         fdnver_decay = value;
-        fdnver_FDN->setDecayInSeconds(fdnver_decay * MAX_REVERB_DECAY_IN_SECONDS);
+        parameterChanges.mark(Dirty_decay);
         break;
     }
     case Param_spread: {
         fdnver_spread = value;
-        fdnver_FDN->setStereoSpread(value);
+        parameterChanges.mark(Dirty_spread);
         break;
     }
     case Param_modDepth: {
         fdnver_modDepth = value;
-        fdnver_FDN->setModDepth(fdnver_modDepth);
+        parameterChanges.mark(Dirty_modDepth);
         break;
     }
     case Param_modRate: {
         fdnver_modRate = value;
-        fdnver_FDN->setModRate(fdnver_modRate * MAX_MOD_RATE);
+        parameterChanges.mark(Dirty_modRate);
         break;
     }
     case Param_freqDamp: { 
         fdnver_freqDamp = value;
-        //float freq = mapValueIntoRange(1.0 - fdnver_freqDamp, MIN_DAMPING_FREQUENCY, MAX_DAMPING_FREQUENCY);
-        float freq = exp(mapValueIntoRange(1.0 - fdnver_freqDamp, MIN_DAMPING_FREQUENCY_LOG, MAX_DAMPING_FREQUENCY_LOG));
-        fdnver_FDN->setDampingFrequency(freq);
+        parameterChanges.mark(Dirty_damping);
         break;
     }
     case Param_lpf: {
         fdnver_lowfreq = exp(mapValueIntoRange(value, LPF_FILTER_MIN_FREQ_LOG, LPF_FILTER_MAX_FREQ_LOG));
-        fdnver_FDN->setLowPassFrequency(fdnver_lowfreq);
+        parameterChanges.mark(Dirty_lpf);
+        break;
+    }
+    case Param_early: {
+        fdnver_early = value;
+        parameterChanges.mark(Dirty_early);
         break;
     }
     case Param_hpf: {
         //fdnver_highfreq = exp(mapValueIntoRange(value, MIN_HPF_FREQUENCY_LOG, MAX_HPF_FREQUENCY_LOG));
         fdnver_highfreq = mapValueIntoRange(value, HPF_FILTER_MIN_FREQ, HPF_FILTER_MAX_FREQ);
-        fdnver_FDN->setHighPassFrequency(fdnver_highfreq);
+        parameterChanges.mark(Dirty_hpf);
         break;
     }    
     default:
         break;
     }
+
+    // after the mark: a capture that records the change at a block start has it applied there too
+    CAPTURE_PARAMETER(captureLog, index, value);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// recompute each quantity invalidated since the last call, once, at the start of a block or on resume
+void Feedverb::applyParameterChanges()
+{
+    uint32_t dirty = parameterChanges.take();
+    if (dirty == 0)
+        return;
+
+    if (dirty & Dirty_mix)
+        updateMix();
+
+    // new delay set first, the gains below are computed on it
+    if (dirty & Dirty_roomSize)
+        updateRoomSize();
+
+    if (dirty & Dirty_decay)
+        fdnver_FDN->setDecayInSeconds(fdnver_decay * MAX_REVERB_DECAY_IN_SECONDS);
+
+    if (dirty & Dirty_spread)
+        fdnver_FDN->setStereoSpread(fdnver_spread);
+
+    if (dirty & Dirty_early)
+        fdnver_FDN->setEarlyLevel(fdnver_early);
+
+    if (dirty & Dirty_modDepth)
+        fdnver_FDN->setModDepth(fdnver_modDepth);
+
+    if (dirty & Dirty_modRate)
+        fdnver_FDN->setModRate(fdnver_modRate * MAX_MOD_RATE);
+
+    if (dirty & Dirty_damping) {
+        //float freq = mapValueIntoRange(1.0 - fdnver_freqDamp, MIN_DAMPING_FREQUENCY, MAX_DAMPING_FREQUENCY);
+        float freq = exp(mapValueIntoRange(1.0 - fdnver_freqDamp, MIN_DAMPING_FREQUENCY_LOG, MAX_DAMPING_FREQUENCY_LOG));
+        fdnver_FDN->setDampingFrequency(freq);
+    }
+
+    if (dirty & Dirty_lpf)
+        fdnver_FDN->setLowPassFrequency(fdnver_lowfreq);
+
+    if (dirty & Dirty_hpf)
+        fdnver_FDN->setHighPassFrequency(fdnver_highfreq);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Feedverb::beginParameterChanges()
+{
+    parameterChanges.begin();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Feedverb::commitParameterChanges()
+{
+    parameterChanges.end();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// the host brackets program loads with these, its setParameter calls are then applied by one block
+bool Feedverb::beginSetProgram()
+{
+    beginParameterChanges();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Feedverb::endSetProgram()
+{
+    commitParameterChanges();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Feedverb::setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput)
+{
+    return surroundOutputs.setSpeakerArrangement(pluginInput, pluginOutput);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Feedverb::getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput)
+{
+    surroundOutputs.getSpeakerArrangement(pluginInput, pluginOutput);
+    return true;
 }
 /*--------------------------------------------------------------------*/
 
@@ -340,7 +567,7 @@ float Feedverb::getParameter(VstInt32 index)
     }
     case Param_hpf: {
         //param = mapValueOutsideRange(log(fdnver_highfreq), MIN_HPF_FREQUENCY_LOG, MAX_HPF_FREQUENCY_LOG);
-        param = mapValueOutsideRange(fdnver_highfreq, MIN_HPF_FREQUENCY, MAX_HPF_FREQUENCY);
+        param = mapValueOutsideRange(fdnver_highfreq, HPF_FILTER_MIN_FREQ, HPF_FILTER_MAX_FREQ);
         break;
     }
     case Param_roomSize: {
@@ -352,7 +579,7 @@ float Feedverb::getParameter(VstInt32 index)
         break;
     }
     case Param_early: {
-        param = t;
+        param = fdnver_early;
         break;
     }
     case Param_spread: {
@@ -364,7 +591,7 @@ float Feedverb::getParameter(VstInt32 index)
         break;
     }
     case Param_lpf: {
-        param = mapValueOutsideRange(log(fdnver_lowfreq), MIN_LPF_FREQUENCY_LOG, MAX_LPF_FREQUENCY_LOG);
+        param = mapValueOutsideRange(log(fdnver_lowfreq), LPF_FILTER_MIN_FREQ_LOG, LPF_FILTER_MAX_FREQ_LOG);
         break;
     }
     default:
@@ -404,7 +631,7 @@ void Feedverb::getParameterLabel(VstInt32 index, char* label)
         break;
     }
     case Param_early: {
-        vst_strncpy(label, "ms", kVstMaxParamStrLen);
+        vst_strncpy(label, "", kVstMaxParamStrLen);
         break;
     }
     case Param_spread: {
@@ -455,7 +682,7 @@ void Feedverb::getParameterDisplay(VstInt32 index, char* text)
         break;
     }
     case Param_early: {
-        float2string(t, text, kVstMaxParamStrLen);
+        float2string(fdnver_early, text, kVstMaxParamStrLen);
         break;
     }
     case Param_spread: {
@@ -506,7 +733,7 @@ void Feedverb::getParameterName(VstInt32 index, char* text)
         break;
     }
     case Param_early: {
-        vst_strncpy(text, "Earl Len", kVstMaxParamStrLen);
+        vst_strncpy(text, "Early", kVstMaxParamStrLen);
         break;
     }
     case Param_spread: {
@@ -572,6 +799,60 @@ void Feedverb::getParameterName(VstInt32 index, char* text)
 ///*--------------------------------------------------------------------*/
 
 
+/* ------------------------------------------------------------------------------------------------------------
+ ---------------------------------------------  STATE  --------------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+
+/*--------------------------------------------------------------------*/
+// serialize the whole state, the same chunk serves banks and single presets
+VstInt32 Feedverb::getChunk(void** data, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    uint32_t seeds[1] = { _delaySeed };
+
+    return stateChunk.write(data, "Feedverb", curProgram, parameters, Param_Count, seeds, 1);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// restore a chunk with a single transaction: each derived quantity is recomputed once
+VstInt32 Feedverb::setChunk(void* data, VstInt32 byteSize, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    int32_t program = curProgram;
+    uint32_t seeds[1] = { _delaySeed };
+
+    // sessions saved before the state went into chunks hold a VST parameter program or bank
+    if (!StateChunk::read(data, byteSize, "Feedverb", &program, parameters, Param_Count, seeds, 1)
+        && !StateChunk::readParameterBank(data, byteSize, cEffect.uniqueID, &program, parameters, Param_Count))
+        return 0;
+
+    beginParameterChanges();
+
+    // only select the program: the stored values override the preset ones
+    if (program >= 0 && program < NUM_PRESETS)
+        AudioEffect::setProgram(program);
+
+    for (int p = 0; p < Param_Count; p++)
+        setParameter(p, parameters[p]);
+
+    // a different seed draws a different delay set even at the same room size
+    if (seeds[0] != _delaySeed) {
+        _delaySeed = seeds[0];
+        parameterChanges.mark(Dirty_roomSize);
+        CAPTURE_SEED(captureLog, 0, _delaySeed);
+    }
+
+    commitParameterChanges();
+    return 1;
+}
+/*--------------------------------------------------------------------*/
+
+
 /* ------------------------------------------------------------------------------------------------------------
  ---------------------------------------------  NAME  ---------------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
@@ -592,11 +873,35 @@ bool Feedverb::getVendorString(char* name)
 }
 /*--------------------------------------------------------------------*/
 
+/* ------------------------------------------------------------------------------------------------------------
+ ------------------------------------------  PROFILING  -------------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+#ifdef FOX_STAGE_PROFILING
+/*--------------------------------------------------------------------*/
+VstInt32 Feedverb::canDo(char* text)
+{
+    if (strcmp(text, PROFILER_CAN_DO) == 0)
+        return 1;
+    return AudioEffectX::canDo(text);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Stage statistics: lArg2 is the stage index, ptrArg a StageStats to fill
+VstIntPtr Feedverb::vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg)
+{
+    if (lArg == PROFILER_VENDOR_OPCODE)
+        return stageProfiler.getStats((int)lArg2, (StageStats*)ptrArg) ? 1 : 0;
+    return AudioEffectX::vendorSpecific(lArg, lArg2, ptrArg, floatArg);
+}
+/*--------------------------------------------------------------------*/
+#endif
+
 /* ------------------------------------------------------------------------------------------------------------
  ------------------------------------------  DESTRUCTOR  ------------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
 Feedverb::~Feedverb() {
-    delete fdnver_FDN;
+    dspArena.release();
 }
 
 
@@ -9,9 +9,24 @@
 #include <stdio.h>
 #include "FDN.h"
 #include "ModDelay.h"
+#include "Arena.h"
+#include "RealtimeCheck.h"
+#include "StageProfiler.h"
+#include "CaptureLog.h"
+#include "DelayRandom.h"
+#include "ParameterChanges.h"
+#include "StateChunk.h"
+#include "HalfBandOversampler.h"
+#include "VelvetDiffuser.h"
+#include "VectorFDN.h"
+#include "SurroundOutputs.h"
 #include "../vstsdk2.4/public.sdk/source/vst2.x/audioeffectx.h"
 #include <math.h>
 
+// Highest sample rate the buffers are reserved for; rates up to it switch without allocating
+#ifndef MAX_SUPPORTED_SAMPLE_RATE
+#define MAX_SUPPORTED_SAMPLE_RATE 192000.0
+#endif
 
 using namespace std;
 
@@ -30,6 +45,26 @@ enum EfxParameter {
 	Param_Count
 };
 
+// Stages of processReplacing timed by the profiler
+enum EfxStage {
+	Stage_fdn = 0,
+	Stage_Count
+};
+
+// Derived state invalidated by parameter changes, recomputed once per transaction
+enum EfxDirtyFlag {
+	Dirty_mix = 1 << 0,
+	Dirty_roomSize = 1 << 1,
+	Dirty_decay = 1 << 2,
+	Dirty_spread = 1 << 3,
+	Dirty_modDepth = 1 << 4,
+	Dirty_modRate = 1 << 5,
+	Dirty_damping = 1 << 6,
+	Dirty_lpf = 1 << 7,
+	Dirty_hpf = 1 << 8,
+	Dirty_early = 1 << 9
+};
+
 // Declare class Reverb
 //class Feedverb;
 //
@@ -64,15 +99,23 @@ class Feedverb : public AudioEffectX {
 	float fdnver_lowfreq;
 	float fdnver_lpftype;
 	float fdnver_stereoSpread;
+	float fdnver_early;
 
 	// Aux parameters
 	DelayDistribution delDistrLeft;
 	DelayDistribution delDistrRight;
 	DiffuserDelayLogic diffLogicLeft;
 	DiffuserDelayLogic diffLogicRight;
-	float t;
-	// FDN
-	FDN* fdnver_FDN;
+	// Seed of the FDN's delays and the velvet taps, mixed with the room size on every change
+	uint32_t _delaySeed;
+	// Memory for all the DSP objects of this instance
+	Arena dspArena;
+	float _maxSampleRate;
+
+	// FDN, its tank at 1/factor of the host rate when the damping and low pass allow
+	VectorFDN* fdnver_FDN;
+	// Replaces the FDN's diffusion steps, only built for DiffusionEngine::Velvet
+	VelvetDiffuser* fdnver_diffuser;
 	Modulation* chorus;
 	/*ChannelSplitter* ch;
 	ChannelMixer* mx;
@@ -80,13 +123,32 @@ class Feedverb : public AudioEffectX {
 	MultiChannelDiffuser* diff;
 	Hadamard* had;*/
 
+	// Pending updates of the open parameter transaction
+	ParameterChanges parameterChanges;
+
+	// Buffer handed to the host by getChunk
+	StateChunk stateChunk;
+
+	// Speakers reported to the host and the mix of the NUM_REVERB_OUTPUTS outputs
+	SurroundOutputs surroundOutputs;
+
+#ifdef FOX_STAGE_PROFILING
+	StageProfiler stageProfiler;
+#endif
+#ifdef FOX_CAPTURE
+	CaptureLog captureLog;
+#endif
+
 	void InitPlugin();
 	void updateMix();
+	void drawDelaySet();
+	void updateRoomSize();
+	void applyParameterChanges();
 	//void InitPresets();
 
 public:
 
-	Feedverb(audioMasterCallback audioMaster);
+	Feedverb(audioMasterCallback audioMaster, float maxSampleRate = MAX_SUPPORTED_SAMPLE_RATE);
 	~Feedverb();
 
 	// Processing
@@ -99,9 +161,31 @@ public:
 	virtual void getParameterDisplay(VstInt32 index, char* text) override;
 	virtual void getParameterName(VstInt32 index, char* text) override;
 	virtual void setSampleRate(float sampleRate) override;
+	virtual void setBlockSize(VstInt32 blockSize) override;
+	virtual void resume() override;
+	virtual void suspend() override;
 	/*virtual void setProgram(VstInt32 program) override;
 	virtual void getProgramName(char* name) override;
 	virtual bool getProgramNameIndexed(VstInt32 category, VstInt32 index, char* text) override;*/
+
+	// Parameter transactions: the changes made in between are applied together, by the first block
+	// after the commit
+	void beginParameterChanges();
+	void commitParameterChanges();
+	virtual bool beginSetProgram() override;
+	virtual bool endSetProgram() override;
+
+	// Whole state in one binary chunk
+	virtual VstInt32 getChunk(void** data, bool isPreset = false) override;
+	virtual VstInt32 setChunk(void* data, VstInt32 byteSize, bool isPreset = false) override;
+
+	// Stereo in; stereo, 5.1 or 7.1 out as built with NUM_REVERB_OUTPUTS
+	virtual bool setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput) override;
+	virtual bool getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput) override;
+#ifdef FOX_STAGE_PROFILING
+	virtual VstInt32 canDo(char* text) override;
+	virtual VstIntPtr vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg) override;
+#endif
 };
 
 
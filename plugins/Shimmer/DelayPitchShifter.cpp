@@ -0,0 +1,176 @@
+//-------------------------------------------------------------------------------------------------------
+//  DelayPitchShifter.cpp
+//  Time-domain pitch shifter: two taps sweep a delay line half a grain apart and are crossfaded
+//  with complementary Hann windows. No look-ahead, so it adds no latency.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "DelayPitchShifter.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+
+/*--------------------------------------------------------------------*/
+DelayPitchShifter::DelayPitchShifter()
+{
+    _buffer = nullptr;
+    _bufferLength = 0;
+    _bufferMask = 0;
+    _allocatedLength = 0;
+    _arena = nullptr;
+    _writeIndex = 0;
+    _sampleRate = 0.0;
+    _grainSizeInMs = DEFAULT_GRAIN_SIZE_IN_MS;
+    _grainLength = 0.0;
+    _pitchRatio = 1.0;
+    _phase = 0.0;
+    _phaseIncrement = 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+DelayPitchShifter::~DelayPitchShifter()
+{
+    releaseFloats(_arena, _buffer);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Delay line length: longest grain plus one block, rounded up to a power of two
+int DelayPitchShifter::getBufferLength(float sampleRate)
+{
+    int minLength = (int)(MAX_GRAIN_SIZE_IN_MS * 0.001 * sampleRate) + MAX_PITCH_SHIFTER_BLOCK_SIZE + 2;
+    int length = 1;
+    while (length < minLength)
+        length <<= 1;
+    return length;
+}
+
+size_t DelayPitchShifter::getMemorySize(float sampleRate)
+{
+    return getBufferLength(sampleRate) * sizeof(float) + ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The buffer is only replaced when it has to grow
+void DelayPitchShifter::reserve(float maxSampleRate)
+{
+    int length = getBufferLength(maxSampleRate);
+    if (length <= _allocatedLength)
+        return;
+    releaseFloats(_arena, _buffer);
+    _buffer = allocateFloats(_arena, length);
+    _allocatedLength = length;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Allocate the delay line for the given sample rate
+void DelayPitchShifter::init(float sampleRate)
+{
+    setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayPitchShifter::reset()
+{
+    memset(_buffer, 0, _bufferLength * sizeof(float));
+    _writeIndex = 0;
+    _phase = 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Resize the delay line for the new rate; only allocates when the reserved buffer is too small
+void DelayPitchShifter::setSampleRate(float sampleRate)
+{
+    int length = getBufferLength(sampleRate);
+    reserve(sampleRate);
+    _bufferLength = length;
+    _bufferMask = length - 1;
+
+    _sampleRate = sampleRate;
+    setGrainSizeInMilliseconds(_grainSizeInMs);
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayPitchShifter::setPitchShift(float semitones)
+{
+    _pitchRatio = pow(2.0, semitones / 12.0);
+    updatePhaseIncrement();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayPitchShifter::setGrainSizeInMilliseconds(float grainSizeInMs)
+{
+    if (grainSizeInMs > MAX_GRAIN_SIZE_IN_MS)
+        grainSizeInMs = MAX_GRAIN_SIZE_IN_MS;
+    _grainSizeInMs = grainSizeInMs;
+    _grainLength = _grainSizeInMs * 0.001 * _sampleRate;
+    updatePhaseIncrement();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The tap delay changes by (1 - ratio) samples per sample, i.e. the phase moves by (1 - ratio) / grain
+void DelayPitchShifter::updatePhaseIncrement()
+{
+    _phaseIncrement = _grainLength > 0.0 ? (1.0 - _pitchRatio) / _grainLength : 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float DelayPitchShifter::readFractional(float readPosition)
+{
+    int idx = (int)floor(readPosition);
+    float frac = readPosition - idx;
+    float y0 = _buffer[idx & _bufferMask];
+    float y1 = _buffer[(idx + 1) & _bufferMask];
+    return y0 + frac * (y1 - y0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayPitchShifter::processBlock(const float* input, float* output, int numSamples)
+{
+    // Write the block into the delay line as (at most) two contiguous spans
+    int firstSpan = _bufferLength - _writeIndex;
+    if (firstSpan > numSamples)
+        firstSpan = numSamples;
+    memcpy(_buffer + _writeIndex, input, firstSpan * sizeof(float));
+    memcpy(_buffer, input + firstSpan, (numSamples - firstSpan) * sizeof(float));
+
+    // Tap delays and crossfade gains for the whole block. The two windows are half a grain apart
+    // and sum to one, so a steady input keeps a constant level.
+    float phase = _phase;
+    for (int i = 0; i < numSamples; i++) {
+        float phase2 = phase + 0.5;
+        if (phase2 >= 1.0)
+            phase2 -= 1.0;
+        _delay1[i] = 1.0 + phase * _grainLength;
+        _delay2[i] = 1.0 + phase2 * _grainLength;
+        _gain1[i] = 0.5 - 0.5 * cos(2.0 * M_PI * phase);
+        _gain2[i] = 1.0 - _gain1[i];
+        phase += _phaseIncrement;
+        if (phase >= 1.0)
+            phase -= 1.0;
+        else if (phase < 0.0)
+            phase += 1.0;
+    }
+    _phase = phase;
+
+    // Read both taps and crossfade
+    for (int i = 0; i < numSamples; i++) {
+        float writePosition = (float)(_writeIndex + i);
+        output[i] = _gain1[i] * readFractional(writePosition - _delay1[i])
+                  + _gain2[i] * readFractional(writePosition - _delay2[i]);
+    }
+
+    _writeIndex = (_writeIndex + numSamples) & _bufferMask;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,67 @@
+//-------------------------------------------------------------------------------------------------------
+//  DelayPitchShifter.h
+//  Time-domain pitch shifter: two taps sweep a delay line half a grain apart and are crossfaded
+//  with complementary Hann windows. No look-ahead, so it adds no latency.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "Arena.h"
+
+#define DEFAULT_GRAIN_SIZE_IN_MS 50.0
+#define MAX_GRAIN_SIZE_IN_MS 100.0
+#define MAX_PITCH_SHIFTER_BLOCK_SIZE 256
+
+//-------------------------------------------------------------------------------------------------------
+class DelayPitchShifter {
+
+	// Delay line (power of two length)
+	float* _buffer;
+	int _bufferLength;
+	int _bufferMask;
+	int _allocatedLength;
+	Arena* _arena;
+	int _writeIndex;
+
+	// Grain state
+	float _sampleRate;
+	float _grainSizeInMs;
+	float _grainLength;
+	float _pitchRatio;
+	float _phase;
+	float _phaseIncrement;
+
+	// Per-block scratch for tap delays and window gains
+	float _delay1[MAX_PITCH_SHIFTER_BLOCK_SIZE];
+	float _delay2[MAX_PITCH_SHIFTER_BLOCK_SIZE];
+	float _gain1[MAX_PITCH_SHIFTER_BLOCK_SIZE];
+	float _gain2[MAX_PITCH_SHIFTER_BLOCK_SIZE];
+
+	void updatePhaseIncrement();
+	float readFractional(float readPosition);
+	static int getBufferLength(float sampleRate);
+
+public:
+
+	DelayPitchShifter();
+	~DelayPitchShifter();
+
+	// Carve the delay line out of the given arena instead of the heap (call before init)
+	void setArena(Arena* arena) { _arena = arena; }
+	static size_t getMemorySize(float sampleRate);
+
+	// Allocate up front for the highest sample rate, so init / setSampleRate below it never allocate
+	void reserve(float maxSampleRate);
+
+	void init(float sampleRate);
+	void reset();
+	void setSampleRate(float sampleRate);
+	void setPitchShift(float semitones);
+	void setGrainSizeInMilliseconds(float grainSizeInMs);
+
+	// The taps only read behind the write position
+	static int getLatencyInSamples() { return 0; }
+
+	// Process up to MAX_PITCH_SHIFTER_BLOCK_SIZE samples
+	void processBlock(const float* input, float* output, int numSamples);
+};
@@ -9,11 +9,13 @@
 #define _USE_MATH_DEFINES
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "utils.h"
 
 /*--------------------------------------------------------------------*/
 // Plugin constants
 #define NUM_PRESETS 5
+#define SHIMMER_BLOCK_SIZE MAX_PITCH_SHIFTER_BLOCK_SIZE
 /*--------------------------------------------------------------------*/
 
 /*--------------------------------------------------------------------*/
@@ -27,10 +29,17 @@
 #define EARLYREFL_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
 #define DIFFUSER_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
 #define FEEDBACK_DELAY_DISTRIBUTION DelayDistribution::RandomInRange
+#ifndef DELAY_TABLE_MODE
+#define DELAY_TABLE_MODE false                  // true: delay sets read DelayRandom's precomputed table
+#endif
 #define OUTPUT_LPF_TYPE LPFilterType::Shelving
 #define DAMPING_LPF_TYPE LPFilterType::Vicanek
 #define OUTPUT_HPF_TYPE HPFilterType::Shelving
 #define DIFFUSION_LOGIC DiffuserDelayLogic::Doubled
+#ifndef DIFFUSION_ENGINE
+#define DIFFUSION_ENGINE DiffusionEngine::Chain
+#endif
+#define FDN_DIFFUSION_STEPS (DIFFUSION_ENGINE == DiffusionEngine::Velvet ? 0 : NUMBER_OF_DIFFUSION_STEPS)
 #define MIN_DAMPING_FREQUENCY 200.0
 #define MAX_DAMPING_FREQUENCY 20000.0
 #define MAX_MOD_RATE 5.0
@@ -39,6 +48,9 @@
 #define LPF_FILTER_MAX_FREQ 20000.0
 #define HPF_FILTER_MAX_FREQ 7000.0
 #define BRANCH_REVERB_DECAY 6.0
+#ifndef FEEDBACK_MATRIX_TYPE
+#define FEEDBACK_MATRIX_TYPE FeedbackMatrixType::Householder
+#endif
 const float MIN_DAMPING_FREQUENCY_LOG = log(MIN_DAMPING_FREQUENCY);
 const float MAX_DAMPING_FREQUENCY_LOG = log(MAX_DAMPING_FREQUENCY);
 const float LPF_FILTER_MAX_FREQ_LOG = log(LPF_FILTER_MAX_FREQ);
@@ -47,6 +59,19 @@ const float LPF_FILTER_MIN_FREQ_LOG = log(LPF_FILTER_MIN_FREQ);
 
 /*--------------------------------------------------------------------*/
 // Pitch shifter constants
+#ifdef PSM_FFT_LEN
+#define PITCH_SHIFTER_FFT_LENGTH PSM_FFT_LEN
+#else
+#define PITCH_SHIFTER_FFT_LENGTH 4096
+#endif
+#define PITCH_SHIFTER_HOP_SIZE (PITCH_SHIFTER_FFT_LENGTH / 4)
+#define NUM_OF_PITCH_SHIFTERS 4
+// Spread the vocoders' hop phases over one hop; 0 keeps them aligned (to benchmark against)
+#ifndef PITCH_SHIFTER_STAGGER
+#define PITCH_SHIFTER_STAGGER 1
+#endif
+#define DRY_DELAY_BUFFER_LENGTH (2 * PITCH_SHIFTER_FFT_LENGTH)
+static_assert(PITCH_SHIFTER_FFT_LENGTH < DRY_DELAY_BUFFER_LENGTH, "the dry delay must hold the whole latency");
 #define NUM_OF_PITCH_INTERVALS_ALLOWED 10
 const float DELTA_PARAMETER_BETWEEN_INTERVALS = 1.0/NUM_OF_PITCH_INTERVALS_ALLOWED;
 char* INTERVALS_NAMES_STRING[NUM_OF_PITCH_INTERVALS_ALLOWED] = { "2nd Maj", "3rd Min", "3rd Maj", "4th Per", "5th Per", "6th Maj", "7th Maj", "1st Oct", "1 Oct+5", "1+2 Oct"};
@@ -62,6 +87,31 @@ void Shimmer::updateMix() {
     _dry = cos(shim_mix * M_PI * 0.5);
 }
 
+// Draw a reverb's delays for the current room size, each reverb from its own seed
+void Shimmer::setDelaySet(VectorFDN* reverb, uint32_t index) {
+    reverb->setSeed(DelayRandom::deriveSeed(_delaySeed, 0.0, index));
+    reverb->setRoomSize(shim_roomSize, DIFFUSION_LOGIC, DIFFUSER_DELAY_DISTRIBUTION, FEEDBACK_DELAY_DISTRIBUTION);
+}
+
+void Shimmer::updateRoomSize() {
+    setDelaySet(BranchReverb, 0);
+    setDelaySet(MasterReverb, 1);
+    updateDiffusers();
+}
+
+// Velvet filters follow the room size, drawn from the plugin's seed like the delay sets
+void Shimmer::updateDiffusers() {
+    float lengthInMs = VELVET_MIN_LENGTH_IN_MS + shim_roomSize * (VELVET_MAX_LENGTH_IN_MS - VELVET_MIN_LENGTH_IN_MS);
+    if (branchDiffuser) {
+        branchDiffuser->setSeed(DelayRandom::deriveSeed(_delaySeed, shim_roomSize, 0));
+        branchDiffuser->setLengthInMilliseconds(lengthInMs);
+    }
+    if (masterDiffuser) {
+        masterDiffuser->setSeed(DelayRandom::deriveSeed(_delaySeed, shim_roomSize, 1));
+        masterDiffuser->setLengthInMilliseconds(lengthInMs);
+    }
+}
+
 // If two pitch shifters are giving output, sum them with half gain each
 void Shimmer::updateMixPitchShifters(float pitch2) {
     _mixP1 = 1.0;
@@ -72,15 +122,94 @@ void Shimmer::updateMixPitchShifters(float pitch2) {
     }
 }
 
+// Reset the pitch shifters and stagger their hop phases: the k-th vocoder is advanced by k/N of a hop.
+// A host block of B samples then holds N * B / hop FFTs rounded up or down, wherever it starts, where
+// aligned vocoders put all N FFTs of a hop into one block. From one hop up every block averages
+// N * B / hop FFTs anyway; the stagger keeps each block within one FFT of that instead of N.
+// Pre-rolling silence moves the vocoder's read and write positions together, so the latency is unchanged.
+void Shimmer::resetPitchShifters(double sampleRate) {
+    PSMVocoder* shifters[NUM_OF_PITCH_SHIFTERS] = { PitchShift_1octL, PitchShift_1octR, PitchShift_2octL, PitchShift_2octR };
+    for (int k = 0; k < NUM_OF_PITCH_SHIFTERS; k++) {
+        shifters[k]->reset(sampleRate);
+        int hopOffset = PITCH_SHIFTER_STAGGER ? k * PITCH_SHIFTER_HOP_SIZE / NUM_OF_PITCH_SHIFTERS : 0;
+        for (int n = 0; n < hopOffset; n++)
+            shifters[k]->processAudioSample(0.0);
+    }
+}
+
+// Latency of the core vocoder in samples: an impulse goes through an unshifted vocoder set up like the
+// shimmer ones, and comes out where its output peaks. Runs while processing is off.
+static int measureVocoderLatency(double sampleRate, const PSMVocoderParameters& parameters) {
+    PSMVocoder* vocoder = new PSMVocoder();
+    vocoder->reset(sampleRate);
+    vocoder->setParameters(parameters);
+    vocoder->setPitchShift(0.0);
+    int latency = PITCH_SHIFTER_FFT_LENGTH;
+    double peak = 0.0;
+    for (int n = 0; n < DRY_DELAY_BUFFER_LENGTH; n++) {
+        double output = fabs(vocoder->processAudioSample(n == 0 ? 1.0 : 0.0));
+        if (output > peak) {
+            peak = output;
+            latency = n;
+        }
+    }
+    delete vocoder;
+    return latency;
+}
+
+// Latency of the pitch shifting path in samples, as the shifters of the given mode report it. Until the
+// vocoders are built, theirs is taken as one FFT frame: the first synthesis frame needs a full analysis one.
+int Shimmer::getPitchShifterLatency(PitchShifterMode mode) {
+    if (mode == PitchShifterMode::Vocoder)
+        return _vocoderLatencyInSamples;
+    return DelayPitchShifter::getLatencyInSamples();
+}
+
+// Realign the dry path with the active shifters, at the start of a block
+void Shimmer::updateLatency() {
+    _latencyInSamples = getPitchShifterLatency(_pitchMode);
+}
+
+// Tell the host about a latency it doesn't know yet
+void Shimmer::reportLatency(int latency) {
+    if (latency == cEffect.initialDelay)
+        return;
+    setInitialDelay(latency);
+    ioChanged();
+}
+
+/*--------------------------------------------------------------------*/
+// Bytes of DSP state carved out of the arena at the given sample rate. The vocoders still
+// allocate their FFT buffers internally, only the objects live here.
+size_t Shimmer::getArenaSize(float sampleRate)
+{
+    return 2 * (sizeof(VectorFDN) + ARENA_OBJECT_OVERHEAD + VectorFDN::getMemorySize(DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, FDN_DIFFUSION_STEPS, DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, sampleRate, MULTIRATE_MAX_FACTOR))
+        + (DIFFUSION_ENGINE == DiffusionEngine::Velvet ? 2 * (sizeof(VelvetDiffuser) + ARENA_OBJECT_OVERHEAD + VelvetDiffuser::getMemorySize(sampleRate)) : 0)
+        + 4 * (sizeof(PSMVocoder) + ARENA_OBJECT_OVERHEAD)
+        + 4 * (sizeof(DelayPitchShifter) + ARENA_OBJECT_OVERHEAD + DelayPitchShifter::getMemorySize(sampleRate))
+        + 2 * (DRY_DELAY_BUFFER_LENGTH * sizeof(float) + ARENA_ALIGNMENT)
+        + 4 * ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
 /*--------------------------------------------------------------------*/
 // Shimmer class constructor
-Shimmer::Shimmer(audioMasterCallback audioMaster)
+Shimmer::Shimmer(audioMasterCallback audioMaster, float maxSampleRate)
     : AudioEffectX(audioMaster, NUM_PRESETS, Param_Count) // n program, n parameters
 {
+    _maxSampleRate = maxSampleRate;
     setNumInputs(2);		// stereo in
-    setNumOutputs(2);		// stereo out
+    setNumOutputs(NUM_REVERB_OUTPUTS);	// stereo or surround out
     setUniqueID('Fox');	    // identify    
+    programsAreChunks();	// state is saved with getChunk/setChunk
     InitPlugin();
+
+#ifdef FOX_CAPTURE
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    captureLog.startFromEnvironment("Shimmer", 2, NUM_REVERB_OUTPUTS, Param_Count, getSampleRate(), parameters);
+#endif
 }
 /*--------------------------------------------------------------------*/
 
@@ -98,9 +227,6 @@ void Shimmer::InitPlugin()
     /*.......................................*/
     // initialize reverb plug-in parameters
     InitPresets();
-
-    // get current sample rate
-    int sampleRate = getSampleRate();
     shim_mix = 0.5;    
     shim_roomSize = 0.5;
     shim_decay = 0.2;
@@ -110,19 +236,64 @@ void Shimmer::InitPlugin()
     shim_intervals = 0.1;
     shim_modRate = 0.0;
     shim_modDepth = 0.0;
-    shim_lpf = MAX_LPF_FREQUENCY;
-    shim_hpf = MIN_HPF_FREQUENCY;           
+    shim_lpf = LPF_FILTER_MAX_FREQ;
+    shim_hpf = HPF_FILTER_MIN_FREQ;
+    shim_pitchMode = PitchShifterMode::Vocoder;
+    _delaySeed = DEFAULT_DELAY_SEED;
     updateMix();
+    updateMixPitchShifters(INTERVALS_IN_SEMITONES_PITCH2[(int)(shim_intervals / DELTA_PARAMETER_BETWEEN_INTERVALS)]);
+    _shimmer = shim_shimmer;
+    _pitchMode = shim_pitchMode;
+
+#ifdef FOX_STAGE_PROFILING
+    stageProfiler.addStage("pitch");
+    stageProfiler.addStage("branch");
+    stageProfiler.addStage("master");
+#endif
+
+    /*.......................................*/
+    // the DSP objects are built by the first resume, at the host's sample rate
+    BranchReverb = MasterReverb = nullptr;
+    branchDiffuser = masterDiffuser = nullptr;
+    PitchShift_1octL = PitchShift_1octR = PitchShift_2octL = PitchShift_2octR = nullptr;
+    DelayShift_1octL = DelayShift_1octR = DelayShift_2octL = DelayShift_2octR = nullptr;
+    _dryDelayL = _dryDelayR = nullptr;
+    _dspReady = false;
+    _releaseOnSuspend = false;
+    _vocoderFlushSamples = 0;
+    _vocoderLatencyInSamples = PITCH_SHIFTER_FFT_LENGTH;
+    _latencyInSamples = getPitchShifterLatency(_pitchMode);
+    setInitialDelay(_latencyInSamples);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Build every DSP object at the current sample rate. Runs in resume(), never on the audio thread.
+void Shimmer::allocateDSP()
+{
+    if (_dspReady)
+        return;
+
+    // get current sample rate
+    int sampleRate = getSampleRate();
+
+    /*.......................................*/
+    // reserve the memory of every DSP object in one region, sized for the highest supported rate
+    dspArena.reserve(getArenaSize(sampleRate > _maxSampleRate ? sampleRate : _maxSampleRate));
 
     /*.......................................*/
     // Create FDN Branch Reverb
-    BranchReverb = new FDN(2, DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, 2, NUMBER_OF_DIFFUSION_STEPS, 1);
+    BranchReverb = dspArena.create<VectorFDN>(DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, FEEDBACK_MATRIX_TYPE, FDN_DIFFUSION_STEPS);
+    BranchReverb->setArena(&dspArena);
+    BranchReverb->setDelayTableMode(DELAY_TABLE_MODE);
+    BranchReverb->setMaxDecimationFactor(MULTIRATE_MAX_FACTOR);
+    BranchReverb->reserve(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, _maxSampleRate);
 
-    // Initialize objects (allocate delay lines)
+    // Initialize objects (carve out the delay lines)
     BranchReverb->initialize(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, sampleRate);
 
     // Set room size
-    BranchReverb->setRoomSize(shim_roomSize);
+    setDelaySet(BranchReverb, 0);
 
     // Set decay
     BranchReverb->setDecayInSeconds(0.25 * shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
@@ -150,13 +321,17 @@ void Shimmer::InitPlugin()
 
     /*.......................................*/
     // Create FDN Master Reverb
-    MasterReverb = new FDN(2, DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, 2, NUMBER_OF_DIFFUSION_STEPS, 1);
+    MasterReverb = dspArena.create<VectorFDN>(DEFAULT_NUMBER_OF_INTERNAL_CHANNELS_FDN, FEEDBACK_MATRIX_TYPE, FDN_DIFFUSION_STEPS);
+    MasterReverb->setArena(&dspArena);
+    MasterReverb->setDelayTableMode(DELAY_TABLE_MODE);
+    MasterReverb->setMaxDecimationFactor(MULTIRATE_MAX_FACTOR);
+    MasterReverb->reserve(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, _maxSampleRate);
 
-    // Initialize objects (allocate delay lines)
+    // Initialize objects (carve out the delay lines)
     MasterReverb->initialize(DIFFUSER_DELAY_BUFFER_SIZE_MS, FEEDBACK_DELAY_BUFFER_SIZE_MS, sampleRate);
 
     // Set room size
-    MasterReverb->setRoomSize(shim_roomSize);
+    setDelaySet(MasterReverb, 1);
 
     // Set decay
     MasterReverb->setDecayInSeconds(shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
@@ -180,19 +355,37 @@ void Shimmer::InitPlugin()
 
     // output mixing mode
     MasterReverb->setMixMode(MixMode::First);
+
+    // one output per speaker, the LFE low pass at the host rate
+    MasterReverb->setNumOutputs(NUM_REVERB_OUTPUTS);
+    surroundOutputs.setSampleRate(sampleRate);
+    /*.......................................*/
+
+    /*.......................................*/
+    // Velvet diffusers: at the host rate, ahead of the reverbs
+    if (DIFFUSION_ENGINE == DiffusionEngine::Velvet) {
+        branchDiffuser = dspArena.create<VelvetDiffuser>();
+        masterDiffuser = dspArena.create<VelvetDiffuser>();
+        branchDiffuser->setArena(&dspArena);
+        masterDiffuser->setArena(&dspArena);
+        branchDiffuser->setDelayTableMode(DELAY_TABLE_MODE);
+        masterDiffuser->setDelayTableMode(DELAY_TABLE_MODE);
+        branchDiffuser->reserve(_maxSampleRate);
+        masterDiffuser->reserve(_maxSampleRate);
+        branchDiffuser->init(sampleRate);
+        masterDiffuser->init(sampleRate);
+        updateDiffusers();
+    }
     /*.......................................*/
  
     /*.......................................*/
     // init PSMVocoder
-    PitchShift_1octL = new PSMVocoder();
-    PitchShift_1octR = new PSMVocoder();
-    PitchShift_2octL = new PSMVocoder();
-    PitchShift_2octR = new PSMVocoder();
-    // set sample rate
-    PitchShift_1octL->reset((double)sampleRate);
-    PitchShift_1octR->reset((double)sampleRate);
-    PitchShift_2octL->reset((double)sampleRate);
-    PitchShift_2octR->reset((double)sampleRate);
+    PitchShift_1octL = dspArena.create<PSMVocoder>();
+    PitchShift_1octR = dspArena.create<PSMVocoder>();
+    PitchShift_2octL = dspArena.create<PSMVocoder>();
+    PitchShift_2octR = dspArena.create<PSMVocoder>();
+    // set sample rate and stagger hop phases
+    resetPitchShifters((double)sampleRate);
     // set phase locking and peak tracking
     PSMVocoderParameters params1L = PitchShift_1octL->getParameters();
     PSMVocoderParameters params1R = PitchShift_1octR->getParameters();
@@ -211,28 +404,139 @@ void Shimmer::InitPlugin()
     PitchShift_1octR->setParameters(params1R);
     PitchShift_2octL->setParameters(params2L);
     PitchShift_2octR->setParameters(params2R);
+    _vocoderLatencyInSamples = measureVocoderLatency((double)sampleRate, params1L);
 
     PitchShift_1octL->setPitchShift(12.0);
     PitchShift_1octR->setPitchShift(12.0);
     PitchShift_2octL->setPitchShift(24.0);
     PitchShift_2octR->setPitchShift(24.0);
+
+    /*.......................................*/
+    // init delay-line pitch shifters
+    DelayShift_1octL = dspArena.create<DelayPitchShifter>();
+    DelayShift_1octR = dspArena.create<DelayPitchShifter>();
+    DelayShift_2octL = dspArena.create<DelayPitchShifter>();
+    DelayShift_2octR = dspArena.create<DelayPitchShifter>();
+    DelayShift_1octL->setArena(&dspArena);
+    DelayShift_1octR->setArena(&dspArena);
+    DelayShift_2octL->setArena(&dspArena);
+    DelayShift_2octR->setArena(&dspArena);
+    DelayShift_1octL->reserve(_maxSampleRate);
+    DelayShift_1octR->reserve(_maxSampleRate);
+    DelayShift_2octL->reserve(_maxSampleRate);
+    DelayShift_2octR->reserve(_maxSampleRate);
+    DelayShift_1octL->init(sampleRate);
+    DelayShift_1octR->init(sampleRate);
+    DelayShift_2octL->init(sampleRate);
+    DelayShift_2octR->init(sampleRate);
+    DelayShift_1octL->setPitchShift(12.0);
+    DelayShift_1octR->setPitchShift(12.0);
+    DelayShift_2octL->setPitchShift(24.0);
+    DelayShift_2octR->setPitchShift(24.0);
+
+    /*.......................................*/
+    // init dry path delay and report latency
+    _dryDelayL = dspArena.allocateFloats(DRY_DELAY_BUFFER_LENGTH);
+    _dryDelayR = dspArena.allocateFloats(DRY_DELAY_BUFFER_LENGTH);
+    _dryDelayWriteIndex = 0;
+    _vocoderFlushSamples = 0;
+    _dspReady = true;
+
+    // bring the new objects up to date with every parameter changed since construction
+    parameterChanges.mark(parameterChanges.getHistory());
+    applyParameterChanges();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Shimmer::releaseDSP()
+{
+    if (!_dspReady)
+        return;
+
+    // the objects go away with the arena, parameters and presets stay
+    _dspReady = false;
+    dspArena.release();
+    BranchReverb = MasterReverb = nullptr;
+    branchDiffuser = masterDiffuser = nullptr;
+    PitchShift_1octL = PitchShift_1octR = PitchShift_2octL = PitchShift_2octR = nullptr;
+    DelayShift_1octL = DelayShift_1octR = DelayShift_2octL = DelayShift_2octR = nullptr;
+    _dryDelayL = _dryDelayR = nullptr;
 }
 /*--------------------------------------------------------------------*/
 
 /*--------------------------------------------------------------------*/
 // replace the "setSampleRate" method with user-defined one
+// Delay lines are reserved for _maxSampleRate, so below it only lengths and coefficients change and
+// nothing allocates: some hosts change the rate from the audio thread without suspending.
+// PSMVocoder has no reserve call and reallocates in reset, but its frames don't depend on the rate:
+// it keeps running, and its output is muted until the frame from before the change has left it.
+// Hosts often repeat the current rate around transport start: nothing to do then.
 void Shimmer::setSampleRate(float sampleRate)
 {
+    if (sampleRate == getSampleRate())
+        return;
+
+    CAPTURE_SAMPLE_RATE(captureLog, sampleRate);
+
     // Call AudioEffect "setSampleRate" method
     AudioEffect::setSampleRate(sampleRate);
+    surroundOutputs.setSampleRate(sampleRate);
+
+    // Nothing built yet: the first resume allocates at this rate
+    if (!_dspReady)
+        return;
 
     // Call setSampleRate on every needed module
     BranchReverb->setSampleRate(sampleRate);
     MasterReverb->setSampleRate(sampleRate);
-    PitchShift_1octL->reset(sampleRate);
-    PitchShift_1octR->reset(sampleRate);
-    PitchShift_2octL->reset(sampleRate);
-    PitchShift_2octR->reset(sampleRate);
+    if (branchDiffuser) {
+        branchDiffuser->setSampleRate(sampleRate);
+        masterDiffuser->setSampleRate(sampleRate);
+    }
+    _vocoderFlushSamples = _vocoderLatencyInSamples;
+    DelayShift_1octL->setSampleRate(sampleRate);
+    DelayShift_1octR->setSampleRate(sampleRate);
+    DelayShift_2octL->setSampleRate(sampleRate);
+    DelayShift_2octR->setSampleRate(sampleRate);
+
+    // Clear the dry path, the latency in samples is the same at every rate
+    memset(_dryDelayL, 0, DRY_DELAY_BUFFER_LENGTH * sizeof(float));
+    memset(_dryDelayR, 0, DRY_DELAY_BUFFER_LENGTH * sizeof(float));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Blocks of any size are processed in SHIMMER_BLOCK_SIZE chunks: the size is only recorded
+void Shimmer::setBlockSize(VstInt32 blockSize)
+{
+    CAPTURE_BLOCK_SIZE(captureLog, blockSize);
+    AudioEffect::setBlockSize(blockSize);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The host turns processing on: build the DSP objects if they don't exist yet, apply the changes
+// made while suspended and report the latency measured on the vocoders
+void Shimmer::resume()
+{
+    CAPTURE_RESUME(captureLog);
+    allocateDSP();
+    if (!parameterChanges.isOpen())
+        applyParameterChanges();
+    updateLatency();
+    reportLatency(_latencyInSamples);
+    AudioEffectX::resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Shimmer::suspend()
+{
+    CAPTURE_SUSPEND(captureLog);
+    AudioEffectX::suspend();
+    if (_releaseOnSuspend)
+        releaseDSP();
 }
 /*--------------------------------------------------------------------*/
 
@@ -241,62 +545,121 @@ void Shimmer::setSampleRate(float sampleRate)
   ------------------------------------------------------------------------------------------------------------ */
 void Shimmer::processReplacing(float** inputs, float** outputs, VstInt32 sampleFrames)
 {
+    REALTIME_SCOPE("Shimmer::processReplacing");
+    CAPTURE_INPUT(captureLog, inputs, sampleFrames);
+
+    // Parameter changes made since the last block take effect here, never in the middle of one
+    if (parameterChanges.beginBlock())
+        applyParameterChanges();
+
+    // Called before the first resume: nothing to process with
+    if (!_dspReady) {
+        for (int c = 0; c < NUM_REVERB_OUTPUTS; c++)
+            memset(outputs[c], 0, sampleFrames * sizeof(float));
+        CAPTURE_OUTPUT(captureLog, outputs, sampleFrames);
+        return;
+    }
+
     // Extract input and output buffers
     float* inL = inputs[0]; // buffer input left
     float* inR = inputs[1]; // buffer input right
 
-    float* outL = outputs[0]; // buffer output left
-    float* outR = outputs[1]; // buffer output right
-
-    // write input to file
-    //string pre = "test_input.txt";
-    //WriteBufferToFile(inputs, sampleFrames, pre);
-    
-    // Cycle over the sample frames number
-    for (int i = 0; i < sampleFrames; i++) {
-
-        // Create tmp arrays for processing
-        float pitch_input[2] = {inL[i], inR[i]};
-        float pitch_output_1oct[2] = { 0.0, 0.0 };
-        float pitch_output_2oct[2] = { 0.0, 0.0 };        
-        float pitch_summed_output[2] = { pitch_input[0], pitch_input[1] };
-        float bran_rev_out[2] = { 0.0, 0.0 };
-        float mast_rev_out[2] = { 0.0, 0.0 };
-        float mast_rev_in[2];
-
-        // --- Pitch Shifting        
-        // Process pitch shifting 1 octave
-        pitch_output_1oct[0] = PitchShift_1octL->processAudioSample(pitch_input[0]);
-        pitch_output_1oct[1] = PitchShift_1octR->processAudioSample(pitch_input[1]);
-
-        // Process pitch shifting 2 octaves
-        pitch_output_2oct[0] = PitchShift_2octL->processAudioSample(pitch_input[0]);
-        pitch_output_2oct[1] = PitchShift_2octR->processAudioSample(pitch_input[1]);
-
-        // Sum outputs
-        pitch_summed_output[0] = _mixP1 * pitch_output_1oct[0] + _mixP2 * pitch_output_2oct[0];
-        pitch_summed_output[1] = _mixP1 * pitch_output_1oct[1] + _mixP2 * pitch_output_2oct[1];
-              
-        // --- Branch Reverb        
-        BranchReverb->processAudio(pitch_summed_output, bran_rev_out);
-
-        // --- Master Reverb        
-        // Mix branch reverb output with dry input
-        mast_rev_in[0] = shim_shimmer * bran_rev_out[0] + (1 - shim_shimmer) * inL[i];
-        mast_rev_in[1] = shim_shimmer * bran_rev_out[1] + (1 - shim_shimmer) * inR[i];
+    // Outputs are NUM_REVERB_OUTPUTS buffers
+    // Cycle over the sample frames in chunks of SHIMMER_BLOCK_SIZE samples
+    for (int start = 0; start < sampleFrames; start += SHIMMER_BLOCK_SIZE) {
+
+        int numSamples = sampleFrames - start < SHIMMER_BLOCK_SIZE ? sampleFrames - start : SHIMMER_BLOCK_SIZE;
+        float* blockInL = inL + start;
+        float* blockInR = inR + start;
+
+        // --- Pitch Shifting
+        float pitch_1octL[SHIMMER_BLOCK_SIZE], pitch_1octR[SHIMMER_BLOCK_SIZE];
+        float pitch_2octL[SHIMMER_BLOCK_SIZE], pitch_2octR[SHIMMER_BLOCK_SIZE];
+        {
+            PROFILE_STAGE(stageProfiler, Stage_pitch);
+            if (_pitchMode == PitchShifterMode::Vocoder) {
+                for (int i = 0; i < numSamples; i++) {
+                    // Process pitch shifting 1 octave
+                    pitch_1octL[i] = PitchShift_1octL->processAudioSample(blockInL[i]);
+                    pitch_1octR[i] = PitchShift_1octR->processAudioSample(blockInR[i]);
+
+                    // Process pitch shifting 2 octaves
+                    pitch_2octL[i] = PitchShift_2octL->processAudioSample(blockInL[i]);
+                    pitch_2octR[i] = PitchShift_2octR->processAudioSample(blockInR[i]);
+                }
+
+                // Output from before a rate change
+                for (int i = 0; i < numSamples && _vocoderFlushSamples > 0; i++, _vocoderFlushSamples--)
+                    pitch_1octL[i] = pitch_1octR[i] = pitch_2octL[i] = pitch_2octR[i] = 0.0;
+            }
+            else {
+                DelayShift_1octL->processBlock(blockInL, pitch_1octL, numSamples);
+                DelayShift_1octR->processBlock(blockInR, pitch_1octR, numSamples);
+                DelayShift_2octL->processBlock(blockInL, pitch_2octL, numSamples);
+                DelayShift_2octR->processBlock(blockInR, pitch_2octR, numSamples);
+            }
+        }
+
+        // --- Branch Reverb, fed with the summed pitch shifters
+        float bran_rev_outL[SHIMMER_BLOCK_SIZE], bran_rev_outR[SHIMMER_BLOCK_SIZE];
+        float* bran_rev_out[2] = { bran_rev_outL, bran_rev_outR };
+        {
+            PROFILE_STAGE(stageProfiler, Stage_branch);
+            float pitch_summedL[SHIMMER_BLOCK_SIZE], pitch_summedR[SHIMMER_BLOCK_SIZE];
+            for (int i = 0; i < numSamples; i++) {
+                pitch_summedL[i] = _mixP1 * pitch_1octL[i] + _mixP2 * pitch_2octL[i];
+                pitch_summedR[i] = _mixP1 * pitch_1octR[i] + _mixP2 * pitch_2octR[i];
+            }
+            processReverb(BranchReverb, branchDiffuser, pitch_summedL, pitch_summedR, bran_rev_out, numSamples);
+        }
+
+        // --- Master Reverb
+        PROFILE_STAGE(stageProfiler, Stage_master);
+        float dryL[SHIMMER_BLOCK_SIZE], dryR[SHIMMER_BLOCK_SIZE];
+        float mast_rev_inL[SHIMMER_BLOCK_SIZE], mast_rev_inR[SHIMMER_BLOCK_SIZE];
+        for (int i = 0; i < numSamples; i++) {
+
+            // Delay the dry signal by the pitch shifters' latency, for the master reverb and the output
+            _dryDelayL[_dryDelayWriteIndex] = blockInL[i];
+            _dryDelayR[_dryDelayWriteIndex] = blockInR[i];
+            int dryReadIndex = (_dryDelayWriteIndex - _latencyInSamples) & (DRY_DELAY_BUFFER_LENGTH - 1);
+            dryL[i] = _dryDelayL[dryReadIndex];
+            dryR[i] = _dryDelayR[dryReadIndex];
+            _dryDelayWriteIndex = (_dryDelayWriteIndex + 1) & (DRY_DELAY_BUFFER_LENGTH - 1);
+
+            // Mix branch reverb output with dry input
+            mast_rev_inL[i] = _shimmer * bran_rev_outL[i] + (1 - _shimmer) * dryL[i];
+            mast_rev_inR[i] = _shimmer * bran_rev_outR[i] + (1 - _shimmer) * dryR[i];
+        }
+
+        // Process master reverb
+        float mast_rev_outBuffers[NUM_REVERB_OUTPUTS][SHIMMER_BLOCK_SIZE];
+        float* mast_rev_out[NUM_REVERB_OUTPUTS];
+        for (int c = 0; c < NUM_REVERB_OUTPUTS; c++)
+            mast_rev_out[c] = mast_rev_outBuffers[c];
+        processReverb(MasterReverb, masterDiffuser, mast_rev_inL, mast_rev_inR, mast_rev_out, numSamples);
+
+        // Output allocation: the delayed dry signal on the stereo pair, the LFE from both
+        surroundOutputs.mix(mast_rev_out, dryL, dryR, _wet, _dry, outputs, start, numSamples);
+    }
 
-        // Process master reverb        
-        MasterReverb->processAudio(mast_rev_in, mast_rev_out);        
+    CAPTURE_OUTPUT(captureLog, outputs, sampleFrames);
+}
+/*--------------------------------------------------------------------*/
 
-        // Stereo spread processing + output allocation
-        outL[i] = _wet * mast_rev_out[0] + _dry * inL[i];
-        outR[i] = _wet * mast_rev_out[1] + _dry * inR[i];
+/*--------------------------------------------------------------------*/
+// Run a reverb on a block, into as many outputs as it was given. A velvet diffuser, when there is
+// one, runs first.
+void Shimmer::processReverb(VectorFDN* reverb, VelvetDiffuser* diffuser, const float* inL, const float* inR, float** outputs, int numSamples)
+{
+    float diffusedL[SHIMMER_BLOCK_SIZE], diffusedR[SHIMMER_BLOCK_SIZE];
+    if (diffuser) {
+        diffuser->processBlock(inL, inR, diffusedL, diffusedR, numSamples);
+        inL = diffusedL;
+        inR = diffusedR;
     }
 
-   // Write samples to file
-   //string post = "test_output.txt";
-   //WriteBufferToFile(outputs, sampleFrames, post);
-
+    reverb->processBlock(inL, inR, outputs, numSamples);
 }
 /*--------------------------------------------------------------------*/
 
@@ -308,75 +671,195 @@ void Shimmer::processReplacing(float** inputs, float** outputs, VstInt32 sampleF
   // set reverb parameters values
 void Shimmer::setParameter(VstInt32 index, float value)
 {
+    REALTIME_SCOPE("Shimmer::setParameter");
+
+    // store the value and mark what it invalidates, the next block applies it
     switch (index) {
     case Param_mix: {
-        shim_mix = value;        
-        updateMix();
+        shim_mix = value;
+        parameterChanges.mark(Dirty_mix);
         break;
     }
     case Param_roomSize: {
         shim_roomSize = value;
-        BranchReverb->setRoomSize(shim_roomSize);
-        MasterReverb->setRoomSize(shim_roomSize);
+        parameterChanges.mark(Dirty_roomSize);
         break;
     }
     case Param_shimmer: {
         shim_shimmer = value;
+        parameterChanges.mark(Dirty_shimmer);
         break;
     }
     case Param_decay: {
         shim_decay = value;
-        BranchReverb->setDecayInSeconds(0.25 * shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
-        MasterReverb->setDecayInSeconds(shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
+        parameterChanges.mark(Dirty_decay);
         break;
     }    
     case Param_damping: {
-        shim_damping = value; 
-        float freq = exp(mapValueIntoRange(1.0 - shim_damping, MIN_DAMPING_FREQUENCY_LOG, MAX_DAMPING_FREQUENCY_LOG));
-        BranchReverb->setDampingFrequency(freq);
-        MasterReverb->setDampingFrequency(freq);
+        shim_damping = value;
+        parameterChanges.mark(Dirty_damping);
         break;
     }        
     case Param_spread: {
         shim_spread = value;
-        MasterReverb->setStereoSpread(shim_spread);
+        parameterChanges.mark(Dirty_spread);
         break;
     }
     case Param_shimIntrvals: {        
         if (value == 1)
             value = 0.99; // if value = 1, then pitIdx = NUM_OF_PITCH_INTRVL_ALLOWED + 1 -> outside of array boundaries
         shim_intervals = value;
-        int pitIdx = shim_intervals / DELTA_PARAMETER_BETWEEN_INTERVALS;
-        PitchShift_1octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
-        PitchShift_1octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
-        PitchShift_2octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
-        PitchShift_2octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
-        updateMixPitchShifters(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+        parameterChanges.mark(Dirty_intervals);
         break;
     }
     case Param_modDepth: {
         shim_modDepth = value;
-        MasterReverb->setModDepth(shim_modDepth);
+        parameterChanges.mark(Dirty_modDepth);
         break;
     }
     case Param_modRate: {
         shim_modRate = value;
-        MasterReverb->setModRate(shim_modRate * MAX_MOD_RATE);
+        parameterChanges.mark(Dirty_modRate);
         break;
     }
     case Param_lpf: {
         shim_lpf = exp(mapValueIntoRange(value, LPF_FILTER_MIN_FREQ_LOG, LPF_FILTER_MAX_FREQ_LOG));
-        MasterReverb->setLowPassFrequency(shim_lpf);
+        parameterChanges.mark(Dirty_lpf);
         break;
     }
     case Param_hpf: {        
         shim_hpf = mapValueIntoRange(value, HPF_FILTER_MIN_FREQ, HPF_FILTER_MAX_FREQ);
-        MasterReverb->setHighPassFrequency(shim_hpf);
+        parameterChanges.mark(Dirty_hpf);
         break;
-    }    
+    }
+    case Param_pitchMode: {
+        shim_pitchMode = value < 0.5 ? PitchShifterMode::Vocoder : PitchShifterMode::DelayLine;
+        parameterChanges.mark(Dirty_pitchMode);
+        // the host compensates from now on, the dry path follows at the start of the next block
+        reportLatency(getPitchShifterLatency(shim_pitchMode));
+        break;
+    }
     default:
         break;
     }
+
+    // after the mark: a capture that records the change at a block start has it applied there too
+    CAPTURE_PARAMETER(captureLog, index, value);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// recompute each quantity invalidated since the last call, once. Runs at the start of a block and
+// on resume, so the DSP state never changes while a block is processed.
+void Shimmer::applyParameterChanges()
+{
+    // without DSP objects the changes stay pending, allocateDSP applies them
+    if (!_dspReady)
+        return;
+
+    uint32_t dirty = parameterChanges.take();
+    if (dirty == 0)
+        return;
+
+    if (dirty & Dirty_mix)
+        updateMix();
+
+    if (dirty & Dirty_shimmer)
+        _shimmer = shim_shimmer;
+
+    // new delay sets first, the gains below are computed on them
+    if (dirty & Dirty_roomSize)
+        updateRoomSize();
+
+    if (dirty & Dirty_decay) {
+        BranchReverb->setDecayInSeconds(0.25 * shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
+        MasterReverb->setDecayInSeconds(shim_decay * MAX_REVERB_DECAY_IN_SECONDS);
+    }
+
+    if (dirty & Dirty_damping) {
+        float freq = exp(mapValueIntoRange(1.0 - shim_damping, MIN_DAMPING_FREQUENCY_LOG, MAX_DAMPING_FREQUENCY_LOG));
+        BranchReverb->setDampingFrequency(freq);
+        MasterReverb->setDampingFrequency(freq);
+    }
+
+    if (dirty & Dirty_spread)
+        MasterReverb->setStereoSpread(shim_spread);
+
+    if (dirty & Dirty_intervals) {
+        int pitIdx = shim_intervals / DELTA_PARAMETER_BETWEEN_INTERVALS;
+        PitchShift_1octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
+        PitchShift_1octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
+        PitchShift_2octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+        PitchShift_2octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+        DelayShift_1octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
+        DelayShift_1octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH1[pitIdx]);
+        DelayShift_2octL->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+        DelayShift_2octR->setPitchShift(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+        updateMixPitchShifters(INTERVALS_IN_SEMITONES_PITCH2[pitIdx]);
+    }
+
+    if (dirty & Dirty_modDepth)
+        MasterReverb->setModDepth(shim_modDepth);
+
+    if (dirty & Dirty_modRate)
+        MasterReverb->setModRate(shim_modRate * MAX_MOD_RATE);
+
+    if (dirty & Dirty_lpf)
+        MasterReverb->setLowPassFrequency(shim_lpf);
+
+    if (dirty & Dirty_hpf)
+        MasterReverb->setHighPassFrequency(shim_hpf);
+
+    if (dirty & Dirty_pitchMode) {
+        _pitchMode = shim_pitchMode;
+        updateLatency();
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Shimmer::beginParameterChanges()
+{
+    parameterChanges.begin();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Shimmer::commitParameterChanges()
+{
+    parameterChanges.end();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// the host brackets program loads with these, its setParameter calls are then applied by one block
+bool Shimmer::beginSetProgram()
+{
+    beginParameterChanges();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Shimmer::endSetProgram()
+{
+    commitParameterChanges();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Shimmer::setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput)
+{
+    return surroundOutputs.setSpeakerArrangement(pluginInput, pluginOutput);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Shimmer::getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput)
+{
+    surroundOutputs.getSpeakerArrangement(pluginInput, pluginOutput);
+    return true;
 }
 /*--------------------------------------------------------------------*/
 
@@ -429,13 +912,17 @@ float Shimmer::getParameter(VstInt32 index)
         break;
     }
     case Param_lpf: {
-        param = mapValueOutsideRange(log(shim_lpf), MIN_LPF_FREQUENCY_LOG, MAX_LPF_FREQUENCY_LOG);
+        param = mapValueOutsideRange(log(shim_lpf), LPF_FILTER_MIN_FREQ_LOG, LPF_FILTER_MAX_FREQ_LOG);
         break;
     }
     case Param_hpf: {        
         param = mapValueOutsideRange(shim_hpf, HPF_FILTER_MIN_FREQ, HPF_FILTER_MAX_FREQ);
         break;
-    }    
+    }
+    case Param_pitchMode: {
+        param = shim_pitchMode == PitchShifterMode::Vocoder ? 0.0 : 1.0;
+        break;
+    }
     default:
         break;
     }
@@ -491,7 +978,11 @@ void Shimmer::getParameterLabel(VstInt32 index, char* label)
     case Param_hpf: {
         vst_strncpy(label, "Hz", kVstMaxParamStrLen);
         break;
-    }      
+    }
+    case Param_pitchMode: {
+        vst_strncpy(label, "", kVstMaxParamStrLen);
+        break;
+    }
     default: {
         break;
     }
@@ -548,7 +1039,11 @@ void Shimmer::getParameterDisplay(VstInt32 index, char* text)
     case Param_hpf: {
         float2string(shim_hpf, text, kVstMaxParamStrLen);
         break;
-    }      
+    }
+    case Param_pitchMode: {
+        vst_strncpy(text, shim_pitchMode == PitchShifterMode::Vocoder ? "Vocoder" : "Delay", kVstMaxParamStrLen);
+        break;
+    }
     default: {
         break;
     }
@@ -604,7 +1099,11 @@ void Shimmer::getParameterName(VstInt32 index, char* text)
     case Param_hpf: {
         vst_strncpy(text, "HPF", kVstMaxParamStrLen);
         break;
-    }     
+    }
+    case Param_pitchMode: {
+        vst_strncpy(text, "Pitch", kVstMaxParamStrLen);
+        break;
+    }
     default: {
         break;
     }
@@ -682,18 +1181,21 @@ void Shimmer::InitPresets()
 /*--------------------------------------------------------------------*/
 void Shimmer::setProgram(VstInt32 program)
 {
+    REALTIME_SCOPE("Shimmer::setProgram");
     // Call the current implementation of "setProgram"
     AudioEffect::setProgram(program);
 
     // Create an instante of ShimmerPresets with current preset
     ShimmerPresets* cp = &shim_presets[curProgram];
 
-    // Set each parameter
+    // Set each parameter, recomputing once at the end
+    beginParameterChanges();
     setParameter(Param_mix, cp->shim_mix);
     setParameter(Param_decay, cp->shim_decay / MAX_REVERB_DECAY_IN_SECONDS);
     setParameter(Param_damping, cp->shim_damping);
     setParameter(Param_shimmer, cp->shim_shimmer);
     setParameter(Param_spread, cp->shim_spread);
+    commitParameterChanges();
 }
 /*--------------------------------------------------------------------*/
 
@@ -719,6 +1221,60 @@ bool Shimmer::getProgramNameIndexed(VstInt32 category, VstInt32 index, char* tex
 /*--------------------------------------------------------------------*/
 
 
+/* ------------------------------------------------------------------------------------------------------------
+ ---------------------------------------------  STATE  --------------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+
+/*--------------------------------------------------------------------*/
+// serialize the whole state, the same chunk serves banks and single presets
+VstInt32 Shimmer::getChunk(void** data, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    uint32_t seeds[1] = { _delaySeed };
+
+    return stateChunk.write(data, "Shimmer", curProgram, parameters, Param_Count, seeds, 1);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// restore a chunk with a single transaction: each derived quantity is recomputed once
+VstInt32 Shimmer::setChunk(void* data, VstInt32 byteSize, bool isPreset)
+{
+    float parameters[Param_Count];
+    for (int p = 0; p < Param_Count; p++)
+        parameters[p] = getParameter(p);
+    int32_t program = curProgram;
+    uint32_t seeds[1] = { _delaySeed };
+
+    // sessions saved before the state went into chunks hold a VST parameter program or bank
+    if (!StateChunk::read(data, byteSize, "Shimmer", &program, parameters, Param_Count, seeds, 1)
+        && !StateChunk::readParameterBank(data, byteSize, cEffect.uniqueID, &program, parameters, Param_Count))
+        return 0;
+
+    beginParameterChanges();
+
+    // only select the program: the stored values override the preset ones
+    if (program >= 0 && program < NUM_PRESETS)
+        AudioEffect::setProgram(program);
+
+    for (int p = 0; p < Param_Count; p++)
+        setParameter(p, parameters[p]);
+
+    // a different seed draws a different delay set even at the same room size
+    if (seeds[0] != _delaySeed) {
+        _delaySeed = seeds[0];
+        parameterChanges.mark(Dirty_roomSize);
+        CAPTURE_SEED(captureLog, 0, _delaySeed);
+    }
+
+    commitParameterChanges();
+    return 1;
+}
+/*--------------------------------------------------------------------*/
+
+
 /* ------------------------------------------------------------------------------------------------------------
  ---------------------------------------------  NAME  ---------------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
@@ -739,15 +1295,48 @@ bool Shimmer::getVendorString(char* name)
 }
 /*--------------------------------------------------------------------*/
 
+/* ------------------------------------------------------------------------------------------------------------
+ ----------------------------------------  HOST REQUESTS  -----------------------------------------------------
+ ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+VstInt32 Shimmer::canDo(char* text)
+{
+    if (strcmp(text, RELEASE_ON_SUSPEND_CAN_DO) == 0)
+        return 1;
+#ifdef FOX_STAGE_PROFILING
+    if (strcmp(text, PROFILER_CAN_DO) == 0)
+        return 1;
+#endif
+    return AudioEffectX::canDo(text);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Release on suspend: lArg2 enables it. Stage statistics: lArg2 is the stage index, ptrArg a
+// StageStats to fill.
+VstIntPtr Shimmer::vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg)
+{
+    if (lArg == RELEASE_ON_SUSPEND_VENDOR_OPCODE) {
+        CAPTURE_RELEASE_ON_SUSPEND(captureLog, lArg2 != 0);
+        _releaseOnSuspend = lArg2 != 0;
+        return 1;
+    }
+#ifdef FOX_STAGE_PROFILING
+    if (lArg == PROFILER_VENDOR_OPCODE)
+        return stageProfiler.getStats((int)lArg2, (StageStats*)ptrArg) ? 1 : 0;
+#endif
+    return AudioEffectX::vendorSpecific(lArg, lArg2, ptrArg, floatArg);
+}
+/*--------------------------------------------------------------------*/
+
 /* ------------------------------------------------------------------------------------------------------------
  ------------------------------------------  DESTRUCTOR  ------------------------------------------------------
  ------------------------------------------------------------------------------------------------------------ */
 Shimmer::~Shimmer()
 {
-    //Free BranchReverb, delay and pitch shifters
-    delete MasterReverb;
-    delete BranchReverb;
-    delete PitchShift_1octL, PitchShift_1octR, PitchShift_2octL, PitchShift_2octR;
+    // Free reverbs, pitch shifters and dry path in one go
+    releaseDSP();
+    delete[] shim_presets;
 }
 
 
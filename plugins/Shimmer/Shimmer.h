@@ -11,6 +11,24 @@
 #include "audioeffectx.h"
 #include <math.h>
 #include "PSMVocoder.h"
+#include "DelayPitchShifter.h"
+#include "Arena.h"
+#include "RealtimeCheck.h"
+#include "StageProfiler.h"
+#include "CaptureLog.h"
+#include "DelayRandom.h"
+#include "ParameterChanges.h"
+#include "StateChunk.h"
+#include "HostRequests.h"
+#include "HalfBandOversampler.h"
+#include "VelvetDiffuser.h"
+#include "VectorFDN.h"
+#include "SurroundOutputs.h"
+
+// Highest sample rate the buffers are reserved for; rates up to it switch without allocating
+#ifndef MAX_SUPPORTED_SAMPLE_RATE
+#define MAX_SUPPORTED_SAMPLE_RATE 192000.0
+#endif
 
 using namespace std;
 
@@ -27,9 +45,40 @@ enum EfxParameter {
 	Param_modRate,
 	Param_lpf,
 	Param_hpf,
+	Param_pitchMode,
 	Param_Count
 };
 
+// Stages of processReplacing timed by the profiler
+enum EfxStage {
+	Stage_pitch = 0,
+	Stage_branch,
+	Stage_master,
+	Stage_Count
+};
+
+// Derived state invalidated by parameter changes, recomputed once per transaction
+enum EfxDirtyFlag {
+	Dirty_mix = 1 << 0,
+	Dirty_roomSize = 1 << 1,
+	Dirty_decay = 1 << 2,
+	Dirty_damping = 1 << 3,
+	Dirty_spread = 1 << 4,
+	Dirty_intervals = 1 << 5,
+	Dirty_modDepth = 1 << 6,
+	Dirty_modRate = 1 << 7,
+	Dirty_lpf = 1 << 8,
+	Dirty_hpf = 1 << 9,
+	Dirty_pitchMode = 1 << 10,
+	Dirty_shimmer = 1 << 11
+};
+
+// declare enum for the pitch shifting engine
+enum class PitchShifterMode {
+	Vocoder = 0,	// phase vocoder, best quality
+	DelayLine		// dual-tap delay line, low latency and low CPU
+};
+
 // Declare class BranchReverb
 class Shimmer;
 
@@ -46,24 +95,69 @@ private:
 //-------------------------------------------------------------------------------------------------------
 class Shimmer : public AudioEffectX {	
 
+	// Memory for all the DSP objects and buffers of this instance
+	Arena dspArena;
+	float _maxSampleRate;
+	// DSP objects exist from the first resume() until a releasing suspend()
+	bool _dspReady;
+	bool _releaseOnSuspend;
+
 	// Initialize ShimmerPresets instance
 	ShimmerPresets* shim_presets;
 	
 	// Shimmer User Parameters
 	float shim_mix, shim_roomSize, shim_shimmer, shim_intervals, shim_decay, shim_damping, shim_spread, shim_modRate, shim_modDepth, shim_lpf, shim_hpf;
 
-	// FDN reverb
-	FDN* BranchReverb;
-	FDN* MasterReverb;
+	// FDN reverbs, each tank at 1/factor of the host rate when its bandwidth allows
+	VectorFDN* BranchReverb;
+	VectorFDN* MasterReverb;
+
+	// Velvet-noise diffusers replacing the FDNs' diffusion steps (only built for DiffusionEngine::Velvet)
+	VelvetDiffuser* branchDiffuser;
+	VelvetDiffuser* masterDiffuser;
+
+	// Seed of the velvet taps: the same seed and room size always give the same taps
+	uint32_t _delaySeed;
 
 	// Pitch Shifters
 	PSMVocoder* PitchShift_1octL;
 	PSMVocoder* PitchShift_1octR;
 	PSMVocoder* PitchShift_2octL;
 	PSMVocoder* PitchShift_2octR;
-
-	// Internal quantities
-	float _wet, _dry, _mixP1, _mixP2;
+	DelayPitchShifter* DelayShift_1octL;
+	DelayPitchShifter* DelayShift_1octR;
+	DelayPitchShifter* DelayShift_2octL;
+	DelayPitchShifter* DelayShift_2octR;
+	PitchShifterMode shim_pitchMode;
+
+	// Internal quantities, only changed at the start of a block
+	float _wet, _dry, _mixP1, _mixP2, _shimmer;
+	PitchShifterMode _pitchMode;
+
+	// Dry path delay, aligns the dry signal with the pitch shifters' latency
+	float* _dryDelayL;
+	float* _dryDelayR;
+	int _dryDelayWriteIndex;
+	int _latencyInSamples;
+	// Latency of the vocoders, measured when they are built
+	int _vocoderLatencyInSamples;
+	// Vocoder samples still to mute after a rate change
+	int _vocoderFlushSamples;
+	// Speakers reported to the host and the mix of the NUM_REVERB_OUTPUTS outputs
+	SurroundOutputs surroundOutputs;
+
+	// Pending updates of the open parameter transaction
+	ParameterChanges parameterChanges;
+
+	// Buffer handed to the host by getChunk
+	StateChunk stateChunk;
+
+#ifdef FOX_STAGE_PROFILING
+	StageProfiler stageProfiler;
+#endif
+#ifdef FOX_CAPTURE
+	CaptureLog captureLog;
+#endif
 
 	void InitPlugin();	
 	void InitPresets();
@@ -71,11 +165,23 @@ class Shimmer : public AudioEffectX {
 private:
 
 	void updateMix();
+	void setDelaySet(VectorFDN* reverb, uint32_t index);
+	void updateRoomSize();
+	void updateDiffusers();
 	void updateMixPitchShifters(float pitch2);
+	void resetPitchShifters(double sampleRate);
+	int getPitchShifterLatency(PitchShifterMode mode);
+	void updateLatency();
+	void reportLatency(int latency);
+	void processReverb(VectorFDN* reverb, VelvetDiffuser* diffuser, const float* inL, const float* inR, float** outputs, int numSamples);
+	void applyParameterChanges();
+	void allocateDSP();
+	void releaseDSP();
+	size_t getArenaSize(float sampleRate);
 
 public:
 
-	Shimmer(audioMasterCallback audioMaster);
+	Shimmer(audioMasterCallback audioMaster, float maxSampleRate = MAX_SUPPORTED_SAMPLE_RATE);
 	~Shimmer();
 
 	// Processing
@@ -88,9 +194,28 @@ public:
 	virtual void getParameterDisplay(VstInt32 index, char* text) override;
 	virtual void getParameterName(VstInt32 index, char* text) override;
 	virtual void setSampleRate(float sampleRate) override;
+	virtual void setBlockSize(VstInt32 blockSize) override;
+	virtual void resume() override;
+	virtual void suspend() override;
 	virtual void setProgram(VstInt32 program) override;
 	virtual void getProgramName(char* name) override;
 	virtual bool getProgramNameIndexed(VstInt32 category, VstInt32 index, char* text) override;
+
+	// Parameter transactions: the changes made in between are applied together, by the first block
+	// after the commit
+	void beginParameterChanges();
+	void commitParameterChanges();
+	virtual bool beginSetProgram() override;
+	virtual bool endSetProgram() override;
+
+	// Whole state in one binary chunk
+	virtual VstInt32 getChunk(void** data, bool isPreset = false) override;
+	virtual VstInt32 setChunk(void* data, VstInt32 byteSize, bool isPreset = false) override;
+	// Stereo in; stereo, 5.1 or 7.1 out as built with NUM_REVERB_OUTPUTS
+	virtual bool setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput) override;
+	virtual bool getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput) override;
+	virtual VstInt32 canDo(char* text) override;
+	virtual VstIntPtr vendorSpecific(VstInt32 lArg, VstIntPtr lArg2, void* ptrArg, float floatArg) override;
 };
 
 
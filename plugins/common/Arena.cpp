@@ -0,0 +1,180 @@
+//-------------------------------------------------------------------------------------------------------
+//  Arena.cpp
+//  Per-instance memory arena for DSP state.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "Arena.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*--------------------------------------------------------------------*/
+// Page-backed allocation for the chunks. Large chunks are aligned to (and on Linux advised as)
+// huge pages, so the whole DSP state of an instance sits behind a handful of TLB entries.
+static char* allocatePages(size_t bytes)
+{
+#ifdef _WIN32
+    return (char*)VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    size_t alignment = bytes >= ARENA_HUGE_PAGE_SIZE ? ARENA_HUGE_PAGE_SIZE : ARENA_ALIGNMENT;
+    void* memory = nullptr;
+    if (posix_memalign(&memory, alignment, bytes) != 0)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (bytes >= ARENA_HUGE_PAGE_SIZE)
+        madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+    return (char*)memory;
+#endif
+}
+
+static void freePages(char* memory)
+{
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    free(memory);
+#endif
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+Arena::Arena()
+{
+    _chunks = nullptr;
+    _lastDestructor = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+Arena::~Arena()
+{
+    release();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Round large regions up to whole huge pages, small ones to whole cache lines
+Arena::Chunk* Arena::addChunk(size_t bytes)
+{
+    if (bytes >= ARENA_HUGE_PAGE_SIZE / 2)
+        bytes = (bytes + ARENA_HUGE_PAGE_SIZE - 1) / ARENA_HUGE_PAGE_SIZE * ARENA_HUGE_PAGE_SIZE;
+    else
+        bytes = (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+    Chunk* chunk = new Chunk;
+    chunk->data = allocatePages(bytes);
+    if (chunk->data == nullptr) {
+        delete chunk;
+        throw std::bad_alloc();
+    }
+    chunk->capacity = bytes;
+    chunk->used = 0;
+
+    // The reserved region stays first, spilled chunks are appended after it
+    chunk->next = nullptr;
+    if (_chunks == nullptr)
+        _chunks = chunk;
+    else {
+        Chunk* last = _chunks;
+        while (last->next != nullptr)
+            last = last->next;
+        last->next = chunk;
+    }
+    return chunk;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Arena::reserve(size_t bytes)
+{
+    release();
+    addChunk(bytes);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+    for (Chunk* chunk = _chunks; chunk != nullptr; chunk = chunk->next) {
+        size_t offset = (chunk->used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= chunk->capacity) {
+            chunk->used = offset + bytes;
+            return chunk->data + offset;
+        }
+    }
+
+    // Out of reserved space: spill into a new chunk
+    Chunk* chunk = addChunk(bytes + alignment);
+    size_t offset = (size_t)(-(ptrdiff_t)chunk->data) & (alignment - 1);
+    chunk->used = offset + bytes;
+    return chunk->data + offset;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float* Arena::allocateFloats(size_t count)
+{
+    float* buffer = (float*)allocate(count * sizeof(float));
+    memset(buffer, 0, count * sizeof(float));
+    return buffer;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Arena::release()
+{
+    // the records live in the chunks: every destructor runs before any chunk is freed
+    while (_lastDestructor != nullptr) {
+        Destructor* destructor = _lastDestructor;
+        _lastDestructor = destructor->previous;
+        destructor->destroy(destructor->object);
+    }
+    while (_chunks != nullptr) {
+        Chunk* next = _chunks->next;
+        freePages(_chunks->data);
+        delete _chunks;
+        _chunks = next;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+size_t Arena::getCapacity()
+{
+    size_t capacity = 0;
+    for (Chunk* chunk = _chunks; chunk != nullptr; chunk = chunk->next)
+        capacity += chunk->capacity;
+    return capacity;
+}
+
+size_t Arena::getUsed()
+{
+    size_t used = 0;
+    for (Chunk* chunk = _chunks; chunk != nullptr; chunk = chunk->next)
+        used += chunk->used;
+    return used;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float* allocateFloats(Arena* arena, size_t count)
+{
+    if (arena != nullptr)
+        return arena->allocateFloats(count);
+    float* buffer = new float[count];
+    memset(buffer, 0, count * sizeof(float));
+    return buffer;
+}
+
+void releaseFloats(Arena* arena, float* buffer)
+{
+    if (arena == nullptr)
+        delete[] buffer;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,125 @@
+//-------------------------------------------------------------------------------------------------------
+//  Arena.h
+//  Per-instance memory arena for DSP state. One contiguous, cache-line aligned region is reserved
+//  up front (rounded to a huge page when large enough) and objects and buffers are carved out of it
+//  with a bump pointer. Nothing is freed individually: release() runs the registered destructors
+//  in reverse order and frees the whole region at once.
+//
+//  The plugin-local DSP blocks (VectorFDN, LaneFDN, VelvetDiffuser, DelayPitchShifter, CombBank and
+//  VectorFreeverb) carve their delay lines out of the arena. Core library objects built here keep
+//  the buffers they allocate themselves, such as PSMVocoder's FFT frames.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#define ARENA_ALIGNMENT 64                      // cache line
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define ARENA_OBJECT_OVERHEAD (2 * ARENA_ALIGNMENT) // per create(): alignment and the destructor record
+
+//-------------------------------------------------------------------------------------------------------
+class Arena {
+
+	// A region of memory; the first one is reserved up front, the others only exist when the
+	// reservation was too small and allocate() had to spill
+	struct Chunk {
+		char* data;
+		size_t capacity;
+		size_t used;
+		Chunk* next;
+	};
+
+	// Destructor of an object built with create(), carved out of the arena just before it and
+	// linked to the one registered before
+	struct Destructor {
+		void (*destroy)(void*);
+		void* object;
+		Destructor* previous;
+	};
+
+	Chunk* _chunks;
+	Destructor* _lastDestructor;
+
+	Chunk* addChunk(size_t bytes);
+
+	template<typename T>
+	static void destroyObject(void* object) { static_cast<T*>(object)->~T(); }
+
+public:
+
+	Arena();
+	~Arena();
+
+	// Reserve the main region. Any previous content is released first.
+	void reserve(size_t bytes);
+
+	// Carve an aligned block out of the arena (never returns nullptr)
+	void* allocate(size_t bytes, size_t alignment = ARENA_ALIGNMENT);
+
+	// Build an object in the arena; its destructor runs on release(). There is no limit on the
+	// number of objects: each takes up to ARENA_OBJECT_OVERHEAD bytes on top of its size.
+	template<typename T, typename... Args>
+	T* create(Args&&... args);
+
+	// Build an array of trivially destructible objects in the arena
+	template<typename T>
+	T* createArray(size_t count);
+
+	// Carve a zeroed float buffer
+	float* allocateFloats(size_t count);
+
+	// Destroy every object and free all memory
+	void release();
+
+	size_t getCapacity();
+	size_t getUsed();
+	bool hasSpilled() { return _chunks != nullptr && _chunks->next != nullptr; }
+};
+
+/*--------------------------------------------------------------------*/
+template<typename T, typename... Args>
+T* Arena::create(Args&&... args)
+{
+	// the record sits in the alignment slot ahead of the object, trivially destructible objects
+	// need none
+	static_assert(sizeof(Destructor) <= ARENA_ALIGNMENT, "the destructor record must fit one alignment slot");
+	size_t alignment = alignof(T) > ARENA_ALIGNMENT ? alignof(T) : ARENA_ALIGNMENT;
+	bool needsDestructor = !std::is_trivially_destructible<T>::value;
+	char* memory = (char*)allocate(needsDestructor ? alignment + sizeof(T) : sizeof(T), alignment);
+	if (needsDestructor)
+		memory += alignment;
+
+	T* object = new (memory) T(std::forward<Args>(args)...);
+	if (needsDestructor) {
+		Destructor* destructor = (Destructor*)(memory - ARENA_ALIGNMENT);
+		destructor->destroy = &Arena::destroyObject<T>;
+		destructor->object = object;
+		destructor->previous = _lastDestructor;
+		_lastDestructor = destructor;
+	}
+	return object;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+template<typename T>
+T* Arena::createArray(size_t count)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+	T* objects = static_cast<T*>(allocate(count * sizeof(T), alignof(T) > ARENA_ALIGNMENT ? alignof(T) : ARENA_ALIGNMENT));
+	for (size_t i = 0; i < count; i++)
+		new (objects + i) T();
+	return objects;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Buffers of DSP blocks: carved from the arena when one is given, from the heap otherwise.
+// Releasing an arena buffer is a no-op, the memory goes away with the arena.
+float* allocateFloats(Arena* arena, size_t count);
+void releaseFloats(Arena* arena, float* buffer);
+/*--------------------------------------------------------------------*/
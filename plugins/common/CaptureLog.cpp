@@ -0,0 +1,324 @@
+//-------------------------------------------------------------------------------------------------------
+//  CaptureLog.cpp
+//  Binary capture of a plugin instance's inputs, parameter changes and outputs.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "CaptureLog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+
+#define CAPTURE_WRITER_IDLE_MS 2
+
+/*--------------------------------------------------------------------*/
+CaptureLog::CaptureLog()
+{
+    _file = nullptr;
+    _numInputs = 0;
+    _numOutputs = 0;
+    _position = 0;
+    _ring = nullptr;
+    _writeIndex = 0;
+    _readIndex = 0;
+    _overrun = false;
+    _eventHead = 0;
+    _eventTail = 0;
+    _running = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+CaptureLog::~CaptureLog()
+{
+    stop();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool CaptureLog::start(const char* path, const char* pluginName, int numInputs, int numOutputs, int numParameters, float sampleRate, const float* parameters)
+{
+    stop();
+    if (numInputs > CAPTURE_MAX_CHANNELS || numOutputs > CAPTURE_MAX_CHANNELS || numParameters > CAPTURE_MAX_PARAMETERS)
+        return false;
+    _file = fopen(path, "wb");
+    if (_file == nullptr)
+        return false;
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, 4);
+    header.version = CAPTURE_VERSION;
+    strncpy(header.pluginName, pluginName, sizeof(header.pluginName) - 1);
+    header.numInputs = numInputs;
+    header.numOutputs = numOutputs;
+    header.numParameters = numParameters;
+    header.sampleRate = sampleRate;
+    fwrite(&header, sizeof(header), 1, _file);
+    fwrite(parameters, sizeof(float), numParameters, _file);
+
+    _numInputs = numInputs;
+    _numOutputs = numOutputs;
+    _position = 0;
+    _ring = (uint8_t*)malloc(CAPTURE_RING_SIZE);
+    _writeIndex = 0;
+    _readIndex = 0;
+    _overrun = false;
+    for (uint32_t e = 0; e < CAPTURE_EVENT_QUEUE_SIZE; e++)
+        _events[e].sequence.store(e, std::memory_order_relaxed);
+    _eventHead = 0;
+    _eventTail = 0;
+
+    _running = true;
+    _writerThread = std::thread(&CaptureLog::writerLoop, this);
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool CaptureLog::startFromEnvironment(const char* pluginName, int numInputs, int numOutputs, int numParameters, float sampleRate, const float* parameters)
+{
+    const char* file = getenv("FOX_CAPTURE_PATH");
+    if (file != nullptr && file[0] != '\0')
+        return start(file, pluginName, numInputs, numOutputs, numParameters, sampleRate, parameters);
+
+    const char* directory = getenv("FOX_CAPTURE_DIR");
+    if (directory == nullptr || directory[0] == '\0')
+        return false;
+
+    static std::atomic<int> instanceCounter(0);
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s-%lld-%d.foxcap", directory, pluginName, (long long)time(nullptr), instanceCounter++);
+    return start(path, pluginName, numInputs, numOutputs, numParameters, sampleRate, parameters);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Processing has stopped by now, so changes still queued can be flushed from this thread
+void CaptureLog::stop()
+{
+    if (!_running)
+        return;
+    drainEvents();
+    _running = false;
+    _writerThread.join();
+    fclose(_file);
+    _file = nullptr;
+    free(_ring);
+    _ring = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  EVENTS  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+// Bounded MPMC queue: a slot's sequence tells whether it is free for the position or holds data
+void CaptureLog::pushEvent(int32_t type, int32_t index, float value)
+{
+    uint32_t position = _eventTail.load(std::memory_order_relaxed);
+    Event* event;
+    while (true) {
+        event = &_events[position & (CAPTURE_EVENT_QUEUE_SIZE - 1)];
+        int32_t difference = (int32_t)(event->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0) {
+            if (_eventTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            // Queue full: the capture could no longer be replayed exactly
+            _overrun = true;
+            return;
+        }
+        else
+            position = _eventTail.load(std::memory_order_relaxed);
+    }
+    event->type = type;
+    event->index = index;
+    event->value = value;
+    event->sequence.store(position + 1, std::memory_order_release);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Single consumer: the audio thread, at the start of a block, or stop() once processing has ended
+void CaptureLog::drainEvents()
+{
+    while (true) {
+        uint32_t position = _eventHead.load(std::memory_order_relaxed);
+        Event* event = &_events[position & (CAPTURE_EVENT_QUEUE_SIZE - 1)];
+        if (event->sequence.load(std::memory_order_acquire) != position + 1)
+            return;
+
+        CaptureRecord record;
+        record.type = event->type;
+        record.numFrames = 0;
+        record.position = _position;
+        record.index = event->index;
+        record.value = event->value;
+        event->sequence.store(position + CAPTURE_EVENT_QUEUE_SIZE, std::memory_order_release);
+        _eventHead.store(position + 1, std::memory_order_relaxed);
+        pushRecord(record, nullptr, 0);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CaptureLog::captureParameter(int index, float value)
+{
+    if (isActive())
+        pushEvent(Capture_parameter, index, value);
+}
+
+void CaptureLog::captureSampleRate(float sampleRate)
+{
+    if (isActive())
+        pushEvent(Capture_sampleRate, 0, sampleRate);
+}
+
+void CaptureLog::captureBlockSize(int blockSize)
+{
+    if (isActive())
+        pushEvent(Capture_blockSize, blockSize, 0.0);
+}
+
+void CaptureLog::captureSuspend()
+{
+    if (isActive())
+        pushEvent(Capture_suspend, 0, 0.0);
+}
+
+void CaptureLog::captureResume()
+{
+    if (isActive())
+        pushEvent(Capture_resume, 0, 0.0);
+}
+
+void CaptureLog::captureReleaseOnSuspend(bool releaseOnSuspend)
+{
+    if (isActive())
+        pushEvent(Capture_releaseOnSuspend, releaseOnSuspend ? 1 : 0, 0.0);
+}
+
+// The seed travels bit for bit in the value field
+void CaptureLog::captureSeed(int slot, uint32_t seed)
+{
+    float bits;
+    memcpy(&bits, &seed, sizeof(bits));
+    if (isActive())
+        pushEvent(Capture_seed, slot, bits);
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  BLOCKS  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+// Copy a record into the ring, or give up the whole capture if it does not fit
+bool CaptureLog::pushRecord(const CaptureRecord& record, float** channels, int numChannels)
+{
+    if (_overrun.load(std::memory_order_relaxed))
+        return false;
+
+    size_t channelBytes = record.numFrames * sizeof(float);
+    size_t size = sizeof(CaptureRecord) + numChannels * channelBytes;
+    uint64_t write = _writeIndex.load(std::memory_order_relaxed);
+    if (size > CAPTURE_RING_SIZE - (write - _readIndex.load(std::memory_order_acquire))) {
+        _overrun = true;
+        return false;
+    }
+
+    const uint8_t* sources[CAPTURE_MAX_CHANNELS + 1];
+    size_t lengths[CAPTURE_MAX_CHANNELS + 1];
+    sources[0] = (const uint8_t*)&record;
+    lengths[0] = sizeof(CaptureRecord);
+    for (int c = 0; c < numChannels; c++) {
+        sources[c + 1] = (const uint8_t*)channels[c];
+        lengths[c + 1] = channelBytes;
+    }
+    for (int s = 0; s <= numChannels; s++) {
+        size_t offset = write & (CAPTURE_RING_SIZE - 1);
+        size_t first = CAPTURE_RING_SIZE - offset < lengths[s] ? CAPTURE_RING_SIZE - offset : lengths[s];
+        memcpy(_ring + offset, sources[s], first);
+        memcpy(_ring, sources[s] + first, lengths[s] - first);
+        write += lengths[s];
+    }
+    _writeIndex.store(write, std::memory_order_release);
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CaptureLog::captureInput(float** inputs, int numFrames)
+{
+    if (!isActive())
+        return;
+    drainEvents();
+
+    CaptureRecord record;
+    record.type = Capture_input;
+    record.numFrames = numFrames;
+    record.position = _position;
+    record.index = 0;
+    record.value = 0.0;
+    pushRecord(record, inputs, _numInputs);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CaptureLog::captureOutput(float** outputs, int numFrames)
+{
+    if (!isActive())
+        return;
+
+    CaptureRecord record;
+    record.type = Capture_output;
+    record.numFrames = numFrames;
+    record.position = _position;
+    record.index = 0;
+    record.value = 0.0;
+    pushRecord(record, outputs, _numOutputs);
+    _position += numFrames;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  WRITER  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+size_t CaptureLog::drainRing()
+{
+    uint64_t read = _readIndex.load(std::memory_order_relaxed);
+    uint64_t write = _writeIndex.load(std::memory_order_acquire);
+    size_t size = (size_t)(write - read);
+    if (size == 0)
+        return 0;
+
+    size_t offset = read & (CAPTURE_RING_SIZE - 1);
+    size_t first = CAPTURE_RING_SIZE - offset < size ? CAPTURE_RING_SIZE - offset : size;
+    fwrite(_ring + offset, 1, first, _file);
+    fwrite(_ring, 1, size - first, _file);
+    _readIndex.store(write, std::memory_order_release);
+    return size;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CaptureLog::writerLoop()
+{
+    while (_running.load(std::memory_order_acquire)) {
+        if (drainRing() == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(CAPTURE_WRITER_IDLE_MS));
+    }
+    drainRing();
+
+    if (_overrun) {
+        CaptureRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = Capture_overrun;
+        record.position = _position;
+        fwrite(&record, sizeof(record), 1, _file);
+    }
+}
+/*--------------------------------------------------------------------*/
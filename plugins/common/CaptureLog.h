@@ -0,0 +1,146 @@
+//-------------------------------------------------------------------------------------------------------
+//  CaptureLog.h
+//  Binary capture of what a plugin instance receives and produces: every host call that changes
+//  its state (sample rate, block size, suspend/resume, release on suspend, parameters, delay seeds
+//  restored from a chunk) and every processReplacing input/output block. Built only with
+//  FOX_CAPTURE; a capture starts when the instance is created and FOX_CAPTURE_DIR names a directory
+//  to write into, or FOX_CAPTURE_PATH the file of a single instance.
+//
+//  The audio thread copies records into a lock-free ring and never touches the file; a background
+//  thread drains the ring to disk. Host calls may come from any thread and go through a bounded
+//  lock-free queue that the audio thread empties at the start of each block, so each one is stamped
+//  with the block it precedes. The plugins apply parameter changes at that same point, before the
+//  block is processed, which makes the stamp the sample position the change takes effect at. A
+//  change made from another thread right as a block starts can be applied by that block but
+//  stamped with the next one: hosts that automate between blocks on the audio thread, as FoxCheck
+//  and FoxRender do, replay exactly. If the ring overflows the capture stops and ends with an
+//  overrun record.
+//
+//  FoxReplay feeds a capture back into a fresh instance of the plugin.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#define CAPTURE_MAGIC "FXCP"
+#define CAPTURE_VERSION 2
+#define CAPTURE_RING_SIZE (16 << 20)            // bytes, power of two
+#define CAPTURE_EVENT_QUEUE_SIZE 1024           // pending host calls, power of two
+#define CAPTURE_MAX_PARAMETERS 64
+#define CAPTURE_MAX_CHANNELS 8
+
+enum CaptureRecordType {
+	Capture_parameter = 1,
+	Capture_sampleRate,
+	Capture_input,
+	Capture_output,
+	Capture_overrun,
+	Capture_blockSize,
+	Capture_suspend,
+	Capture_resume,
+	Capture_releaseOnSuspend,
+	Capture_seed
+};
+
+// File header, followed by numParameters floats with the initial parameter values
+struct CaptureHeader {
+	char magic[4];
+	uint32_t version;
+	char pluginName[32];
+	int32_t numInputs;
+	int32_t numOutputs;
+	int32_t numParameters;
+	float sampleRate;
+};
+
+// Record header. Input/output records are followed by numFrames floats per channel (planar).
+struct CaptureRecord {
+	uint32_t type;
+	uint32_t numFrames;
+	uint64_t position;                          // samples processed before the record
+	int32_t index;                              // parameter index, block size, release flag or seed slot
+	float value;                                // parameter value, sample rate or the seed's bits
+};
+
+//-------------------------------------------------------------------------------------------------------
+class CaptureLog {
+
+	struct Event {
+		std::atomic<uint32_t> sequence;
+		int32_t type;
+		int32_t index;
+		float value;
+	};
+
+	FILE* _file;
+	int _numInputs, _numOutputs;
+	uint64_t _position;
+
+	// Single-producer (audio thread) / single-consumer (writer thread) byte ring
+	uint8_t* _ring;
+	std::atomic<uint64_t> _writeIndex, _readIndex;
+	std::atomic<bool> _overrun;
+
+	// Bounded multi-producer queue of parameter and sample rate changes
+	Event _events[CAPTURE_EVENT_QUEUE_SIZE];
+	std::atomic<uint32_t> _eventHead, _eventTail;
+
+	std::thread _writerThread;
+	std::atomic<bool> _running;
+
+	void pushEvent(int32_t type, int32_t index, float value);
+	void drainEvents();
+	bool pushRecord(const CaptureRecord& record, float** channels, int numChannels);
+	void writerLoop();
+	size_t drainRing();
+
+public:
+
+	CaptureLog();
+	~CaptureLog();
+
+	bool start(const char* path, const char* pluginName, int numInputs, int numOutputs, int numParameters, float sampleRate, const float* parameters);
+	// Start in FOX_CAPTURE_PATH, or in FOX_CAPTURE_DIR with a unique file name, if either is set
+	bool startFromEnvironment(const char* pluginName, int numInputs, int numOutputs, int numParameters, float sampleRate, const float* parameters);
+	void stop();
+	bool isActive() { return _running.load(std::memory_order_relaxed); }
+
+	// Any thread
+	void captureParameter(int index, float value);
+	void captureSampleRate(float sampleRate);
+	void captureBlockSize(int blockSize);
+	void captureSuspend();
+	void captureResume();
+	void captureReleaseOnSuspend(bool releaseOnSuspend);
+	void captureSeed(int slot, uint32_t seed);
+
+	// Audio thread: around processReplacing
+	void captureInput(float** inputs, int numFrames);
+	void captureOutput(float** outputs, int numFrames);
+};
+
+#ifdef FOX_CAPTURE
+#define CAPTURE_PARAMETER(log, index, value) (log).captureParameter(index, value)
+#define CAPTURE_SAMPLE_RATE(log, sampleRate) (log).captureSampleRate(sampleRate)
+#define CAPTURE_BLOCK_SIZE(log, blockSize) (log).captureBlockSize(blockSize)
+#define CAPTURE_SUSPEND(log) (log).captureSuspend()
+#define CAPTURE_RESUME(log) (log).captureResume()
+#define CAPTURE_RELEASE_ON_SUSPEND(log, releaseOnSuspend) (log).captureReleaseOnSuspend(releaseOnSuspend)
+#define CAPTURE_SEED(log, slot, seed) (log).captureSeed(slot, seed)
+#define CAPTURE_INPUT(log, inputs, numFrames) (log).captureInput(inputs, numFrames)
+#define CAPTURE_OUTPUT(log, outputs, numFrames) (log).captureOutput(outputs, numFrames)
+#else
+#define CAPTURE_PARAMETER(log, index, value)
+#define CAPTURE_SAMPLE_RATE(log, sampleRate)
+#define CAPTURE_BLOCK_SIZE(log, blockSize)
+#define CAPTURE_SUSPEND(log)
+#define CAPTURE_RESUME(log)
+#define CAPTURE_RELEASE_ON_SUSPEND(log, releaseOnSuspend)
+#define CAPTURE_SEED(log, slot, seed)
+#define CAPTURE_INPUT(log, inputs, numFrames)
+#define CAPTURE_OUTPUT(log, outputs, numFrames)
+#endif
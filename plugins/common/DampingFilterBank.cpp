@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------------------------
+//  DampingFilterBank.cpp
+//  Decay and damping of every feedback channel of an FDN, processed together with SSE.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "DampingFilterBank.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <emmintrin.h>
+
+/*--------------------------------------------------------------------*/
+// 2^x for x in [-126, 126]: 2^round(x) from the exponent bits times a degree 6 Taylor polynomial
+// of 2^f on [-0.5, 0.5] (relative error below 2e-7). Below -126 the result is 0, so a zero decay
+// really silences the loop.
+static inline __m128 exp2Vector(__m128 x)
+{
+    __m128 inRange = _mm_cmpge_ps(x, _mm_set1_ps(-126.0f));
+    x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(126.0f)), _mm_set1_ps(-126.0f));
+    __m128i whole = _mm_cvtps_epi32(x);
+    __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(whole));
+
+    __m128 p = _mm_set1_ps(1.5403530e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.3333558e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.6181291e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.5504109e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.4022651e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.9314718e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+    __m128i exponent = _mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23);
+    return _mm_and_ps(_mm_mul_ps(p, _mm_castsi128_ps(exponent)), inRange);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+DampingFilterBank::DampingFilterBank()
+{
+    _numChannels = 0;
+    _type = DampingFilterType::OnePole;
+    memset(_inputGains, 0, sizeof(_inputGains));
+    memset(_previousGains, 0, sizeof(_previousGains));
+    memset(_poles, 0, sizeof(_poles));
+    memset(_inputStates, 0, sizeof(_inputStates));
+    memset(_states, 0, sizeof(_states));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DampingFilterBank::init(int numChannels)
+{
+    if (numChannels > DAMPING_BANK_MAX_CHANNELS)
+        numChannels = DAMPING_BANK_MAX_CHANNELS;
+    _numChannels = numChannels & ~3;
+    reset();
+}
+
+void DampingFilterBank::reset()
+{
+    memset(_inputStates, 0, sizeof(_inputStates));
+    memset(_states, 0, sizeof(_states));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// gain = 10^(-3 d / (T60 fs)) = 2^(d * -3 log2(10) / (T60 fs)). With the pole a, the section
+// with DC gain 1 and Nyquist gain n has b0 = ((1 - a) + n (1 + a)) / 2 and b1 = ((1 - a) - n (1 + a)) / 2,
+// both scaled by the channel's gain. r = fs / (2 fc) is the Nyquist frequency in cutoffs:
+//  - OnePole: n = (1 - a) / (1 + a), so b1 = 0
+//  - Matched: n = 1 / sqrt(1 + r^2), the analog one-pole's gain
+//  - Shelving: n = sqrt((1 + (floor r)^2) / (1 + r^2)), the analog shelf's gain
+void DampingFilterBank::setCoefficients(const float* delaysInSamples, float decayInSeconds, float dampingFrequency, float sampleRate)
+{
+    if (sampleRate <= 0.0)
+        return;
+    if (dampingFrequency > 0.49 * sampleRate)
+        dampingFrequency = 0.49 * sampleRate;
+
+    double pole = exp(-2.0 * M_PI * dampingFrequency / sampleRate);
+    double r = 0.5 * sampleRate / dampingFrequency;
+    double nyquistGain = (1.0 - pole) / (1.0 + pole);
+    if (_type == DampingFilterType::Matched)
+        nyquistGain = 1.0 / sqrt(1.0 + r * r);
+    else if (_type == DampingFilterType::Shelving)
+        nyquistGain = sqrt((1.0 + DAMPING_SHELF_FLOOR * DAMPING_SHELF_FLOOR * r * r) / (1.0 + r * r));
+
+    __m128 a = _mm_set1_ps((float)pole);
+    __m128 b0 = _mm_set1_ps((float)(0.5 * ((1.0 - pole) + nyquistGain * (1.0 + pole))));
+    __m128 b1 = _mm_set1_ps(_type == DampingFilterType::OnePole ? 0.0f : (float)(0.5 * ((1.0 - pole) - nyquistGain * (1.0 + pole))));
+    __m128 scale = _mm_set1_ps(decayInSeconds > 0.0 ? -3.0 * M_LN10 / M_LN2 / (decayInSeconds * sampleRate) : -1.0e30f);
+
+    for (int k = 0; k < _numChannels; k += 4) {
+        __m128 gains = exp2Vector(_mm_mul_ps(_mm_loadu_ps(delaysInSamples + k), scale));
+        _mm_store_ps(_inputGains + k, _mm_mul_ps(gains, b0));
+        _mm_store_ps(_previousGains + k, _mm_mul_ps(gains, b1));
+        _mm_store_ps(_poles + k, a);
+    }
+}
+/*--------------------------------------------------------------------*/
+void DampingFilterBank::process(float* x)
+{
+    for (int k = 0; k < _numChannels; k += 4) {
+        __m128 input = _mm_loadu_ps(x + k);
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(_inputGains + k), input), _mm_mul_ps(_mm_load_ps(_previousGains + k), _mm_load_ps(_inputStates + k)));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_load_ps(_poles + k), _mm_load_ps(_states + k)));
+        _mm_store_ps(_inputStates + k, input);
+        _mm_store_ps(_states + k, y);
+        _mm_storeu_ps(x + k, y);
+    }
+}
+/*--------------------------------------------------------------------*/
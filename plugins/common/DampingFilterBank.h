@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------------------------------------
+//  DampingFilterBank.h
+//  Decay and damping of every feedback channel of an FDN, processed together with SSE. Channel
+//  i runs y = b0[i] x + b1[i] x[n-1] + a[i] y[n-1]: a first-order lowpass whose DC gain is the
+//  channel's decay gain, so the loop attenuation and the damping cost three multiplies and two
+//  adds per four channels. States and coefficients are stored as one aligned array each
+//  (structure of arrays).
+//
+//  The zero sets the shape above the damping frequency (DampingFilterType): none for the plain
+//  one-pole, the analog one-pole's gain at Nyquist for Matched (Vicanek's matched lowpass, no
+//  cramping towards Nyquist), or a floor DAMPING_SHELF_FLOOR below the DC gain for Shelving.
+//
+//  setCoefficients recomputes the whole bank in one vector pass, the decay gains included
+//  (10^(-3 d / (T60 fs)) through a vectorized exp2), so parameter changes never loop over
+//  channels with a scalar pow.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#define DAMPING_BANK_MAX_CHANNELS 64
+#define DAMPING_SHELF_FLOOR 0.125               // gain above the cutoff of the shelving shape, -18 dB
+
+enum class DampingFilterType {
+	OnePole = 0,
+	Matched,
+	Shelving
+};
+
+//-------------------------------------------------------------------------------------------------------
+class DampingFilterBank {
+
+	int _numChannels;
+	DampingFilterType _type;
+
+	// b0, b1 = decay gain * the shape's zero terms, a = pole, x and y = filter states
+	alignas(16) float _inputGains[DAMPING_BANK_MAX_CHANNELS];
+	alignas(16) float _previousGains[DAMPING_BANK_MAX_CHANNELS];
+	alignas(16) float _poles[DAMPING_BANK_MAX_CHANNELS];
+	alignas(16) float _inputStates[DAMPING_BANK_MAX_CHANNELS];
+	alignas(16) float _states[DAMPING_BANK_MAX_CHANNELS];
+
+public:
+
+	DampingFilterBank();
+
+	// Multiples of 4, up to DAMPING_BANK_MAX_CHANNELS
+	void init(int numChannels);
+	void reset();
+
+	// Takes effect at the next setCoefficients
+	void setType(DampingFilterType type) { _type = type; }
+	DampingFilterType getType() { return _type; }
+
+	// Decay gains from the channel delays and the decay time, pole and zero from the damping
+	// frequency and the type
+	void setCoefficients(const float* delaysInSamples, float decayInSeconds, float dampingFrequency, float sampleRate);
+
+	// Filters getNumChannels() values in place
+	void process(float* x);
+	int getNumChannels() { return _numChannels; }
+};
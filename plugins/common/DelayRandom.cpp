@@ -0,0 +1,95 @@
+//-------------------------------------------------------------------------------------------------------
+//  DelayRandom.cpp
+//  Reproducible randomness for delay-set generation.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "DelayRandom.h"
+#include <string.h>
+
+#define DELAY_RANDOM_ZERO_SEED 0x9e3779b9u
+#define DELAY_RANDOM_TABLE_SEED 0x7a3c9e15u
+
+/*--------------------------------------------------------------------*/
+// Finalizer of splitmix32: spreads nearby seeds far apart and never returns 0 for xorshift
+static uint32_t mixBits(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x != 0 ? x : DELAY_RANDOM_ZERO_SEED;
+}
+
+static uint32_t xorshift(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Filled by static initialization, before any instance can draw from it
+static uint32_t delayTable[DELAY_RANDOM_TABLE_SIZE];
+
+static bool fillDelayTable()
+{
+    uint32_t state = DELAY_RANDOM_TABLE_SEED;
+    for (int i = 0; i < DELAY_RANDOM_TABLE_SIZE; i++)
+        delayTable[i] = xorshift(state);
+    return true;
+}
+
+static const bool delayTableFilled = fillDelayTable();
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+DelayRandom::DelayRandom(uint32_t seed, bool useTable)
+{
+    _useTable = useTable;
+    this->seed(seed);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayRandom::seed(uint32_t seed)
+{
+    _state = mixBits(seed);
+    _tableIndex = _state;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+uint32_t DelayRandom::nextUInt()
+{
+    if (_useTable)
+        return delayTable[_tableIndex++ & (DELAY_RANDOM_TABLE_SIZE - 1)];
+    return xorshift(_state);
+}
+
+float DelayRandom::nextFloat()
+{
+    return (nextUInt() >> 8) * (1.0f / 16777216.0f);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void DelayRandom::fillInRange(float* values, int count, float minValue, float maxValue)
+{
+    float share = (maxValue - minValue) / count;
+    for (int i = 0; i < count; i++)
+        values[i] = minValue + share * (i + nextFloat());
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+uint32_t DelayRandom::deriveSeed(uint32_t baseSeed, float value, uint32_t index)
+{
+    uint32_t valueBits;
+    memcpy(&valueBits, &value, sizeof(valueBits));
+    return mixBits(mixBits(baseSeed ^ valueBits) + index);
+}
+/*--------------------------------------------------------------------*/
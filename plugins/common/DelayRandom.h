@@ -0,0 +1,49 @@
+//-------------------------------------------------------------------------------------------------------
+//  DelayRandom.h
+//  Reproducible randomness for delay-set generation.
+//
+//  DelayRandom is a small seedable generator (xorshift32) for delay sets built in plugin code. Its
+//  integer arithmetic gives the same sequence on every compiler and machine, and each object owns
+//  its state: nothing is shared between instances or threads, so drawing is safe on the audio
+//  thread. The objects that draw delays take their seed explicitly (VectorFDN, VelvetDiffuser).
+//
+//  In table mode the values are read from a table filled once, from a fixed seed, when the module
+//  is loaded: the seed only picks the starting entry, so drawing a set costs one lookup per value.
+//  The table is read-only after loading, so instances share it without locking.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+
+#define DEFAULT_DELAY_SEED 0x46786f78u          // "Fxox"
+#define DELAY_RANDOM_TABLE_SIZE 4096            // power of two
+
+//-------------------------------------------------------------------------------------------------------
+class DelayRandom {
+
+	uint32_t _state;
+	uint32_t _tableIndex;
+	bool _useTable;
+
+public:
+
+	DelayRandom(uint32_t seed = DEFAULT_DELAY_SEED, bool useTable = false);
+
+	void seed(uint32_t seed);
+	void setTableMode(bool useTable) { _useTable = useTable; }
+	bool getTableMode() { return _useTable; }
+
+	uint32_t nextUInt();
+	// Uniform in [0, 1), with 24 bits of resolution
+	float nextFloat();
+	float nextInRange(float minValue, float maxValue) { return minValue + (maxValue - minValue) * nextFloat(); }
+
+	// One value per slot, each drawn in its own equal share of [minValue, maxValue): spread out
+	// like a uniform distribution but without repeating patterns
+	void fillInRange(float* values, int count, float minValue, float maxValue);
+
+	// Seed for a given state: mixes a base seed with a parameter value and an object index
+	static uint32_t deriveSeed(uint32_t baseSeed, float value, uint32_t index);
+};
+
@@ -0,0 +1,210 @@
+//-------------------------------------------------------------------------------------------------------
+//  FeedbackMatrix.cpp
+//  Lossless feedback mixing for feedback delay networks.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FeedbackMatrix.h"
+#include "DelayRandom.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+/*--------------------------------------------------------------------*/
+static inline bool isPowerOfTwo(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static inline float horizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+FeedbackMatrix::FeedbackMatrix()
+{
+    _type = FeedbackMatrixType::Householder;
+    _numChannels = 0;
+    _numStages = 0;
+    memset(_scratch, 0, sizeof(_scratch));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Draws the rotation cascade: log2(N) stages, each a random permutation (Fisher-Yates) and one
+// angle per pair kept away from 0 and pi/2 so that every rotation really mixes its two channels
+void FeedbackMatrix::init(int numChannels, FeedbackMatrixType type, uint32_t seed)
+{
+    if (numChannels > MAX_FEEDBACK_CHANNELS)
+        numChannels = MAX_FEEDBACK_CHANNELS;
+    _numChannels = numChannels & ~3;
+
+    _numStages = 0;
+    while ((1 << _numStages) < _numChannels)
+        _numStages++;
+
+    DelayRandom random(seed);
+    for (int s = 0; s < _numStages; s++) {
+        int* permutation = _permutations[s];
+        for (int k = 0; k < _numChannels; k++)
+            permutation[k] = k;
+        for (int k = _numChannels - 1; k > 0; k--) {
+            int j = random.nextUInt() % (k + 1);
+            int swap = permutation[k];
+            permutation[k] = permutation[j];
+            permutation[j] = swap;
+        }
+        for (int p = 0; p < _numChannels / 2; p++) {
+            float angle = random.nextInRange(M_PI / 8.0, 3.0 * M_PI / 8.0);
+            _cosines[s][p] = cos(angle);
+            _sines[s][p] = sin(angle);
+        }
+    }
+
+    setType(type);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FeedbackMatrix::setType(FeedbackMatrixType type)
+{
+    if (type == FeedbackMatrixType::Hadamard && !isPowerOfTwo(_numChannels))
+        type = FeedbackMatrixType::Householder;
+    _type = type;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void FeedbackMatrix::process(float* x)
+{
+    switch (_type) {
+    case FeedbackMatrixType::Hadamard:
+        applyHadamard(x);
+        break;
+    case FeedbackMatrixType::Rotation:
+        applyRotation(x);
+        break;
+    default:
+        applyHouseholder(x);
+        break;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Reflection about the plane orthogonal to (1, ..., 1): x - 2 * mean(x)
+void FeedbackMatrix::applyHouseholder(float* x)
+{
+    __m128 acc = _mm_setzero_ps();
+    for (int k = 0; k < _numChannels; k += 4)
+        acc = _mm_add_ps(acc, _mm_loadu_ps(x + k));
+    __m128 offset = _mm_set1_ps(horizontalSum(acc) * 2.0f / _numChannels);
+    for (int k = 0; k < _numChannels; k += 4)
+        _mm_storeu_ps(x + k, _mm_sub_ps(_mm_loadu_ps(x + k), offset));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The two shortest butterfly passes stay inside one register: [a, b, c, d] becomes
+// [a + b, a - b, c + d, c - d] and then pairs two apart are combined the same way. Longer
+// passes combine whole registers, the last one also applies the 1/sqrt(N) scale.
+void FeedbackMatrix::applyHadamard(float* x)
+{
+    const __m128 signs1 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    const __m128 signs2 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+    __m128 scale = _mm_set1_ps(1.0f / sqrtf((float)_numChannels));
+    bool scaled = _numChannels == 4;
+
+    for (int k = 0; k < _numChannels; k += 4) {
+        __m128 v = _mm_loadu_ps(x + k);
+        v = _mm_add_ps(_mm_mul_ps(v, signs1), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm_add_ps(_mm_mul_ps(v, signs2), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        if (scaled)
+            v = _mm_mul_ps(v, scale);
+        _mm_storeu_ps(x + k, v);
+    }
+
+    for (int h = 4; h < _numChannels; h <<= 1) {
+        bool last = 2 * h == _numChannels;
+        for (int i = 0; i < _numChannels; i += 2 * h) {
+            for (int j = i; j < i + h; j += 4) {
+                __m128 a = _mm_loadu_ps(x + j);
+                __m128 b = _mm_loadu_ps(x + j + h);
+                __m128 sum = _mm_add_ps(a, b);
+                __m128 difference = _mm_sub_ps(a, b);
+                if (last) {
+                    sum = _mm_mul_ps(sum, scale);
+                    difference = _mm_mul_ps(difference, scale);
+                }
+                _mm_storeu_ps(x + j, sum);
+                _mm_storeu_ps(x + j + h, difference);
+            }
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Each stage gathers the channels in permuted order, then rotates consecutive pairs:
+// (a, b) -> (c a - s b, s a + c b). Four pairs are deinterleaved into one register of first and
+// one of second elements, rotated, and interleaved back.
+void FeedbackMatrix::applyRotation(float* x)
+{
+    int numPairs = _numChannels / 2;
+    for (int s = 0; s < _numStages; s++) {
+        const int* permutation = _permutations[s];
+        for (int k = 0; k < _numChannels; k++)
+            _scratch[k] = x[permutation[k]];
+
+        int p = 0;
+        for (; p + 4 <= numPairs; p += 4) {
+            __m128 v0 = _mm_loadu_ps(_scratch + 2 * p);
+            __m128 v1 = _mm_loadu_ps(_scratch + 2 * p + 4);
+            __m128 a = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 b = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 c = _mm_loadu_ps(_cosines[s] + p);
+            __m128 sn = _mm_loadu_ps(_sines[s] + p);
+            __m128 ra = _mm_sub_ps(_mm_mul_ps(c, a), _mm_mul_ps(sn, b));
+            __m128 rb = _mm_add_ps(_mm_mul_ps(sn, a), _mm_mul_ps(c, b));
+            _mm_storeu_ps(x + 2 * p, _mm_unpacklo_ps(ra, rb));
+            _mm_storeu_ps(x + 2 * p + 4, _mm_unpackhi_ps(ra, rb));
+        }
+        for (; p < numPairs; p++) {
+            float a = _scratch[2 * p];
+            float b = _scratch[2 * p + 1];
+            x[2 * p] = _cosines[s][p] * a - _sines[s][p] * b;
+            x[2 * p + 1] = _sines[s][p] * a + _cosines[s][p] * b;
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float FeedbackMatrix::getUnitarityError()
+{
+    float columns[MAX_FEEDBACK_CHANNELS][MAX_FEEDBACK_CHANNELS];
+    for (int j = 0; j < _numChannels; j++) {
+        memset(columns[j], 0, sizeof(columns[j]));
+        columns[j][j] = 1.0f;
+        process(columns[j]);
+    }
+
+    float maxError = 0.0f;
+    for (int i = 0; i < _numChannels; i++) {
+        for (int j = i; j < _numChannels; j++) {
+            double dot = 0.0;
+            for (int k = 0; k < _numChannels; k++)
+                dot += (double)columns[i][k] * columns[j][k];
+            float error = fabs(dot - (i == j ? 1.0 : 0.0));
+            if (error > maxError)
+                maxError = error;
+        }
+    }
+    return maxError;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,59 @@
+//-------------------------------------------------------------------------------------------------------
+//  FeedbackMatrix.h
+//  Lossless (orthogonal) feedback mixing for feedback delay networks, applied in place without
+//  ever forming the N x N matrix:
+//   - Householder: I - 2/N * 1 1^T, one sum and one subtraction per channel (O(N))
+//   - Hadamard: fast Walsh-Hadamard transform scaled by 1/sqrt(N), log2(N) butterfly passes
+//     (O(N log N)); N must be a power of two, other sizes fall back to Householder
+//   - Rotation: log2(N) stages of a fixed permutation followed by N/2 plane rotations, with the
+//     permutations and angles drawn from a seed (O(N log N))
+//  Channel counts are multiples of 4 up to MAX_FEEDBACK_CHANNELS; every pass runs on 4-wide SSE.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+
+#define MAX_FEEDBACK_CHANNELS 64
+#define MAX_FEEDBACK_ROTATION_STAGES 6          // log2(MAX_FEEDBACK_CHANNELS)
+
+enum class FeedbackMatrixType {
+	Householder = 0,
+	Hadamard,
+	Rotation
+};
+
+//-------------------------------------------------------------------------------------------------------
+class FeedbackMatrix {
+
+	FeedbackMatrixType _type;
+	int _numChannels;
+	int _numStages;
+
+	// Rotation cascade: source channel of each output slot, then one angle per channel pair
+	int _permutations[MAX_FEEDBACK_ROTATION_STAGES][MAX_FEEDBACK_CHANNELS];
+	float _cosines[MAX_FEEDBACK_ROTATION_STAGES][MAX_FEEDBACK_CHANNELS / 2];
+	float _sines[MAX_FEEDBACK_ROTATION_STAGES][MAX_FEEDBACK_CHANNELS / 2];
+	float _scratch[MAX_FEEDBACK_CHANNELS];
+
+	void applyHouseholder(float* x);
+	void applyHadamard(float* x);
+	void applyRotation(float* x);
+
+public:
+
+	FeedbackMatrix();
+
+	// Channel counts are rounded down to a supported size; the seed only matters for Rotation
+	void init(int numChannels, FeedbackMatrixType type, uint32_t seed);
+	void setType(FeedbackMatrixType type);
+	FeedbackMatrixType getType() { return _type; }
+	int getNumChannels() { return _numChannels; }
+
+	// x = M x over getNumChannels() values
+	void process(float* x);
+
+	// Largest deviation of M^T M from the identity, measured on the basis vectors. Costs N
+	// applications and an N x N Gram matrix: for checks outside the audio thread.
+	float getUnitarityError();
+};
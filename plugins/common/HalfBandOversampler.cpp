@@ -0,0 +1,527 @@
+//-------------------------------------------------------------------------------------------------------
+//  HalfBandOversampler.cpp
+//  2x/4x oversampling and decimation built from cascaded polyphase half-band FIR stages.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "HalfBandOversampler.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#define KAISER_BETA 7.0
+
+/*--------------------------------------------------------------------*/
+// Dot product of the coefficients with a HALFBAND_TAPS long window
+static inline float dotProduct(const float* coefficients, const float* window)
+{
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < HALFBAND_TAPS; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(coefficients + i), _mm_loadu_ps(window + i)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+}
+
+// Zeroth order modified Bessel function, used by the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser-windowed half-band lowpass. h[0] = 0.5 and the even taps vanish, so only the odd taps
+// k = +-1, +-3, ... are stored. Window index i holds tap k = 2 * HALFBAND_HALF_TAPS - 1 - 2 * i.
+static void designCoefficients(float* coefficients)
+{
+    int halfLength = 2 * HALFBAND_HALF_TAPS;
+    double sum = 0.0;
+    for (int i = 0; i < HALFBAND_TAPS; i++) {
+        int k = 2 * HALFBAND_HALF_TAPS - 1 - 2 * i;
+        double ratio = (double)k / halfLength;
+        double window = besselI0(KAISER_BETA * sqrt(1.0 - ratio * ratio)) / besselI0(KAISER_BETA);
+        double sinc = sin(M_PI * k * 0.5) / (M_PI * k);
+        coefficients[i] = sinc * window;
+        sum += coefficients[i];
+    }
+
+    // Normalize for unity DC gain: odd taps must sum to 0.5
+    for (int i = 0; i < HALFBAND_TAPS; i++)
+        coefficients[i] *= 0.5 / sum;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+HalfBandStage::HalfBandStage()
+{
+    reset();
+}
+
+void HalfBandStage::reset()
+{
+    memset(_upHistory, 0, sizeof(_upHistory));
+    memset(_downEvenHistory, 0, sizeof(_downEvenHistory));
+    memset(_downOddHistory, 0, sizeof(_downOddHistory));
+    _upIndex = 0;
+    _downIndex = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Histories are written twice, HALFBAND_TAPS apart, so the last HALFBAND_TAPS samples are always
+// contiguous (oldest first) starting at index + 1.
+void HalfBandStage::upsample(const float* input, float* output, int numSamples, const float* coefficients)
+{
+    for (int n = 0; n < numSamples; n++) {
+        _upHistory[_upIndex] = input[n];
+        _upHistory[_upIndex + HALFBAND_TAPS] = input[n];
+        const float* window = _upHistory + _upIndex + 1;
+
+        // Even phase is the delayed input, odd phase is the interpolated sample (x2 for the zero stuffing)
+        output[2 * n] = window[HALFBAND_HALF_TAPS - 1];
+        output[2 * n + 1] = 2.0 * dotProduct(coefficients, window);
+
+        _upIndex = (_upIndex + 1) % HALFBAND_TAPS;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandStage::downsample(const float* input, float* output, int numSamples, const float* coefficients)
+{
+    for (int n = 0; n < numSamples; n++) {
+        // Odd phase window holds the previous HALFBAND_TAPS odd samples
+        float odd = dotProduct(coefficients, _downOddHistory + _downIndex);
+
+        _downEvenHistory[_downIndex] = input[2 * n];
+        _downEvenHistory[_downIndex + HALFBAND_TAPS] = input[2 * n];
+        _downOddHistory[_downIndex] = input[2 * n + 1];
+        _downOddHistory[_downIndex + HALFBAND_TAPS] = input[2 * n + 1];
+        float even = _downEvenHistory[_downIndex + HALFBAND_HALF_TAPS];
+
+        output[n] = 0.5 * even + odd;
+
+        _downIndex = (_downIndex + 1) % HALFBAND_TAPS;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Append numSamples samples to a history of the given length, oldest first
+static void pushHistory(float* history, int length, const float* input, int numSamples)
+{
+    if (numSamples >= length) {
+        memcpy(history, input + numSamples - length, length * sizeof(float));
+        return;
+    }
+    memmove(history, history + numSamples, (length - numSamples) * sizeof(float));
+    memcpy(history + length - numSamples, input, numSamples * sizeof(float));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+HalfBandOversampler::HalfBandOversampler()
+{
+    _numChannels = 0;
+    _factor = 1;
+    _requestedFactor = 1;
+    _latency = 0;
+    _minLatency = 0;
+    designCoefficients(_coefficients);
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandOversampler::init(int numChannels)
+{
+    _numChannels = numChannels > MAX_OVERSAMPLER_CHANNELS ? MAX_OVERSAMPLER_CHANNELS : numChannels;
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandOversampler::reset()
+{
+    for (int c = 0; c < MAX_OVERSAMPLER_CHANNELS; c++) {
+        _stages[c][0].reset();
+        _stages[c][1].reset();
+        _compensationIndex[c] = 0;
+        _channelFactor[c] = _factor;
+        _numReplayed[c] = 0;
+    }
+    memset(_compensation, 0, sizeof(_compensation));
+    memset(_inputHistory, 0, sizeof(_inputHistory));
+    memset(_processedHistory, 0, sizeof(_processedHistory));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A 2x round trip delays by 2 * HALFBAND_HALF_TAPS and the 4x one by 3 * HALFBAND_HALF_TAPS base-rate samples
+int HalfBandOversampler::getFactorLatency(int factor)
+{
+    if (factor >= 4)
+        return 3 * HALFBAND_HALF_TAPS;
+    if (factor >= 2)
+        return 2 * HALFBAND_HALF_TAPS;
+    return 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandOversampler::setFactor(int factor)
+{
+    if (factor >= 4)
+        factor = 4;
+    else if (factor >= 2)
+        factor = 2;
+    else
+        factor = 1;
+    _requestedFactor = factor;
+
+    // a longer round trip than the host knows about waits for the next resume
+    while (getFactorLatency(factor) > _latency)
+        factor /= 2;
+    _factor = factor;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandOversampler::setMaxFactor(int factor)
+{
+    _minLatency = getFactorLatency(factor);
+    if (_latency < _minLatency)
+        _latency = _minLatency;
+    setFactor(_requestedFactor);
+}
+
+// never below the latency of the maximum factor
+bool HalfBandOversampler::updateLatency()
+{
+    int latency = getFactorLatency(_requestedFactor);
+    if (latency < _minLatency)
+        latency = _minLatency;
+    if (latency == _latency)
+        return false;
+    _latency = latency;
+    _factor = _requestedFactor;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Move a channel to the current factor without losing what its stages hold.
+void HalfBandOversampler::switchFactor(int channel)
+{
+    int fromFactor = _channelFactor[channel];
+    int toFactor = _factor;
+    _channelFactor[channel] = toFactor;
+
+    float raw[OVERSAMPLER_HISTORY_LENGTH * MAX_OVERSAMPLING_FACTOR];
+    float processed[OVERSAMPLER_HISTORY_LENGTH * MAX_OVERSAMPLING_FACTOR];
+    float work[OVERSAMPLER_HISTORY_LENGTH * MAX_OVERSAMPLING_FACTOR];
+
+    if (toFactor < fromFactor) {
+        // The old path still held the last inputs it was given: the next block runs them again through
+        // the new one. Down from 4x, the base stage's decimation window already holds what the 2x path
+        // would have given it by then, only its interpolation window is taken back before those inputs.
+        int numReplayed = getFactorLatency(fromFactor) - getFactorLatency(toFactor);
+        int numKept = OVERSAMPLER_HISTORY_LENGTH - numReplayed;
+        _numReplayed[channel] = numReplayed;
+
+        // the processed signal isn't known at the lower rate: the input stands in for it until the
+        // next blocks replace it
+        memset(processed, 0, sizeof(processed));
+        if (toFactor == 2) {
+            _stages[channel][0].upsample(_inputHistory[channel], work, numKept, _coefficients);
+            memcpy(processed + 2 * numReplayed, work, 2 * numKept * sizeof(float));
+        }
+        else
+            memcpy(processed + numReplayed, _inputHistory[channel], numKept * sizeof(float));
+        memcpy(_processedHistory[channel], processed, OVERSAMPLER_HISTORY_LENGTH * toFactor * sizeof(float));
+        return;
+    }
+
+    // Up: the added interpolation stages are rebuilt exactly from the input history. The decimation
+    // stages need the caller's processed signal at the new rate, interpolated from the processed history
+    // by spare stages, which delay it just like the interpolation path would have. Each decimation stage
+    // then gets the window it would have had, from the top one down.
+    int numSamples = OVERSAMPLER_HISTORY_LENGTH;
+    memcpy(raw, _inputHistory[channel], numSamples * sizeof(float));
+    memcpy(processed, _processedHistory[channel], numSamples * fromFactor * sizeof(float));
+    int numStages = 0;
+    for (int rate = 1; rate < toFactor; rate *= 2, numStages++) {
+        if (rate < fromFactor) {
+            HalfBandStage spare;
+            spare.upsample(raw, work, numSamples, _coefficients);
+        }
+        else {
+            HalfBandStage spare;
+            spare.upsample(processed, work, numSamples, _coefficients);
+            memcpy(processed, work, 2 * numSamples * sizeof(float));
+            _stages[channel][numStages].upsample(raw, work, numSamples, _coefficients);
+        }
+        memcpy(raw, work, 2 * numSamples * sizeof(float));
+        numSamples *= 2;
+    }
+    memcpy(_processedHistory[channel], processed, numSamples * sizeof(float));
+
+    for (int stage = numStages - 1; stage >= 0; stage--) {
+        numSamples /= 2;
+        _stages[channel][stage].downsample(processed, work, numSamples, _coefficients);
+        memcpy(processed, work, numSamples * sizeof(float));
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float* HalfBandOversampler::upsample(int channel, const float* input, int numSamples, int* numOversampled)
+{
+    if (_channelFactor[channel] != _factor)
+        switchFactor(channel);
+
+    // the first block after a switch to a shorter path starts with the inputs the old one held back
+    int numReplayed = _numReplayed[channel];
+    if (numReplayed > 0) {
+        memcpy(_baseRate, _inputHistory[channel] + OVERSAMPLER_HISTORY_LENGTH - numReplayed, numReplayed * sizeof(float));
+        memcpy(_baseRate + numReplayed, input, numSamples * sizeof(float));
+    }
+    pushHistory(_inputHistory[channel], OVERSAMPLER_HISTORY_LENGTH, input, numSamples);
+    if (numReplayed > 0)
+        input = _baseRate;
+
+    int numFrames = numReplayed + numSamples;
+    float* output = _oversampled[channel];
+    switch (_channelFactor[channel]) {
+    case 4:
+        _stages[channel][0].upsample(input, _intermediate, numFrames, _coefficients);
+        _stages[channel][1].upsample(_intermediate, output, 2 * numFrames, _coefficients);
+        break;
+    case 2:
+        _stages[channel][0].upsample(input, output, numFrames, _coefficients);
+        break;
+    default:
+        memcpy(output, input, numFrames * sizeof(float));
+        break;
+    }
+    *numOversampled = numFrames * _channelFactor[channel];
+    return output;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandOversampler::downsample(int channel, float* output, int numSamples)
+{
+    int factor = _channelFactor[channel];
+    int numReplayed = _numReplayed[channel];
+    int numFrames = numReplayed + numSamples;
+    _numReplayed[channel] = 0;
+
+    float* input = _oversampled[channel];
+    pushHistory(_processedHistory[channel], OVERSAMPLER_HISTORY_LENGTH * factor, input, numFrames * factor);
+    switch (factor) {
+    case 4:
+        _stages[channel][1].downsample(input, _intermediate, 2 * numFrames, _coefficients);
+        _stages[channel][0].downsample(_intermediate, _baseRate, numFrames, _coefficients);
+        break;
+    case 2:
+        _stages[channel][0].downsample(input, _baseRate, numFrames, _coefficients);
+        break;
+    default:
+        memcpy(_baseRate, input, numFrames * sizeof(float));
+        break;
+    }
+    compensate(channel, _baseRate, numReplayed, output, numSamples);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The path's output is written where the sample it came from was input, getFactorLatency() back, and
+// read _latency back. A new path only moves the write position: a longer one overwrites samples the
+// old path already wrote, the replayed samples of a shorter one fill in those the old path never got to.
+void HalfBandOversampler::compensate(int channel, const float* input, int numReplayed, float* output, int numSamples)
+{
+    int length = 4 * HALFBAND_HALF_TAPS;
+    int writeDelay = getFactorLatency(_channelFactor[channel]);
+    float* line = _compensation[channel];
+    int index = _compensationIndex[channel];
+
+    for (int n = 0; n < numReplayed; n++)
+        line[(index - numReplayed + n - writeDelay + 2 * length) % length] = input[n];
+    input += numReplayed;
+
+    for (int n = 0; n < numSamples; n++) {
+        int writeIndex = index - writeDelay;
+        if (writeIndex < 0)
+            writeIndex += length;
+        line[writeIndex] = input[n];
+        int readIndex = index - _latency;
+        if (readIndex < 0)
+            readIndex += length;
+        output[n] = line[readIndex];
+        index = (index + 1) % length;
+    }
+    _compensationIndex[channel] = index;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+HalfBandDecimator::HalfBandDecimator()
+{
+    _numChannels = 0;
+    _factor = 1;
+    _frameAligned = false;
+    designCoefficients(_coefficients);
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandDecimator::init(int numChannels)
+{
+    _numChannels = numChannels > MAX_DECIMATOR_CHANNELS ? MAX_DECIMATOR_CHANNELS : numChannels;
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The output side starts factor - 1 samples ahead, so that it always holds what the input side
+// still lacks to complete a frame: every call can then return exactly numSamples. Frame aligned,
+// the input side also starts with the zeros that round the latency up to whole frames.
+void HalfBandDecimator::reset()
+{
+    int padding = _frameAligned ? getAlignedLatency(_factor) - getFactorLatency(_factor) : 0;
+    for (int c = 0; c < MAX_DECIMATOR_CHANNELS; c++) {
+        for (int s = 0; s < 2; s++) {
+            _down[c][s].reset();
+            _up[c][s].reset();
+        }
+        _numPendingInput[c] = padding;
+        _numPendingOutput[c] = _factor - 1;
+        _numDecimated[c] = 0;
+    }
+    memset(_pendingInput, 0, sizeof(_pendingInput));
+    memset(_pendingOutput, 0, sizeof(_pendingOutput));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandDecimator::setFactor(int factor)
+{
+    if (factor >= 4)
+        factor = 4;
+    else if (factor >= 2)
+        factor = 2;
+    else
+        factor = 1;
+    if (factor != _factor) {
+        _factor = factor;
+        reset();
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int HalfBandDecimator::chooseFactor(float bandwidth, float sampleRate, int maxFactor)
+{
+    if (maxFactor > MAX_DECIMATION_FACTOR)
+        maxFactor = MAX_DECIMATION_FACTOR;
+    int factor = 1;
+    while (factor < maxFactor && bandwidth < DECIMATOR_PASSBAND_RATIO * sampleRate / factor)
+        factor *= 2;
+    return factor;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Each stage delays by HALFBAND_HALF_TAPS at its lower rate on the way down and again on the way
+// up; the output side running factor - 1 samples ahead adds the rest
+int HalfBandDecimator::getFactorLatency(int factor)
+{
+    if (factor >= 4)
+        return 12 * HALFBAND_HALF_TAPS + 3;
+    if (factor >= 2)
+        return 4 * HALFBAND_HALF_TAPS + 1;
+    return 0;
+}
+
+int HalfBandDecimator::getAlignedLatency(int factor)
+{
+    int latency = getFactorLatency(factor);
+    return factor > 1 ? (latency + factor - 1) / factor * factor : latency;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float* HalfBandDecimator::decimate(int channel, const float* input, int numSamples, int* numDecimated)
+{
+    float* output = _decimated[channel];
+    if (_factor == 1) {
+        memcpy(output, input, numSamples * sizeof(float));
+        _numDecimated[channel] = numSamples;
+        *numDecimated = numSamples;
+        return output;
+    }
+
+    // Complete frames with the samples left over from the last call, keep the new remainder
+    int numPending = _numPendingInput[channel];
+    int total = numPending + numSamples;
+    int frames = total / _factor;
+    memcpy(_baseRate, _pendingInput[channel], numPending * sizeof(float));
+    memcpy(_baseRate + numPending, input, numSamples * sizeof(float));
+    _numPendingInput[channel] = total - frames * _factor;
+    memcpy(_pendingInput[channel], _baseRate + frames * _factor, _numPendingInput[channel] * sizeof(float));
+
+    if (_factor == 4) {
+        _down[channel][0].downsample(_baseRate, _intermediate, 2 * frames, _coefficients);
+        _down[channel][1].downsample(_intermediate, output, frames, _coefficients);
+    }
+    else
+        _down[channel][0].downsample(_baseRate, output, frames, _coefficients);
+
+    _numDecimated[channel] = frames;
+    *numDecimated = frames;
+    return output;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float* HalfBandDecimator::getDecimated(int channel, int numDecimated)
+{
+    _numDecimated[channel] = numDecimated;
+    return _decimated[channel];
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void HalfBandDecimator::interpolate(int channel, float* output, int numSamples)
+{
+    float* input = _decimated[channel];
+    int frames = _numDecimated[channel];
+    if (_factor == 1) {
+        memcpy(output, input, numSamples * sizeof(float));
+        return;
+    }
+
+    // Queue the interpolated frames behind the samples not handed out yet
+    int numPending = _numPendingOutput[channel];
+    float* frameOutput = _baseRate + numPending;
+    memcpy(_baseRate, _pendingOutput[channel], numPending * sizeof(float));
+    if (_factor == 4) {
+        _up[channel][1].upsample(input, _intermediate, frames, _coefficients);
+        _up[channel][0].upsample(_intermediate, frameOutput, 2 * frames, _coefficients);
+    }
+    else
+        _up[channel][0].upsample(input, frameOutput, frames, _coefficients);
+
+    int total = numPending + frames * _factor;
+    memcpy(output, _baseRate, numSamples * sizeof(float));
+    _numPendingOutput[channel] = total - numSamples;
+    memcpy(_pendingOutput[channel], _baseRate + numSamples, _numPendingOutput[channel] * sizeof(float));
+}
+/*--------------------------------------------------------------------*/
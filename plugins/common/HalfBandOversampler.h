@@ -0,0 +1,188 @@
+//-------------------------------------------------------------------------------------------------------
+//  HalfBandOversampler.h
+//  2x/4x oversampling and decimation built from cascaded polyphase half-band FIR stages.
+//  Only the odd-phase taps of a half-band filter are non-zero, so every stage costs one short
+//  SSE dot product per output pair.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// Non-zero odd taps on each side of the centre tap (filter length = 4 * HALFBAND_HALF_TAPS - 1)
+#define HALFBAND_HALF_TAPS 12
+#define HALFBAND_TAPS (2 * HALFBAND_HALF_TAPS)
+#define MAX_OVERSAMPLING_FACTOR 4
+#define MAX_OVERSAMPLER_CHANNELS 2
+#define MAX_OVERSAMPLER_BLOCK_SIZE 256
+#define OVERSAMPLER_HISTORY_LENGTH (4 * HALFBAND_TAPS)    // base-rate samples kept to prime the stages
+#define OVERSAMPLER_MAX_REPLAY (3 * HALFBAND_HALF_TAPS)    // longest latency difference between factors
+#define MAX_DECIMATION_FACTOR 4
+#define MAX_DECIMATOR_CHANNELS 8                // stereo in, up to 7.1 out
+#define MAX_DECIMATOR_BLOCK_SIZE 256
+#define DECIMATOR_PASSBAND_RATIO 0.2            // band kept by a stage, as a fraction of its higher rate
+
+// Highest factor the plugins run their reverbs decimated by; build with 1 to keep them at full rate
+#ifndef MULTIRATE_MAX_FACTOR
+#define MULTIRATE_MAX_FACTOR MAX_DECIMATION_FACTOR
+#endif
+// Damping and output filters roll off gently: the band kept for a reverb reaches an octave above them
+#define MULTIRATE_BANDWIDTH_MARGIN 2.0
+
+//-------------------------------------------------------------------------------------------------------
+// One 2x half-band stage for a single channel. Both directions delay the signal by HALFBAND_HALF_TAPS
+// samples at the stage's lower rate.
+class HalfBandStage {
+
+	float _upHistory[2 * HALFBAND_TAPS];
+	float _downEvenHistory[2 * HALFBAND_TAPS];
+	float _downOddHistory[2 * HALFBAND_TAPS];
+	int _upIndex;
+	int _downIndex;
+
+public:
+
+	HalfBandStage();
+	void reset();
+
+	// numSamples input samples -> 2 * numSamples output samples
+	void upsample(const float* input, float* output, int numSamples, const float* coefficients);
+
+	// 2 * numSamples input samples -> numSamples output samples
+	void downsample(const float* input, float* output, int numSamples, const float* coefficients);
+};
+
+//-------------------------------------------------------------------------------------------------------
+// The latency is the round trip of the factor the host was last told about (getFactorLatency): lower
+// factors are padded up to it, and a higher factor requested while processing waits for updateLatency(),
+// called from resume(), so the reported latency always holds. setMaxFactor() reports the longest round
+// trip from the start instead, and every factor up to it switches while processing. A factor change keeps the stages running
+// and takes effect at the next upsample(): a longer path has its added stages primed from the recent
+// signal, a shorter one first runs the input the old path still held through the new one.
+class HalfBandOversampler {
+
+	// Odd-phase coefficients, ordered to match the history windows
+	float _coefficients[HALFBAND_TAPS];
+
+	// Two cascaded stages per channel: [0] base <-> 2x, [1] 2x <-> 4x
+	HalfBandStage _stages[MAX_OVERSAMPLER_CHANNELS][2];
+
+	// Oversampled and work buffers, with room for the samples replayed after a factor change
+	float _oversampled[MAX_OVERSAMPLER_CHANNELS][(MAX_OVERSAMPLER_BLOCK_SIZE + OVERSAMPLER_MAX_REPLAY) * MAX_OVERSAMPLING_FACTOR];
+	float _intermediate[(MAX_OVERSAMPLER_BLOCK_SIZE + OVERSAMPLER_MAX_REPLAY) * 2];
+	float _baseRate[MAX_OVERSAMPLER_BLOCK_SIZE + OVERSAMPLER_MAX_REPLAY];
+
+	// Last OVERSAMPLER_HISTORY_LENGTH base-rate inputs, and the caller's processed signal over the same
+	// span at the channel's rate: what new stages are primed with
+	float _inputHistory[MAX_OVERSAMPLER_CHANNELS][OVERSAMPLER_HISTORY_LENGTH];
+	float _processedHistory[MAX_OVERSAMPLER_CHANNELS][OVERSAMPLER_HISTORY_LENGTH * MAX_OVERSAMPLING_FACTOR];
+
+	// Pads the current path up to the reported latency. Samples are stored by the time they were
+	// input, so switching between paths of different length neither skips nor repeats any.
+	float _compensation[MAX_OVERSAMPLER_CHANNELS][4 * HALFBAND_HALF_TAPS];
+	int _compensationIndex[MAX_OVERSAMPLER_CHANNELS];
+
+	// Factor each channel last ran at, and the inputs its next block replays
+	int _channelFactor[MAX_OVERSAMPLER_CHANNELS];
+	int _numReplayed[MAX_OVERSAMPLER_CHANNELS];
+
+	int _numChannels;
+	int _factor;
+	int _requestedFactor;
+	int _latency;
+	int _minLatency;
+
+	void switchFactor(int channel);
+	void compensate(int channel, const float* input, int numReplayed, float* output, int numSamples);
+
+public:
+
+	HalfBandOversampler();
+
+	void init(int numChannels);
+	void reset();
+
+	// Run at the given factor, or at the highest lower one that fits in the current latency
+	void setFactor(int factor);
+	int getFactor() { return _factor; }
+
+	// Take on the latency of the given factor for good: every factor up to it runs without waiting
+	void setMaxFactor(int factor);
+
+	// Called while processing is off: switch to the last requested factor and take on its latency.
+	// Returns true when the latency changed and has to be reported to the host.
+	bool updateLatency();
+
+	// Latency in base-rate samples
+	int getLatencyInSamples() { return _latency; }
+	static int getFactorLatency(int factor);
+
+	// Upsample numSamples (<= MAX_OVERSAMPLER_BLOCK_SIZE) samples into the channel's internal buffer.
+	// Returns the buffer, to be processed in place, and its length in numOversampled: numSamples *
+	// getFactor(), plus the replayed samples in the first block after a factor change.
+	float* upsample(int channel, const float* input, int numSamples, int* numOversampled);
+
+	// Downsample the channel's internal buffer back into numSamples output samples
+	void downsample(int channel, float* output, int numSamples);
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Runs a processing block at 1/2 or 1/4 of the base rate: decimate() brings each channel down, the
+// caller processes the returned buffer in place and interpolate() brings it back up.
+// Blocks of any length are accepted: the samples that don't fill a decimated frame wait for the
+// next call. Together with the filters, the round trip is late by getFactorLatency(). Frame
+// aligned, the input side starts late by the rest of a frame, so that the round trip is a whole
+// number of decimated samples (getAlignedLatency): VectorFDN takes it back out of its delay lines.
+class HalfBandDecimator {
+
+	float _coefficients[HALFBAND_TAPS];
+
+	// Two cascaded stages per channel and direction: [0] base <-> 1/2, [1] 1/2 <-> 1/4
+	HalfBandStage _down[MAX_DECIMATOR_CHANNELS][2];
+	HalfBandStage _up[MAX_DECIMATOR_CHANNELS][2];
+
+	// Base-rate samples carried over to the next call on each side (the output side holds up to a
+	// frame more when frame aligned)
+	float _pendingInput[MAX_DECIMATOR_CHANNELS][MAX_DECIMATION_FACTOR];
+	float _pendingOutput[MAX_DECIMATOR_CHANNELS][2 * MAX_DECIMATION_FACTOR];
+	int _numPendingInput[MAX_DECIMATOR_CHANNELS];
+	int _numPendingOutput[MAX_DECIMATOR_CHANNELS];
+
+	// Decimated buffers handed to the caller, and work buffers
+	float _decimated[MAX_DECIMATOR_CHANNELS][MAX_DECIMATOR_BLOCK_SIZE + MAX_DECIMATION_FACTOR];
+	int _numDecimated[MAX_DECIMATOR_CHANNELS];
+	float _baseRate[MAX_DECIMATOR_BLOCK_SIZE + 2 * MAX_DECIMATION_FACTOR];
+	float _intermediate[MAX_DECIMATOR_BLOCK_SIZE / 2 + MAX_DECIMATION_FACTOR];
+
+	int _numChannels;
+	int _factor;
+	bool _frameAligned;
+
+public:
+
+	HalfBandDecimator();
+
+	void init(int numChannels);
+	void reset();
+	void setFactor(int factor);
+	int getFactor() { return _factor; }
+	// Takes effect at the next reset() or factor change
+	void setFrameAligned(bool aligned) { _frameAligned = aligned; }
+
+	// Highest factor (up to maxFactor) whose passband still holds the given bandwidth
+	static int chooseFactor(float bandwidth, float sampleRate, int maxFactor);
+	// Round trip latency in base-rate samples: 4 * HALFBAND_HALF_TAPS + 1 at 2x, 12 * HALFBAND_HALF_TAPS + 3 at 4x
+	static int getFactorLatency(int factor);
+	// Round trip of a frame aligned decimator: getFactorLatency() rounded up to a multiple of the factor
+	static int getAlignedLatency(int factor);
+
+	// Bring numSamples (<= MAX_DECIMATOR_BLOCK_SIZE) base-rate samples of the channel down. Returns the
+	// decimated buffer, to be processed in place, and its length in numDecimated.
+	float* decimate(int channel, const float* input, int numSamples, int* numDecimated);
+
+	// Decimated buffer of a channel that only goes up (an output with no matching input), to be
+	// filled with numDecimated samples, the count decimate returned for this block
+	float* getDecimated(int channel, int numDecimated);
+
+	// Interpolate the channel's processed buffer back into numSamples base-rate samples
+	void interpolate(int channel, float* output, int numSamples);
+};
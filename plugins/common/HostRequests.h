@@ -0,0 +1,15 @@
+//-------------------------------------------------------------------------------------------------------
+//  HostRequests.h
+//  Fox Suite specific requests a host can make through canDo/vendorSpecific, besides the stage
+//  statistics of StageProfiler.h.
+//
+//  Release on suspend: the plugins build their DSP objects on the first resume(). A host that
+//  keeps many idle instances around (plugin browsers, frozen tracks) can ask an instance to free
+//  them again on every suspend(); the next resume() rebuilds them at the current sample rate.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#define RELEASE_ON_SUSPEND_CAN_DO "foxReleaseOnSuspend"
+#define RELEASE_ON_SUSPEND_VENDOR_OPCODE 0x4678524c     // 'FxRL': vendorSpecific(opcode, enable, nullptr, 0)
@@ -0,0 +1,215 @@
+//-------------------------------------------------------------------------------------------------------
+//  LaneFDN.cpp
+//  Independent mono feedback delay networks processed together, one per SSE lane.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "LaneFDN.h"
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+/*--------------------------------------------------------------------*/
+LaneFDN::LaneFDN()
+{
+    _buffer = nullptr;
+    _bufferLength = 0;
+    _bufferMask = 0;
+    _writeIndex = 0;
+    _allocatedFloats = 0;
+    _arena = nullptr;
+    _numChannels = 0;
+    _numLanes = 0;
+    _sampleRate = 0.0;
+    _maxDelayInMs = 0.0;
+    _decayInSeconds = 1.0;
+    _dampingFrequency = 20000.0;
+    _sharedDelays = true;
+    for (int i = 0; i < LANE_FDN_MAX_CHANNELS; i++) {
+        for (int l = 0; l < LANE_FDN_LANES; l++) {
+            _delayInMs[i][l] = 1.0;
+            _delayInSamples[i][l] = 1.0;
+            _readOffsets[i][l] = 0;
+        }
+        _inputGains[i] = 0.0;
+    }
+    memset(_channels, 0, sizeof(_channels));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+LaneFDN::~LaneFDN()
+{
+    releaseFloats(_arena, _buffer);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Longest delay, rounded up to a power of two
+int LaneFDN::getBufferLength(float sampleRate, float maxDelayInMs)
+{
+    int minLength = (int)(maxDelayInMs * 0.001 * sampleRate) + 2;
+    int length = 1;
+    while (length < minLength)
+        length <<= 1;
+    return length;
+}
+
+size_t LaneFDN::getMemorySize(float sampleRate, float maxDelayInMs, int numChannels)
+{
+    return getBufferLength(sampleRate, maxDelayInMs) * numChannels * LANE_FDN_LANES * sizeof(float) + ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The input reaches every line with alternating signs, scaled so the lines carry its energy once
+void LaneFDN::init(float sampleRate, float maxDelayInMs, int numChannels, int numLanes)
+{
+    if (numChannels > LANE_FDN_MAX_CHANNELS)
+        numChannels = LANE_FDN_MAX_CHANNELS;
+    _numChannels = numChannels & ~3;
+    _numLanes = numLanes < 1 ? 1 : (numLanes > LANE_FDN_LANES ? LANE_FDN_LANES : numLanes);
+    _maxDelayInMs = maxDelayInMs;
+    _damping.init(_numChannels * LANE_FDN_LANES);
+
+    float inputGain = 1.0 / sqrt((float)_numChannels);
+    for (int i = 0; i < _numChannels; i++)
+        _inputGains[i] = (i & 1) ? -inputGain : inputGain;
+
+    setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void LaneFDN::reset()
+{
+    memset(_buffer, 0, _bufferLength * _numChannels * LANE_FDN_LANES * sizeof(float));
+    _damping.reset();
+    _writeIndex = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The delay lines are only replaced when they have to grow
+void LaneFDN::setSampleRate(float sampleRate)
+{
+    int length = getBufferLength(sampleRate, _maxDelayInMs);
+    size_t numFloats = (size_t)length * _numChannels * LANE_FDN_LANES;
+    if (numFloats > _allocatedFloats) {
+        releaseFloats(_arena, _buffer);
+        _buffer = allocateFloats(_arena, numFloats);
+        _allocatedFloats = numFloats;
+    }
+    _bufferLength = length;
+    _bufferMask = length - 1;
+
+    _sampleRate = sampleRate;
+    updateDelays();
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void LaneFDN::setDelaysInMilliseconds(int lane, const float* delaysInMs)
+{
+    for (int i = 0; i < _numChannels; i++)
+        _delayInMs[i][lane] = delaysInMs[i];
+    updateDelays();
+}
+
+void LaneFDN::setDelaysInMilliseconds(const float* delaysInMs)
+{
+    for (int i = 0; i < _numChannels; i++)
+        for (int l = 0; l < LANE_FDN_LANES; l++)
+            _delayInMs[i][l] = delaysInMs[i];
+    updateDelays();
+}
+
+void LaneFDN::setDecayInSeconds(float decayInSeconds)
+{
+    _decayInSeconds = decayInSeconds;
+    updateDamping();
+}
+
+void LaneFDN::setDampingFrequency(float frequency)
+{
+    _dampingFrequency = frequency;
+    updateDamping();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Whole-sample delays, kept inside the lines. The read offsets are relative to the write row.
+// Unused lanes follow lane 0, so they never force the gathered reads.
+void LaneFDN::updateDelays()
+{
+    if (_sampleRate <= 0.0)
+        return;
+
+    _sharedDelays = true;
+    for (int i = 0; i < _numChannels; i++) {
+        for (int l = 0; l < LANE_FDN_LANES; l++) {
+            float delayInMs = l < _numLanes ? _delayInMs[i][l] : _delayInMs[i][0];
+            int delay = (int)(delayInMs * 0.001 * _sampleRate + 0.5);
+            delay = delay < 1 ? 1 : (delay > _bufferLength - 1 ? _bufferLength - 1 : delay);
+            _delayInSamples[i][l] = delay;
+            _readOffsets[i][l] = delay;
+            if (delay != _readOffsets[i][0])
+                _sharedDelays = false;
+        }
+    }
+    updateDamping();
+}
+
+void LaneFDN::updateDamping()
+{
+    _damping.setCoefficients(&_delayInSamples[0][0], _decayInSeconds, _dampingFrequency, _sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Householder mixing per lane: x - 2 * mean(x) over the lines. The sum that gives the mean is
+// also the output, so mixing and output share one pass.
+void LaneFDN::processAudio(const float* inputs, float* outputs)
+{
+    int rowSize = _numChannels * LANE_FDN_LANES;
+
+    // Read the delayed samples of every line and lane
+    for (int i = 0; i < _numChannels; i++) {
+        float* channel = _channels + i * LANE_FDN_LANES;
+        if (_sharedDelays) {
+            const float* source = _buffer + ((_writeIndex - _readOffsets[i][0]) & _bufferMask) * rowSize + i * LANE_FDN_LANES;
+            _mm_store_ps(channel, _mm_loadu_ps(source));
+        }
+        else {
+            for (int l = 0; l < LANE_FDN_LANES; l++)
+                channel[l] = _buffer[((_writeIndex - _readOffsets[i][l]) & _bufferMask) * rowSize + i * LANE_FDN_LANES + l];
+        }
+    }
+
+    // Decay and damping of all lines and lanes in one pass
+    _damping.process(_channels);
+
+    // Output and mean, then mix, add the input and write the row
+    __m128 sum = _mm_setzero_ps();
+    for (int i = 0; i < _numChannels; i++)
+        sum = _mm_add_ps(sum, _mm_load_ps(_channels + i * LANE_FDN_LANES));
+
+    alignas(16) float laneInputs[LANE_FDN_LANES] = { 0.0 };
+    alignas(16) float laneOutputs[LANE_FDN_LANES];
+    memcpy(laneInputs, inputs, _numLanes * sizeof(float));
+    _mm_store_ps(laneOutputs, sum);
+
+    __m128 offset = _mm_mul_ps(sum, _mm_set1_ps(2.0f / _numChannels));
+    __m128 input = _mm_load_ps(laneInputs);
+    float* row = _buffer + _writeIndex * rowSize;
+    for (int i = 0; i < _numChannels; i++) {
+        __m128 x = _mm_sub_ps(_mm_load_ps(_channels + i * LANE_FDN_LANES), offset);
+        x = _mm_add_ps(x, _mm_mul_ps(input, _mm_set1_ps(_inputGains[i])));
+        _mm_storeu_ps(row + i * LANE_FDN_LANES, x);
+    }
+    _writeIndex = (_writeIndex + 1) & _bufferMask;
+
+    memcpy(outputs, laneOutputs, _numLanes * sizeof(float));
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,75 @@
+//-------------------------------------------------------------------------------------------------------
+//  LaneFDN.h
+//  Up to LANE_FDN_LANES independent mono feedback delay networks with the same topology, one per
+//  SSE lane. Every step of the loop (reads, decay and damping, Householder mixing, writes) runs on
+//  one register per delay line that holds that line of every instance, so the instances share
+//  the work of one: a dual-mono reverb or a handful of voices cost about as much as a single FDN.
+//
+//  The delay lines are interleaved as [position][line][lane]. Each instance may have its own
+//  delays (reads are then gathered lane by lane); when all lanes share them, every read is one
+//  vector load. Decay and damping go through a DampingFilterBank over the line x lane values.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "Arena.h"
+#include "DampingFilterBank.h"
+
+#define LANE_FDN_LANES 4
+#define LANE_FDN_MAX_CHANNELS 16                // delay lines per instance
+
+//-------------------------------------------------------------------------------------------------------
+class LaneFDN {
+
+	// Interleaved delay lines: _buffer[(position * _numChannels + line) * LANE_FDN_LANES + lane]
+	float* _buffer;
+	int _bufferLength;
+	int _bufferMask;
+	int _writeIndex;
+	size_t _allocatedFloats;
+	Arena* _arena;
+	int _numChannels;
+	int _numLanes;
+
+	float _sampleRate;
+	float _maxDelayInMs;
+	float _decayInSeconds;
+	float _dampingFrequency;
+	float _delayInMs[LANE_FDN_MAX_CHANNELS][LANE_FDN_LANES];
+	float _delayInSamples[LANE_FDN_MAX_CHANNELS][LANE_FDN_LANES];
+	int _readOffsets[LANE_FDN_MAX_CHANNELS][LANE_FDN_LANES];
+	bool _sharedDelays;
+
+	// Per line values of all lanes, and the signs the input is spread with
+	alignas(16) float _channels[LANE_FDN_MAX_CHANNELS * LANE_FDN_LANES];
+	float _inputGains[LANE_FDN_MAX_CHANNELS];
+	DampingFilterBank _damping;
+
+	void updateDelays();
+	void updateDamping();
+	static int getBufferLength(float sampleRate, float maxDelayInMs);
+
+public:
+
+	LaneFDN();
+	~LaneFDN();
+
+	// Carve the delay lines out of the given arena instead of the heap (call before init)
+	void setArena(Arena* arena) { _arena = arena; }
+	static size_t getMemorySize(float sampleRate, float maxDelayInMs, int numChannels);
+
+	// numChannels delay lines (a multiple of 4) in each of numLanes instances
+	void init(float sampleRate, float maxDelayInMs, int numChannels, int numLanes);
+	void reset();
+	void setSampleRate(float sampleRate);
+	int getNumLanes() { return _numLanes; }
+
+	// One delay per line for one lane, or the same delays for every lane
+	void setDelaysInMilliseconds(int lane, const float* delaysInMs);
+	void setDelaysInMilliseconds(const float* delaysInMs);
+	void setDecayInSeconds(float decayInSeconds);
+	void setDampingFrequency(float frequency);
+
+	// One input and one output sample per lane (getNumLanes() values each)
+	void processAudio(const float* inputs, float* outputs);
+};
@@ -0,0 +1,76 @@
+//-------------------------------------------------------------------------------------------------------
+//  ParameterChanges.h
+//  Batches parameter changes so their derived state is recomputed once.
+//
+//  setParameter only stores the new value and marks which derived quantities (delay sets, feedback
+//  gains, filter coefficients...) it invalidates. The plugin applies every marked update exactly
+//  once at the start of its next block, or on resume, so the DSP state never changes in the middle
+//  of a block. Between begin() and the matching end() the marks are held back: a program load is
+//  applied as a whole by one block.
+//
+//  Marks come from the host's threads while the audio thread drains them, so the flags are atomic:
+//  mark() releases the value stored before it and take() acquires every value marked so far. A
+//  transaction the host never ends (beginSetProgram without endSetProgram) is abandoned after
+//  PARAMETER_CHANGES_MAX_HELD_BLOCKS blocks, so the marks can't be held back forever.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+#ifndef PARAMETER_CHANGES_MAX_HELD_BLOCKS
+#define PARAMETER_CHANGES_MAX_HELD_BLOCKS 16
+#endif
+
+//-------------------------------------------------------------------------------------------------------
+class ParameterChanges {
+
+	std::atomic<uint32_t> _dirty;
+	std::atomic<uint32_t> _history;
+	std::atomic<int> _depth;
+	int _heldBlocks;                            // audio thread only
+
+public:
+
+	ParameterChanges() : _dirty(0), _history(0), _depth(0), _heldBlocks(0) {}
+
+	// Transactions nest: the marks are held back until the outermost end(). An end() after the
+	// transaction was abandoned does nothing.
+	void begin() { _depth.fetch_add(1, std::memory_order_acq_rel); }
+	bool end()
+	{
+		int depth = _depth.load(std::memory_order_acquire);
+		while (depth > 0 && !_depth.compare_exchange_weak(depth, depth - 1, std::memory_order_acq_rel))
+			;
+		return depth == 1;
+	}
+	bool isOpen() const { return _depth.load(std::memory_order_acquire) > 0; }
+
+	// Call once at the start of every block: true when the marks may be applied. Counts the blocks
+	// an open transaction holds back and closes it past PARAMETER_CHANGES_MAX_HELD_BLOCKS.
+	bool beginBlock()
+	{
+		if (!isOpen()) {
+			_heldBlocks = 0;
+			return true;
+		}
+		if (++_heldBlocks < PARAMETER_CHANGES_MAX_HELD_BLOCKS)
+			return false;
+		_depth.store(0, std::memory_order_release);
+		_heldBlocks = 0;
+		return true;
+	}
+
+	void mark(uint32_t flags)
+	{
+		_history.fetch_or(flags, std::memory_order_relaxed);
+		_dirty.fetch_or(flags, std::memory_order_release);
+	}
+
+	// Every flag marked since construction: what rebuilt DSP objects must be brought up to date on
+	uint32_t getHistory() const { return _history.load(std::memory_order_relaxed); }
+
+	// Returns the marked flags and clears them
+	uint32_t take() { return _dirty.exchange(0, std::memory_order_acquire); }
+};
@@ -0,0 +1,322 @@
+//-------------------------------------------------------------------------------------------------------
+//  RealtimeCheck.cpp
+//  Debug instrumentation for the audio path: allocator, lock and syscall interposition.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "RealtimeCheck.h"
+
+#ifdef REALTIME_CHECK_ENABLED
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <atomic>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REALTIME_BACKTRACE_DEPTH 32
+
+/*--------------------------------------------------------------------*/
+// Name of the real-time scope the thread is in (nullptr outside), and a guard so reporting a
+// violation (which may itself allocate or write) does not report again
+static thread_local const char* t_scopeName = nullptr;
+static thread_local bool t_reporting = false;
+
+static std::atomic<int> g_violationCount(0);
+static std::atomic<bool> g_abortOnViolation(getenv("FOX_REALTIME_ABORT") != nullptr && atoi(getenv("FOX_REALTIME_ABORT")) != 0);
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static void reportViolation(const char* call)
+{
+    if (t_scopeName == nullptr || t_reporting)
+        return;
+    t_reporting = true;
+    g_violationCount++;
+
+    char message[256];
+    int length = snprintf(message, sizeof(message), "[realtime] %s called inside %s\n", call, t_scopeName);
+    if (length > 0)
+        ::write(STDERR_FILENO, message, length < (int)sizeof(message) ? length : (int)sizeof(message) - 1);
+    void* frames[REALTIME_BACKTRACE_DEPTH];
+    int depth = backtrace(frames, REALTIME_BACKTRACE_DEPTH);
+    backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+
+    if (g_abortOnViolation)
+        abort();
+    t_reporting = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+RealtimeScope::RealtimeScope(const char* name)
+{
+    _previousName = t_scopeName;
+    t_scopeName = name;
+}
+
+RealtimeScope::~RealtimeScope()
+{
+    t_scopeName = _previousName;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int getRealtimeViolationCount()
+{
+    return g_violationCount;
+}
+
+void resetRealtimeViolationCount()
+{
+    g_violationCount = 0;
+}
+
+void setRealtimeAbortOnViolation(bool abortOnViolation)
+{
+    g_abortOnViolation = abortOnViolation;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Allocator: forward to glibc's internal entry points (operator new / delete end up here too)
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size)
+{
+    reportViolation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    reportViolation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    reportViolation("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    reportViolation("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    reportViolation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    reportViolation("posix_memalign");
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer != nullptr ? 0 : ENOMEM;
+}
+
+void free(void* pointer)
+{
+    if (pointer != nullptr)
+        reportViolation("free");
+    __libc_free(pointer);
+}
+
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Locks and blocking system calls: report, then forward to the next definition (libc / libpthread)
+#define REALTIME_NEXT(function) \
+    static auto next = (decltype(&function))dlsym(RTLD_NEXT, #function)
+
+// dlsym returns the oldest version of a versioned symbol: the condition variable calls need the
+// current one, or they run the compatibility code on a new-style pthread_cond_t
+#define REALTIME_NEXT_VERSION(function, version) \
+    static auto next = (decltype(&function))dlvsym(RTLD_NEXT, #function, version)
+
+extern "C" {
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    reportViolation("pthread_mutex_lock");
+    REALTIME_NEXT(pthread_mutex_lock);
+    return next(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+{
+    reportViolation("pthread_cond_wait");
+    REALTIME_NEXT_VERSION(pthread_cond_wait, "GLIBC_2.3.2");
+    return next(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* timeout)
+{
+    reportViolation("pthread_cond_timedwait");
+    REALTIME_NEXT_VERSION(pthread_cond_timedwait, "GLIBC_2.3.2");
+    return next(condition, mutex, timeout);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+{
+    reportViolation("pthread_rwlock_rdlock");
+    REALTIME_NEXT(pthread_rwlock_rdlock);
+    return next(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+{
+    reportViolation("pthread_rwlock_wrlock");
+    REALTIME_NEXT(pthread_rwlock_wrlock);
+    return next(lock);
+}
+
+int pthread_rwlock_timedrdlock(pthread_rwlock_t* lock, const struct timespec* timeout)
+{
+    reportViolation("pthread_rwlock_timedrdlock");
+    REALTIME_NEXT(pthread_rwlock_timedrdlock);
+    return next(lock, timeout);
+}
+
+int pthread_rwlock_timedwrlock(pthread_rwlock_t* lock, const struct timespec* timeout)
+{
+    reportViolation("pthread_rwlock_timedwrlock");
+    REALTIME_NEXT(pthread_rwlock_timedwrlock);
+    return next(lock, timeout);
+}
+
+int sem_wait(sem_t* semaphore)
+{
+    reportViolation("sem_wait");
+    REALTIME_NEXT(sem_wait);
+    return next(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const struct timespec* timeout)
+{
+    reportViolation("sem_timedwait");
+    REALTIME_NEXT(sem_timedwait);
+    return next(semaphore, timeout);
+}
+
+int open(const char* path, int flags, ...)
+{
+    reportViolation("open");
+    REALTIME_NEXT(open);
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    return next(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...)
+{
+    reportViolation("open64");
+    REALTIME_NEXT(open64);
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    return next(path, flags, mode);
+}
+
+int openat(int directory, const char* path, int flags, ...)
+{
+    reportViolation("openat");
+    REALTIME_NEXT(openat);
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    return next(directory, path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* fileMode)
+{
+    reportViolation("fopen");
+    REALTIME_NEXT(fopen);
+    return next(path, fileMode);
+}
+
+ssize_t read(int fd, void* buffer, size_t count)
+{
+    reportViolation("read");
+    REALTIME_NEXT(read);
+    return next(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void* buffer, size_t count)
+{
+    reportViolation("write");
+    REALTIME_NEXT(write);
+    return next(fd, buffer, count);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining)
+{
+    reportViolation("nanosleep");
+    REALTIME_NEXT(nanosleep);
+    return next(duration, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+    reportViolation("usleep");
+    REALTIME_NEXT(usleep);
+    return next(microseconds);
+}
+
+int sched_yield()
+{
+    reportViolation("sched_yield");
+    REALTIME_NEXT(sched_yield);
+    return next();
+}
+
+}
+/*--------------------------------------------------------------------*/
+
+#else
+
+/*--------------------------------------------------------------------*/
+RealtimeScope::RealtimeScope(const char* name) { _previousName = name; }
+RealtimeScope::~RealtimeScope() {}
+int getRealtimeViolationCount() { return 0; }
+void resetRealtimeViolationCount() {}
+void setRealtimeAbortOnViolation(bool) {}
+/*--------------------------------------------------------------------*/
+
+#endif
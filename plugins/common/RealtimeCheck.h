@@ -0,0 +1,45 @@
+//-------------------------------------------------------------------------------------------------------
+//  RealtimeCheck.h
+//  Debug instrumentation for the audio path. Built with FOX_REALTIME_CHECK on Linux, it interposes
+//  the allocator, mutex / rwlock / semaphore waits, file opens and blocking system calls, and reports every call made by a thread
+//  that is inside a REALTIME_SCOPE (processReplacing, setParameter, setProgram) with a stack trace.
+//  Without the flag REALTIME_SCOPE expands to nothing.
+//
+//  The interposed symbols only win over libc when they come before it in the global lookup
+//  order. A dlopen'ed plugin's own copy never does, so a loaded plugin is only covered when the
+//  checker lives in the host: FoxCheck links it and exports it (-rdynamic), other hosts need a
+//  shared build of RealtimeCheck.cpp in LD_PRELOAD. The plugin's RealtimeScope calls then bind to
+//  the host's copy as well.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(FOX_REALTIME_CHECK) && defined(__linux__)
+#define REALTIME_CHECK_ENABLED
+#endif
+
+//-------------------------------------------------------------------------------------------------------
+// Marks the calling thread as running real-time code for the lifetime of the object
+class RealtimeScope {
+
+	const char* _previousName;
+
+public:
+
+	RealtimeScope(const char* name);
+	~RealtimeScope();
+};
+
+// Number of violations reported since start (or since the last reset)
+int getRealtimeViolationCount();
+void resetRealtimeViolationCount();
+
+// Abort on the first violation instead of logging and carrying on (also set by FOX_REALTIME_ABORT=1)
+void setRealtimeAbortOnViolation(bool abortOnViolation);
+
+#ifdef REALTIME_CHECK_ENABLED
+#define REALTIME_SCOPE(name) RealtimeScope realtimeScope(name)
+#else
+#define REALTIME_SCOPE(name)
+#endif
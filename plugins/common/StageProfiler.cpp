@@ -0,0 +1,116 @@
+//-------------------------------------------------------------------------------------------------------
+//  StageProfiler.cpp
+//  Optional per-stage CPU profiling for the audio path.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "StageProfiler.h"
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/*--------------------------------------------------------------------*/
+StageProfiler::StageProfiler()
+{
+    _numStages = 0;
+    for (int s = 0; s < PROFILER_MAX_STAGES; s++) {
+        _names[s] = "";
+        _count[s] = 0;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int StageProfiler::addStage(const char* name)
+{
+    if (_numStages >= PROFILER_MAX_STAGES)
+        return PROFILER_MAX_STAGES - 1;
+    _names[_numStages] = name;
+    return _numStages++;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+uint64_t StageProfiler::now()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+#endif
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The slot is written before the count is published, so a reader never sees an unwritten slot
+void StageProfiler::record(int stage, uint64_t ticks)
+{
+    uint64_t count = _count[stage].load(std::memory_order_relaxed);
+    _ring[stage][count & (PROFILER_RING_SIZE - 1)] = ticks;
+    _count[stage].store(count + 1, std::memory_order_release);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Slots overwritten while copying only skew the statistics a little, which is fine for profiling
+bool StageProfiler::getStats(int stage, StageStats* stats)
+{
+    if (stage < 0 || stage >= _numStages || stats == nullptr)
+        return false;
+
+    uint64_t count = _count[stage].load(std::memory_order_acquire);
+    int numValues = count < PROFILER_RING_SIZE ? (int)count : PROFILER_RING_SIZE;
+    uint64_t values[PROFILER_RING_SIZE];
+    for (int i = 0; i < numValues; i++)
+        values[i] = _ring[stage][i];
+
+    stats->name = _names[stage];
+    stats->count = count;
+    stats->min = stats->max = stats->p99 = 0;
+    stats->avg = 0.0;
+    if (numValues == 0)
+        return true;
+
+    uint64_t sum = 0;
+    stats->min = values[0];
+    for (int i = 0; i < numValues; i++) {
+        sum += values[i];
+        stats->min = std::min(stats->min, values[i]);
+        stats->max = std::max(stats->max, values[i]);
+    }
+    stats->avg = (double)sum / numValues;
+
+    int p99Index = (numValues * 99) / 100;
+    std::nth_element(values, values + p99Index, values + numValues);
+    stats->p99 = values[p99Index];
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void StageProfiler::reset()
+{
+    for (int s = 0; s < _numStages; s++)
+        _count[s].store(0, std::memory_order_release);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void StageProfiler::dump(FILE* file)
+{
+    fprintf(file, "%-16s %10s %12s %12s %12s %12s\n", "stage", "blocks", "min", "avg", "max", "p99");
+    for (int s = 0; s < _numStages; s++) {
+        StageStats stats;
+        getStats(s, &stats);
+        fprintf(file, "%-16s %10llu %12llu %12.0f %12llu %12llu\n", stats.name, (unsigned long long)stats.count,
+            (unsigned long long)stats.min, stats.avg, (unsigned long long)stats.max, (unsigned long long)stats.p99);
+    }
+}
+/*--------------------------------------------------------------------*/
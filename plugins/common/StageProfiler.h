@@ -0,0 +1,78 @@
+//-------------------------------------------------------------------------------------------------------
+//  StageProfiler.h
+//  Optional per-stage CPU profiling for the audio path. Built only with FOX_STAGE_PROFILING:
+//  PROFILE_STAGE times the enclosing scope with the CPU timestamp counter (clock_gettime where
+//  there is none) and pushes the ticks into a per-stage lock-free ring. Statistics over the ring
+//  (min / avg / max / p99) are read from any thread. Without the flag the macro is empty and
+//  plugins do not even hold a profiler.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#define PROFILER_MAX_STAGES 8
+#define PROFILER_RING_SIZE 1024                 // power of two
+#define PROFILER_CAN_DO "foxStageProfiling"     // canDo string of plugins built with profiling
+#define PROFILER_VENDOR_OPCODE 0x46785350       // 'FxSP': vendorSpecific(opcode, stage, StageStats*, 0)
+
+// Statistics of one stage, in ticks (CPU cycles, or nanoseconds without a timestamp counter)
+struct StageStats {
+	const char* name;
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	double avg;
+	uint64_t p99;
+};
+
+//-------------------------------------------------------------------------------------------------------
+class StageProfiler {
+
+	const char* _names[PROFILER_MAX_STAGES];
+	int _numStages;
+
+	// One single-producer ring per stage: the audio thread writes, readers copy a snapshot
+	uint64_t _ring[PROFILER_MAX_STAGES][PROFILER_RING_SIZE];
+	std::atomic<uint64_t> _count[PROFILER_MAX_STAGES];
+
+public:
+
+	StageProfiler();
+
+	// Register a stage, returns its index
+	int addStage(const char* name);
+	int getNumStages() { return _numStages; }
+
+	// Audio thread: store the duration of one block of a stage
+	void record(int stage, uint64_t ticks);
+
+	// Any thread: statistics over the last PROFILER_RING_SIZE blocks of a stage
+	bool getStats(int stage, StageStats* stats);
+	void reset();
+	void dump(FILE* file);
+
+	static uint64_t now();
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Times its own lifetime and records it into a stage
+class StageTimer {
+
+	StageProfiler& _profiler;
+	int _stage;
+	uint64_t _start;
+
+public:
+
+	StageTimer(StageProfiler& profiler, int stage) : _profiler(profiler), _stage(stage), _start(StageProfiler::now()) {}
+	~StageTimer() { _profiler.record(_stage, StageProfiler::now() - _start); }
+};
+
+#ifdef FOX_STAGE_PROFILING
+#define PROFILE_STAGE(profiler, stage) StageTimer stageTimer(profiler, stage)
+#else
+#define PROFILE_STAGE(profiler, stage)
+#endif
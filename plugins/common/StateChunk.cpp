@@ -0,0 +1,168 @@
+//-------------------------------------------------------------------------------------------------------
+//  StateChunk.cpp
+//  Binary plugin state for getChunk/setChunk.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "StateChunk.h"
+#include <string.h>
+
+#define FX_CHUNK_MAGIC "CcnK"
+#define FX_PROGRAM_MAGIC "FxCk"
+#define FX_BANK_MAGIC "FxBk"
+
+/*--------------------------------------------------------------------*/
+// The parameter containers are big-endian whatever the machine
+static int32_t readBigEndian(const uint8_t* p)
+{
+    return (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static float readBigEndianFloat(const uint8_t* p)
+{
+    int32_t bits = readBigEndian(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// the comparisons also reject NaN
+static float clampParameter(float value)
+{
+    if (!(value >= 0.0f))
+        return 0.0f;
+    if (!(value <= 1.0f))
+        return 1.0f;
+    return value;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// One 'FxCk' program at p, bounded by end. Any other program format (a chunk) is not ours to read.
+static bool readFxProgram(const uint8_t* p, const uint8_t* end, int32_t uniqueID, float* parameters, int numParameters)
+{
+    if (end - p < STATE_CHUNK_FX_PROGRAM_HEADER_SIZE || memcmp(p, FX_CHUNK_MAGIC, 4) != 0 || memcmp(p + 8, FX_PROGRAM_MAGIC, 4) != 0)
+        return false;
+    if (readBigEndian(p + 16) != uniqueID)
+        return false;
+    int32_t numStored = readBigEndian(p + 24);
+    if (numStored < 0 || numStored > (end - p - STATE_CHUNK_FX_PROGRAM_HEADER_SIZE) / (int32_t)sizeof(float))
+        return false;
+
+    const uint8_t* values = p + STATE_CHUNK_FX_PROGRAM_HEADER_SIZE;
+    for (int i = 0; i < numStored && i < numParameters; i++)
+        parameters[i] = clampParameter(readBigEndianFloat(values + i * sizeof(float)));
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int32_t StateChunk::write(void** data, const char* pluginName, int32_t program, const float* parameters, int numParameters, const uint32_t* seeds, int numSeeds)
+{
+    if (numParameters > STATE_CHUNK_MAX_PARAMETERS)
+        numParameters = STATE_CHUNK_MAX_PARAMETERS;
+    if (numSeeds > STATE_CHUNK_MAX_SEEDS)
+        numSeeds = STATE_CHUNK_MAX_SEEDS;
+
+    StateChunkHeader header;
+    memcpy(header.magic, STATE_CHUNK_MAGIC, 4);
+    header.version = STATE_CHUNK_VERSION;
+    memset(header.pluginName, 0, sizeof(header.pluginName));
+    strncpy(header.pluginName, pluginName, sizeof(header.pluginName) - 1);
+    header.program = program;
+    header.numParameters = numParameters;
+    header.numSeeds = numSeeds;
+
+    uint8_t* p = _data;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, parameters, numParameters * sizeof(float));
+    p += numParameters * sizeof(float);
+    memcpy(p, seeds, numSeeds * sizeof(uint32_t));
+    p += numSeeds * sizeof(uint32_t);
+
+    *data = _data;
+    return (int32_t)(p - _data);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Later versions may only append to the layout, so any version parses with this header
+bool StateChunk::read(const void* data, int32_t byteSize, const char* pluginName, int32_t* program, float* parameters, int numParameters, uint32_t* seeds, int numSeeds)
+{
+    if (!data || byteSize < (int32_t)sizeof(StateChunkHeader))
+        return false;
+
+    StateChunkHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, STATE_CHUNK_MAGIC, 4) != 0 || header.version < 1)
+        return false;
+    if (strncmp(header.pluginName, pluginName, sizeof(header.pluginName) - 1) != 0)
+        return false;
+    if (header.numParameters > STATE_CHUNK_MAX_PARAMETERS || header.numSeeds > STATE_CHUNK_MAX_SEEDS)
+        return false;
+
+    size_t size = sizeof(header) + header.numParameters * sizeof(float) + header.numSeeds * sizeof(uint32_t);
+    if ((size_t)byteSize < size)
+        return false;
+
+    const uint8_t* p = (const uint8_t*)data + sizeof(header);
+    for (uint32_t i = 0; i < header.numParameters; i++, p += sizeof(float)) {
+        float value;
+        memcpy(&value, p, sizeof(float));
+        if ((int)i < numParameters)
+            parameters[i] = clampParameter(value);
+    }
+    for (uint32_t i = 0; i < header.numSeeds && (int)i < numSeeds; i++, p += sizeof(uint32_t))
+        memcpy(&seeds[i], p, sizeof(uint32_t));
+
+    *program = header.program;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Parameters are read into a copy first, so a bank that fails half way changes nothing
+bool StateChunk::readParameterBank(const void* data, int32_t byteSize, int32_t uniqueID, int32_t* program, float* parameters, int numParameters)
+{
+    if (!data || byteSize < STATE_CHUNK_FX_PROGRAM_HEADER_SIZE || numParameters > STATE_CHUNK_MAX_PARAMETERS)
+        return false;
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + byteSize;
+    float values[STATE_CHUNK_MAX_PARAMETERS];
+    memcpy(values, parameters, numParameters * sizeof(float));
+
+    if (memcmp(p + 8, FX_PROGRAM_MAGIC, 4) == 0) {
+        if (!readFxProgram(p, end, uniqueID, values, numParameters))
+            return false;
+    }
+    else {
+        if (byteSize < STATE_CHUNK_FX_BANK_HEADER_SIZE || memcmp(p, FX_CHUNK_MAGIC, 4) != 0 || memcmp(p + 8, FX_BANK_MAGIC, 4) != 0)
+            return false;
+        if (readBigEndian(p + 16) != uniqueID)
+            return false;
+        int32_t numPrograms = readBigEndian(p + 24);
+        // version 1 banks have no current program
+        int32_t current = readBigEndian(p + 12) >= 2 ? readBigEndian(p + 28) : 0;
+        if (numPrograms <= 0 || current < 0 || current >= numPrograms)
+            return false;
+
+        // programs are stored back to back, each sized by its own parameter count
+        const uint8_t* stored = p + STATE_CHUNK_FX_BANK_HEADER_SIZE;
+        for (int32_t i = 0; i < current; i++) {
+            if (end - stored < STATE_CHUNK_FX_PROGRAM_HEADER_SIZE)
+                return false;
+            int32_t numStored = readBigEndian(stored + 24);
+            if (numStored < 0 || numStored > (end - stored - STATE_CHUNK_FX_PROGRAM_HEADER_SIZE) / (int32_t)sizeof(float))
+                return false;
+            stored += STATE_CHUNK_FX_PROGRAM_HEADER_SIZE + numStored * sizeof(float);
+        }
+        if (!readFxProgram(stored, end, uniqueID, values, numParameters))
+            return false;
+        *program = current;
+    }
+
+    memcpy(parameters, values, numParameters * sizeof(float));
+    return true;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,55 @@
+//-------------------------------------------------------------------------------------------------------
+//  StateChunk.h
+//  Compact binary state for getChunk/setChunk: a versioned header, the normalized value of every
+//  parameter and the seeds of the delay sets. Hosts save and restore it in one call instead of
+//  one setParameter per parameter, and the plugin applies it with a single parameter transaction.
+//
+//  Chunks from an older version with fewer parameters or seeds still load: the missing values
+//  keep their current state. Values a newer version added beyond what this build knows are
+//  ignored. Fields are stored little-endian, as written by every supported target.
+//
+//  Sessions saved before the plugins declared programsAreChunks hold the standard VST 2 parameter
+//  containers instead: a program ('FxCk') or a bank of programs ('FxBk'), big-endian, one float
+//  per parameter. readParameterBank loads those, so an old session opens with its settings.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+
+#define STATE_CHUNK_MAGIC "FXST"
+#define STATE_CHUNK_VERSION 1
+#define STATE_CHUNK_MAX_PARAMETERS 64
+#define STATE_CHUNK_MAX_SEEDS 8
+#define STATE_CHUNK_FX_PROGRAM_HEADER_SIZE 56   // fxProgram up to its params, see vstfxstore.h
+#define STATE_CHUNK_FX_BANK_HEADER_SIZE 156     // fxBank up to its programs
+
+// Chunk header, followed by numParameters floats and numSeeds 32-bit seeds
+struct StateChunkHeader {
+	char magic[4];
+	uint32_t version;
+	char pluginName[16];                        // plugin the state belongs to, some share a unique ID
+	int32_t program;
+	uint32_t numParameters;
+	uint32_t numSeeds;
+};
+
+//-------------------------------------------------------------------------------------------------------
+class StateChunk {
+
+	// getChunk hands the host a pointer that must stay valid after the call returns
+	uint8_t _data[sizeof(StateChunkHeader) + STATE_CHUNK_MAX_PARAMETERS * sizeof(float) + STATE_CHUNK_MAX_SEEDS * sizeof(uint32_t)];
+
+public:
+
+	// Serializes the state, returns its size in bytes. *data points into this object.
+	int32_t write(void** data, const char* pluginName, int32_t program, const float* parameters, int numParameters, const uint32_t* seeds, int numSeeds);
+
+	// Deserializes a chunk into the given arrays, which hold the current state on entry. Returns
+	// false and changes nothing if the chunk is malformed or belongs to another plugin.
+	static bool read(const void* data, int32_t byteSize, const char* pluginName, int32_t* program, float* parameters, int numParameters, uint32_t* seeds, int numSeeds);
+
+	// Same contract for a parameter program or bank saved for the plugin with the given unique ID.
+	// From a bank it loads the program that was current, and sets *program to it.
+	static bool readParameterBank(const void* data, int32_t byteSize, int32_t uniqueID, int32_t* program, float* parameters, int numParameters);
+};
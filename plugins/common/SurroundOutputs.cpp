@@ -0,0 +1,97 @@
+//-------------------------------------------------------------------------------------------------------
+//  SurroundOutputs.cpp
+//  Speaker layout and output mix of the stereo and surround reverbs.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "SurroundOutputs.h"
+#include <string.h>
+
+// Speakers of the outputs in VST order: L R C Lfe Ls Rs, then Sl Sr for 7.1 Music or Lc Rc for Cine
+static const VstInt32 SURROUND_SPEAKERS[8] = { kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr };
+static const char* SURROUND_SPEAKER_NAMES[8] = { "L", "R", "C", "Lfe", "Ls", "Rs", "Sl", "Sr" };
+static const VstInt32 CINE_SPEAKERS[2] = { kSpeakerLc, kSpeakerRc };
+static const char* CINE_SPEAKER_NAMES[2] = { "Lc", "Rc" };
+
+/*--------------------------------------------------------------------*/
+static void fillSpeakerArrangement(VstSpeakerArrangement* arrangement, VstInt32 type, int numChannels)
+{
+    memset(arrangement, 0, sizeof(VstSpeakerArrangement));
+    arrangement->type = type;
+    arrangement->numChannels = numChannels;
+    for (int c = 0; c < numChannels; c++) {
+        bool cine = type == kSpeakerArr71Cine && c >= 6;
+        arrangement->speakers[c].type = cine ? CINE_SPEAKERS[c - 6] : SURROUND_SPEAKERS[c];
+        strncpy(arrangement->speakers[c].name, cine ? CINE_SPEAKER_NAMES[c - 6] : SURROUND_SPEAKER_NAMES[c], kVstMaxNameLen - 1);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+SurroundOutputs::SurroundOutputs()
+{
+    fillSpeakerArrangement(&_inputArrangement, kSpeakerArrStereo, 2);
+    fillSpeakerArrangement(&_outputArrangement, OUTPUT_SPEAKER_ARRANGEMENT, NUM_REVERB_OUTPUTS);
+    _sampleRate = 44100.0;
+    reset();
+}
+
+void SurroundOutputs::setSampleRate(float sampleRate)
+{
+    _sampleRate = sampleRate;
+    _lfeFilter.setSampleRate(sampleRate);
+    _lfeFilter.setCutoffFrequency(LFE_CUTOFF_FREQUENCY);
+}
+
+// The filter has no reset call of its own: start over with a new one at the same rate
+void SurroundOutputs::reset()
+{
+    _lfeFilter = LPFButterworth();
+    _lfeFilter.init(_sampleRate);
+    _lfeFilter.setCutoffFrequency(LFE_CUTOFF_FREQUENCY);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool SurroundOutputs::setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput)
+{
+    if (!pluginInput || !pluginOutput)
+        return false;
+    if (pluginInput->numChannels != 2 || pluginOutput->numChannels != NUM_REVERB_OUTPUTS)
+        return false;
+    VstInt32 type = pluginOutput->type;
+    if (NUM_REVERB_OUTPUTS > 2 && type != OUTPUT_SPEAKER_ARRANGEMENT && !(NUM_REVERB_OUTPUTS == 8 && type == kSpeakerArr71Cine))
+        return false;
+    fillSpeakerArrangement(&_outputArrangement, NUM_REVERB_OUTPUTS > 2 ? type : (VstInt32)kSpeakerArrStereo, NUM_REVERB_OUTPUTS);
+    return true;
+}
+
+void SurroundOutputs::getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput)
+{
+    *pluginInput = &_inputArrangement;
+    *pluginOutput = &_outputArrangement;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void SurroundOutputs::mix(float* const* wet, const float* dryL, const float* dryR, float wetGain, float dryGain, float** outputs, int offset, int numSamples)
+{
+    float* outL = outputs[0] + offset;
+    float* outR = outputs[1] + offset;
+    for (int i = 0; i < numSamples; i++) {
+        outL[i] = wet[0][i] * wetGain + dryL[i] * dryGain;
+        outR[i] = wet[1][i] * wetGain + dryR[i] * dryGain;
+    }
+    for (int c = 2; c < NUM_REVERB_OUTPUTS; c++) {
+        float* out = outputs[c] + offset;
+        if (c == LFE_OUTPUT) {
+            for (int i = 0; i < numSamples; i++)
+                out[i] = _lfeFilter.processAudio(0.5f * (outL[i] + outR[i]));
+        }
+        else {
+            for (int i = 0; i < numSamples; i++)
+                out[i] = wet[c][i] * wetGain;
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,56 @@
+//-------------------------------------------------------------------------------------------------------
+//  SurroundOutputs.h
+//  Speaker layout and output mix of the reverbs built with NUM_REVERB_OUTPUTS: stereo in, and
+//  stereo, 5.1 or 7.1 out from a single FDN whose outputs are already decorrelated.
+//
+//  The dry signal goes to the stereo pair. The LFE carries the low end of the mixed stereo pair
+//  below LFE_CUTOFF_FREQUENCY, the other surround outputs the wet signal only. The FDNs add no
+//  latency, so the dry signal lines up with the wet one on every output that carries it.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "LPFButterworth.h"
+#include "aeffectx.h"
+
+#ifndef NUM_REVERB_OUTPUTS
+#define NUM_REVERB_OUTPUTS 2                    // 6 for 5.1, 8 for 7.1: one FDN feeds every speaker
+#endif
+#if NUM_REVERB_OUTPUTS == 2
+#define OUTPUT_SPEAKER_ARRANGEMENT kSpeakerArrStereo
+#elif NUM_REVERB_OUTPUTS == 6
+#define OUTPUT_SPEAKER_ARRANGEMENT kSpeakerArr51
+#elif NUM_REVERB_OUTPUTS == 8
+#define OUTPUT_SPEAKER_ARRANGEMENT kSpeakerArr71Music
+#else
+#error "NUM_REVERB_OUTPUTS must be 2, 6 or 8"
+#endif
+#define LFE_OUTPUT 3                            // in VST order: L R C Lfe Ls Rs (Sl Sr or Lc Rc)
+#define LFE_CUTOFF_FREQUENCY 120.0
+
+//-------------------------------------------------------------------------------------------------------
+class SurroundOutputs {
+
+	// Speakers reported to the host: stereo in, NUM_REVERB_OUTPUTS out
+	VstSpeakerArrangement _inputArrangement;
+	VstSpeakerArrangement _outputArrangement;
+
+	// Low pass of the LFE output
+	LPFButterworth _lfeFilter;
+	float _sampleRate;
+
+public:
+
+	SurroundOutputs();
+
+	void setSampleRate(float sampleRate);
+	void reset();
+
+	// The layout is fixed by NUM_REVERB_OUTPUTS: stereo in and the built layout out. A 7.1 build
+	// takes either 7.1 type, the channels past Rs are only named differently.
+	bool setSpeakerArrangement(VstSpeakerArrangement* pluginInput, VstSpeakerArrangement* pluginOutput);
+	void getSpeakerArrangement(VstSpeakerArrangement** pluginInput, VstSpeakerArrangement** pluginOutput);
+
+	// outputs[c][offset + i] from the FDN's wet[c][i] and the dry input, numSamples samples
+	void mix(float* const* wet, const float* dryL, const float* dryR, float wetGain, float dryGain, float** outputs, int offset, int numSamples);
+};
@@ -0,0 +1,792 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFDN.cpp
+//  Feedback delay network with a selectable lossless feedback matrix.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "VectorFDN.h"
+#include "DelayRandom.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+/*--------------------------------------------------------------------*/
+// First-order section y = b0 x + b1 x[n-1] + a y[n-1] with the pole of the cutoff (kept below
+// Nyquist) and the given gains at DC and at Nyquist. nyquistGain receives r = fs / (2 fc), the
+// Nyquist frequency in cutoffs, to compute the analog prototype's gain there.
+static void setFirstOrderSection(float* coefficients, float frequency, float sampleRate, double dcGain, double (*nyquistGain)(double r))
+{
+    if (frequency > 0.49 * sampleRate)
+        frequency = 0.49 * sampleRate;
+    double pole = exp(-2.0 * M_PI * frequency / sampleRate);
+    double gain = nyquistGain(0.5 * sampleRate / frequency);
+    coefficients[0] = 0.5 * (dcGain * (1.0 - pole) + gain * (1.0 + pole));
+    coefficients[1] = 0.5 * (dcGain * (1.0 - pole) - gain * (1.0 + pole));
+    coefficients[2] = pole;
+}
+
+static double matchedLowPassGain(double r) { return 1.0 / sqrt(1.0 + r * r); }
+static double lowShelfGain(double r) { return sqrt((1.0 + DAMPING_SHELF_FLOOR * DAMPING_SHELF_FLOOR * r * r) / (1.0 + r * r)); }
+static double highShelfGain(double r) { return sqrt((r * r + DAMPING_SHELF_FLOOR * DAMPING_SHELF_FLOOR) / (r * r + 1.0)); }
+
+static inline float processFirstOrderSection(const float* coefficients, float* states, float x)
+{
+    float y = coefficients[0] * x + coefficients[1] * states[0] + coefficients[2] * states[1];
+    states[0] = x;
+    states[1] = y;
+    return y;
+}
+
+static int powerOfTwoAtLeast(int minLength)
+{
+    int length = 1;
+    while (length < minLength)
+        length <<= 1;
+    return length;
+}
+
+static DampingFilterType getDampingFilterType(LPFilterType type)
+{
+    return type == LPFilterType::Shelving ? DampingFilterType::Shelving : DampingFilterType::Matched;
+}
+
+static inline float dotProduct(const float* a, const float* b, int count)
+{
+    __m128 acc = _mm_setzero_ps();
+    for (int k = 0; k < count; k += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+}
+
+// What a retired tank is fed
+static const float silence[VECTOR_FDN_BLOCK_SIZE] = { 0.0 };
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VectorFDN::VectorFDN(int numChannels, FeedbackMatrixType matrixType, int numDiffusionSteps)
+{
+    _matrix.init(numChannels, matrixType, DEFAULT_DELAY_SEED);
+    _numChannels = _matrix.getNumChannels();
+    _mixMode = MixMode::All;
+    _arena = nullptr;
+
+    for (int i = 0; i < MAX_FEEDBACK_CHANNELS; i++) {
+        _delayInMs[i] = VECTOR_FDN_MIN_LONGEST_DELAY_MS;
+        _channels[i] = 0.0;
+        _diffusedLines[i] = 0.0;
+        _modCosines[i] = cos(2.0 * M_PI * i / _numChannels);
+        _modSines[i] = sin(2.0 * M_PI * i / _numChannels);
+    }
+    _buffer = nullptr;
+    _allocatedFloats = 0;
+    _usedFloats = 0;
+
+    if (numDiffusionSteps < 0)
+        numDiffusionSteps = 0;
+    else if (numDiffusionSteps > VECTOR_FDN_MAX_DIFFUSION_STEPS)
+        numDiffusionSteps = VECTOR_FDN_MAX_DIFFUSION_STEPS;
+    _numDiffusionSteps = numDiffusionSteps;
+    _diffusionMatrix.init(_numChannels, FeedbackMatrixType::Hadamard, DEFAULT_DELAY_SEED);
+    for (int k = 0; k < VECTOR_FDN_MAX_DIFFUSION_STEPS; k++) {
+        _diffusionBuffers[k] = nullptr;
+        _diffusionMasks[k] = 0;
+        for (int i = 0; i < MAX_FEEDBACK_CHANNELS; i++) {
+            _diffusionDelayInMs[k][i] = 0.0;
+            _diffusionDelayInSamples[k][i] = 0;
+            _diffusionSigns[k][i] = 1.0;
+        }
+    }
+    _diffusionIndexMask = 0;
+    _diffusionWriteIndex = 0;
+
+    _numOutputs = 2;
+    memset(_lowPassCoefficients, 0, sizeof(_lowPassCoefficients));
+    memset(_highPassCoefficients, 0, sizeof(_highPassCoefficients));
+    _lowPassCoefficients[0] = 1.0;
+    _highPassCoefficients[0] = 1.0;
+    memset(_lowPassStates, 0, sizeof(_lowPassStates));
+    memset(_highPassStates, 0, sizeof(_highPassStates));
+    _spread = 1.0;
+    _earlyLevel = 0.0;
+    updateOutputMatrix();
+
+    for (Tank& tank : _tanks) {
+        tank.state = TankState::Idle;
+        tank.factor = 1;
+        tank.sampleRate = 0.0;
+        tank.decimator.setFrameAligned(true);
+        tank.decimator.init(_numOutputs);
+        tank.buffer = nullptr;
+        tank.length = 0;
+        tank.mask = 0;
+        tank.writeIndex = 0;
+        tank.inputOffset = 0;
+        tank.longestRead = 0;
+        for (int i = 0; i < MAX_FEEDBACK_CHANNELS; i++)
+            tank.delayInSamples[i] = 1.0;
+        tank.damping.init(_numChannels);
+        tank.damping.setType(DampingFilterType::Matched);
+        tank.oscillatorCos = 1.0;
+        tank.oscillatorSin = 0.0;
+        tank.rotationCos = 1.0;
+        tank.rotationSin = 0.0;
+        tank.modDepthInSamples = 0.0;
+        tank.fadeGain = 1.0;
+        tank.quietSamples = 0;
+    }
+    _tanks[0].state = TankState::Active;
+    _activeTank = 0;
+    _maxDecimationFactor = 1;
+    _requestedFactor = 1;
+    _tankFloats = 0;
+
+    _sampleRate = 0.0;
+    _diffuserBufferInMs = 0.0;
+    _feedbackBufferInMs = 0.0;
+    _roomSize = 0.5;
+    _seed = DEFAULT_DELAY_SEED;
+    _useDelayTable = false;
+    _diffuserLogic = DiffuserDelayLogic::Doubled;
+    _diffuserDistribution = DelayDistribution::RandomInRange;
+    _feedbackDistribution = DelayDistribution::RandomInRange;
+    _decayInSeconds = 1.0;
+    _dampingFrequency = 20000.0;
+    _lowPassFrequency = 20000.0;
+    _highPassFrequency = 20.0;
+    _lowPassType = LPFilterType::Vicanek;
+    _highPassType = HPFilterType::Shelving;
+    _modDepth = 0.0;
+    _modRate = 0.0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VectorFDN::~VectorFDN()
+{
+    releaseFloats(_arena, _buffer);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The buffer size plus the modulation excursion and the interpolation sample, to a power of two
+int VectorFDN::getBufferLength(float bufferSizeInMs, float sampleRate)
+{
+    return powerOfTwoAtLeast((int)((bufferSizeInMs + 2.0 * VECTOR_FDN_MAX_MOD_MS) * 0.001 * sampleRate) + 2);
+}
+
+// Share of the diffusion length taken by a step: Doubled doubles it from step to step, Equal
+// splits it evenly
+float VectorFDN::getDiffusionShare(int step, int numSteps, DiffuserDelayLogic logic)
+{
+    if (logic == DiffuserDelayLogic::Equal)
+        return 1.0 / numSteps;
+    return (float)(1 << step) / ((1 << numSteps) - 1);
+}
+
+// No room reads further back than VECTOR_FDN_MAX_LONGEST_DELAY_MS
+float VectorFDN::getFeedbackBufferInMs(float feedbackBufferMs)
+{
+    return feedbackBufferMs < VECTOR_FDN_MAX_LONGEST_DELAY_MS ? feedbackBufferMs : VECTOR_FDN_MAX_LONGEST_DELAY_MS;
+}
+
+// Longest delay a step can get under either logic, within the diffuser buffer size
+float VectorFDN::getDiffusionBufferInMs(int step, int numSteps, float diffuserBufferMs)
+{
+    float doubled = getDiffusionShare(step, numSteps, DiffuserDelayLogic::Doubled);
+    float equal = getDiffusionShare(step, numSteps, DiffuserDelayLogic::Equal);
+    float maxInMs = VECTOR_FDN_DIFFUSION_RATIO * VECTOR_FDN_MAX_LONGEST_DELAY_MS * (doubled > equal ? doubled : equal);
+    return diffuserBufferMs < maxInMs ? diffuserBufferMs : maxInMs;
+}
+
+// Every tank is sized for the full rate, whatever factor it runs at
+size_t VectorFDN::getNumFloats(int numChannels, int numDiffusionSteps, float diffuserBufferMs, float feedbackBufferMs, float sampleRate, int numTanks)
+{
+    size_t numFloats = (size_t)numTanks * numChannels * getBufferLength(getFeedbackBufferInMs(feedbackBufferMs), sampleRate);
+    for (int k = 0; k < numDiffusionSteps; k++)
+        numFloats += (size_t)numChannels * powerOfTwoAtLeast((int)(getDiffusionBufferInMs(k, numDiffusionSteps, diffuserBufferMs) * 0.001 * sampleRate) + 1);
+    return numFloats;
+}
+
+size_t VectorFDN::getMemorySize(int numChannels, int numDiffusionSteps, float diffuserBufferMs, float feedbackBufferMs, float sampleRate, int maxDecimationFactor)
+{
+    return getNumFloats(numChannels, numDiffusionSteps, diffuserBufferMs, feedbackBufferMs, sampleRate, getNumTanks(maxDecimationFactor)) * sizeof(float) + ARENA_ALIGNMENT;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::setMaxDecimationFactor(int factor)
+{
+    _maxDecimationFactor = factor >= 4 ? 4 : (factor >= 2 ? 2 : 1);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The delay lines are only replaced when they have to grow
+void VectorFDN::reserveFloats(size_t numFloats)
+{
+    if (numFloats <= _allocatedFloats)
+        return;
+    releaseFloats(_arena, _buffer);
+    _buffer = allocateFloats(_arena, numFloats);
+    _allocatedFloats = numFloats;
+}
+
+void VectorFDN::reserve(float diffuserBufferMs, float feedbackBufferMs, float maxSampleRate)
+{
+    reserveFloats(getNumFloats(_numChannels, _numDiffusionSteps, diffuserBufferMs, feedbackBufferMs, maxSampleRate, getNumTanks(_maxDecimationFactor)));
+}
+
+// Lay the tanks and the diffusion steps out for the rate; only allocates when the reserved memory
+// is too small
+void VectorFDN::allocateDelayLines(float sampleRate)
+{
+    int numTanks = getNumTanks(_maxDecimationFactor);
+    _usedFloats = getNumFloats(_numChannels, _numDiffusionSteps, _diffuserBufferInMs, _feedbackBufferInMs, sampleRate, numTanks);
+    reserveFloats(_usedFloats);
+
+    _tankFloats = (size_t)_numChannels * getBufferLength(getFeedbackBufferInMs(_feedbackBufferInMs), sampleRate);
+    float* next = _buffer;
+    for (int t = 0; t < numTanks; t++) {
+        _tanks[t].buffer = next;
+        next += _tankFloats;
+    }
+    int longest = 1;
+    for (int k = 0; k < _numDiffusionSteps; k++) {
+        int length = powerOfTwoAtLeast((int)(getDiffusionBufferInMs(k, _numDiffusionSteps, _diffuserBufferInMs) * 0.001 * sampleRate) + 1);
+        _diffusionBuffers[k] = next;
+        _diffusionMasks[k] = length - 1;
+        next += (size_t)_numChannels * length;
+        if (length > longest)
+            longest = length;
+    }
+    _diffusionIndexMask = longest - 1;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::initialize(float diffuserBufferMs, float feedbackBufferMs, float sampleRate)
+{
+    _diffuserBufferInMs = diffuserBufferMs;
+    _feedbackBufferInMs = feedbackBufferMs;
+    setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Clears both tanks and starts the first one at the factor the filters allow
+void VectorFDN::reset()
+{
+    memset(_buffer, 0, _usedFloats * sizeof(float));
+    _diffusionWriteIndex = 0;
+    memset(_lowPassStates, 0, sizeof(_lowPassStates));
+    memset(_highPassStates, 0, sizeof(_highPassStates));
+    _tanks[1].state = TankState::Idle;
+    _activeTank = 0;
+    startTank(_tanks[0], _requestedFactor);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::setSampleRate(float sampleRate)
+{
+    allocateDelayLines(sampleRate);
+    _sampleRate = sampleRate;
+    updateDelays();
+    updateFilters();
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::setRoomSize(float roomSize, DiffuserDelayLogic logic, DelayDistribution diffuserDistribution, DelayDistribution feedbackDistribution)
+{
+    _roomSize = roomSize;
+    _diffuserLogic = logic;
+    _diffuserDistribution = diffuserDistribution;
+    _feedbackDistribution = feedbackDistribution;
+    drawDelays();
+    updateDelays();
+}
+
+// The longest feedback delay follows the room size and the shortest sits VECTOR_FDN_DELAY_SPREAD
+// below it. The diffusion steps share VECTOR_FDN_DIFFUSION_RATIO of the longest delay; each
+// step's delays span zero to its share, in a seeded order so no line is always the shortest,
+// and each line gets a seeded polarity.
+void VectorFDN::drawDelays()
+{
+    float longest = VECTOR_FDN_MIN_LONGEST_DELAY_MS + _roomSize * (VECTOR_FDN_MAX_LONGEST_DELAY_MS - VECTOR_FDN_MIN_LONGEST_DELAY_MS);
+    float shortest = longest / VECTOR_FDN_DELAY_SPREAD;
+    DelayRandom random(DelayRandom::deriveSeed(_seed, _roomSize, 0), _useDelayTable);
+    if (_feedbackDistribution == DelayDistribution::Uniform) {
+        for (int i = 0; i < _numChannels; i++)
+            _delayInMs[i] = shortest + (longest - shortest) * (i + 0.5) / _numChannels;
+    }
+    else
+        random.fillInRange(_delayInMs, _numChannels, shortest, longest);
+
+    for (int k = 0; k < _numDiffusionSteps; k++) {
+        float range = VECTOR_FDN_DIFFUSION_RATIO * longest * getDiffusionShare(k, _numDiffusionSteps, _diffuserLogic);
+        float* delays = _diffusionDelayInMs[k];
+        random.seed(DelayRandom::deriveSeed(_seed, _roomSize, k + 1));
+        if (_diffuserDistribution == DelayDistribution::Uniform) {
+            for (int i = 0; i < _numChannels; i++)
+                delays[i] = range * (i + 0.5) / _numChannels;
+        }
+        else {
+            random.fillInRange(delays, _numChannels, 0.0, range);
+            for (int i = _numChannels - 1; i > 0; i--) {
+                int j = random.nextUInt() % (i + 1);
+                float delay = delays[i];
+                delays[i] = delays[j];
+                delays[j] = delay;
+            }
+        }
+        for (int i = 0; i < _numChannels; i++)
+            _diffusionSigns[k][i] = random.nextUInt() & 1 ? -1.0 : 1.0;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::updateDelays()
+{
+    if (_sampleRate <= 0.0)
+        return;
+    for (int k = 0; k < _numDiffusionSteps; k++) {
+        for (int i = 0; i < _numChannels; i++) {
+            int delay = (int)(_diffusionDelayInMs[k][i] * 0.001 * _sampleRate + 0.5);
+            _diffusionDelayInSamples[k][i] = delay < _diffusionMasks[k] ? delay : _diffusionMasks[k];
+        }
+    }
+    for (Tank& tank : _tanks) {
+        if (tank.state != TankState::Idle)
+            updateTankDelays(tank);
+    }
+}
+
+void VectorFDN::updateDamping()
+{
+    for (Tank& tank : _tanks) {
+        if (tank.state != TankState::Idle)
+            updateTankDamping(tank);
+    }
+    updateDecimation();
+}
+
+void VectorFDN::updateFilters()
+{
+    if (_sampleRate <= 0.0)
+        return;
+    setFirstOrderSection(_lowPassCoefficients, _lowPassFrequency, _sampleRate, 1.0, _lowPassType == LPFilterType::Shelving ? lowShelfGain : matchedLowPassGain);
+    setFirstOrderSection(_highPassCoefficients, _highPassFrequency, _sampleRate, DAMPING_SHELF_FLOOR, highShelfGain);
+    updateDecimation();
+}
+
+void VectorFDN::updateModulation()
+{
+    for (Tank& tank : _tanks) {
+        if (tank.state != TankState::Idle)
+            updateTankModulation(tank);
+    }
+}
+
+// The tank keeps an octave above the narrower of the damping and the low pass. The factor is
+// only requested here: the next block switches to it.
+void VectorFDN::updateDecimation()
+{
+    if (_sampleRate <= 0.0)
+        return;
+    float cutoff = _dampingFrequency < _lowPassFrequency ? _dampingFrequency : _lowPassFrequency;
+    _requestedFactor = HalfBandDecimator::chooseFactor(MULTIRATE_BANDWIDTH_MARGIN * cutoff, _sampleRate, _maxDecimationFactor);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Run the tank at the factor from its next sample, with empty filters. Its lines are not cleared:
+// a tank is only started after reset() or once it is silent.
+void VectorFDN::startTank(Tank& tank, int factor)
+{
+    tank.state = TankState::Active;
+    tank.factor = factor;
+    tank.sampleRate = _sampleRate / factor;
+    tank.decimator.setFactor(factor);
+    tank.decimator.reset();
+    tank.length = getBufferLength(getFeedbackBufferInMs(_feedbackBufferInMs), tank.sampleRate);
+    tank.mask = tank.length - 1;
+    tank.writeIndex = 0;
+    tank.damping.reset();
+    tank.oscillatorCos = 1.0;
+    tank.oscillatorSin = 0.0;
+    tank.fadeGain = 1.0;
+    tank.quietSamples = 0;
+    updateTankModulation(tank);
+    updateTankDelays(tank);
+}
+
+void VectorFDN::updateTankModulation(Tank& tank)
+{
+    if (_sampleRate <= 0.0)
+        return;
+    tank.modDepthInSamples = _modDepth * VECTOR_FDN_MAX_MOD_MS * 0.001 * tank.sampleRate;
+    tank.rotationCos = cos(2.0 * M_PI * _modRate / tank.sampleRate);
+    tank.rotationSin = sin(2.0 * M_PI * _modRate / tank.sampleRate);
+}
+
+// Delays are clamped to what the lines hold once the modulation excursion is added. The input
+// goes in as many samples back as the decimator's round trip, as long as no line has read that
+// far yet.
+void VectorFDN::updateTankDelays(Tank& tank)
+{
+    if (_sampleRate <= 0.0)
+        return;
+    float maxDelay = tank.length - 2.0 * tank.modDepthInSamples - 2.0;
+    float minDelay = maxDelay, longest = 1.0;
+    for (int i = 0; i < _numChannels; i++) {
+        float delay = _delayInMs[i] * 0.001 * tank.sampleRate;
+        tank.delayInSamples[i] = delay < 1.0 ? 1.0 : (delay > maxDelay ? maxDelay : delay);
+        if (tank.delayInSamples[i] < minDelay)
+            minDelay = tank.delayInSamples[i];
+        if (tank.delayInSamples[i] > longest)
+            longest = tank.delayInSamples[i];
+    }
+    tank.longestRead = (int)(longest + 2.0 * tank.modDepthInSamples) + 2;
+    int offset = HalfBandDecimator::getAlignedLatency(tank.factor) / tank.factor;
+    tank.inputOffset = offset < (int)minDelay - 1 ? offset : (int)minDelay - 1;
+    updateTankDamping(tank);
+}
+
+// -60 dB after decayInSeconds: each pass through a line of d seconds loses 60 d / T60 dB. A tank
+// that faded out for the next factor change drops its tail quickly.
+void VectorFDN::updateTankDamping(Tank& tank)
+{
+    if (_sampleRate <= 0.0)
+        return;
+    bool flushed = tank.state == TankState::Flushing && tank.fadeGain <= 0.0;
+    tank.damping.setCoefficients(tank.delayInSamples, flushed ? VECTOR_FDN_FLUSH_DECAY_IN_SECONDS : _decayInSeconds, _dampingFrequency, tank.sampleRate);
+}
+
+// Move the input to a tank at the requested factor: the idle one, or the one still ringing out
+// at that factor. When the other tank is still ringing out at another factor it fades out first,
+// and the change waits until it is silent.
+void VectorFDN::switchTanks()
+{
+    Tank& active = _tanks[_activeTank];
+    if (_maxDecimationFactor == 1 || active.factor == _requestedFactor)
+        return;
+    Tank& other = _tanks[1 - _activeTank];
+    if (other.state == TankState::Idle)
+        startTank(other, _requestedFactor);
+    else if (other.state == TankState::RingingOut && other.factor == _requestedFactor)
+        other.state = TankState::Active;
+    else {
+        other.state = TankState::Flushing;
+        return;
+    }
+    active.state = TankState::RingingOut;
+    active.quietSamples = 0;
+    _activeTank = 1 - _activeTank;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VectorFDN::setDecayInSeconds(float decayInSeconds)
+{
+    _decayInSeconds = decayInSeconds;
+    updateDamping();
+}
+
+void VectorFDN::setDampingFrequency(float frequency)
+{
+    _dampingFrequency = frequency;
+    updateDamping();
+}
+
+void VectorFDN::setDampingType(LPFilterType type)
+{
+    for (Tank& tank : _tanks)
+        tank.damping.setType(getDampingFilterType(type));
+    updateDamping();
+}
+
+void VectorFDN::setLowPassFrequency(float frequency)
+{
+    _lowPassFrequency = frequency;
+    updateFilters();
+}
+
+void VectorFDN::setLowPassType(LPFilterType type)
+{
+    _lowPassType = type;
+    updateFilters();
+}
+
+void VectorFDN::setHighPassFrequency(float frequency)
+{
+    _highPassFrequency = frequency;
+    updateFilters();
+}
+
+void VectorFDN::setHighPassType(HPFilterType type)
+{
+    _highPassType = type;
+    updateFilters();
+}
+
+void VectorFDN::setModDepth(float depth)
+{
+    _modDepth = depth;
+    updateModulation();
+    updateDelays();
+}
+
+void VectorFDN::setModRate(float rate)
+{
+    _modRate = rate;
+    updateModulation();
+}
+
+void VectorFDN::setMixMode(MixMode mode)
+{
+    _mixMode = mode;
+    updateOutputMatrix();
+}
+
+void VectorFDN::setNumOutputs(int numOutputs)
+{
+    if (numOutputs < 2)
+        numOutputs = 2;
+    else if (numOutputs > VECTOR_FDN_MAX_OUTPUTS)
+        numOutputs = VECTOR_FDN_MAX_OUTPUTS;
+    _numOutputs = numOutputs;
+    for (Tank& tank : _tanks)
+        tank.decimator.init(_numOutputs);
+    updateOutputMatrix();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The feedback matrix spreads the energy evenly over the lines: a sum of N / 2 lines needs no
+// scaling, a single line is brought up to the same level and a +-1 row over all N lines is
+// scaled by 1 / sqrt(2).
+void VectorFDN::updateOutputMatrix()
+{
+    float lineGain = sqrt(0.5 * _numChannels);
+    memset(_outputMatrix, 0, sizeof(_outputMatrix));
+    for (int k = 0; k < _numOutputs; k++) {
+        float* row = _outputMatrix[k];
+        if (_mixMode == MixMode::First)
+            row[k % _numChannels] = lineGain;
+        else if (_numOutputs == 2) {
+            for (int i = k; i < _numChannels; i += 2)
+                row[i] = 1.0;
+        }
+        else {
+            for (int i = 0; i < _numChannels; i++) {
+                int bits = (k + 1) & i, parity = 0;
+                for (; bits; bits &= bits - 1)
+                    parity ^= 1;
+                row[i] = (parity ? -1.0 : 1.0) * M_SQRT1_2;
+            }
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float VectorFDN::readDelay(const Tank& tank, int channel, float delayInSamples)
+{
+    int whole = (int)delayInSamples;
+    float fraction = delayInSamples - whole;
+    float a = tank.buffer[((tank.writeIndex - whole) & tank.mask) * _numChannels + channel];
+    float b = tank.buffer[((tank.writeIndex - whole - 1) & tank.mask) * _numChannels + channel];
+    return a + fraction * (b - a);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The left input feeds the even lines and the right input the odd ones. Every step writes its
+// input row, reads each line its own delay back with its polarity and mixes the row; the even
+// and the odd lines are then summed back to stereo. The mix is orthogonal, so the sums keep the
+// input's level once the echoes are dense.
+void VectorFDN::diffuse(const float* input, float* output)
+{
+    float inputGain = 1.0 / sqrt(0.5 * _numChannels);
+    float* x = _diffusedLines;
+    for (int i = 0; i < _numChannels; i++)
+        x[i] = input[i & 1] * inputGain;
+    if (_numDiffusionSteps == 0) {
+        output[0] = input[0];
+        output[1] = input[1];
+        return;
+    }
+
+    for (int k = 0; k < _numDiffusionSteps; k++) {
+        float* buffer = _diffusionBuffers[k];
+        int mask = _diffusionMasks[k];
+        int writeIndex = _diffusionWriteIndex & mask;
+        memcpy(buffer + (size_t)writeIndex * _numChannels, x, _numChannels * sizeof(float));
+        for (int i = 0; i < _numChannels; i++)
+            x[i] = buffer[((writeIndex - _diffusionDelayInSamples[k][i]) & mask) * _numChannels + i] * _diffusionSigns[k][i];
+        _diffusionMatrix.process(x);
+    }
+    _diffusionWriteIndex = (_diffusionWriteIndex + 1) & _diffusionIndexMask;
+
+    output[0] = output[1] = 0.0;
+    for (int i = 0; i < _numChannels; i += 2) {
+        output[0] += x[i];
+        output[1] += x[i + 1];
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Bring the block down to the tank's rate, run the tank and add its interpolated outputs to wet.
+// The diffused left input feeds the even lines and the right input the odd ones.
+void VectorFDN::processTank(Tank& tank, const float* inL, const float* inR, float** wet, int numSamples)
+{
+    int numDecimated;
+    float* decimated[VECTOR_FDN_MAX_OUTPUTS];
+    decimated[0] = tank.decimator.decimate(0, inL, numSamples, &numDecimated);
+    decimated[1] = tank.decimator.decimate(1, inR, numSamples, &numDecimated);
+    for (int k = 2; k < _numOutputs; k++)
+        decimated[k] = tank.decimator.getDecimated(k, numDecimated);
+
+    float inputGain = 1.0 / sqrt(0.5 * _numChannels);
+    bool retired = tank.state != TankState::Active;
+    float peak = 0.0;
+    for (int n = 0; n < numDecimated; n++) {
+        float input[2] = { decimated[0][n] * inputGain, decimated[1][n] * inputGain };
+
+        // Read, decay and damp. Modulated lines read cos(phase + offset) around depth samples
+        // late, so the delay never drops below its nominal value.
+        if (tank.modDepthInSamples > 0.0) {
+            for (int i = 0; i < _numChannels; i++) {
+                float mod = tank.oscillatorCos * _modCosines[i] - tank.oscillatorSin * _modSines[i];
+                _channels[i] = readDelay(tank, i, tank.delayInSamples[i] + tank.modDepthInSamples * (1.0 + mod));
+            }
+            float c = tank.oscillatorCos * tank.rotationCos - tank.oscillatorSin * tank.rotationSin;
+            float s = tank.oscillatorSin * tank.rotationCos + tank.oscillatorCos * tank.rotationSin;
+            float norm = 1.5 - 0.5 * (c * c + s * s);
+            tank.oscillatorCos = c * norm;
+            tank.oscillatorSin = s * norm;
+        }
+        else {
+            for (int i = 0; i < _numChannels; i++)
+                _channels[i] = tank.buffer[((tank.writeIndex - (int)tank.delayInSamples[i]) & tank.mask) * _numChannels + i];
+        }
+        tank.damping.process(_channels);
+        if (retired) {
+            for (int i = 0; i < _numChannels; i++)
+                peak = fmax(peak, fabs(_channels[i]));
+        }
+
+        // Outputs
+        for (int k = 0; k < _numOutputs; k++)
+            decimated[k][n] = dotProduct(_outputMatrix[k], _channels, _numChannels);
+
+        // Mix and write back, the input inputOffset rows back
+        _matrix.process(_channels);
+        memcpy(tank.buffer + tank.writeIndex * _numChannels, _channels, _numChannels * sizeof(float));
+        float* row = tank.buffer + ((tank.writeIndex - tank.inputOffset) & tank.mask) * _numChannels;
+        for (int i = 0; i < _numChannels; i++)
+            row[i] += input[i & 1];
+        tank.writeIndex = (tank.writeIndex + 1) & tank.mask;
+    }
+
+    // Back to the full rate. A flushing tank fades out, then loses its tail quickly.
+    float gains[VECTOR_FDN_BLOCK_SIZE];
+    bool fading = tank.state == TankState::Flushing && tank.fadeGain > 0.0;
+    if (fading) {
+        float step = 1.0 / (VECTOR_FDN_FADE_MS * 0.001 * _sampleRate);
+        for (int i = 0; i < numSamples; i++) {
+            tank.fadeGain = tank.fadeGain > step ? tank.fadeGain - step : 0.0;
+            gains[i] = tank.fadeGain;
+        }
+        if (tank.fadeGain <= 0.0)
+            updateTankDamping(tank);
+    }
+    for (int k = 0; k < _numOutputs; k++) {
+        float upsampled[VECTOR_FDN_BLOCK_SIZE];
+        tank.decimator.interpolate(k, upsampled, numSamples);
+        if (tank.state == TankState::Flushing && !fading)
+            continue;
+        for (int i = 0; i < numSamples; i++)
+            wet[k][i] += fading ? upsampled[i] * gains[i] : upsampled[i];
+    }
+
+    // A retired tank is free once no line has read above VECTOR_FDN_SILENCE for as long as its
+    // longest delay: everything left in the lines is below it too
+    if (retired) {
+        tank.quietSamples = peak < VECTOR_FDN_SILENCE ? tank.quietSamples + numDecimated : 0;
+        if (tank.quietSamples > tank.longestRead)
+            tank.state = TankState::Idle;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Diffusion and the early output at the full rate, the tanks at theirs, then the output filters
+// and the width
+void VectorFDN::processChunk(const float* inL, const float* inR, float** outputs, int numSamples)
+{
+    switchTanks();
+
+    float diffusedL[VECTOR_FDN_BLOCK_SIZE], diffusedR[VECTOR_FDN_BLOCK_SIZE];
+    float wetBuffers[VECTOR_FDN_MAX_OUTPUTS][VECTOR_FDN_BLOCK_SIZE];
+    float* wet[VECTOR_FDN_MAX_OUTPUTS];
+    bool early = _earlyLevel != 0.0;
+    for (int k = 0; k < _numOutputs; k++)
+        wet[k] = wetBuffers[k];
+    for (int i = 0; i < numSamples; i++) {
+        float input[2] = { inL[i], inR[i] }, diffused[2];
+        diffuse(input, diffused);
+        diffusedL[i] = diffused[0];
+        diffusedR[i] = diffused[1];
+        for (int k = 0; k < _numOutputs; k++)
+            wet[k][i] = early ? _earlyLevel * dotProduct(_outputMatrix[k], _diffusedLines, _numChannels) : 0.0;
+    }
+
+    processTank(_tanks[_activeTank], diffusedL, diffusedR, wet, numSamples);
+    Tank& other = _tanks[1 - _activeTank];
+    if (_maxDecimationFactor > 1 && other.state != TankState::Idle)
+        processTank(other, silence, silence, wet, numSamples);
+
+    // Output filters, then the width: spread 1 leaves the outputs as they are, 0 sends their
+    // mean everywhere (mid / side for stereo)
+    for (int i = 0; i < numSamples; i++) {
+        float filtered[VECTOR_FDN_MAX_OUTPUTS];
+        float mean = 0.0;
+        for (int k = 0; k < _numOutputs; k++) {
+            float lowPassed = processFirstOrderSection(_lowPassCoefficients, _lowPassStates[k], wet[k][i]);
+            filtered[k] = processFirstOrderSection(_highPassCoefficients, _highPassStates[k], lowPassed);
+            mean += filtered[k];
+        }
+        mean /= _numOutputs;
+        for (int k = 0; k < _numOutputs; k++)
+            outputs[k][i] = mean + _spread * (filtered[k] - mean);
+    }
+}
+
+void VectorFDN::processBlock(const float* inL, const float* inR, float** outputs, int numSamples)
+{
+    for (int start = 0; start < numSamples; start += VECTOR_FDN_BLOCK_SIZE) {
+        int chunkSize = numSamples - start < VECTOR_FDN_BLOCK_SIZE ? numSamples - start : VECTOR_FDN_BLOCK_SIZE;
+        float* chunkOutputs[VECTOR_FDN_MAX_OUTPUTS];
+        for (int k = 0; k < _numOutputs; k++)
+            chunkOutputs[k] = outputs[k] + start;
+        processChunk(inL + start, inR + start, chunkOutputs, chunkSize);
+    }
+}
+
+void VectorFDN::processAudio(float* input, float* output)
+{
+    float* outputs[VECTOR_FDN_MAX_OUTPUTS];
+    for (int k = 0; k < _numOutputs; k++)
+        outputs[k] = &output[k];
+    processBlock(&input[0], &input[1], outputs, 1);
+}
+/*--------------------------------------------------------------------*/
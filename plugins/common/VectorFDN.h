@@ -0,0 +1,238 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFDN.h
+//  Plugin-local feedback delay network with a selectable lossless feedback matrix, and the reverb
+//  engine of MisEfx and Shimmer. It keeps the interface of the core FDN for the calls the plugins
+//  make, so either can be built against the other, and adds setFeedbackMatrix() to pick the
+//  mixing per instance and setSeed() to choose the delay set. Up to MAX_FEEDBACK_CHANNELS delay
+//  lines: with the structured matrices the mixing cost grows with N or N log N instead of N^2.
+//
+//  Signal flow per sample: the stereo input is spread over the lines and runs through the
+//  diffusion steps (one delay per line, seeded polarity flips and a Hadamard mix each), then is
+//  folded back to stereo and fed to the tank: read every delay line (modulated reads
+//  interpolate), apply the decay gain and the damping filter, tap the outputs, mix through the
+//  feedback matrix and write back with the inputs added. Damping and output filters are
+//  first-order sections shaped by the core filter types (DampingFilterBank.h).
+//
+//  Multirate (setMaxDecimationFactor): the tank runs at 1/2 or 1/4 of the rate when the damping
+//  and the low pass leave no more bandwidth, behind a frame aligned HalfBandDecimator. The
+//  diffusion, the early output and the output filters stay at the full rate. The decimator's
+//  round trip is taken back out of the tank: the input is written that many samples further
+//  back in the delay lines, so its first pass is shorter by exactly the round trip and the
+//  reverb adds no latency. A factor change starts the other of two tanks at the new rate: it
+//  takes the input from then on while the old one rings out on its own, and the sum goes on
+//  without a seam.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+#include "FDN.h"
+#include "Arena.h"
+#include "FeedbackMatrix.h"
+#include "DampingFilterBank.h"
+#include "HalfBandOversampler.h"
+
+#define VECTOR_FDN_MIN_LONGEST_DELAY_MS 40.0    // longest delay at room size 0
+#define VECTOR_FDN_MAX_LONGEST_DELAY_MS 300.0   // longest delay at room size 1
+#define VECTOR_FDN_DELAY_SPREAD 4.0             // longest / shortest delay
+#define VECTOR_FDN_DIFFUSION_RATIO 0.5          // all diffusion steps together / longest delay
+#define VECTOR_FDN_MAX_DIFFUSION_STEPS 8
+#define VECTOR_FDN_MAX_MOD_MS 0.5               // read excursion at mod depth 1
+#define VECTOR_FDN_MAX_OUTPUTS 8                // up to 7.1
+#define VECTOR_FDN_BLOCK_SIZE MAX_DECIMATOR_BLOCK_SIZE    // longer blocks are processed in chunks of this
+#define VECTOR_FDN_SILENCE 1e-5                 // a retired tank whose lines read below this is free again
+#define VECTOR_FDN_FADE_MS 50.0                 // fade out of a retired tank needed before it is silent
+#define VECTOR_FDN_FLUSH_DECAY_IN_SECONDS 0.01  // decay of a faded out tank, until it is silent
+
+//-------------------------------------------------------------------------------------------------------
+class VectorFDN {
+
+	int _numChannels;
+	FeedbackMatrix _matrix;
+	MixMode _mixMode;
+	Arena* _arena;
+
+	// One allocation for the tanks' feedback lines and the diffusion steps
+	float* _buffer;
+	size_t _allocatedFloats;
+	size_t _usedFloats;
+
+	// What a tank is doing: taking the input, ringing out after a factor change, fading out to make
+	// room for the next one, or waiting silent
+	enum class TankState {
+		Idle = 0,
+		Active,
+		RingingOut,
+		Flushing
+	};
+
+	// Feedback lines and everything that depends on their rate. Delay lines have a power of two
+	// length and are interleaved: sample t of line i is element (t & mask) * _numChannels + i, so
+	// every sample's writes form one contiguous row. The input is added inputOffset rows back.
+	struct Tank {
+		TankState state;
+		int factor;
+		float sampleRate;
+		HalfBandDecimator decimator;
+		float* buffer;
+		int length;
+		int mask;
+		int writeIndex;
+		int inputOffset;
+		int longestRead;
+		float delayInSamples[MAX_FEEDBACK_CHANNELS];
+		// Decay gains and damping filters of all lines, one SIMD bank
+		DampingFilterBank damping;
+		// Delay modulation: one quadrature oscillator, each line reads it at its own phase offset
+		float oscillatorCos, oscillatorSin;
+		float rotationCos, rotationSin;
+		float modDepthInSamples;
+		// Output gain while flushing, and the decimated samples read below VECTOR_FDN_SILENCE in a row
+		float fadeGain;
+		int quietSamples;
+	};
+	Tank _tanks[2];
+	int _activeTank;
+	int _maxDecimationFactor;
+	int _requestedFactor;
+	size_t _tankFloats;
+	float _channels[MAX_FEEDBACK_CHANNELS];
+	float _modCosines[MAX_FEEDBACK_CHANNELS];
+	float _modSines[MAX_FEEDBACK_CHANNELS];
+	float _delayInMs[MAX_FEEDBACK_CHANNELS];
+
+	// Diffusion steps, laid out like the feedback lines, each with its own power of two length.
+	// All steps advance one shared write index, wrapped at the longest length. _diffusedLines
+	// holds the last step's output, which the early output taps.
+	int _numDiffusionSteps;
+	FeedbackMatrix _diffusionMatrix;
+	float* _diffusionBuffers[VECTOR_FDN_MAX_DIFFUSION_STEPS];
+	int _diffusionMasks[VECTOR_FDN_MAX_DIFFUSION_STEPS];
+	int _diffusionIndexMask;
+	int _diffusionWriteIndex;
+	float _diffusionDelayInMs[VECTOR_FDN_MAX_DIFFUSION_STEPS][MAX_FEEDBACK_CHANNELS];
+	int _diffusionDelayInSamples[VECTOR_FDN_MAX_DIFFUSION_STEPS][MAX_FEEDBACK_CHANNELS];
+	float _diffusionSigns[VECTOR_FDN_MAX_DIFFUSION_STEPS][MAX_FEEDBACK_CHANNELS];
+	float _diffusedLines[MAX_FEEDBACK_CHANNELS];
+
+	// Output section: one row of line weights per output, then a first-order lowpass and
+	// highpass per output (y = b0 x + b1 x[n-1] + a y[n-1]) and the width around the outputs' mean
+	int _numOutputs;
+	alignas(16) float _outputMatrix[VECTOR_FDN_MAX_OUTPUTS][MAX_FEEDBACK_CHANNELS];
+	float _lowPassCoefficients[3], _highPassCoefficients[3];
+	float _lowPassStates[VECTOR_FDN_MAX_OUTPUTS][2], _highPassStates[VECTOR_FDN_MAX_OUTPUTS][2];
+	float _spread;
+	float _earlyLevel;
+
+	// Parameters
+	float _sampleRate;
+	float _diffuserBufferInMs;
+	float _feedbackBufferInMs;
+	float _roomSize;
+	uint32_t _seed;
+	bool _useDelayTable;
+	DiffuserDelayLogic _diffuserLogic;
+	DelayDistribution _diffuserDistribution, _feedbackDistribution;
+	float _decayInSeconds;
+	float _dampingFrequency;
+	float _lowPassFrequency, _highPassFrequency;
+	LPFilterType _lowPassType;
+	HPFilterType _highPassType;
+	float _modDepth, _modRate;
+
+	static int getBufferLength(float bufferSizeInMs, float sampleRate);
+	static float getDiffusionShare(int step, int numSteps, DiffuserDelayLogic logic);
+	static float getFeedbackBufferInMs(float feedbackBufferMs);
+	static float getDiffusionBufferInMs(int step, int numSteps, float diffuserBufferMs);
+	static int getNumTanks(int maxDecimationFactor) { return maxDecimationFactor > 1 ? 2 : 1; }
+	static size_t getNumFloats(int numChannels, int numDiffusionSteps, float diffuserBufferMs, float feedbackBufferMs, float sampleRate, int numTanks);
+	void reserveFloats(size_t numFloats);
+	void allocateDelayLines(float sampleRate);
+	void drawDelays();
+	void updateDelays();
+	void updateDamping();
+	void updateFilters();
+	void updateModulation();
+	void updateDecimation();
+	void updateOutputMatrix();
+	void startTank(Tank& tank, int factor);
+	void updateTankModulation(Tank& tank);
+	void updateTankDelays(Tank& tank);
+	void updateTankDamping(Tank& tank);
+	void switchTanks();
+	float readDelay(const Tank& tank, int channel, float delayInSamples);
+	void diffuse(const float* input, float* output);
+	void processTank(Tank& tank, const float* inL, const float* inR, float** wet, int numSamples);
+	void processChunk(const float* inL, const float* inR, float** outputs, int numSamples);
+
+public:
+
+	// numDiffusionSteps up to VECTOR_FDN_MAX_DIFFUSION_STEPS; 0 feeds the input straight to the tank
+	VectorFDN(int numChannels, FeedbackMatrixType matrixType = FeedbackMatrixType::Householder, int numDiffusionSteps = 0);
+	~VectorFDN();
+
+	// Carve the delay lines out of the given arena instead of the heap (call before initialize)
+	void setArena(Arena* arena) { _arena = arena; }
+	static size_t getMemorySize(int numChannels, int numDiffusionSteps, float diffuserBufferMs, float feedbackBufferMs, float sampleRate, int maxDecimationFactor = 1);
+
+	// Let the tank run at up to 1/factor of the rate (1, 2 or 4; call before reserve and
+	// initialize). Above 1 a second tank is allocated for the factor changes.
+	void setMaxDecimationFactor(int factor);
+	// Factor the tank that takes the input runs at
+	int getDecimationFactor() { return _tanks[_activeTank].factor; }
+
+	// Allocate up front for the highest sample rate, so initialize / setSampleRate below it never
+	// allocate
+	void reserve(float diffuserBufferMs, float feedbackBufferMs, float maxSampleRate);
+
+	// Buffers are capped to what the largest room can read: feedback lines at
+	// VECTOR_FDN_MAX_LONGEST_DELAY_MS, every diffusion step at its share of the diffusion length
+	void initialize(float diffuserBufferMs, float feedbackBufferMs, float sampleRate);
+	void reset();
+	void setSampleRate(float sampleRate);
+
+	// Draws the feedback and diffusion delays for the room size from the seed: the same seed,
+	// room size, logic and distributions always give the same delays. RandomInRange places every
+	// line in its own equal share of the range, Uniform spaces them evenly. setSeed takes effect
+	// at the next setRoomSize.
+	void setSeed(uint32_t seed) { _seed = seed; }
+	uint32_t getSeed() { return _seed; }
+	// Draw from DelayRandom's precomputed table instead of the generator (next setRoomSize)
+	void setDelayTableMode(bool useTable) { _useDelayTable = useTable; }
+	void setRoomSize(float roomSize, DiffuserDelayLogic logic = DiffuserDelayLogic::Doubled, DelayDistribution diffuserDistribution = DelayDistribution::RandomInRange, DelayDistribution feedbackDistribution = DelayDistribution::RandomInRange);
+	void setFeedbackMatrix(FeedbackMatrixType type) { _matrix.setType(type); }
+	FeedbackMatrixType getFeedbackMatrix() { return _matrix.getType(); }
+	int getNumDiffusionSteps() { return _numDiffusionSteps; }
+	// At the rate of the tank that takes the input
+	float getDelayInSamples(int line) { return _tanks[_activeTank].delayInSamples[line]; }
+
+	void setDecayInSeconds(float decayInSeconds);
+	void setDampingFrequency(float frequency);
+	// Vicanek: matched one-pole, Shelving: shelf down to DAMPING_SHELF_FLOOR
+	void setDampingType(LPFilterType type);
+	void setLowPassFrequency(float frequency);
+	void setLowPassType(LPFilterType type);
+	void setHighPassFrequency(float frequency);
+	// Shelving: low shelf at DAMPING_SHELF_FLOOR below the frequency
+	void setHighPassType(HPFilterType type);
+	void setModDepth(float depth);
+	void setModRate(float rate);
+	void setStereoSpread(float spread) { _spread = spread; }
+	// Level of the diffused input sent straight to the outputs, tapped like the lines
+	void setEarlyLevel(float level) { _earlyLevel = level; }
+	// First: output k taps line k. All: stereo sums the even and the odd lines, more outputs
+	// take their Hadamard rows.
+	void setMixMode(MixMode mode);
+
+	// 2 (stereo) up to VECTOR_FDN_MAX_OUTPUTS. Beyond stereo, output k weighs the lines with the
+	// signs of Hadamard row k + 1, so the outputs are mutually uncorrelated (for line counts that
+	// are multiples of 16) at the level of the stereo pair.
+	void setNumOutputs(int numOutputs);
+	int getNumOutputs() { return _numOutputs; }
+
+	// Stereo in, getNumOutputs() out
+	void processAudio(float* input, float* output);
+	// Blocks of any length, getNumOutputs() output buffers. A factor change takes effect at the
+	// start of a block.
+	void processBlock(const float* inL, const float* inR, float** outputs, int numSamples);
+};
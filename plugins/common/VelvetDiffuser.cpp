@@ -0,0 +1,230 @@
+//-------------------------------------------------------------------------------------------------------
+//  VelvetDiffuser.cpp
+//  Stereo diffuser built from sparse velvet-noise FIR filters.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "VelvetDiffuser.h"
+#include "DelayRandom.h"
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+// Share of the total length taken by each stage: a short dense-ish smear, then the long tail
+static const float VELVET_STAGE_SHARE[VELVET_NUM_STAGES] = { 0.25, 0.75 };
+
+/*--------------------------------------------------------------------*/
+// output += gain * input over numSamples contiguous samples
+static inline void addScaled(float* output, const float* input, float gain, int numSamples)
+{
+    __m128 g = _mm_set1_ps(gain);
+    int n = 0;
+    for (; n + 4 <= numSamples; n += 4)
+        _mm_storeu_ps(output + n, _mm_add_ps(_mm_loadu_ps(output + n), _mm_mul_ps(g, _mm_loadu_ps(input + n))));
+    for (; n < numSamples; n++)
+        output[n] += gain * input[n];
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VelvetDiffuser::VelvetDiffuser()
+{
+    for (int s = 0; s < VELVET_NUM_STAGES; s++) {
+        for (int c = 0; c < VELVET_NUM_CHANNELS; c++)
+            _history[s][c] = nullptr;
+        _numTaps[s] = 0;
+    }
+    _bufferLength = 0;
+    _bufferMask = 0;
+    _allocatedLength = 0;
+    _arena = nullptr;
+    _writeIndex = 0;
+    _sampleRate = 0.0;
+    _lengthInMs = VELVET_MAX_LENGTH_IN_MS;
+    _density = VELVET_DEFAULT_DENSITY;
+    _seed = DEFAULT_DELAY_SEED;
+    _useDelayTable = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+VelvetDiffuser::~VelvetDiffuser()
+{
+    for (int s = 0; s < VELVET_NUM_STAGES; s++)
+        for (int c = 0; c < VELVET_NUM_CHANNELS; c++)
+            releaseFloats(_arena, _history[s][c]);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// History length: longest stage (at most the whole length) plus one block, rounded up to a power of two
+int VelvetDiffuser::getBufferLength(float sampleRate)
+{
+    int minLength = (int)(VELVET_MAX_LENGTH_IN_MS * 0.001 * sampleRate) + MAX_VELVET_BLOCK_SIZE + 1;
+    int length = 1;
+    while (length < minLength)
+        length <<= 1;
+    return length;
+}
+
+size_t VelvetDiffuser::getMemorySize(float sampleRate)
+{
+    return VELVET_NUM_STAGES * VELVET_NUM_CHANNELS * (getBufferLength(sampleRate) * sizeof(float) + ARENA_ALIGNMENT);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The histories are only replaced when they have to grow
+void VelvetDiffuser::reserve(float maxSampleRate)
+{
+    int length = getBufferLength(maxSampleRate);
+    if (length <= _allocatedLength)
+        return;
+    for (int s = 0; s < VELVET_NUM_STAGES; s++) {
+        for (int c = 0; c < VELVET_NUM_CHANNELS; c++) {
+            releaseFloats(_arena, _history[s][c]);
+            _history[s][c] = allocateFloats(_arena, length);
+        }
+    }
+    _allocatedLength = length;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VelvetDiffuser::init(float sampleRate)
+{
+    setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VelvetDiffuser::reset()
+{
+    for (int s = 0; s < VELVET_NUM_STAGES; s++)
+        for (int c = 0; c < VELVET_NUM_CHANNELS; c++)
+            memset(_history[s][c], 0, _bufferLength * sizeof(float));
+    _writeIndex = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Resize the histories for the new rate; only allocates when the reserved ones are too small
+void VelvetDiffuser::setSampleRate(float sampleRate)
+{
+    int length = getBufferLength(sampleRate);
+    reserve(sampleRate);
+    _bufferLength = length;
+    _bufferMask = length - 1;
+
+    _sampleRate = sampleRate;
+    generateTaps();
+    reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VelvetDiffuser::setLengthInMilliseconds(float lengthInMs)
+{
+    if (lengthInMs < VELVET_MIN_LENGTH_IN_MS)
+        lengthInMs = VELVET_MIN_LENGTH_IN_MS;
+    else if (lengthInMs > VELVET_MAX_LENGTH_IN_MS)
+        lengthInMs = VELVET_MAX_LENGTH_IN_MS;
+    _lengthInMs = lengthInMs;
+    generateTaps();
+}
+
+void VelvetDiffuser::setDensity(float pulsesPerSecond)
+{
+    _density = pulsesPerSecond > 1.0 ? pulsesPerSecond : 1.0;
+    generateTaps();
+}
+
+void VelvetDiffuser::setSeed(uint32_t seed)
+{
+    _seed = seed;
+    generateTaps();
+}
+
+void VelvetDiffuser::setDelayTableMode(bool useTable)
+{
+    _useDelayTable = useTable;
+    generateTaps();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// One pulse per grid period of sampleRate / density samples, at a random offset inside the period
+// and with a random sign. The envelope falls by VELVET_ENVELOPE_DECAY_DB across each stage, like
+// the energy of a diffusion chain's response, and each stage is scaled to unit energy.
+void VelvetDiffuser::generateTaps()
+{
+    if (_sampleRate <= 0.0)
+        return;
+
+    float gridPeriod = _sampleRate / _density;
+    if (gridPeriod < 1.0)
+        gridPeriod = 1.0;
+
+    for (int s = 0; s < VELVET_NUM_STAGES; s++) {
+        int numTaps = (int)(VELVET_STAGE_SHARE[s] * _lengthInMs * 0.001 * _sampleRate / gridPeriod);
+        if (numTaps < 1)
+            numTaps = 1;
+        else if (numTaps > VELVET_MAX_TAPS)
+            numTaps = VELVET_MAX_TAPS;
+
+        for (int c = 0; c < VELVET_NUM_CHANNELS; c++) {
+            DelayRandom random(DelayRandom::deriveSeed(_seed, _density, s * VELVET_NUM_CHANNELS + c), _useDelayTable);
+            int* delays = _tapDelays[s][c];
+            float* gains = _tapGains[s][c];
+            double energy = 0.0;
+            for (int m = 0; m < numTaps; m++) {
+                delays[m] = (int)(m * gridPeriod + random.nextFloat() * (gridPeriod - 1.0) + 0.5);
+                float sign = (random.nextUInt() & 0x80000000u) ? -1.0 : 1.0;
+                gains[m] = sign * pow(10.0, VELVET_ENVELOPE_DECAY_DB / 20.0 * m / numTaps);
+                energy += gains[m] * gains[m];
+            }
+            float scale = 1.0 / sqrt(energy);
+            for (int m = 0; m < numTaps; m++)
+                gains[m] *= scale;
+        }
+        _numTaps[s] = numTaps;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The block is written to the history first, so every tap reads at most two contiguous stretches
+// (split where the history wraps) and the output may overwrite the input.
+void VelvetDiffuser::processStage(int stage, int channel, const float* input, float* output, int numSamples)
+{
+    float* history = _history[stage][channel];
+    for (int n = 0; n < numSamples; n++)
+        history[(_writeIndex + n) & _bufferMask] = input[n];
+
+    const int* delays = _tapDelays[stage][channel];
+    const float* gains = _tapGains[stage][channel];
+    memset(output, 0, numSamples * sizeof(float));
+    for (int k = 0; k < _numTaps[stage]; k++) {
+        int readIndex = (_writeIndex - delays[k]) & _bufferMask;
+        int first = _bufferLength - readIndex;
+        if (first > numSamples)
+            first = numSamples;
+        addScaled(output, history + readIndex, gains[k], first);
+        addScaled(output + first, history, gains[k], numSamples - first);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void VelvetDiffuser::processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples)
+{
+    const float* inputs[VELVET_NUM_CHANNELS] = { inL, inR };
+    float* outputs[VELVET_NUM_CHANNELS] = { outL, outR };
+
+    for (int c = 0; c < VELVET_NUM_CHANNELS; c++) {
+        processStage(0, c, inputs[c], _stageOutput, numSamples);
+        processStage(1, c, _stageOutput, outputs[c], numSamples);
+    }
+    _writeIndex = (_writeIndex + numSamples) & _bufferMask;
+}
+/*--------------------------------------------------------------------*/
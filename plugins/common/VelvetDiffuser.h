@@ -0,0 +1,89 @@
+//-------------------------------------------------------------------------------------------------------
+//  VelvetDiffuser.h
+//  Stereo diffuser built from sparse velvet-noise FIR filters. A velvet filter holds one signed
+//  pulse per grid period, at a random offset inside the period, under a decaying envelope. Each
+//  channel runs a short filter into a long one: the cascade's echo count is the product of their
+//  pulse counts, so it reaches the echo density of a multi-step delay/Hadamard chain with a short
+//  list of (delay, gain) taps and no multichannel mixing.
+//
+//  Taps are drawn with DelayRandom from a seed, so a seed and a length always give the same
+//  filters. Blocks are processed tap by tap: every tap adds one contiguous, scaled stretch of the
+//  input history to the output.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+#include "Arena.h"
+
+#define VELVET_NUM_CHANNELS 2
+#define VELVET_NUM_STAGES 2
+#define VELVET_MIN_LENGTH_IN_MS 20.0
+#define VELVET_MAX_LENGTH_IN_MS 100.0
+#define VELVET_DEFAULT_DENSITY 2000.0           // pulses per second in each stage
+#define VELVET_MAX_TAPS 512                     // per stage and channel
+#define VELVET_ENVELOPE_DECAY_DB -30.0          // envelope level at the end of each stage
+#define MAX_VELVET_BLOCK_SIZE 256
+
+// Diffusion ahead of an FDN's feedback loop: the FDN's own delay/Hadamard steps or a velvet diffuser
+enum class DiffusionEngine {
+	Chain = 0,
+	Velvet
+};
+
+//-------------------------------------------------------------------------------------------------------
+class VelvetDiffuser {
+
+	// Sparse taps of each stage and channel, sorted by delay. Gains are normalized to unit energy.
+	int _tapDelays[VELVET_NUM_STAGES][VELVET_NUM_CHANNELS][VELVET_MAX_TAPS];
+	float _tapGains[VELVET_NUM_STAGES][VELVET_NUM_CHANNELS][VELVET_MAX_TAPS];
+	int _numTaps[VELVET_NUM_STAGES];
+
+	// Input history of each stage and channel (power of two length)
+	float* _history[VELVET_NUM_STAGES][VELVET_NUM_CHANNELS];
+	float _stageOutput[MAX_VELVET_BLOCK_SIZE];
+	int _bufferLength;
+	int _bufferMask;
+	int _allocatedLength;
+	Arena* _arena;
+	int _writeIndex;
+
+	float _sampleRate;
+	float _lengthInMs;
+	float _density;
+	uint32_t _seed;
+	bool _useDelayTable;
+
+	void generateTaps();
+	void processStage(int stage, int channel, const float* input, float* output, int numSamples);
+	static int getBufferLength(float sampleRate);
+
+public:
+
+	VelvetDiffuser();
+	~VelvetDiffuser();
+
+	// Carve the histories out of the given arena instead of the heap (call before init)
+	void setArena(Arena* arena) { _arena = arena; }
+	static size_t getMemorySize(float sampleRate);
+
+	// Allocate up front for the highest sample rate, so init / setSampleRate below it never allocate
+	void reserve(float maxSampleRate);
+
+	void init(float sampleRate);
+	void reset();
+	void setSampleRate(float sampleRate);
+
+	// Each of these draws new taps; none of them allocates
+	void setLengthInMilliseconds(float lengthInMs);
+	void setDensity(float pulsesPerSecond);
+	void setSeed(uint32_t seed);
+	// Draw from DelayRandom's precomputed table instead of the generator
+	void setDelayTableMode(bool useTable);
+
+	// Taps per channel, all stages together
+	int getNumTaps() { return _numTaps[0] + _numTaps[1]; }
+
+	// Process up to MAX_VELVET_BLOCK_SIZE samples. Outputs may alias the inputs.
+	void processBlock(const float* inL, const float* inR, float* outL, float* outR, int numSamples);
+};
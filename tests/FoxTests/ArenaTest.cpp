@@ -0,0 +1,64 @@
+//-------------------------------------------------------------------------------------------------------
+//  ArenaTest.cpp
+//  Object lifetimes in the per-instance arena.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "Arena.h"
+#include <vector>
+
+using namespace std;
+
+/*--------------------------------------------------------------------*/
+// Appends its id to a shared list when destroyed
+struct Tracked {
+    vector<int>* destroyed;
+    int id;
+    Tracked(vector<int>* destroyed, int id) : destroyed(destroyed), id(id) {}
+    ~Tracked() { destroyed->push_back(id); }
+};
+
+struct Plain {
+    float values[4];
+};
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+TEST(arenaDestroysInReverseOrder)
+{
+    vector<int> destroyed;
+    Arena arena;
+    arena.reserve(4096);
+    for (int i = 0; i < 3; i++)
+        arena.create<Tracked>(&destroyed, i);
+    arena.release();
+    CHECK(destroyed.size() == 3);
+    CHECK(destroyed.size() == 3 && destroyed[0] == 2 && destroyed[2] == 0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Any number of objects with a destructor is built and destroyed, none refused; sized with
+// ARENA_OBJECT_OVERHEAD each, they all fit the reservation
+TEST(arenaHasNoObjectLimit)
+{
+    const int numObjects = 1000;
+    vector<int> destroyed;
+    Arena arena;
+    arena.reserve(numObjects * (sizeof(Tracked) + ARENA_OBJECT_OVERHEAD) + 2 * numObjects * (sizeof(Plain) + ARENA_ALIGNMENT));
+    bool built = true;
+    for (int i = 0; i < numObjects; i++) {
+        built = built && arena.create<Tracked>(&destroyed, i) != nullptr;
+        built = built && arena.create<Plain>() != nullptr && arena.create<Plain>() != nullptr;
+    }
+    CHECK(built);
+    CHECK(!arena.hasSpilled());
+
+    arena.release();
+    bool reversed = destroyed.size() == numObjects;
+    for (int i = 0; reversed && i < numObjects; i++)
+        reversed = destroyed[i] == numObjects - 1 - i;
+    CHECK(reversed);
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,197 @@
+//-------------------------------------------------------------------------------------------------------
+//  CombBankTest.cpp
+//  FoxVerb's SIMD comb bank against one scalar lowpass-feedback comb per lane.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "CombBank.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_MAX_DELAY_IN_MS 100.0
+#define TEST_DECAY_IN_SECONDS 2.0
+#define TEST_DAMPING_FREQUENCY 5000.0
+
+static const float TEST_DELAYS_IN_MS[COMB_BANK_MAX_LANES] = {
+    31.1, 32.9, 34.3, 36.1, 37.7, 39.4, 41.2, 43.3,
+    31.6, 33.4, 34.8, 36.6, 38.2, 39.9, 41.7, 43.8 };
+
+/*--------------------------------------------------------------------*/
+// Reference comb, written the obvious way
+struct ScalarComb {
+    vector<float> line;
+    int index = 0;
+    int delay = 1;
+    float feedback = 0.0;
+    float damping = 0.0;
+    float state = 0.0;
+
+    ScalarComb(float delayInMs)
+    {
+        delay = (int)(delayInMs * 0.001 * TEST_SAMPLE_RATE + 0.5);
+        line.assign(delay + 1, 0.0f);
+        feedback = pow(10.0, -3.0 * delay / (TEST_DECAY_IN_SECONDS * TEST_SAMPLE_RATE));
+        damping = exp(-2.0 * M_PI * TEST_DAMPING_FREQUENCY / TEST_SAMPLE_RATE);
+    }
+
+    float process(float input)
+    {
+        int readIndex = index - delay;
+        if (readIndex < 0)
+            readIndex += (int)line.size();
+        float delayed = line[readIndex];
+        state = delayed * (1.0f - damping) + state * damping;
+        line[index] = input + feedback * state;
+        if (++index >= (int)line.size())
+            index = 0;
+        return delayed;
+    }
+};
+
+static void initBank(CombBank& bank, int numLanes)
+{
+    bank.init(TEST_SAMPLE_RATE, TEST_MAX_DELAY_IN_MS, numLanes);
+    bank.setDelaysInMilliseconds(TEST_DELAYS_IN_MS);
+    bank.setDecayInSeconds(TEST_DECAY_IN_SECONDS);
+    bank.setDampingFrequency(TEST_DAMPING_FREQUENCY);
+}
+
+static vector<float> makeNoise(int numSamples, uint32_t seed)
+{
+    vector<float> noise(numSamples);
+    TestRandom random(seed);
+    for (float& sample : noise)
+        sample = random.nextNoise(0.25f);
+    return noise;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+TEST(combBankMatchesScalarCombs)
+{
+    CombBank bank;
+    initBank(bank, COMB_BANK_LANES);
+    vector<ScalarComb> combs(TEST_DELAYS_IN_MS, TEST_DELAYS_IN_MS + COMB_BANK_LANES);
+
+    vector<float> input = makeNoise(48000, 1);
+    vector<float> output(input.size());
+    bank.processBlock(input.data(), output.data(), (int)input.size());
+
+    double maxError = 0.0;
+    for (size_t n = 0; n < input.size(); n++) {
+        float expected = 0.0;
+        for (ScalarComb& comb : combs)
+            expected += comb.process(input[n]);
+        maxError = fmax(maxError, fabs(output[n] - expected));
+    }
+    CHECK_NEAR(maxError, 0.0, 1e-5);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+TEST(combBankStereoMatchesScalarCombs)
+{
+    CombBank bank;
+    initBank(bank, COMB_BANK_MAX_LANES);
+    vector<ScalarComb> combs(TEST_DELAYS_IN_MS, TEST_DELAYS_IN_MS + COMB_BANK_MAX_LANES);
+
+    vector<float> inputL = makeNoise(48000, 1), inputR = makeNoise(48000, 2);
+    vector<float> outputL(inputL.size()), outputR(inputR.size());
+    bank.processStereoBlock(inputL.data(), inputR.data(), outputL.data(), outputR.data(), (int)inputL.size());
+
+    double maxError = 0.0;
+    for (size_t n = 0; n < inputL.size(); n++) {
+        float expectedL = 0.0, expectedR = 0.0;
+        for (int l = 0; l < COMB_BANK_LANES; l++) {
+            expectedL += combs[l].process(inputL[n]);
+            expectedR += combs[l + COMB_BANK_LANES].process(inputR[n]);
+        }
+        maxError = fmax(maxError, fmax(fabs(outputL[n] - expectedL), fabs(outputR[n] - expectedR)));
+    }
+    CHECK_NEAR(maxError, 0.0, 1e-5);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Stereo -> mid -> stereo in the middle of a tail: the left lanes carry on exactly, the right
+// lanes come back with a tail instead of silence
+TEST(combBankLaneChangeKeepsTail)
+{
+    CombBank bank;
+    initBank(bank, COMB_BANK_MAX_LANES);
+    vector<ScalarComb> combs(TEST_DELAYS_IN_MS, TEST_DELAYS_IN_MS + COMB_BANK_LANES);
+
+    vector<float> inputL = makeNoise(4800, 1), inputR = makeNoise(4800, 2);
+    for (size_t n = 0; n < inputL.size(); n++) {
+        float outputL, outputR;
+        bank.processStereo(inputL[n], inputR[n], &outputL, &outputR);
+        for (ScalarComb& comb : combs)
+            comb.process(inputL[n]);
+    }
+
+    bank.setNumLanes(COMB_BANK_LANES);
+    double maxError = 0.0;
+    for (int n = 0; n < 4800; n++) {
+        float expected = 0.0;
+        for (ScalarComb& comb : combs)
+            expected += comb.process(0.0f);
+        maxError = fmax(maxError, fabs(bank.processAudio(0.0f) - expected));
+    }
+    CHECK_NEAR(maxError, 0.0, 1e-5);
+
+    bank.setNumLanes(COMB_BANK_MAX_LANES);
+    double energyL = 0.0, energyR = 0.0;
+    for (int n = 0; n < 4800; n++) {
+        float outputL, outputR;
+        bank.processStereo(0.0f, 0.0f, &outputL, &outputR);
+        energyL += outputL * outputL;
+        energyR += outputR * outputR;
+    }
+    CHECK(energyL > 0.0);
+    CHECK_NEAR(energyR / energyL, 1.0, 0.5);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Nanoseconds per sample of the bank and of the scalar combs it replaces
+BENCH(combBankVsScalarCombs)
+{
+    const int numSamples = 10 * 48000;
+    vector<float> inputL = makeNoise(numSamples, 1), inputR = makeNoise(numSamples, 2);
+    vector<float> outputL(numSamples), outputR(numSamples);
+
+    for (int numLanes = COMB_BANK_LANES; numLanes <= COMB_BANK_MAX_LANES; numLanes *= 2) {
+        CombBank bank;
+        initBank(bank, numLanes);
+        vector<ScalarComb> combs(TEST_DELAYS_IN_MS, TEST_DELAYS_IN_MS + numLanes);
+
+        auto start = chrono::steady_clock::now();
+        if (numLanes == COMB_BANK_LANES)
+            bank.processBlock(inputL.data(), outputL.data(), numSamples);
+        else
+            bank.processStereoBlock(inputL.data(), inputR.data(), outputL.data(), outputR.data(), numSamples);
+        double bankSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for (int n = 0; n < numSamples; n++) {
+            float sumL = 0.0, sumR = 0.0;
+            for (int l = 0; l < COMB_BANK_LANES; l++)
+                sumL += combs[l].process(inputL[n]);
+            for (int l = COMB_BANK_LANES; l < numLanes; l++)
+                sumR += combs[l].process(inputR[n]);
+            outputL[n] = sumL;
+            outputR[n] = sumR;
+        }
+        double scalarSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("    %2d lanes: bank %6.1f ns/sample, scalar %6.1f ns/sample, %.2fx\n", numLanes,
+            1e9 * bankSeconds / numSamples, 1e9 * scalarSeconds / numSamples, scalarSeconds / bankSeconds);
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,261 @@
+//-------------------------------------------------------------------------------------------------------
+//  DampingFilterBankTest.cpp
+//  The SIMD damping bank, vectorized exp2 included, against one scalar decay gain and first-order
+//  lowpass per channel, for every filter type; then the bank inside VectorFDN against a scalar
+//  network built from the same delays.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "DampingFilterBank.h"
+#include "VectorFDN.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+#define TEST_NUM_SAMPLES 4800
+#define TEST_RELATIVE_TOLERANCE 1e-5
+#define TEST_FDN_CHANNELS 16
+#define TEST_FDN_SAMPLE_RATE 48000.0
+#define TEST_FDN_NUM_SAMPLES 96000
+#define TEST_FDN_TOLERANCE 1e-4                 // of the output's peak, float against double over 2 s
+
+static const float TEST_SAMPLE_RATES[] = { 44100, 48000, 96000, 192000 };
+static const float TEST_DECAYS_IN_SECONDS[] = { 0.1, 1.0, 5.0, 30.0 };
+static const float TEST_DAMPING_FREQUENCIES[] = { 200.0, 2000.0, 12000.0, 20000.0 };
+static const DampingFilterType TEST_TYPES[] = { DampingFilterType::OnePole, DampingFilterType::Matched, DampingFilterType::Shelving };
+
+/*--------------------------------------------------------------------*/
+// Reference channel, written the obvious way: the one-pole as it always was, the other types as
+// the first-order section with the type's DC and Nyquist gains
+struct ScalarDamping {
+    double b0 = 0.0, b1 = 0.0;
+    double pole = 0.0;
+    double inputState = 0.0, state = 0.0;
+
+    ScalarDamping(float delayInSamples, float decayInSeconds, float dampingFrequency, float sampleRate, DampingFilterType type)
+    {
+        if (dampingFrequency > 0.49 * sampleRate)
+            dampingFrequency = 0.49 * sampleRate;
+        pole = exp(-2.0 * M_PI * dampingFrequency / sampleRate);
+        double gain = decayInSeconds > 0.0 ? pow(10.0, -3.0 * delayInSamples / (decayInSeconds * sampleRate)) : 0.0;
+        if (type == DampingFilterType::OnePole) {
+            b0 = gain * (1.0 - pole);
+            return;
+        }
+        // Analog gain at Nyquist, r cutoffs up
+        double r = 0.5 * sampleRate / dampingFrequency;
+        double nyquistGain = type == DampingFilterType::Matched ? 1.0 / sqrt(1.0 + r * r)
+            : sqrt((1.0 + pow(DAMPING_SHELF_FLOOR * r, 2.0)) / (1.0 + r * r));
+        b0 = gain * 0.5 * ((1.0 - pole) + nyquistGain * (1.0 + pole));
+        b1 = gain * 0.5 * ((1.0 - pole) - nyquistGain * (1.0 + pole));
+    }
+
+    double process(double input)
+    {
+        state = b0 * input + b1 * inputState + pole * state;
+        inputState = input;
+        return state;
+    }
+};
+
+// Delays from a few samples up to a second, as an FDN at the given rate could use
+static vector<float> makeDelays(int numChannels, float sampleRate, uint32_t seed)
+{
+    vector<float> delays(numChannels);
+    TestRandom random(seed);
+    for (float& delay : delays)
+        delay = 4.0f + (float)(random.nextUniform() * sampleRate);
+    return delays;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Noise through one bank and its scalar channels. The error is measured against the reference's
+// peak, so channels with a tiny decay gain are held to the same bound.
+static void checkAgainstScalarFilters(DampingFilterType type, int numChannels, float sampleRate, float decay, float damping, uint32_t delaySeed, TestRandom& random)
+{
+    vector<float> delays = makeDelays(numChannels, sampleRate, delaySeed);
+    DampingFilterBank bank;
+    bank.init(numChannels);
+    CHECK(bank.getNumChannels() == numChannels);
+    bank.setType(type);
+    bank.setCoefficients(delays.data(), decay, damping, sampleRate);
+    vector<ScalarDamping> channels;
+    for (float delay : delays)
+        channels.push_back(ScalarDamping(delay, decay, damping, sampleRate, type));
+
+    vector<double> maxError(numChannels, 0.0), peak(numChannels, 0.0);
+    for (int n = 0; n < TEST_NUM_SAMPLES; n++) {
+        float x[DAMPING_BANK_MAX_CHANNELS];
+        for (int k = 0; k < numChannels; k++)
+            x[k] = random.nextNoise();
+        double expected[DAMPING_BANK_MAX_CHANNELS];
+        for (int k = 0; k < numChannels; k++)
+            expected[k] = channels[k].process(x[k]);
+        bank.process(x);
+        for (int k = 0; k < numChannels; k++) {
+            maxError[k] = fmax(maxError[k], fabs(x[k] - expected[k]));
+            peak[k] = fmax(peak[k], fabs(expected[k]));
+        }
+    }
+    for (int k = 0; k < numChannels; k++)
+        CHECK_NEAR(maxError[k], 0.0, TEST_RELATIVE_TOLERANCE * peak[k] + 1e-30);
+}
+
+// Every type, channel count, rate, decay and damping frequency
+TEST(dampingBankMatchesScalarFilters)
+{
+    uint32_t delaySeed = 1;
+    TestRandom random(1);
+    for (DampingFilterType type : TEST_TYPES)
+        for (int numChannels = 4; numChannels <= DAMPING_BANK_MAX_CHANNELS; numChannels *= 2)
+            for (float sampleRate : TEST_SAMPLE_RATES)
+                for (float decay : TEST_DECAYS_IN_SECONDS)
+                    for (float damping : TEST_DAMPING_FREQUENCIES)
+                        checkAgainstScalarFilters(type, numChannels, sampleRate, decay, damping, delaySeed++, random);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A zero decay silences the loop; reset clears the states without touching the coefficients
+TEST(dampingBankZeroDecayAndReset)
+{
+    const int numChannels = 16;
+    vector<float> delays = makeDelays(numChannels, 48000, 7);
+    DampingFilterBank bank;
+    bank.init(numChannels);
+
+    bank.setCoefficients(delays.data(), 0.0, 5000.0, 48000);
+    float x[numChannels];
+    for (int k = 0; k < numChannels; k++)
+        x[k] = 1.0f;
+    bank.process(x);
+    for (int k = 0; k < numChannels; k++)
+        CHECK(x[k] == 0.0f);
+
+    bank.setCoefficients(delays.data(), 2.0, 5000.0, 48000);
+    float first[numChannels], again[numChannels];
+    for (int k = 0; k < numChannels; k++)
+        first[k] = again[k] = 1.0f;
+    bank.process(first);
+    bank.reset();
+    bank.process(again);
+    for (int k = 0; k < numChannels; k++)
+        CHECK(first[k] == again[k]);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Output filter of the reference network: the first-order section with the given DC gain and
+// Nyquist gain, as VectorFDN builds it for a low or high shelf
+struct ScalarShelf {
+    double b0 = 0.0, b1 = 0.0, pole = 0.0;
+    double inputState = 0.0, state = 0.0;
+
+    ScalarShelf(float frequency, float sampleRate, bool highPass)
+    {
+        pole = exp(-2.0 * M_PI * frequency / sampleRate);
+        double r = 0.5 * sampleRate / frequency, floor = DAMPING_SHELF_FLOOR;
+        double dcGain = highPass ? floor : 1.0;
+        double nyquistGain = highPass ? sqrt((r * r + floor * floor) / (r * r + 1.0)) : sqrt((1.0 + floor * floor * r * r) / (1.0 + r * r));
+        b0 = 0.5 * (dcGain * (1.0 - pole) + nyquistGain * (1.0 + pole));
+        b1 = 0.5 * (dcGain * (1.0 - pole) - nyquistGain * (1.0 + pole));
+    }
+
+    double process(double input)
+    {
+        state = b0 * input + b1 * inputState + pole * state;
+        inputState = input;
+        return state;
+    }
+};
+
+// The FDN of the plugins without diffusion steps and modulation, one line at a time in double:
+// read, damp, sum the even and the odd lines to the outputs, Householder mix, add the input
+// (left to the even lines, right to the odd ones) and write back, then the output shelves
+struct ScalarFDN {
+    vector<vector<double>> lines;
+    vector<int> positions;
+    vector<ScalarDamping> damping;
+    vector<ScalarShelf> lowPasses, highPasses;
+
+    ScalarFDN(VectorFDN& reverb, float decay, float dampingFrequency, DampingFilterType type, float lowPass, float highPass)
+    {
+        for (int i = 0; i < TEST_FDN_CHANNELS; i++) {
+            float delay = reverb.getDelayInSamples(i);
+            lines.push_back(vector<double>((int)delay, 0.0));
+            positions.push_back(0);
+            damping.push_back(ScalarDamping(delay, decay, dampingFrequency, TEST_FDN_SAMPLE_RATE, type));
+        }
+        for (int k = 0; k < 2; k++) {
+            lowPasses.push_back(ScalarShelf(lowPass, TEST_FDN_SAMPLE_RATE, false));
+            highPasses.push_back(ScalarShelf(highPass, TEST_FDN_SAMPLE_RATE, true));
+        }
+    }
+
+    void process(const float* input, double* output)
+    {
+        double x[TEST_FDN_CHANNELS], sum = 0.0;
+        output[0] = output[1] = 0.0;
+        for (int i = 0; i < TEST_FDN_CHANNELS; i++) {
+            x[i] = damping[i].process(lines[i][positions[i]]);
+            output[i & 1] += x[i];
+            sum += x[i];
+        }
+        double inputGain = 1.0 / sqrt(0.5 * TEST_FDN_CHANNELS);
+        for (int i = 0; i < TEST_FDN_CHANNELS; i++) {
+            lines[i][positions[i]] = x[i] - 2.0 / TEST_FDN_CHANNELS * sum + input[i & 1] * inputGain;
+            positions[i] = (positions[i] + 1) % (int)lines[i].size();
+        }
+        for (int k = 0; k < 2; k++)
+            output[k] = highPasses[k].process(lowPasses[k].process(output[k]));
+    }
+};
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The bank as the plugins run it: a 16-line VectorFDN with the damping, low pass and high pass
+// types of MisEfx and Shimmer must follow the scalar network sample by sample
+TEST(dampingBankInsideVectorFDN)
+{
+    const float decay = 4.0, dampingFrequency = 3000.0, lowPass = 9000.0, highPass = 120.0;
+    const LPFilterType dampingTypes[] = { LPFilterType::Vicanek, LPFilterType::Shelving };
+    for (LPFilterType dampingType : dampingTypes) {
+        VectorFDN reverb(TEST_FDN_CHANNELS);
+        reverb.initialize(0.0, VECTOR_FDN_MAX_LONGEST_DELAY_MS, TEST_FDN_SAMPLE_RATE);
+        reverb.setRoomSize(0.7);
+        reverb.setDecayInSeconds(decay);
+        reverb.setDampingFrequency(dampingFrequency);
+        reverb.setDampingType(dampingType);
+        reverb.setLowPassFrequency(lowPass);
+        reverb.setLowPassType(LPFilterType::Shelving);
+        reverb.setHighPassFrequency(highPass);
+        reverb.setHighPassType(HPFilterType::Shelving);
+        DampingFilterType type = dampingType == LPFilterType::Shelving ? DampingFilterType::Shelving : DampingFilterType::Matched;
+        ScalarFDN reference(reverb, decay, dampingFrequency, type, lowPass, highPass);
+
+        TestRandom random(5);
+        double maxError = 0.0, peak = 0.0;
+        for (int n = 0; n < TEST_FDN_NUM_SAMPLES; n++) {
+            float input[2] = { 0.0f, 0.0f };
+            if (n < TEST_FDN_NUM_SAMPLES / 8) {
+                input[0] = random.nextNoise(0.5f);
+                input[1] = random.nextNoise(0.5f);
+            }
+            float output[2];
+            double expected[2];
+            reverb.processAudio(input, output);
+            reference.process(input, expected);
+            for (int k = 0; k < 2; k++) {
+                maxError = fmax(maxError, fabs(output[k] - expected[k]));
+                peak = fmax(peak, fabs(expected[k]));
+            }
+        }
+        CHECK(peak > 0.0);
+        CHECK_NEAR(maxError, 0.0, TEST_FDN_TOLERANCE * peak);
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------------------------------------
+//  DualMonoFDNTest.cpp
+//  Feedverb's left and right FDNs, run as two lanes of one engine, against two scalar FDNs that
+//  process the channels one sample at a time in double precision.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "DualMonoFDN.h"
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_DECAY_IN_SECONDS 2.0
+#define TEST_DAMPING_FREQUENCY 5000.0
+#define TEST_SPREAD 1.0
+#define TEST_BLOCK_SIZE 256
+#define TEST_NUM_BLOCKS 200
+
+/*--------------------------------------------------------------------*/
+// Mono FDN with the engine's topology: whole-sample delays, one-pole damping with the decay gain
+// of each line, Householder feedback and the input spread over the lines with alternating signs
+class ScalarFDN {
+
+    vector<vector<double>> _lines;
+    vector<int> _delays;
+    vector<double> _gains, _states;
+    double _pole, _b0;
+    int _position;
+
+public:
+
+    ScalarFDN(const float* delaysInMs)
+    {
+        _pole = exp(-2.0 * M_PI * TEST_DAMPING_FREQUENCY / TEST_SAMPLE_RATE);
+        _b0 = 1.0 - _pole;
+        _position = 0;
+        for (int i = 0; i < DUAL_MONO_NUM_CHANNELS; i++) {
+            int delay = (int)(delaysInMs[i] * 0.001 * TEST_SAMPLE_RATE + 0.5);
+            _delays.push_back(delay);
+            _lines.push_back(vector<double>(delay, 0.0));
+            _gains.push_back(pow(10.0, -3.0 * delay / (TEST_DECAY_IN_SECONDS * TEST_SAMPLE_RATE)));
+            _states.push_back(0.0);
+        }
+    }
+
+    double process(double input)
+    {
+        int n = DUAL_MONO_NUM_CHANNELS;
+        double values[DUAL_MONO_NUM_CHANNELS], sum = 0.0;
+        for (int i = 0; i < n; i++) {
+            double x = _lines[i][_position % _delays[i]];
+            _states[i] = _gains[i] * _b0 * x + _pole * _states[i];
+            values[i] = _states[i];
+            sum += values[i];
+        }
+        for (int i = 0; i < n; i++)
+            _lines[i][_position % _delays[i]] = values[i] - 2.0 * sum / n + ((i & 1) ? -1.0 : 1.0) * input / sqrt((double)n);
+        _position++;
+        return sum;
+    }
+};
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Different noise bursts on the two channels and the right delays spread away from the left
+// ones: each output must follow its own scalar FDN through the burst and the tail
+TEST(dualMonoFDNMatchesScalarFDNs)
+{
+    DualMonoFDN reverb;
+    reverb.init(TEST_SAMPLE_RATE);
+    reverb.setSpread(TEST_SPREAD);
+    reverb.setDecayInSeconds(TEST_DECAY_IN_SECONDS);
+    reverb.setDampingFrequency(TEST_DAMPING_FREQUENCY);
+
+    float leftDelays[DUAL_MONO_NUM_CHANNELS], rightDelays[DUAL_MONO_NUM_CHANNELS];
+    DualMonoFDN::getDelaysInMilliseconds(0, TEST_SPREAD, leftDelays);
+    DualMonoFDN::getDelaysInMilliseconds(1, TEST_SPREAD, rightDelays);
+    CHECK(rightDelays[0] > leftDelays[0]);
+    ScalarFDN left(leftDelays), right(rightDelays);
+
+    TestRandom random(5);
+    double maxError = 0.0, peak = 0.0, tailEnergy = 0.0;
+    for (int b = 0; b < TEST_NUM_BLOCKS; b++) {
+        float inL[TEST_BLOCK_SIZE], inR[TEST_BLOCK_SIZE], outL[TEST_BLOCK_SIZE], outR[TEST_BLOCK_SIZE];
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++) {
+            inL[i] = b < TEST_NUM_BLOCKS / 8 ? random.nextNoise(0.5f) : 0.0f;
+            inR[i] = b < TEST_NUM_BLOCKS / 8 ? random.nextNoise(0.5f) : 0.0f;
+        }
+        reverb.processBlock(inL, inR, outL, outR, TEST_BLOCK_SIZE);
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++) {
+            double expectedL = left.process(inL[i]);
+            double expectedR = right.process(inR[i]);
+            maxError = fmax(maxError, fmax(fabs(outL[i] - expectedL), fabs(outR[i] - expectedR)));
+            peak = fmax(peak, fmax(fabs(expectedL), fabs(expectedR)));
+            if (b >= TEST_NUM_BLOCKS / 2)
+                tailEnergy += expectedL * expectedL + expectedR * expectedR;
+        }
+    }
+    CHECK(tailEnergy > 0.0);
+    CHECK_NEAR(maxError / peak, 0.0, 1.0e-5);
+}
+/*--------------------------------------------------------------------*/
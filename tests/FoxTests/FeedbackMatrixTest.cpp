@@ -0,0 +1,97 @@
+//-------------------------------------------------------------------------------------------------------
+//  FeedbackMatrixTest.cpp
+//  Every feedback matrix type at every supported channel count must be orthogonal, and the fast
+//  Hadamard transform must match the Sylvester matrix it stands for.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "FeedbackMatrix.h"
+#include <math.h>
+
+#define TEST_SEED 1234u
+#define UNITARITY_TOLERANCE 1e-5
+
+static const FeedbackMatrixType MATRIX_TYPES[] = { FeedbackMatrixType::Householder, FeedbackMatrixType::Hadamard, FeedbackMatrixType::Rotation };
+
+/*--------------------------------------------------------------------*/
+static bool isPowerOfTwo(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Sign of Sylvester's Hadamard matrix at (i, j): (-1)^popcount(i & j)
+static float getHadamardSign(int i, int j)
+{
+    int bits = i & j;
+    int parity = 0;
+    while (bits) {
+        parity ^= bits & 1;
+        bits >>= 1;
+    }
+    return parity ? -1.0f : 1.0f;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Every multiple of 4 up to MAX_FEEDBACK_CHANNELS; Hadamard at the other sizes is Householder
+TEST(feedbackMatricesAreUnitary)
+{
+    for (FeedbackMatrixType type : MATRIX_TYPES) {
+        for (int numChannels = 4; numChannels <= MAX_FEEDBACK_CHANNELS; numChannels += 4) {
+            FeedbackMatrix matrix;
+            matrix.init(numChannels, type, TEST_SEED);
+            CHECK(matrix.getNumChannels() == numChannels);
+            if (type == FeedbackMatrixType::Hadamard && !isPowerOfTwo(numChannels))
+                CHECK(matrix.getType() == FeedbackMatrixType::Householder);
+            else
+                CHECK(matrix.getType() == type);
+            CHECK_NEAR(matrix.getUnitarityError(), 0.0, UNITARITY_TOLERANCE);
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// getUnitarityError measures the matrix through process(): check the Hadamard columns against
+// the explicit matrix, so a wrong but orthogonal transform can't pass
+TEST(hadamardMatchesSylvesterMatrix)
+{
+    for (int numChannels = 4; numChannels <= MAX_FEEDBACK_CHANNELS; numChannels <<= 1) {
+        FeedbackMatrix matrix;
+        matrix.init(numChannels, FeedbackMatrixType::Hadamard, TEST_SEED);
+        float scale = 1.0f / sqrtf((float)numChannels);
+
+        double maxError = 0.0;
+        for (int j = 0; j < numChannels; j++) {
+            float column[MAX_FEEDBACK_CHANNELS] = { 0.0f };
+            column[j] = 1.0f;
+            matrix.process(column);
+            for (int i = 0; i < numChannels; i++)
+                maxError = fmax(maxError, fabs(column[i] - scale * getHadamardSign(i, j)));
+        }
+        CHECK_NEAR(maxError, 0.0, UNITARITY_TOLERANCE);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Householder is the reflection I - 2/N 1 1^T
+TEST(householderMatchesReflection)
+{
+    for (int numChannels = 4; numChannels <= MAX_FEEDBACK_CHANNELS; numChannels += 4) {
+        FeedbackMatrix matrix;
+        matrix.init(numChannels, FeedbackMatrixType::Householder, TEST_SEED);
+
+        double maxError = 0.0;
+        for (int j = 0; j < numChannels; j++) {
+            float column[MAX_FEEDBACK_CHANNELS] = { 0.0f };
+            column[j] = 1.0f;
+            matrix.process(column);
+            for (int i = 0; i < numChannels; i++)
+                maxError = fmax(maxError, fabs(column[i] - ((i == j ? 1.0 : 0.0) - 2.0 / numChannels)));
+        }
+        CHECK_NEAR(maxError, 0.0, UNITARITY_TOLERANCE);
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,52 @@
+//-------------------------------------------------------------------------------------------------------
+//  FoxTest.h
+//  Minimal test registry for the shared DSP modules: every TEST in the linked files runs from
+//  FoxTests.cpp, BENCH bodies only on request.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+
+typedef void (*TestFunction)();
+
+// Adds a test or benchmark to the list main() runs, in link order
+struct TestRegistration {
+	TestRegistration(const char* name, TestFunction function, bool isBench);
+};
+
+// Records a failed check against the running test
+void reportFailure(const char* file, int line, const char* expression, double value, double limit);
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCH(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) reportFailure(__FILE__, __LINE__, #expression, 0.0, 0.0); } while (0)
+
+// |value - expected| must stay within tolerance; the failure message shows the difference
+#define CHECK_NEAR(value, expected, tolerance) \
+	do { double difference = fabs((double)(value) - (double)(expected)); \
+		if (!(difference <= (tolerance))) reportFailure(__FILE__, __LINE__, #value " ~ " #expected, difference, (tolerance)); } while (0)
+
+// Reproducible test signals: one LCG for every test, with 24-bit draws that are the same on every
+// compiler and machine
+struct TestRandom {
+	uint32_t state;
+
+	TestRandom(uint32_t seed) : state(seed) {}
+	uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+	// Uniform in [0, 1)
+	double nextUniform() { return next() / 16777216.0; }
+	// White noise in [-amplitude, amplitude)
+	float nextNoise(float amplitude = 1.0f) { return amplitude * (next() * (2.0f / 16777216.0f) - 1.0f); }
+};
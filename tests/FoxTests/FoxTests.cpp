@@ -0,0 +1,87 @@
+//-------------------------------------------------------------------------------------------------------
+//  FoxTests.cpp
+//  Unit tests and micro-benchmarks of the modules in plugins/common and the plugin-local DSP.
+//
+//  FoxTests [-b] [name ...]
+//      Runs every test, or those whose name contains one of the arguments. -b runs the benchmarks
+//      instead. Exits with 1 when a check fails.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+/*--------------------------------------------------------------------*/
+struct RegisteredTest {
+    const char* name;
+    TestFunction function;
+    bool isBench;
+};
+
+// Function-local so registrations from other files' static initializers find it constructed
+static vector<RegisteredTest>& getTests()
+{
+    static vector<RegisteredTest> tests;
+    return tests;
+}
+
+static int numFailures = 0;
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+TestRegistration::TestRegistration(const char* name, TestFunction function, bool isBench)
+{
+    getTests().push_back({ name, function, isBench });
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void reportFailure(const char* file, int line, const char* expression, double value, double limit)
+{
+    if (limit > 0.0)
+        printf("    %s:%d: %s off by %g (limit %g)\n", file, line, expression, value, limit);
+    else
+        printf("    %s:%d: %s\n", file, line, expression);
+    numFailures++;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static bool isSelected(const char* name, int argc, char** argv, int firstName)
+{
+    if (firstName >= argc)
+        return true;
+    for (int a = firstName; a < argc; a++)
+        if (strstr(name, argv[a]) != nullptr)
+            return true;
+    return false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    bool runBenches = argc > 1 && strcmp(argv[1], "-b") == 0;
+    int firstName = runBenches ? 2 : 1;
+
+    int numRun = 0, numFailed = 0;
+    for (const RegisteredTest& test : getTests()) {
+        if (test.isBench != runBenches || !isSelected(test.name, argc, argv, firstName))
+            continue;
+        int failuresBefore = numFailures;
+        printf("%s\n", test.name);
+        test.function();
+        numRun++;
+        if (numFailures > failuresBefore) {
+            printf("    FAILED\n");
+            numFailed++;
+        }
+    }
+
+    printf("%d run, %d failed\n", numRun, numFailed);
+    return numFailed > 0 ? 1 : 0;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,191 @@
+//-------------------------------------------------------------------------------------------------------
+//  HalfBandOversamplerTest.cpp
+//  Latency and factor changes of the output oversampler, latency of the reverb decimator.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "HalfBandOversampler.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_BLOCK_SIZE 64
+
+/*--------------------------------------------------------------------*/
+// Round trip of one block through the oversampler, the oversampled signal scaled by gain
+static void processBlock(HalfBandOversampler& oversampler, const float* input, float* output, int numSamples, float gain)
+{
+    int numOversampled;
+    float* oversampled = oversampler.upsample(0, input, numSamples, &numOversampled);
+    for (int i = 0; i < numOversampled; i++)
+        oversampled[i] *= gain;
+    oversampler.downsample(0, output, numSamples);
+}
+
+static vector<float> makeSine(int numSamples, float frequency)
+{
+    vector<float> signal(numSamples);
+    for (int n = 0; n < numSamples; n++)
+        signal[n] = 0.5 * sin(2.0 * M_PI * frequency * n / TEST_SAMPLE_RATE);
+    return signal;
+}
+
+// Runs the signal through in blocks, switching to factors[b] before block b (0 keeps the factor),
+// and returns the largest difference from the input scaled by gain and delayed by the latency
+static double runFactorChanges(HalfBandOversampler& oversampler, const vector<float>& signal, const vector<int>& factors, float gain)
+{
+    vector<float> output(signal.size());
+    for (size_t b = 0; b * TEST_BLOCK_SIZE < signal.size(); b++) {
+        if (b < factors.size() && factors[b] != 0)
+            oversampler.setFactor(factors[b]);
+        processBlock(oversampler, &signal[b * TEST_BLOCK_SIZE], &output[b * TEST_BLOCK_SIZE], TEST_BLOCK_SIZE, gain);
+    }
+
+    int latency = oversampler.getLatencyInSamples();
+    double maxError = 0.0;
+    for (size_t n = 4 * TEST_BLOCK_SIZE; n < signal.size(); n++)
+        maxError = fmax(maxError, fabs(output[n] - gain * signal[n - latency]));
+    return maxError;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+TEST(oversamplerLatencyFollowsFactor)
+{
+    for (int factor = 1; factor <= 4; factor *= 2) {
+        HalfBandOversampler oversampler;
+        oversampler.init(1);
+        oversampler.setFactor(factor);
+        oversampler.updateLatency();
+        CHECK(oversampler.getFactor() == factor);
+        CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(factor));
+
+        // the impulse comes out exactly the reported latency later
+        float impulse[TEST_BLOCK_SIZE] = { 1.0f };
+        float output[TEST_BLOCK_SIZE];
+        processBlock(oversampler, impulse, output, TEST_BLOCK_SIZE, 1.0f);
+        int peak = 0;
+        for (int n = 1; n < TEST_BLOCK_SIZE; n++)
+            if (fabs(output[n]) > fabs(output[peak]))
+                peak = n;
+        CHECK(peak == oversampler.getLatencyInSamples());
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A factor with a longer round trip than the reported latency waits for updateLatency()
+TEST(oversamplerHoldsLongerLatencyUntilUpdate)
+{
+    HalfBandOversampler oversampler;
+    oversampler.init(1);
+    oversampler.setFactor(2);
+    oversampler.updateLatency();
+
+    oversampler.setFactor(4);
+    CHECK(oversampler.getFactor() == 2);
+    CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(2));
+    CHECK(oversampler.updateLatency());
+    CHECK(oversampler.getFactor() == 4);
+    CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(4));
+
+    // lower factors run padded to it, and switching back needs no new latency
+    oversampler.setFactor(1);
+    CHECK(oversampler.getFactor() == 1);
+    CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(4));
+    oversampler.setFactor(4);
+    CHECK(!oversampler.updateLatency());
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// With the maximum factor's latency taken on up front, every factor switches without updateLatency()
+TEST(oversamplerMaxFactorSwitchesImmediately)
+{
+    HalfBandOversampler oversampler;
+    oversampler.init(1);
+    oversampler.setMaxFactor(4);
+    CHECK(oversampler.getFactor() == 1);
+    CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(4));
+
+    oversampler.setFactor(4);
+    CHECK(oversampler.getFactor() == 4);
+    oversampler.setFactor(2);
+    CHECK(oversampler.getFactor() == 2);
+    CHECK(!oversampler.updateLatency());
+    CHECK(oversampler.getLatencyInSamples() == HalfBandOversampler::getFactorLatency(4));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Switching factors mid-stream neither drops nor repeats samples
+TEST(oversamplerFactorChangesKeepSignal)
+{
+    HalfBandOversampler oversampler;
+    oversampler.init(1);
+    oversampler.setFactor(4);
+    oversampler.updateLatency();
+
+    vector<float> signal = makeSine(64 * TEST_BLOCK_SIZE, 997.0);
+    vector<int> factors(64, 0);
+    int sequence[] = { 2, 1, 4, 2, 4, 1, 2, 1, 4 };
+    for (int s = 0; s < 9; s++)
+        factors[6 + 6 * s] = sequence[s];
+    CHECK_NEAR(runFactorChanges(oversampler, signal, factors, 1.0f), 0.0, 2e-3);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Going up a factor, the added stages are primed with what the caller made of the signal
+TEST(oversamplerFactorIncreaseKeepsProcessedSignal)
+{
+    HalfBandOversampler oversampler;
+    oversampler.init(1);
+    oversampler.setFactor(4);
+    oversampler.updateLatency();
+    oversampler.setFactor(1);
+
+    vector<float> signal = makeSine(32 * TEST_BLOCK_SIZE, 2503.0);
+    vector<int> factors(32, 0);
+    factors[8] = 2;
+    factors[16] = 4;
+    factors[24] = 1;
+    factors[25] = 4;
+    CHECK_NEAR(runFactorChanges(oversampler, signal, factors, 0.5f), 0.0, 2e-3);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// An impulse must come out of the round trip exactly getFactorLatency() late, and frame aligned
+// exactly getAlignedLatency() late: the whole frames VectorFDN takes out of its delay lines
+TEST(decimatorLatencyMatchesFactorLatency)
+{
+    for (bool aligned : { false, true }) {
+        for (int factor = 1; factor <= 4; factor *= 2) {
+            HalfBandDecimator decimator;
+            decimator.setFrameAligned(aligned);
+            decimator.init(1);
+            decimator.setFactor(factor);
+
+            vector<float> output(4 * TEST_BLOCK_SIZE);
+            for (int b = 0; b < 4; b++) {
+                float input[TEST_BLOCK_SIZE] = { b == 0 ? 1.0f : 0.0f };
+                int numDecimated;
+                decimator.decimate(0, input, TEST_BLOCK_SIZE, &numDecimated);
+                decimator.interpolate(0, &output[b * TEST_BLOCK_SIZE], TEST_BLOCK_SIZE);
+            }
+            int peak = 0;
+            for (int n = 1; n < (int)output.size(); n++)
+                if (fabs(output[n]) > fabs(output[peak]))
+                    peak = n;
+            CHECK(peak == (aligned ? HalfBandDecimator::getAlignedLatency(factor) : HalfBandDecimator::getFactorLatency(factor)));
+            CHECK(HalfBandDecimator::getAlignedLatency(factor) % factor == 0);
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
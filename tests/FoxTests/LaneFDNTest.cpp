@@ -0,0 +1,149 @@
+//-------------------------------------------------------------------------------------------------------
+//  LaneFDNTest.cpp
+//  Each lane of a LaneFDN must be the mono FDN it stands for, with shared or per-lane delays, and
+//  a benchmark of the lanes against the same instances one after the other.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "LaneFDN.h"
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_MAX_DELAY_IN_MS 100.0
+#define TEST_NUM_CHANNELS 8
+#define TEST_DECAY_IN_SECONDS 1.5
+#define TEST_DAMPING_FREQUENCY 6000.0
+#define TEST_NUM_SAMPLES 24000
+
+/*--------------------------------------------------------------------*/
+// Delays between 20 and 80 ms, different for every seed
+static vector<float> makeDelays(uint32_t seed)
+{
+    vector<float> delays(TEST_NUM_CHANNELS);
+    TestRandom random(seed);
+    for (float& delay : delays)
+        delay = 20.0f + (float)(random.nextUniform() * 60.0);
+    return delays;
+}
+
+static void initReverb(LaneFDN& reverb, int numLanes)
+{
+    reverb.init(TEST_SAMPLE_RATE, TEST_MAX_DELAY_IN_MS, TEST_NUM_CHANNELS, numLanes);
+    reverb.setDecayInSeconds(TEST_DECAY_IN_SECONDS);
+    reverb.setDampingFrequency(TEST_DAMPING_FREQUENCY);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Every lane with its own delays and input against a one-lane instance with the same ones: the
+// outputs must be identical, and a lane fed with silence must stay silent
+TEST(laneFDNMatchesSingleInstances)
+{
+    LaneFDN lanes;
+    initReverb(lanes, LANE_FDN_LANES);
+    CHECK(lanes.getNumLanes() == LANE_FDN_LANES);
+    LaneFDN singles[LANE_FDN_LANES];
+    for (int l = 0; l < LANE_FDN_LANES; l++) {
+        vector<float> delays = makeDelays(l + 1);
+        lanes.setDelaysInMilliseconds(l, delays.data());
+        initReverb(singles[l], 1);
+        singles[l].setDelaysInMilliseconds(delays.data());
+    }
+
+    const int silentLane = LANE_FDN_LANES - 1;
+    TestRandom random(1);
+    double maxError = 0.0, silentPeak = 0.0, energy = 0.0;
+    for (int n = 0; n < TEST_NUM_SAMPLES; n++) {
+        float inputs[LANE_FDN_LANES], outputs[LANE_FDN_LANES];
+        for (int l = 0; l < LANE_FDN_LANES; l++)
+            inputs[l] = l != silentLane && n < TEST_NUM_SAMPLES / 4 ? random.nextNoise(0.5f) : 0.0f;
+        lanes.processAudio(inputs, outputs);
+        for (int l = 0; l < LANE_FDN_LANES; l++) {
+            float output;
+            singles[l].processAudio(&inputs[l], &output);
+            maxError = fmax(maxError, fabs(outputs[l] - output));
+            energy += (double)output * output;
+        }
+        silentPeak = fmax(silentPeak, fabs(outputs[silentLane]));
+    }
+    CHECK(energy > 0.0);
+    CHECK(maxError == 0.0);
+    CHECK(silentPeak == 0.0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The same delays given to every lane take the single-load reads: two lanes with the same input
+// must match each other and a one-lane instance
+TEST(laneFDNSharedDelays)
+{
+    vector<float> delays = makeDelays(7);
+    LaneFDN lanes, single;
+    initReverb(lanes, 2);
+    lanes.setDelaysInMilliseconds(delays.data());
+    initReverb(single, 1);
+    single.setDelaysInMilliseconds(delays.data());
+
+    TestRandom random(3);
+    double maxError = 0.0;
+    for (int n = 0; n < TEST_NUM_SAMPLES; n++) {
+        float input = n < TEST_NUM_SAMPLES / 4 ? random.nextNoise(0.5f) : 0.0f;
+        float inputs[2] = { input, input }, outputs[2], output;
+        lanes.processAudio(inputs, outputs);
+        single.processAudio(&input, &output);
+        maxError = fmax(maxError, fmax(fabs(outputs[0] - output), fabs(outputs[1] - output)));
+    }
+    CHECK(maxError == 0.0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// One lane, two lanes with shared delays, and all lanes with their own delays against as many
+// one-lane instances in a row. Prints ns per sample and instance.
+BENCH(laneFDNAgainstSequentialInstances)
+{
+    const int numSamples = 10 * (int)TEST_SAMPLE_RATE;
+    vector<float> noise(numSamples);
+    TestRandom random(1);
+    for (float& sample : noise)
+        sample = random.nextNoise(0.5f);
+
+    for (int numLanes : { 1, 2, LANE_FDN_LANES }) {
+        bool shared = numLanes == 2;
+        LaneFDN lanes;
+        initReverb(lanes, numLanes);
+        vector<LaneFDN> singles(numLanes);
+        for (int l = 0; l < numLanes; l++) {
+            vector<float> delays = makeDelays(shared ? 1 : l + 1);
+            lanes.setDelaysInMilliseconds(l, delays.data());
+            initReverb(singles[l], 1);
+            singles[l].setDelaysInMilliseconds(delays.data());
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (int n = 0; n < numSamples; n++) {
+            float inputs[LANE_FDN_LANES], outputs[LANE_FDN_LANES];
+            for (int l = 0; l < numLanes; l++)
+                inputs[l] = noise[n];
+            lanes.processAudio(inputs, outputs);
+        }
+        double laneSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for (int n = 0; n < numSamples; n++)
+            for (LaneFDN& single : singles) {
+                float output;
+                single.processAudio(&noise[n], &output);
+            }
+        double sequentialSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("    %d lane%s%s: lanes %6.1f ns, sequential %6.1f ns\n", numLanes, numLanes > 1 ? "s" : " ", shared ? " (shared delays)" : "",
+            1e9 * laneSeconds / ((double)numSamples * numLanes), 1e9 * sequentialSeconds / ((double)numSamples * numLanes));
+    }
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------------------------------------------
+//  ParameterChangesTest.cpp
+//  Marks made on other threads and transactions the host never ends.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "ParameterChanges.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define MARKING_THREADS 4
+#define MARKS_PER_THREAD 5000
+#define MARK_TIMEOUT_SECONDS 10
+
+/*--------------------------------------------------------------------*/
+// Each thread marks its flag and waits for the drain to take it before marking again, so every
+// mark must show up in exactly one take(). A lost mark leaves its thread waiting until the timeout.
+TEST(parameterChangesKeepConcurrentMarks)
+{
+    ParameterChanges changes;
+    atomic<int> taken[MARKING_THREADS];
+    for (int t = 0; t < MARKING_THREADS; t++)
+        taken[t] = 0;
+    atomic<bool> lost(false);
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(MARK_TIMEOUT_SECONDS);
+
+    vector<thread> threads;
+    for (int t = 0; t < MARKING_THREADS; t++)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < MARKS_PER_THREAD && !lost; i++) {
+                changes.mark(1u << t);
+                while (taken[t] <= i && !lost) {
+                    if (chrono::steady_clock::now() > deadline)
+                        lost = true;
+                    this_thread::yield();
+                }
+            }
+        });
+
+    int remaining = MARKING_THREADS * MARKS_PER_THREAD;
+    while (remaining > 0 && !lost) {
+        uint32_t dirty = changes.take();
+        if (dirty == 0)
+            this_thread::yield();
+        for (int t = 0; t < MARKING_THREADS; t++)
+            if (dirty & (1u << t)) {
+                taken[t]++;
+                remaining--;
+            }
+    }
+    for (thread& marker : threads)
+        marker.join();
+
+    CHECK(!lost);
+    for (int t = 0; t < MARKING_THREADS; t++)
+        CHECK(taken[t] == MARKS_PER_THREAD);
+    CHECK(changes.getHistory() == (1u << MARKING_THREADS) - 1);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A nested transaction holds the marks until the outermost end
+TEST(parameterChangesHoldMarksUntilOutermostEnd)
+{
+    ParameterChanges changes;
+    changes.begin();
+    changes.begin();
+    changes.mark(1);
+    CHECK(!changes.beginBlock());
+    CHECK(!changes.end());
+    CHECK(!changes.beginBlock());
+    CHECK(changes.end());
+    CHECK(changes.beginBlock());
+    CHECK(changes.take() == 1);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// beginSetProgram without endSetProgram: the marks go through after the timeout, and the late end
+// leaves the next transaction working
+TEST(parameterChangesAbandonOpenTransaction)
+{
+    ParameterChanges changes;
+    changes.begin();
+    changes.mark(2);
+    for (int i = 1; i < PARAMETER_CHANGES_MAX_HELD_BLOCKS; i++)
+        CHECK(!changes.beginBlock());
+    CHECK(changes.beginBlock());
+    CHECK(!changes.isOpen());
+    CHECK(changes.take() == 2);
+
+    CHECK(!changes.end());
+    CHECK(!changes.isOpen());
+    changes.begin();
+    CHECK(changes.isOpen());
+    CHECK(changes.end());
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,85 @@
+//-------------------------------------------------------------------------------------------------------
+//  SampleRateSweepTest.cpp
+//  Every plugin-local delay line reserved for MAX_SUPPORTED_SAMPLE_RATE must switch between rates
+//  below it without allocating. Allocations are counted by RealtimeCheck, so the checks only run
+//  in Linux builds with FOX_REALTIME_CHECK; other builds report the tests as skipped.
+//  Whole plugins, Shimmer and MisEfx with their core objects, are swept between blocks by
+//  FoxCheck realtime.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "RealtimeCheck.h"
+#include "CombBank.h"
+#include "VectorFreeverb.h"
+#include "DelayPitchShifter.h"
+#include "VelvetDiffuser.h"
+#include "VectorFDN.h"
+
+#define TEST_MAX_SAMPLE_RATE 192000.0
+#define TEST_COMB_MAX_DELAY_IN_MS 100.0
+#define TEST_FDN_BUFFER_IN_MS 2000.0
+
+static const float SWEEP_SAMPLE_RATES[] = { 44100, 22050, 48000, 88200, 96000, 176400, 192000, 8000, 48000 };
+
+/*--------------------------------------------------------------------*/
+// Runs every setSampleRate of the sweep inside a real-time scope and checks nothing was reported
+template<typename SetSampleRate>
+static void checkSweepDoesNotAllocate(const char* name, SetSampleRate setSampleRate)
+{
+#ifdef REALTIME_CHECK_ENABLED
+    resetRealtimeViolationCount();
+    {
+        RealtimeScope scope(name);
+        for (float sampleRate : SWEEP_SAMPLE_RATES)
+            setSampleRate(sampleRate);
+    }
+    CHECK(getRealtimeViolationCount() == 0);
+#else
+    printf("  skipped: allocation counting needs FOX_REALTIME_CHECK on Linux\n");
+#endif
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The modules use the heap here (no arena), so any growth is a malloc the checker sees
+TEST(combBankSweepDoesNotAllocate)
+{
+    CombBank bank;
+    bank.reserve(TEST_MAX_SAMPLE_RATE, TEST_COMB_MAX_DELAY_IN_MS, COMB_BANK_MAX_LANES);
+    bank.init(44100, TEST_COMB_MAX_DELAY_IN_MS, COMB_BANK_MAX_LANES);
+    checkSweepDoesNotAllocate("CombBank::setSampleRate", [&](float sampleRate) { bank.setSampleRate(sampleRate); });
+}
+
+TEST(vectorFreeverbSweepDoesNotAllocate)
+{
+    VectorFreeverb reverb;
+    reverb.reserve(TEST_MAX_SAMPLE_RATE);
+    reverb.init(44100, 0.5, 2.0, 8000.0, 0.5, 0.5, 20.0);
+    checkSweepDoesNotAllocate("VectorFreeverb::setSampleRate", [&](float sampleRate) { reverb.setSampleRate(sampleRate); });
+}
+
+TEST(delayPitchShifterSweepDoesNotAllocate)
+{
+    DelayPitchShifter shifter;
+    shifter.reserve(TEST_MAX_SAMPLE_RATE);
+    shifter.init(44100);
+    checkSweepDoesNotAllocate("DelayPitchShifter::setSampleRate", [&](float sampleRate) { shifter.setSampleRate(sampleRate); });
+}
+
+TEST(velvetDiffuserSweepDoesNotAllocate)
+{
+    VelvetDiffuser diffuser;
+    diffuser.reserve(TEST_MAX_SAMPLE_RATE);
+    diffuser.init(44100);
+    checkSweepDoesNotAllocate("VelvetDiffuser::setSampleRate", [&](float sampleRate) { diffuser.setSampleRate(sampleRate); });
+}
+
+TEST(vectorFDNSweepDoesNotAllocate)
+{
+    VectorFDN fdn(16);
+    fdn.reserve(0.0, TEST_FDN_BUFFER_IN_MS, TEST_MAX_SAMPLE_RATE);
+    fdn.initialize(0.0, TEST_FDN_BUFFER_IN_MS, 44100);
+    checkSweepDoesNotAllocate("VectorFDN::setSampleRate", [&](float sampleRate) { fdn.setSampleRate(sampleRate); });
+}
+/*--------------------------------------------------------------------*/
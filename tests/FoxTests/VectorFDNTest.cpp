@@ -0,0 +1,335 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFDNTest.cpp
+//  Checks that the seed alone picks the vector FDN's delay set, that every surround output carries
+//  its own share of the tail, that a decimated tank adds no latency and changes its factor without
+//  a seam, and a benchmark over line and instance counts.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "VectorFDN.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_BUFFER_IN_MS 2000.0
+#define TEST_DECAY_IN_SECONDS 3.0
+#define TEST_BURST_IN_SECONDS 0.1
+#define TEST_TAIL_IN_SECONDS 4.0
+#define TEST_DIFFUSION_STEPS 5
+#define TEST_SEED_SAMPLES 12000
+#define MIN_OUTPUT_TO_STEREO_LEVEL 0.5          // energy of each surround output over the stereo pair's
+#define MAX_OUTPUT_CORRELATION 0.3              // measured up to 0.19 over a 0.1 s burst
+#define TEST_BLOCK_SIZE 128
+#define TEST_QUARTER_RATE_DAMPING 1500.0        // leaves the tank 1/4 of the rate
+#define TEST_HALF_RATE_DAMPING 3000.0           // leaves it 1/2
+#define TEST_FULL_RATE_DAMPING 8000.0           // needs the full rate
+#define TEST_NOISE_CUTOFF 800.0                 // band of the test noise, well inside the decimated tanks'
+#define MIN_DECIMATED_CORRELATION 0.9
+#define MAX_SUPERPOSITION_ERROR 1e-5            // of the peak
+
+static const int SURROUND_NUM_OUTPUTS[] = { 6, 8 };
+
+static const int BENCH_NUM_CHANNELS[] = { 16, 64 };
+static const int BENCH_NUM_INSTANCES[] = { 1, 4, 16 };
+
+/*--------------------------------------------------------------------*/
+static void initReverb(VectorFDN& reverb, uint32_t seed)
+{
+    reverb.initialize(TEST_BUFFER_IN_MS, TEST_BUFFER_IN_MS, TEST_SAMPLE_RATE);
+    reverb.setSeed(seed);
+    reverb.setRoomSize(1.0);
+    reverb.setDecayInSeconds(TEST_DECAY_IN_SECONDS);
+    reverb.setModDepth(0.5);
+    reverb.setModRate(1.0);
+}
+/*--------------------------------------------------------------------*/
+
+// Noise through six one-poles at TEST_NOISE_CUTOFF for the first burst samples, silence after
+static vector<float> makeBandLimitedNoise(int numSamples, int burst)
+{
+    vector<float> noise(numSamples, 0.0f);
+    TestRandom random(1);
+    double pole = exp(-2.0 * M_PI * TEST_NOISE_CUTOFF / TEST_SAMPLE_RATE), states[6] = { 0.0 };
+    for (int n = 0; n < numSamples; n++) {
+        double x = n < burst ? random.nextNoise(2.0f) : 0.0;
+        for (double& state : states)
+            x = state = (1.0 - pole) * x + pole * state;
+        noise[n] = (float)x;
+    }
+    return noise;
+}
+
+// Left output for the same signal on both inputs, TEST_BLOCK_SIZE at a time; each block's damping
+// is given by dampingAt, called with the block's first sample
+template <typename DampingAt>
+static vector<float> renderBlocks(VectorFDN& reverb, const vector<float>& input, DampingAt dampingAt)
+{
+    vector<float> left(input.size()), right(input.size());
+    for (size_t start = 0; start < input.size(); start += TEST_BLOCK_SIZE) {
+        reverb.setDampingFrequency(dampingAt((int)start));
+        int numSamples = input.size() - start < TEST_BLOCK_SIZE ? (int)(input.size() - start) : TEST_BLOCK_SIZE;
+        float* outputs[2] = { &left[start], &right[start] };
+        reverb.processBlock(&input[start], &input[start], outputs, numSamples);
+    }
+    return left;
+}
+
+static void initMultirateReverb(VectorFDN& reverb, float damping)
+{
+    reverb.setMaxDecimationFactor(4);
+    reverb.initialize(TEST_BUFFER_IN_MS, TEST_BUFFER_IN_MS, TEST_SAMPLE_RATE);
+    reverb.setRoomSize(0.5);
+    reverb.setDecayInSeconds(1.0);
+    reverb.setDampingFrequency(damping);
+    reverb.reset();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Impulse response of a diffused 16-line network drawn from the seed, from the generator or the table
+static vector<float> renderImpulse(uint32_t seed, bool useTable)
+{
+    VectorFDN reverb(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+    reverb.setDelayTableMode(useTable);
+    initReverb(reverb, seed);
+    vector<float> response(TEST_SEED_SAMPLES);
+    for (int n = 0; n < TEST_SEED_SAMPLES; n++) {
+        float input[2] = { n == 0 ? 1.0f : 0.0f, 0.0f }, output[2];
+        reverb.processAudio(input, output);
+        response[n] = output[0];
+    }
+    return response;
+}
+
+// Two instances with the same seed render the same samples, another seed renders another room;
+// the same holds in table mode, which draws a set of its own
+TEST(vectorFDNSeedPicksTheDelays)
+{
+    for (bool useTable : { false, true }) {
+        vector<float> first = renderImpulse(1, useTable);
+        CHECK(renderImpulse(1, useTable) == first);
+        CHECK(renderImpulse(2, useTable) != first);
+        double energy = 0.0;
+        for (float sample : first)
+            energy += (double)sample * sample;
+        CHECK(energy > 0.0);
+    }
+    CHECK(renderImpulse(1, true) != renderImpulse(1, false));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// 5.1 and 7.1 from one network: a noise burst must reach every output at the level of the stereo
+// pair, and no two outputs may be correlated
+TEST(vectorFDNSurroundOutputs)
+{
+    for (int numOutputs : SURROUND_NUM_OUTPUTS) {
+        VectorFDN reverb(16);
+        reverb.setNumOutputs(numOutputs);
+        initReverb(reverb, 1);
+        CHECK(reverb.getNumOutputs() == numOutputs);
+
+        int burst = (int)(TEST_BURST_IN_SECONDS * TEST_SAMPLE_RATE);
+        int numSamples = burst + (int)(TEST_DECAY_IN_SECONDS * TEST_SAMPLE_RATE);
+        TestRandom random(1);
+        double products[VECTOR_FDN_MAX_OUTPUTS][VECTOR_FDN_MAX_OUTPUTS] = { { 0.0 } };
+        for (int n = 0; n < numSamples; n++) {
+            float input[2] = { 0.0, 0.0 };
+            if (n < burst) {
+                for (float& sample : input)
+                    sample = random.nextNoise(0.5f);
+            }
+            float output[VECTOR_FDN_MAX_OUTPUTS] = { 0.0 };
+            reverb.processAudio(input, output);
+            for (int i = 0; i < numOutputs; i++)
+                for (int j = i; j < numOutputs; j++)
+                    products[i][j] += (double)output[i] * output[j];
+        }
+
+        double stereoEnergy = 0.5 * (products[0][0] + products[1][1]);
+        CHECK(stereoEnergy > 0.0);
+        for (int i = 0; i < numOutputs; i++) {
+            CHECK(products[i][i] >= MIN_OUTPUT_TO_STEREO_LEVEL * stereoEnergy);
+            for (int j = i + 1; j < numOutputs; j++)
+                CHECK_NEAR(products[i][j] / sqrt(products[i][i] * products[j][j] + 1e-30), 0.0, MAX_OUTPUT_CORRELATION);
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The decimator's round trip is taken out of the delay lines: at 1/2 and 1/4 of the rate the tail
+// must line up with the full rate one, up to the delays rounded down to the tank's rate (less than
+// a frame each, where the round trip alone is 50 and 148 samples). Processing
+// sample by sample must not change a sample.
+TEST(vectorFDNDecimatedTankAddsNoLatency)
+{
+    const int numSamples = (int)(0.5 * TEST_SAMPLE_RATE);
+    vector<float> input = makeBandLimitedNoise(numSamples, numSamples / 5);
+    for (int factor : { 2, 4 }) {
+        float damping = factor == 4 ? TEST_QUARTER_RATE_DAMPING : TEST_HALF_RATE_DAMPING;
+        auto dampingAt = [damping](int) { return damping; };
+        VectorFDN full(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        full.initialize(TEST_BUFFER_IN_MS, TEST_BUFFER_IN_MS, TEST_SAMPLE_RATE);
+        full.setRoomSize(0.5);
+        full.setDecayInSeconds(1.0);
+        vector<float> reference = renderBlocks(full, input, dampingAt);
+        VectorFDN decimated(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        initMultirateReverb(decimated, damping);
+        vector<float> output = renderBlocks(decimated, input, dampingAt);
+        CHECK(full.getDecimationFactor() == 1);
+        CHECK(decimated.getDecimationFactor() == factor);
+
+        double best = 0.0;
+        int bestLag = 0;
+        for (int lag = -200; lag <= 200; lag++) {
+            double product = 0.0, energy = 0.0, referenceEnergy = 0.0;
+            for (int n = 200; n < numSamples - 200; n++) {
+                product += (double)output[n + lag] * reference[n];
+                energy += (double)output[n + lag] * output[n + lag];
+                referenceEnergy += (double)reference[n] * reference[n];
+            }
+            double correlation = product / sqrt(energy * referenceEnergy + 1e-30);
+            if (correlation > best) {
+                best = correlation;
+                bestLag = lag;
+            }
+        }
+        CHECK(abs(bestLag) <= factor);
+        CHECK(best > MIN_DECIMATED_CORRELATION);
+
+        VectorFDN sampled(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        initMultirateReverb(sampled, damping);
+        bool same = true;
+        for (int n = 0; n < numSamples; n++) {
+            float in[2] = { input[n], input[n] }, out[2];
+            sampled.processAudio(in, out);
+            same = same && out[0] == output[n];
+        }
+        CHECK(same);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A factor change hands the input to a new tank while the old one rings out, so the output must be
+// the sum of a reverb fed the signal up to the change and one fed the rest at the new factor. Both
+// directions, once the damping changes at a block start.
+TEST(vectorFDNFactorChangeIsSeamless)
+{
+    const int numSamples = (int)(1.0 * TEST_SAMPLE_RATE);
+    const int change = 96 * TEST_BLOCK_SIZE;
+    vector<float> input = makeBandLimitedNoise(numSamples, numSamples / 2);
+    vector<float> before(input), after(input);
+    fill(before.begin() + change, before.end(), 0.0f);
+    fill(after.begin(), after.begin() + change, 0.0f);
+
+    for (bool up : { false, true }) {
+        float first = up ? TEST_FULL_RATE_DAMPING : TEST_QUARTER_RATE_DAMPING;
+        float second = up ? TEST_QUARTER_RATE_DAMPING : TEST_FULL_RATE_DAMPING;
+        auto dampingAt = [first, second, change](int n) { return n < change ? first : second; };
+        VectorFDN switched(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        VectorFDN untilChange(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        VectorFDN fromChange(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+        initMultirateReverb(switched, first);
+        initMultirateReverb(untilChange, first);
+        initMultirateReverb(fromChange, second);
+        int firstFactor = switched.getDecimationFactor();
+        vector<float> output = renderBlocks(switched, input, dampingAt);
+        vector<float> sum = renderBlocks(untilChange, before, dampingAt);
+        vector<float> rest = renderBlocks(fromChange, after, [second](int) { return second; });
+        CHECK(firstFactor == (up ? 1 : 4));
+        CHECK(switched.getDecimationFactor() == (up ? 4 : 1));
+
+        double peak = 0.0, maxError = 0.0;
+        for (int n = 0; n < numSamples; n++) {
+            peak = fmax(peak, fabs(output[n]));
+            maxError = fmax(maxError, fabs(output[n] - (sum[n] + rest[n])));
+        }
+        CHECK(peak > 0.0);
+        CHECK_NEAR(maxError / peak, 0.0, MAX_SUPERPOSITION_ERROR);
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Damping automated across the factors faster than the tails ring out: every change finds the
+// other tank busy, the output must stay within the level of a full rate reverb under the same
+// automation, and the factor must follow the last value once it holds
+TEST(vectorFDNFactorFollowsAutomation)
+{
+    const int numSamples = (int)(3.0 * TEST_SAMPLE_RATE);
+    const int automation = (int)(1.5 * TEST_SAMPLE_RATE);
+    vector<float> input = makeBandLimitedNoise(numSamples, numSamples);
+    auto dampingAt = [automation](int n) {
+        if (n >= automation)
+            return (float)TEST_HALF_RATE_DAMPING;
+        int step = n / (int)(0.05 * TEST_SAMPLE_RATE);
+        return (float)(step % 3 == 0 ? TEST_QUARTER_RATE_DAMPING : (step % 3 == 1 ? TEST_FULL_RATE_DAMPING : TEST_HALF_RATE_DAMPING));
+    };
+    VectorFDN full(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+    full.initialize(TEST_BUFFER_IN_MS, TEST_BUFFER_IN_MS, TEST_SAMPLE_RATE);
+    full.setRoomSize(0.5);
+    full.setDecayInSeconds(1.0);
+    VectorFDN automated(16, FeedbackMatrixType::Householder, TEST_DIFFUSION_STEPS);
+    initMultirateReverb(automated, TEST_QUARTER_RATE_DAMPING);
+    vector<float> reference = renderBlocks(full, input, dampingAt);
+    vector<float> output = renderBlocks(automated, input, dampingAt);
+    CHECK(automated.getDecimationFactor() == 2);
+
+    double referencePeak = 0.0, peak = 0.0;
+    for (int n = 0; n < numSamples; n++) {
+        referencePeak = fmax(referencePeak, fabs(reference[n]));
+        peak = fmax(peak, fabs(output[n]));
+    }
+    CHECK(peak > 0.5 * referencePeak);
+    CHECK(peak < 1.5 * referencePeak);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Instances processed one block after the other, as a host runs a session, with room size 1 so
+// every line reads far back. Prints ns per sample and instance.
+BENCH(vectorFDNInstances)
+{
+    const int blockSize = 256;
+    const int numBlocks = (int)(2 * TEST_SAMPLE_RATE) / blockSize;
+    vector<float> input(2 * blockSize);
+    TestRandom random(1);
+    for (float& sample : input)
+        sample = random.nextNoise(0.25f);
+
+    for (int numChannels : BENCH_NUM_CHANNELS) {
+        for (int numInstances : BENCH_NUM_INSTANCES) {
+            vector<VectorFDN*> reverbs;
+            for (int i = 0; i < numInstances; i++) {
+                reverbs.push_back(new VectorFDN(numChannels));
+                initReverb(*reverbs.back(), i + 1);
+            }
+
+            // The first half fills the lines, the second is timed
+            double seconds = 0.0;
+            for (int pass = 0; pass < 2; pass++) {
+                auto start = chrono::steady_clock::now();
+                for (int b = 0; b < numBlocks; b++)
+                    for (VectorFDN* reverb : reverbs)
+                        for (int i = 0; i < blockSize; i++) {
+                            float output[2];
+                            reverb->processAudio(&input[2 * i], output);
+                        }
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+            printf("    %2d lines, %2d instances: %7.1f ns\n", numChannels, numInstances, 1e9 * seconds / ((double)numBlocks * blockSize * numInstances));
+            for (VectorFDN* reverb : reverbs)
+                delete reverb;
+        }
+    }
+}
+/*--------------------------------------------------------------------*/
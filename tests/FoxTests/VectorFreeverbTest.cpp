@@ -0,0 +1,169 @@
+//-------------------------------------------------------------------------------------------------------
+//  VectorFreeverbTest.cpp
+//  FoxVerb's Freeverb against the same reverb built from the core's scalar LPCombFilter, one comb
+//  per delay line and Jezar's allpasses written out, and a benchmark of the two.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "VectorFreeverb.h"
+#include "LPCombFilter.h"
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_DECAY_IN_SECONDS 2.0
+#define TEST_DAMPING_FREQUENCY 5000.0
+#define TEST_SMEARING 0.5
+#define TEST_SPREAD 1.0
+#define TEST_NUM_SAMPLES 48000
+
+// Freeverb's tuning at 44.1 kHz, input gain, wet scale and allpass feedback
+static const int TEST_COMB_TUNINGS[8] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+static const int TEST_ALLPASS_TUNINGS[4] = { 556, 441, 341, 225 };
+static const int TEST_STEREO_SPREAD = 23;
+static const float TEST_FIXED_GAIN = 0.015f;
+static const float TEST_SCALE_WET = 3.0f;
+static const float TEST_ALLPASS_FEEDBACK = 0.5f;
+
+/*--------------------------------------------------------------------*/
+// One channel of the reference: eight core combs on the mono input, then four allpasses
+struct ScalarFreeverbChannel {
+    LPCombFilter combs[8];
+    vector<float> allPasses[4];
+    int allPassIndex[4] = { 0, 0, 0, 0 };
+
+    ScalarFreeverbChannel(int offset)
+    {
+        for (int k = 0; k < 8; k++) {
+            combs[k].init(TEST_SAMPLE_RATE, 40.0);
+            combs[k].setDelayInMilliseconds((TEST_COMB_TUNINGS[k] + offset) * 1000.0 / 44100.0);
+            combs[k].setDecayInSeconds(TEST_DECAY_IN_SECONDS);
+            combs[k].setDampingFrequency(TEST_DAMPING_FREQUENCY);
+        }
+        for (int k = 0; k < 4; k++)
+            allPasses[k].assign((int)((TEST_ALLPASS_TUNINGS[k] + offset) * TEST_SAMPLE_RATE / 44100.0 + 0.5), 0.0f);
+    }
+
+    float processCombs(float input)
+    {
+        float output = 0.0;
+        for (LPCombFilter& comb : combs)
+            output += comb.processAudio(input);
+        return output;
+    }
+
+    float processAllPasses(float output)
+    {
+        for (int k = 0; k < 4; k++) {
+            float& delayed = allPasses[k][allPassIndex[k]];
+            float x = output;
+            output = delayed - x;
+            delayed = x + TEST_ALLPASS_FEEDBACK * delayed;
+            if (++allPassIndex[k] >= (int)allPasses[k].size())
+                allPassIndex[k] = 0;
+        }
+        return output;
+    }
+
+    float process(float input) { return processAllPasses(processCombs(input)); }
+};
+
+static void initReverb(VectorFreeverb& reverb)
+{
+    reverb.init(TEST_SAMPLE_RATE, 1.0, TEST_DECAY_IN_SECONDS, TEST_DAMPING_FREQUENCY, TEST_SMEARING, TEST_SPREAD, 0.0);
+}
+
+static vector<float> makeNoise(int numSamples, uint32_t seed)
+{
+    vector<float> noise(numSamples);
+    TestRandom random(seed);
+    for (float& sample : noise)
+        sample = random.nextNoise(0.5f);
+    return noise;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Fully wet, no pre-delay: each output must be the scaled reference channel, spread included
+TEST(vectorFreeverbMatchesScalarCombs)
+{
+    VectorFreeverb reverb;
+    initReverb(reverb);
+    ScalarFreeverbChannel left(0), right(TEST_STEREO_SPREAD);
+
+    vector<float> inputL = makeNoise(TEST_NUM_SAMPLES, 1), inputR = makeNoise(TEST_NUM_SAMPLES, 2);
+    for (int n = TEST_NUM_SAMPLES / 4; n < TEST_NUM_SAMPLES; n++)
+        inputL[n] = inputR[n] = 0.0f;
+    vector<float> outputL(TEST_NUM_SAMPLES), outputR(TEST_NUM_SAMPLES);
+    reverb.processBlock(inputL.data(), inputR.data(), outputL.data(), outputR.data(), TEST_NUM_SAMPLES);
+
+    double maxError = 0.0, peak = 0.0, differenceLR = 0.0;
+    for (int n = 0; n < TEST_NUM_SAMPLES; n++) {
+        float input = (inputL[n] + inputR[n]) * TEST_FIXED_GAIN;
+        float expectedL = TEST_SCALE_WET * left.process(input);
+        float expectedR = TEST_SCALE_WET * right.process(input);
+        maxError = fmax(maxError, fmax(fabs(outputL[n] - expectedL), fabs(outputR[n] - expectedR)));
+        peak = fmax(peak, fmax(fabs(expectedL), fabs(expectedR)));
+        differenceLR += fabs(expectedL - expectedR);
+    }
+    CHECK(differenceLR > 0.0);
+    CHECK_NEAR(maxError / peak, 0.0, 1e-4);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Mid mode: the left combs feed both channels, each through its own allpasses
+TEST(vectorFreeverbMidModeSharesLeftCombs)
+{
+    VectorFreeverb reverb;
+    initReverb(reverb);
+    reverb.setStereoMode(FreeverbStereoMode::Mid);
+    ScalarFreeverbChannel left(0), right(TEST_STEREO_SPREAD);
+
+    vector<float> inputL = makeNoise(TEST_NUM_SAMPLES, 3), inputR = makeNoise(TEST_NUM_SAMPLES, 4);
+    vector<float> outputL(TEST_NUM_SAMPLES), outputR(TEST_NUM_SAMPLES);
+    reverb.processBlock(inputL.data(), inputR.data(), outputL.data(), outputR.data(), TEST_NUM_SAMPLES);
+
+    double maxError = 0.0, peak = 0.0;
+    for (int n = 0; n < TEST_NUM_SAMPLES; n++) {
+        float combs = left.processCombs((inputL[n] + inputR[n]) * TEST_FIXED_GAIN);
+        float expectedL = TEST_SCALE_WET * left.processAllPasses(combs);
+        float expectedR = TEST_SCALE_WET * right.processAllPasses(combs);
+        maxError = fmax(maxError, fmax(fabs(outputL[n] - expectedL), fabs(outputR[n] - expectedR)));
+        peak = fmax(peak, fmax(fabs(expectedL), fabs(expectedR)));
+    }
+    CHECK_NEAR(maxError / peak, 0.0, 1e-4);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Nanoseconds per stereo sample of the block engine and of the scalar reference
+BENCH(vectorFreeverbVsScalarCombs)
+{
+    const int numSamples = 10 * (int)TEST_SAMPLE_RATE;
+    vector<float> inputL = makeNoise(numSamples, 1), inputR = makeNoise(numSamples, 2);
+    vector<float> outputL(numSamples), outputR(numSamples);
+
+    VectorFreeverb reverb;
+    initReverb(reverb);
+    auto start = chrono::steady_clock::now();
+    reverb.processBlock(inputL.data(), inputR.data(), outputL.data(), outputR.data(), numSamples);
+    double vectorSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ScalarFreeverbChannel left(0), right(TEST_STEREO_SPREAD);
+    start = chrono::steady_clock::now();
+    for (int n = 0; n < numSamples; n++) {
+        float input = (inputL[n] + inputR[n]) * TEST_FIXED_GAIN;
+        outputL[n] = left.process(input);
+        outputR[n] = right.process(input);
+    }
+    double scalarSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("    block %6.1f ns/sample, scalar %6.1f ns/sample, %.2fx\n",
+        1e9 * vectorSeconds / numSamples, 1e9 * scalarSeconds / numSamples, scalarSeconds / vectorSeconds);
+}
+/*--------------------------------------------------------------------*/
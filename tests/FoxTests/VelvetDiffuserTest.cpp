@@ -0,0 +1,183 @@
+//-------------------------------------------------------------------------------------------------------
+//  VelvetDiffuserTest.cpp
+//  The velvet diffuser's block processing, its echo density, and a benchmark against the FDN's own
+//  delay/Hadamard diffusion chain.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "FoxTest.h"
+#include "VelvetDiffuser.h"
+#include "FDN.h"
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_LENGTH_IN_MS 100.0
+#define ECHO_DENSITY_WINDOW_IN_MS 20.0
+#define MIN_ECHO_DENSITY 0.6                    // Gaussian noise measures 1
+
+// Same FDN settings as Shimmer's master reverb
+#define BENCH_FDN_CHANNELS 16
+#define BENCH_DIFFUSION_STEPS 5
+#define BENCH_BUFFER_SIZE_MS 2000.0
+#define BENCH_DECAY_IN_SECONDS 2.0
+#define BENCH_ROOM_SIZE 0.5
+#define BENCH_NUM_WINDOWS 10
+#define BENCH_WINDOW_STEP_IN_MS 50.0
+
+/*--------------------------------------------------------------------*/
+static vector<float> makeNoise(int numSamples, uint32_t seed)
+{
+    vector<float> noise(numSamples);
+    TestRandom random(seed);
+    for (float& sample : noise)
+        sample = random.nextNoise(0.25f);
+    return noise;
+}
+
+static void initDiffuser(VelvetDiffuser& diffuser)
+{
+    diffuser.init(TEST_SAMPLE_RATE);
+    diffuser.setLengthInMilliseconds(TEST_LENGTH_IN_MS);
+}
+
+// Abel and Huang's normalized echo density: the share of samples in a window standing out of its
+// standard deviation, over the share expected from Gaussian noise (erfc(1/sqrt(2)))
+static double getEchoDensity(const vector<float>& response, int start, int length)
+{
+    double energy = 0.0;
+    for (int n = start; n < start + length; n++)
+        energy += (double)response[n] * response[n];
+    double deviation = sqrt(energy / length);
+    int outliers = 0;
+    for (int n = start; n < start + length; n++)
+        outliers += fabs(response[n]) > deviation ? 1 : 0;
+    return outliers / (length * erfc(1.0 / sqrt(2.0)));
+}
+
+// Impulse response of the left channel, in blocks of MAX_VELVET_BLOCK_SIZE
+static vector<float> getImpulseResponse(VelvetDiffuser& diffuser, int numSamples)
+{
+    vector<float> inputL(numSamples, 0.0f), inputR(numSamples, 0.0f);
+    vector<float> outputL(numSamples), outputR(numSamples);
+    inputL[0] = 1.0;
+    for (int start = 0; start < numSamples; start += MAX_VELVET_BLOCK_SIZE) {
+        int blockSize = numSamples - start < MAX_VELVET_BLOCK_SIZE ? numSamples - start : MAX_VELVET_BLOCK_SIZE;
+        diffuser.processBlock(&inputL[start], &inputR[start], &outputL[start], &outputR[start], blockSize);
+    }
+    return outputL;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Taps that straddle a block edge or the history's wrap must give the same output whatever the
+// block sizes: ragged blocks against whole ones, over several wraps of the history
+TEST(velvetDiffuserIgnoresBlockSize)
+{
+    const int numSamples = 48000;
+    vector<float> inputL = makeNoise(numSamples, 1), inputR = makeNoise(numSamples, 2);
+
+    VelvetDiffuser whole, ragged;
+    initDiffuser(whole);
+    initDiffuser(ragged);
+
+    vector<float> wholeL(numSamples), wholeR(numSamples), raggedL(numSamples), raggedR(numSamples);
+    for (int start = 0; start < numSamples; start += MAX_VELVET_BLOCK_SIZE) {
+        int blockSize = numSamples - start < MAX_VELVET_BLOCK_SIZE ? numSamples - start : MAX_VELVET_BLOCK_SIZE;
+        whole.processBlock(&inputL[start], &inputR[start], &wholeL[start], &wholeR[start], blockSize);
+    }
+    TestRandom random(3);
+    for (int start = 0; start < numSamples;) {
+        int blockSize = 1 + random.next() % MAX_VELVET_BLOCK_SIZE;
+        if (blockSize > numSamples - start)
+            blockSize = numSamples - start;
+        ragged.processBlock(&inputL[start], &inputR[start], &raggedL[start], &raggedR[start], blockSize);
+        start += blockSize;
+    }
+
+    double maxError = 0.0;
+    for (int n = 0; n < numSamples; n++)
+        maxError = fmax(maxError, fmax(fabs(wholeL[n] - raggedL[n]), fabs(wholeR[n] - raggedR[n])));
+    CHECK_NEAR(maxError, 0.0, 1e-6);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Past the first stage's length the cascade must look like noise, window after window
+TEST(velvetDiffuserReachesEchoDensity)
+{
+    VelvetDiffuser diffuser;
+    initDiffuser(diffuser);
+    int window = (int)(ECHO_DENSITY_WINDOW_IN_MS * 0.001 * TEST_SAMPLE_RATE);
+    int length = (int)(TEST_LENGTH_IN_MS * 0.001 * TEST_SAMPLE_RATE);
+    vector<float> response = getImpulseResponse(diffuser, length);
+
+    for (int start = length / 4; start + window <= length; start += window / 2)
+        CHECK(getEchoDensity(response, start, window) >= MIN_ECHO_DENSITY);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// A fresh FDN set up like Shimmer's master reverb, with its diffusion steps or with a velvet
+// diffuser in front instead. Returns the seconds spent processing.
+static double runReverb(bool velvet, const vector<float>& inputL, const vector<float>& inputR, vector<float>& outputL)
+{
+    FDN reverb(2, BENCH_FDN_CHANNELS, 2, velvet ? 0 : BENCH_DIFFUSION_STEPS, 1);
+    reverb.initialize(BENCH_BUFFER_SIZE_MS, BENCH_BUFFER_SIZE_MS, TEST_SAMPLE_RATE);
+    reverb.setRoomSize(BENCH_ROOM_SIZE, DiffuserDelayLogic::Doubled, DelayDistribution::Uniform, DelayDistribution::Uniform);
+    reverb.setDecayInSeconds(BENCH_DECAY_IN_SECONDS);
+    VelvetDiffuser diffuser;
+    initDiffuser(diffuser);
+
+    int numSamples = (int)inputL.size();
+    outputL.resize(numSamples);
+    auto start = chrono::steady_clock::now();
+    for (int block = 0; block < numSamples; block += MAX_VELVET_BLOCK_SIZE) {
+        int blockSize = numSamples - block < MAX_VELVET_BLOCK_SIZE ? numSamples - block : MAX_VELVET_BLOCK_SIZE;
+        float diffusedL[MAX_VELVET_BLOCK_SIZE], diffusedR[MAX_VELVET_BLOCK_SIZE];
+        const float* inL = &inputL[block];
+        const float* inR = &inputR[block];
+        if (velvet) {
+            diffuser.processBlock(inL, inR, diffusedL, diffusedR, blockSize);
+            inL = diffusedL;
+            inR = diffusedR;
+        }
+        for (int i = 0; i < blockSize; i++) {
+            float in[2] = { inL[i], inR[i] };
+            float out[2] = { 0.0, 0.0 };
+            reverb.processAudio(in, out);
+            outputL[block + i] = out[0];
+        }
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// What the plugins choose between with DIFFUSION_ENGINE. Prints the echo density of both impulse
+// responses every BENCH_WINDOW_STEP_IN_MS over the first half second, and the time each takes on
+// 10 s of stereo noise.
+BENCH(velvetDiffuserVsDiffusionChain)
+{
+    const int numSamples = 10 * (int)TEST_SAMPLE_RATE;
+    int window = (int)(ECHO_DENSITY_WINDOW_IN_MS * 0.001 * TEST_SAMPLE_RATE);
+    int step = (int)(BENCH_WINDOW_STEP_IN_MS * 0.001 * TEST_SAMPLE_RATE);
+    vector<float> impulse(numSamples, 0.0f), silence(numSamples, 0.0f);
+    impulse[0] = 1.0;
+    vector<float> noiseL = makeNoise(numSamples, 1), noiseR = makeNoise(numSamples, 2);
+
+    for (int velvet = 0; velvet < 2; velvet++) {
+        const char* name = velvet ? "velvet" : "chain ";
+        vector<float> output;
+        runReverb(velvet != 0, impulse, silence, output);
+        printf("    %s echo density:", name);
+        for (int w = 0; w < BENCH_NUM_WINDOWS; w++)
+            printf(" %.2f", getEchoDensity(output, w * step, window));
+        double seconds = runReverb(velvet != 0, noiseL, noiseR, output);
+        printf(", %6.1f ns/sample\n", 1e9 * seconds / numSamples);
+    }
+}
+/*--------------------------------------------------------------------*/
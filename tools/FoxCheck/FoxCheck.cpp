@@ -0,0 +1,510 @@
+//-------------------------------------------------------------------------------------------------------
+//  FoxCheck.cpp
+//  Checks and benchmarks run against a built plugin through its VST 2.4 entry point, so they cover
+//  the same binary a host loads, core library included.
+//
+//  FoxCheck <plugin library> bench [-r rate] [-s seconds] [-b size,size,...]
+//      Per-block processing time at each host block size: mean and peak share of the block's
+//      real-time budget. The peak is what decides dropouts.
+//
+//  FoxCheck <plugin library> realtime [-r rate] [-b size,size,...]
+//      Every program, then every parameter stepped across its range, set between blocks the way
+//      a host automates them, then a sweep of sample rates up to 192 kHz set between blocks without
+//      suspending, as some hosts do around transport start. setProgram, setParameter,
+//      setSampleRate and processReplacing run inside a RealtimeScope; any allocation, lock or
+//      blocking call in them is reported with a backtrace.
+//      Needs a Linux build with FOX_REALTIME_CHECK, linked with -rdynamic so the loaded plugin
+//      binds to FoxCheck's interposed calls.
+//
+//  FoxCheck <plugin library> replay [-r rate] [-b size,size,...]
+//      Drives a plugin built with FOX_CAPTURE through a host session (block sizes changing within
+//      and across the given ones, automation between blocks, a program load, a restored delay
+//      seed, a rate change and suspend/resume with and without release on suspend) while it
+//      captures itself, then replays the capture into a new instance. The replay must be bit-exact;
+//      on a mismatch the capture is kept for FoxReplay.
+//
+//  FoxCheck <plugin library> state [-r rate]
+//      Sets every parameter to a random value, saves the state with getChunk and restores it with
+//      setChunk into a new instance, which must report the same parameter values. The same values
+//      written as a VST parameter program, the way sessions saved before programsAreChunks hold
+//      them, must load too.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "PluginHost.h"
+#include "RealtimeCheck.h"
+#include "CaptureReplay.h"
+#include "StateChunk.h"
+
+using namespace std;
+
+#define CHECK_DEFAULT_SAMPLE_RATE 48000.0
+#define BENCH_DEFAULT_SECONDS 10.0
+#define BENCH_WARMUP_SECONDS 1.0
+#define BENCH_NOISE_LEVEL 0.25
+#define REALTIME_PARAMETER_STEPS 16     // values per parameter, 0 and 1 included
+#define REALTIME_BLOCKS_PER_STEP 2      // one block applies the change, the next runs with it
+#define REPLAY_CAPTURE_PATH "FoxCheck-replay.foxcap"
+#define REPLAY_BLOCKS_PER_SIZE 24
+#define REPLAY_SEED 0x5eed1234u
+#define STATE_ROUNDS 8
+#define STATE_TOLERANCE 1e-5            // normalized values go through the plugin's own units
+#define STATE_FX_PROGRAM_HEADER_SIZE 56
+
+static const int BENCH_DEFAULT_BLOCK_SIZES[] = { 64, 128, 256, 512, 1024, 1500, 2048, 4096 };
+// Rates of the realtime sweep, within the MAX_SUPPORTED_SAMPLE_RATE the plugins reserve for
+static const float REALTIME_SWEEP_SAMPLE_RATES[] = { 44100, 22050, 48000, 88200, 96000, 176400, 192000, 8000 };
+
+/*--------------------------------------------------------------------*/
+struct CheckOptions {
+    float sampleRate;
+    double seconds;
+    vector<int> blockSizes;
+};
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Planar buffers for one instance, filled with deterministic noise
+struct CheckBuffers {
+    vector<vector<float>> inputs, outputs;
+    vector<float*> inputPointers, outputPointers;
+
+    CheckBuffers(int numInputs, int numOutputs, int numFrames, uint32_t seed = 1)
+        : inputs(numInputs, vector<float>(numFrames)), outputs(numOutputs, vector<float>(numFrames))
+    {
+        for (vector<float>& channel : inputs)
+            for (float& sample : channel) {
+                seed = seed * 1664525u + 1013904223u;
+                sample = BENCH_NOISE_LEVEL * ((seed >> 8) * (2.0f / 16777216.0f) - 1.0f);
+            }
+        for (vector<float>& channel : inputs)
+            inputPointers.push_back(channel.data());
+        for (vector<float>& channel : outputs)
+            outputPointers.push_back(channel.data());
+    }
+};
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  BENCH  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+static int runBench(PluginLibrary& library, const CheckOptions& options)
+{
+    printf("%10s %10s %10s %10s %10s\n", "block", "mean load", "p99 load", "peak load", "peak/mean");
+    for (int blockSize : options.blockSizes) {
+        PluginInstance plugin;
+        if (!plugin.open(library, options.sampleRate, blockSize)) {
+            fprintf(stderr, "cannot create a plugin instance\n");
+            return 1;
+        }
+        CheckBuffers buffers(plugin.getNumInputs(), plugin.getNumOutputs(), blockSize);
+        int numWarmup = (int)(BENCH_WARMUP_SECONDS * options.sampleRate / blockSize);
+        int numBlocks = (int)(options.seconds * options.sampleRate / blockSize);
+        double budget = blockSize / options.sampleRate;
+
+        vector<double> loads;
+        loads.reserve(numBlocks);
+        for (int b = 0; b < numWarmup + numBlocks; b++) {
+            auto start = chrono::steady_clock::now();
+            plugin.process(buffers.inputPointers.data(), buffers.outputPointers.data(), blockSize);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (b >= numWarmup)
+                loads.push_back(seconds / budget);
+        }
+
+        double mean = 0.0;
+        for (double load : loads)
+            mean += load;
+        mean /= loads.size();
+        sort(loads.begin(), loads.end());
+        double p99 = loads[(size_t)(0.99 * (loads.size() - 1))];
+        double peak = loads.back();
+        printf("%10d %9.2f%% %9.2f%% %9.2f%% %10.2f\n", blockSize, 100.0 * mean, 100.0 * p99, 100.0 * peak, peak / mean);
+    }
+    return 0;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  REALTIME  -------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+// The calls a host makes from its audio thread, each in its own scope
+static void processInScope(PluginInstance& plugin, CheckBuffers& buffers, int blockSize)
+{
+    RealtimeScope scope("host processReplacing");
+    plugin.process(buffers.inputPointers.data(), buffers.outputPointers.data(), blockSize);
+}
+
+static void setParameterInScope(PluginInstance& plugin, int index, float value)
+{
+    RealtimeScope scope("host setParameter");
+    plugin.setParameter(index, value);
+}
+
+static void setProgramInScope(PluginInstance& plugin, int program)
+{
+    RealtimeScope scope("host setProgram");
+    plugin.setProgram(program);
+}
+
+static void setSampleRateInScope(PluginInstance& plugin, float sampleRate)
+{
+    RealtimeScope scope("host setSampleRate");
+    plugin.setSampleRate(sampleRate);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Violations of one part of the run, printed as they are counted
+static int countViolations(int blockSize, const char* call, int index)
+{
+    int count = getRealtimeViolationCount();
+    resetRealtimeViolationCount();
+    if (count > 0)
+        printf("%10d %16s %6d %10d\n", blockSize, call, index, count);
+    return count;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static int runRealtime(PluginLibrary& library, const CheckOptions& options)
+{
+#ifndef REALTIME_CHECK_ENABLED
+    fprintf(stderr, "realtime needs FoxCheck built with FOX_REALTIME_CHECK on Linux\n");
+    return 1;
+#else
+    printf("%10s %16s %6s %10s\n", "block", "call", "index", "violations");
+    int total = 0;
+    for (int blockSize : options.blockSizes) {
+        // opening and resuming may allocate: only what follows is checked
+        PluginInstance plugin;
+        if (!plugin.open(library, options.sampleRate, blockSize)) {
+            fprintf(stderr, "cannot create a plugin instance\n");
+            return 1;
+        }
+        CheckBuffers buffers(plugin.getNumInputs(), plugin.getNumOutputs(), blockSize);
+        processInScope(plugin, buffers, blockSize);
+        resetRealtimeViolationCount();
+
+        for (int program = 0; program < plugin.getNumPrograms(); program++) {
+            setProgramInScope(plugin, program);
+            for (int b = 0; b < REALTIME_BLOCKS_PER_STEP; b++)
+                processInScope(plugin, buffers, blockSize);
+            total += countViolations(blockSize, "setProgram", program);
+        }
+
+        for (int p = 0; p < plugin.getNumParameters(); p++) {
+            float initialValue = plugin.getParameter(p);
+            for (int step = 0; step < REALTIME_PARAMETER_STEPS; step++) {
+                setParameterInScope(plugin, p, step / (float)(REALTIME_PARAMETER_STEPS - 1));
+                for (int b = 0; b < REALTIME_BLOCKS_PER_STEP; b++)
+                    processInScope(plugin, buffers, blockSize);
+            }
+            setParameterInScope(plugin, p, initialValue);
+            processInScope(plugin, buffers, blockSize);
+            total += countViolations(blockSize, "setParameter", p);
+        }
+
+        // back to the session's rate last
+        int numRates = sizeof(REALTIME_SWEEP_SAMPLE_RATES) / sizeof(REALTIME_SWEEP_SAMPLE_RATES[0]);
+        for (int r = 0; r <= numRates; r++) {
+            float sampleRate = r < numRates ? REALTIME_SWEEP_SAMPLE_RATES[r] : (float)options.sampleRate;
+            setSampleRateInScope(plugin, sampleRate);
+            for (int b = 0; b < REALTIME_BLOCKS_PER_STEP; b++)
+                processInScope(plugin, buffers, blockSize);
+            total += countViolations(blockSize, "setSampleRate", (int)sampleRate);
+        }
+    }
+    printf("%d violations\n", total);
+    return total > 0 ? 1 : 0;
+#endif
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  REPLAY  ---------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+// Blocks at and below each size, the parameters automated in turn between them
+static void runSessionBlocks(PluginInstance& plugin, const CheckOptions& options, vector<float>& parameters, uint32_t& seed)
+{
+    int maxBlockSize = *max_element(options.blockSizes.begin(), options.blockSizes.end());
+    CheckBuffers buffers(plugin.getNumInputs(), plugin.getNumOutputs(), maxBlockSize, seed);
+    for (int blockSize : options.blockSizes)
+        for (int b = 0; b < REPLAY_BLOCKS_PER_SIZE; b++) {
+            seed = seed * 1664525u + 1013904223u;
+            if (b % 3 == 0) {
+                int index = (seed >> 8) % plugin.getNumParameters();
+                parameters[index] = (seed >> 16) / 65535.0f;
+                plugin.setParameter(index, parameters[index]);
+            }
+            int numFrames = b % 4 == 3 ? 1 + (int)((seed >> 4) % blockSize) : blockSize;
+            plugin.process(buffers.inputPointers.data(), buffers.outputPointers.data(), numFrames);
+        }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The capture is written by the plugin itself, as it would be in a host
+static bool captureSession(PluginLibrary& library, const CheckOptions& options)
+{
+#ifdef _WIN32
+    _putenv("FOX_CAPTURE_PATH=" REPLAY_CAPTURE_PATH);
+#else
+    setenv("FOX_CAPTURE_PATH", REPLAY_CAPTURE_PATH, 1);
+#endif
+    remove(REPLAY_CAPTURE_PATH);
+
+    PluginInstance plugin;
+    bool created = plugin.create(library);
+#ifdef _WIN32
+    _putenv("FOX_CAPTURE_PATH=");
+#else
+    unsetenv("FOX_CAPTURE_PATH");
+#endif
+    if (!created)
+        return false;
+
+    vector<float> parameters(plugin.getNumParameters());
+    for (int p = 0; p < plugin.getNumParameters(); p++)
+        parameters[p] = plugin.getParameter(p);
+    uint32_t seed = 1;
+
+    int maxBlockSize = *max_element(options.blockSizes.begin(), options.blockSizes.end());
+    plugin.setSampleRate(options.sampleRate);
+    plugin.setBlockSize(maxBlockSize);
+    plugin.resume();
+    runSessionBlocks(plugin, options, parameters, seed);
+
+    // a program load, bracketed like hosts do
+    if (plugin.getNumPrograms() > 1) {
+        plugin.beginSetProgram();
+        plugin.setProgram(1);
+        plugin.endSetProgram();
+        for (int p = 0; p < plugin.getNumParameters(); p++)
+            parameters[p] = plugin.getParameter(p);
+    }
+    runSessionBlocks(plugin, options, parameters, seed);
+
+    // a session restored with another delay set
+    if (setStateSeed(plugin, 0, REPLAY_SEED, parameters.data()))
+        runSessionBlocks(plugin, options, parameters, seed);
+
+    plugin.setSampleRate(2.0f * options.sampleRate);
+    runSessionBlocks(plugin, options, parameters, seed);
+
+    plugin.reset();
+    runSessionBlocks(plugin, options, parameters, seed);
+
+    if (plugin.setReleaseOnSuspend(true)) {
+        plugin.reset();
+        runSessionBlocks(plugin, options, parameters, seed);
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static int runReplay(PluginLibrary& library, const CheckOptions& options)
+{
+    if (!captureSession(library, options)) {
+        fprintf(stderr, "cannot create a plugin instance\n");
+        return 1;
+    }
+
+    CaptureReplay replay;
+    if (!replay.open(REPLAY_CAPTURE_PATH)) {
+        fprintf(stderr, "no capture written: replay needs a plugin built with FOX_CAPTURE\n");
+        return 1;
+    }
+    ReplayResult result;
+    if (!replay.run(library, nullptr, &result)) {
+        fprintf(stderr, "the capture does not match the plugin\n");
+        return 1;
+    }
+    replay.close();
+
+    printf("%llu blocks, %llu samples replayed\n", (unsigned long long)result.numBlocks, (unsigned long long)result.numSamples);
+    if (result.truncated || !result.complete)
+        printf("capture incomplete, replayed up to sample %llu\n", (unsigned long long)result.numSamples);
+    if (!result.isBitExact() || result.truncated) {
+        if (result.numMismatches > 0)
+            printf("output: %llu blocks differ, first at sample %llu, max difference %g\n", (unsigned long long)result.numMismatches,
+                (unsigned long long)result.firstMismatch, result.maxDifference);
+        printf("capture kept in %s\n", REPLAY_CAPTURE_PATH);
+        return 1;
+    }
+    printf("output: bit-exact\n");
+    remove(REPLAY_CAPTURE_PATH);
+    return 0;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  STATE  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+static void appendBigEndian(vector<uint8_t>& data, int32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        data.push_back((uint8_t)((uint32_t)value >> shift));
+}
+
+// A regular 'FxCk' program, as vstfxstore.h lays it out
+static vector<uint8_t> makeFxProgram(int32_t uniqueID, const vector<float>& parameters)
+{
+    vector<uint8_t> data;
+    data.insert(data.end(), { 'C', 'c', 'n', 'K' });
+    appendBigEndian(data, (int32_t)(STATE_FX_PROGRAM_HEADER_SIZE - 8 + parameters.size() * sizeof(float)));
+    data.insert(data.end(), { 'F', 'x', 'C', 'k' });
+    appendBigEndian(data, 1);
+    appendBigEndian(data, uniqueID);
+    appendBigEndian(data, 1);
+    appendBigEndian(data, (int32_t)parameters.size());
+    data.resize(STATE_FX_PROGRAM_HEADER_SIZE, 0);
+    for (float value : parameters) {
+        int32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        appendBigEndian(data, bits);
+    }
+    return data;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Number of parameters that differ from the expected values, each one printed
+static int compareParameters(PluginInstance& plugin, const vector<float>& expected, const char* what)
+{
+    int numDifferent = 0;
+    for (int p = 0; p < plugin.getNumParameters(); p++)
+        if (!(fabs(plugin.getParameter(p) - expected[p]) <= STATE_TOLERANCE)) {
+            printf("%s: parameter %d is %g, saved %g\n", what, p, plugin.getParameter(p), expected[p]);
+            numDifferent++;
+        }
+    return numDifferent;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static int runState(PluginLibrary& library, const CheckOptions& options)
+{
+    PluginInstance saved;
+    if (!saved.open(library, options.sampleRate, options.blockSizes[0])) {
+        fprintf(stderr, "cannot create a plugin instance\n");
+        return 1;
+    }
+    CheckBuffers buffers(saved.getNumInputs(), saved.getNumOutputs(), options.blockSizes[0]);
+    vector<float> parameters(saved.getNumParameters());
+    uint32_t seed = 1;
+    int numFailures = 0;
+
+    for (int round = 0; round < STATE_ROUNDS; round++) {
+        for (int p = 0; p < saved.getNumParameters(); p++) {
+            seed = seed * 1664525u + 1013904223u;
+            saved.setParameter(p, (seed >> 8) * (1.0f / 16777216.0f));
+        }
+        saved.process(buffers.inputPointers.data(), buffers.outputPointers.data(), options.blockSizes[0]);
+        for (int p = 0; p < saved.getNumParameters(); p++)
+            parameters[p] = saved.getParameter(p);
+
+        void* data;
+        int size = saved.getChunk(&data);
+        if (size <= 0) {
+            fprintf(stderr, "the plugin does not save its state in chunks\n");
+            return 1;
+        }
+        vector<uint8_t> chunk((uint8_t*)data, (uint8_t*)data + size);
+
+        PluginInstance restored;
+        restored.open(library, options.sampleRate, options.blockSizes[0]);
+        if (!restored.setChunk(chunk.data(), (int)chunk.size())) {
+            printf("round %d: setChunk refused the chunk getChunk wrote\n", round);
+            numFailures++;
+        }
+        else
+            numFailures += compareParameters(restored, parameters, "chunk") > 0 ? 1 : 0;
+
+        PluginInstance legacy;
+        legacy.open(library, options.sampleRate, options.blockSizes[0]);
+        vector<uint8_t> program = makeFxProgram(saved.getUniqueID(), parameters);
+        if (!legacy.setChunk(program.data(), (int)program.size())) {
+            printf("round %d: setChunk refused a parameter program\n", round);
+            numFailures++;
+        }
+        else
+            numFailures += compareParameters(legacy, parameters, "parameter program") > 0 ? 1 : 0;
+    }
+
+    printf("%d rounds, %d failed\n", STATE_ROUNDS, numFailures);
+    return numFailures > 0 ? 1 : 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static void printUsage()
+{
+    fprintf(stderr, "usage: FoxCheck <plugin library> bench [-r rate] [-s seconds] [-b size,size,...]\n");
+    fprintf(stderr, "       FoxCheck <plugin library> realtime [-r rate] [-b size,size,...]\n");
+    fprintf(stderr, "       FoxCheck <plugin library> replay [-r rate] [-b size,size,...]\n");
+    fprintf(stderr, "       FoxCheck <plugin library> state [-r rate]\n");
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    CheckOptions options;
+    options.sampleRate = CHECK_DEFAULT_SAMPLE_RATE;
+    options.seconds = BENCH_DEFAULT_SECONDS;
+    options.blockSizes.assign(begin(BENCH_DEFAULT_BLOCK_SIZES), end(BENCH_DEFAULT_BLOCK_SIZES));
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "-r") == 0 && a + 1 < argc)
+            options.sampleRate = (float)atof(argv[++a]);
+        else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+            options.seconds = atof(argv[++a]);
+        else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc) {
+            options.blockSizes.clear();
+            for (char* size = strtok(argv[++a], ","); size != nullptr; size = strtok(nullptr, ","))
+                if (atoi(size) > 0)
+                    options.blockSizes.push_back(atoi(size));
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    PluginLibrary library;
+    if (!library.open(argv[1])) {
+        fprintf(stderr, "cannot load plugin %s\n", argv[1]);
+        return 1;
+    }
+
+    string check = argv[2];
+    if (check == "bench")
+        return runBench(library, options);
+    if (check == "realtime")
+        return runRealtime(library, options);
+    if (check == "replay")
+        return runReplay(library, options);
+    if (check == "state")
+        return runState(library, options);
+    printUsage();
+    return 1;
+}
+/*--------------------------------------------------------------------*/
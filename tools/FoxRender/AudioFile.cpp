@@ -0,0 +1,512 @@
+//-------------------------------------------------------------------------------------------------------
+//  AudioFile.cpp
+//  Streaming audio file I/O for the offline tools.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "AudioFile.h"
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_HEADER_SIZE 44
+#define INT24_SCALE (1.0 / 8388608.0)
+
+/*--------------------------------------------------------------------*/
+// WAV fields are little endian whatever the host is
+static uint32_t readLE(const uint8_t* bytes, int numBytes)
+{
+    uint32_t value = 0;
+    for (int b = numBytes - 1; b >= 0; b--)
+        value = (value << 8) | bytes[b];
+    return value;
+}
+
+static void writeLE(uint8_t* bytes, uint32_t value, int numBytes)
+{
+    for (int b = 0; b < numBytes; b++)
+        bytes[b] = (uint8_t)(value >> (8 * b));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static int getBytesPerSample(SampleFormat format)
+{
+    switch (format) {
+    case SampleFormat::Int16:
+        return 2;
+    case SampleFormat::Int24:
+        return 3;
+    default:
+        return 4;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  MAPPED FILE  -----------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = nullptr;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    _granularity = info.dwAllocationGranularity;
+#else
+    _file = -1;
+    _granularity = sysconf(_SC_PAGESIZE);
+#endif
+    _size = 0;
+    _window = nullptr;
+    _windowOffset = 0;
+    _windowLength = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+MappedFile::~MappedFile()
+{
+    close();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool MappedFile::open(const char* path)
+{
+    close();
+#ifdef _WIN32
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    _size = size.QuadPart;
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr) {
+        close();
+        return false;
+    }
+#else
+    _file = ::open(path, O_RDONLY);
+    if (_file < 0)
+        return false;
+    struct stat info;
+    if (fstat(_file, &info) != 0 || info.st_size == 0) {
+        close();
+        return false;
+    }
+    _size = info.st_size;
+#endif
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void MappedFile::unmapWindow()
+{
+    if (_window != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(_window);
+#else
+        munmap((void*)_window, _windowLength);
+#endif
+    }
+    _window = nullptr;
+    _windowLength = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void MappedFile::close()
+{
+    unmapWindow();
+#ifdef _WIN32
+    if (_mapping != nullptr)
+        CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+#else
+    if (_file >= 0)
+        ::close(_file);
+    _file = -1;
+#endif
+    _size = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Windows start on a granularity boundary and span at least MAPPED_WINDOW_SIZE bytes, so a
+// sequential reader remaps once per window and only a window's worth of the file is resident
+const uint8_t* MappedFile::map(int64_t offset, size_t length)
+{
+    if (offset < 0 || offset + (int64_t)length > _size)
+        return nullptr;
+    if (_window != nullptr && offset >= _windowOffset && offset + (int64_t)length <= _windowOffset + (int64_t)_windowLength)
+        return _window + (offset - _windowOffset);
+
+    unmapWindow();
+    int64_t start = offset - offset % _granularity;
+    int64_t end = offset + (int64_t)length;
+    if (end - start < MAPPED_WINDOW_SIZE)
+        end = start + MAPPED_WINDOW_SIZE;
+    if (end > _size)
+        end = _size;
+    size_t windowLength = (size_t)(end - start);
+
+#ifdef _WIN32
+    void* window = MapViewOfFile(_mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)(start & 0xFFFFFFFF), windowLength);
+    if (window == nullptr)
+        return nullptr;
+#else
+    void* window = mmap(nullptr, windowLength, PROT_READ, MAP_PRIVATE, _file, (off_t)start);
+    if (window == MAP_FAILED)
+        return nullptr;
+    madvise(window, windowLength, MADV_SEQUENTIAL);
+#endif
+    _window = (const uint8_t*)window;
+    _windowOffset = start;
+    _windowLength = windowLength;
+    return _window + (offset - _windowOffset);
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  READER  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+AudioFileReader::AudioFileReader()
+{
+    _format = SampleFormat::Float32;
+    _numChannels = 0;
+    _bytesPerSample = 4;
+    _sampleRate = 0.0;
+    _dataOffset = 0;
+    _numFrames = 0;
+    _position = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool AudioFileReader::openWav(const char* path)
+{
+    close();
+    if (!_file.open(path) || !parseWavHeader()) {
+        close();
+        return false;
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool AudioFileReader::openRaw(const char* path, const RawFormat& format)
+{
+    close();
+    if (format.numChannels <= 0 || !_file.open(path))
+        return false;
+    _format = format.format;
+    _numChannels = format.numChannels;
+    _bytesPerSample = getBytesPerSample(_format);
+    _sampleRate = format.sampleRate;
+    _dataOffset = 0;
+    _numFrames = _file.getSize() / (_numChannels * _bytesPerSample);
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Walk the RIFF chunks up to "data", picking up the format on the way. A data size that does not
+// fit the file (streamed or > 4 GB recordings) is clamped to what is actually there.
+bool AudioFileReader::parseWavHeader()
+{
+    const uint8_t* riff = _file.map(0, 12);
+    if (riff == nullptr || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        return false;
+
+    bool hasFormat = false;
+    int64_t offset = 12;
+    const uint8_t* chunk;
+    while ((chunk = _file.map(offset, 8)) != nullptr) {
+        uint32_t chunkSize = readLE(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+            const uint8_t* format = _file.map(offset + 8, chunkSize);
+            if (format == nullptr)
+                return false;
+            uint32_t tag = readLE(format, 2);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26)
+                tag = readLE(format + 24, 2);
+            _numChannels = readLE(format + 2, 2);
+            _sampleRate = (float)readLE(format + 4, 4);
+            int bitsPerSample = readLE(format + 14, 2);
+            hasFormat = true;
+            if (tag == WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32)
+                _format = SampleFormat::Float32;
+            else if (tag == WAVE_FORMAT_PCM && bitsPerSample == 16)
+                _format = SampleFormat::Int16;
+            else if (tag == WAVE_FORMAT_PCM && bitsPerSample == 24)
+                _format = SampleFormat::Int24;
+            else if (tag == WAVE_FORMAT_PCM && bitsPerSample == 32)
+                _format = SampleFormat::Int32;
+            else
+                hasFormat = false;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (!hasFormat || _numChannels <= 0)
+                return false;
+            _bytesPerSample = getBytesPerSample(_format);
+            _dataOffset = offset + 8;
+            int64_t dataSize = _file.getSize() - _dataOffset;
+            if (chunkSize < dataSize)
+                dataSize = chunkSize;
+            _numFrames = dataSize / (_numChannels * _bytesPerSample);
+            return true;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void AudioFileReader::close()
+{
+    _file.close();
+    _numChannels = 0;
+    _numFrames = 0;
+    _position = 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int AudioFileReader::read(float** destinations, int numDestinations, int numFrames)
+{
+    if (numFrames > _numFrames - _position)
+        numFrames = (int)(_numFrames - _position);
+    if (numFrames <= 0)
+        return 0;
+
+    int frameBytes = _numChannels * _bytesPerSample;
+    const uint8_t* data = _file.map(_dataOffset + _position * frameBytes, (size_t)numFrames * frameBytes);
+    if (data == nullptr)
+        return 0;
+    _position += numFrames;
+
+    for (int d = 0; d < numDestinations; d++) {
+        int channel = d < _numChannels ? d : _numChannels - 1;
+        const uint8_t* bytes = data + channel * _bytesPerSample;
+        float* destination = destinations[d];
+        switch (_format) {
+        case SampleFormat::Float32:
+            for (int i = 0; i < numFrames; i++, bytes += frameBytes)
+                memcpy(destination + i, bytes, sizeof(float));
+            break;
+        case SampleFormat::Int16:
+            for (int i = 0; i < numFrames; i++, bytes += frameBytes)
+                destination[i] = (int16_t)(bytes[0] | (bytes[1] << 8)) * (float)(1.0 / 32768.0);
+            break;
+        case SampleFormat::Int24:
+            // Assemble in the top three bytes so the shift back sign-extends
+            for (int i = 0; i < numFrames; i++, bytes += frameBytes)
+                destination[i] = (((int32_t)((uint32_t)bytes[0] << 8 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 24)) >> 8) * (float)INT24_SCALE;
+            break;
+        case SampleFormat::Int32:
+            for (int i = 0; i < numFrames; i++, bytes += frameBytes)
+                destination[i] = (int32_t)readLE(bytes, 4) * (float)(1.0 / 2147483648.0);
+            break;
+        }
+    }
+    return numFrames;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  WRITER  ----------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+AudioFileWriter::AudioFileWriter()
+{
+    _file = nullptr;
+    _isWav = true;
+    _failed = false;
+    _numChannels = 0;
+    _numFrames = 0;
+    _currentBuffer = -1;
+    _closing = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+AudioFileWriter::~AudioFileWriter()
+{
+    close();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool AudioFileWriter::open(const char* path, int numChannels, float sampleRate, bool asRaw)
+{
+    close();
+    _file = fopen(path, "wb");
+    if (_file == nullptr)
+        return false;
+    _isWav = !asRaw;
+    _failed = false;
+    _numChannels = numChannels;
+    _numFrames = 0;
+
+    // Sizes are patched by close()
+    if (_isWav) {
+        uint8_t header[WAV_HEADER_SIZE];
+        memcpy(header, "RIFF", 4);
+        writeLE(header + 4, 0, 4);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        writeLE(header + 16, 16, 4);
+        writeLE(header + 20, WAVE_FORMAT_IEEE_FLOAT, 2);
+        writeLE(header + 22, numChannels, 2);
+        writeLE(header + 24, (uint32_t)sampleRate, 4);
+        writeLE(header + 28, (uint32_t)sampleRate * numChannels * sizeof(float), 4);
+        writeLE(header + 32, numChannels * sizeof(float), 2);
+        writeLE(header + 34, 32, 2);
+        memcpy(header + 36, "data", 4);
+        writeLE(header + 40, 0, 4);
+        _failed = fwrite(header, 1, WAV_HEADER_SIZE, _file) != WAV_HEADER_SIZE;
+    }
+
+    _buffers.assign(WRITER_NUM_BUFFERS, std::vector<float>((size_t)WRITER_BUFFER_FRAMES * numChannels));
+    _bufferFrames.assign(WRITER_NUM_BUFFERS, 0);
+    _freeBuffers.clear();
+    _fullBuffers.clear();
+    for (int b = 0; b < WRITER_NUM_BUFFERS; b++)
+        _freeBuffers.push_back(b);
+    _currentBuffer = -1;
+    _closing = false;
+    _flushThread = std::thread(&AudioFileWriter::flushLoop, this);
+    return !_failed;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void AudioFileWriter::flushLoop()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    while (true) {
+        _changed.wait(guard, [this]() { return !_fullBuffers.empty() || _closing; });
+        if (_fullBuffers.empty())
+            return;
+        int buffer = _fullBuffers.front();
+        _fullBuffers.pop_front();
+
+        guard.unlock();
+        size_t numSamples = (size_t)_bufferFrames[buffer] * _numChannels;
+        bool failed = fwrite(_buffers[buffer].data(), sizeof(float), numSamples, _file) != numSamples;
+        guard.lock();
+
+        _failed = _failed || failed;
+        _freeBuffers.push_back(buffer);
+        _changed.notify_all();
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Caller holds _lock
+void AudioFileWriter::submitCurrent()
+{
+    _fullBuffers.push_back(_currentBuffer);
+    _currentBuffer = -1;
+    _changed.notify_all();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool AudioFileWriter::write(float** sources, int numFrames)
+{
+    if (_file == nullptr)
+        return false;
+
+    int written = 0;
+    while (written < numFrames) {
+        std::unique_lock<std::mutex> guard(_lock);
+        if (_currentBuffer < 0) {
+            _changed.wait(guard, [this]() { return !_freeBuffers.empty(); });
+            _currentBuffer = _freeBuffers.front();
+            _freeBuffers.pop_front();
+            _bufferFrames[_currentBuffer] = 0;
+        }
+        if (_failed)
+            return false;
+        guard.unlock();
+
+        // Only this thread touches the current buffer, so it is filled without the lock
+        int offset = _bufferFrames[_currentBuffer];
+        int count = WRITER_BUFFER_FRAMES - offset;
+        if (count > numFrames - written)
+            count = numFrames - written;
+        float* buffer = _buffers[_currentBuffer].data() + (size_t)offset * _numChannels;
+        for (int c = 0; c < _numChannels; c++) {
+            const float* source = sources[c] + written;
+            for (int i = 0; i < count; i++)
+                buffer[(size_t)i * _numChannels + c] = source[i];
+        }
+        _bufferFrames[_currentBuffer] += count;
+        written += count;
+
+        if (_bufferFrames[_currentBuffer] == WRITER_BUFFER_FRAMES) {
+            guard.lock();
+            submitCurrent();
+        }
+    }
+    _numFrames += numFrames;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool AudioFileWriter::close()
+{
+    if (_file == nullptr)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_currentBuffer >= 0)
+            submitCurrent();
+        _closing = true;
+        _changed.notify_all();
+    }
+    _flushThread.join();
+
+    // A WAV data chunk cannot describe more than 4 GB; readers clamp to the file size
+    if (_isWav) {
+        int64_t dataSize = _numFrames * _numChannels * sizeof(float);
+        uint32_t chunkSize = dataSize > 0xFFFFFFFF - WAV_HEADER_SIZE ? 0xFFFFFFFF - WAV_HEADER_SIZE : (uint32_t)dataSize;
+        uint8_t size[4];
+        fseek(_file, 4, SEEK_SET);
+        writeLE(size, chunkSize + WAV_HEADER_SIZE - 8, 4);
+        fwrite(size, 1, 4, _file);
+        fseek(_file, 40, SEEK_SET);
+        writeLE(size, chunkSize, 4);
+        fwrite(size, 1, 4, _file);
+    }
+    bool failed = _failed || fclose(_file) != 0;
+    _file = nullptr;
+    return !failed;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,135 @@
+//-------------------------------------------------------------------------------------------------------
+//  AudioFile.h
+//  Streaming audio file I/O for the offline tools, exchanging planar float buffers in the layout
+//  processReplacing uses. Readers map the file in sliding windows and de-interleave straight out of
+//  the mapping, so stems of any size are never loaded whole. Writers interleave into buffers that a
+//  background thread flushes to disk while rendering goes on.
+//
+//  Formats: WAV (16/24/32 bit integer, 32 bit float) and headerless RAW (float32 or int24, little
+//  endian, interleaved). Writers produce float32 WAV or RAW.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define MAPPED_WINDOW_SIZE (64 << 20)           // bytes mapped at once by a reader
+#define WRITER_BUFFER_FRAMES 65536              // frames per buffer handed to the flush thread
+#define WRITER_NUM_BUFFERS 4                    // buffers in flight before write() waits
+
+enum class SampleFormat {
+	Int16 = 0,
+	Int24,
+	Int32,
+	Float32
+};
+
+// Layout of a headerless file
+struct RawFormat {
+	SampleFormat format;
+	int numChannels;
+	float sampleRate;
+};
+
+//-------------------------------------------------------------------------------------------------------
+// Read-only file mapped one window at a time
+class MappedFile {
+
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#else
+	int _file;
+#endif
+	int64_t _size;
+	int64_t _granularity;
+	const uint8_t* _window;
+	int64_t _windowOffset;
+	size_t _windowLength;
+
+	void unmapWindow();
+
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char* path);
+	void close();
+	int64_t getSize() { return _size; }
+
+	// Pointer to [offset, offset + length), remapping the window when needed; nullptr past the end
+	const uint8_t* map(int64_t offset, size_t length);
+};
+
+//-------------------------------------------------------------------------------------------------------
+class AudioFileReader {
+
+	MappedFile _file;
+	SampleFormat _format;
+	int _numChannels;
+	int _bytesPerSample;
+	float _sampleRate;
+	int64_t _dataOffset;
+	int64_t _numFrames;
+	int64_t _position;
+
+	bool parseWavHeader();
+
+public:
+
+	AudioFileReader();
+
+	bool openWav(const char* path);
+	bool openRaw(const char* path, const RawFormat& format);
+	void close();
+
+	int getNumChannels() { return _numChannels; }
+	float getSampleRate() { return _sampleRate; }
+	int64_t getNumFrames() { return _numFrames; }
+
+	// Read up to numFrames frames into numDestinations planar buffers, returns the frames read
+	// (0 at the end). A mono file feeds every destination; extra file channels are dropped.
+	int read(float** destinations, int numDestinations, int numFrames);
+};
+
+//-------------------------------------------------------------------------------------------------------
+class AudioFileWriter {
+
+	FILE* _file;
+	bool _isWav;
+	bool _failed;
+	int _numChannels;
+	int64_t _numFrames;
+
+	// Buffers cycle between the renderer (filling) and the flush thread (writing)
+	std::vector<std::vector<float>> _buffers;
+	std::vector<int> _bufferFrames;
+	std::deque<int> _freeBuffers, _fullBuffers;
+	int _currentBuffer;
+	std::mutex _lock;
+	std::condition_variable _changed;
+	std::thread _flushThread;
+	bool _closing;
+
+	void flushLoop();
+	void submitCurrent();
+
+public:
+
+	AudioFileWriter();
+	~AudioFileWriter();
+
+	// RAW when asRaw is true, float32 WAV otherwise
+	bool open(const char* path, int numChannels, float sampleRate, bool asRaw);
+	// Waits for pending buffers and patches the WAV header, false if anything failed to write
+	bool close();
+
+	bool write(float** sources, int numFrames);
+};
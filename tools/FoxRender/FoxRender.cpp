@@ -0,0 +1,225 @@
+//-------------------------------------------------------------------------------------------------------
+//  FoxRender.cpp
+//  Offline batch renderer for the Fox Suite plugins.
+//
+//  FoxRender <plugin library> <job list> [-t threads] [-b block size] [-s silence dB] [-m max tail s]
+//            [-r f32|s24:channels:rate] [-p]
+//
+//  Every line of the job list is "<input> <output> [program=N] [index=value ...]", with normalized
+//  parameter values; empty lines and lines starting with '#' are skipped. Files are WAV, or
+//  headerless RAW when the name ends in ".raw": -r gives the layout of RAW inputs (f32:2:48000 by
+//  default), RAW outputs are float32. Each worker
+//  thread owns one plugin instance and renders whole files, faster than realtime. -p prints the
+//  per-stage statistics of plugins built with FOX_STAGE_PROFILING.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <fstream>
+#include "PluginHost.h"
+#include "Renderer.h"
+#include "WorkPool.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------*/
+static bool parseJob(const string& line, RenderJob* job)
+{
+    istringstream tokens(line);
+    job->program = -1;
+    job->parameters.clear();
+    if (!(tokens >> job->inputPath >> job->outputPath))
+        return false;
+
+    string token;
+    while (tokens >> token) {
+        size_t equal = token.find('=');
+        if (equal == string::npos)
+            return false;
+        string key = token.substr(0, equal);
+        float value = (float)atof(token.c_str() + equal + 1);
+        if (key == "program")
+            job->program = (int)value;
+        else
+            job->parameters.push_back(make_pair(atoi(key.c_str()), value));
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static bool readJobList(const char* path, vector<RenderJob>& jobs)
+{
+    ifstream file(path);
+    if (!file)
+        return false;
+
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+        RenderJob job;
+        if (!parseJob(line, &job)) {
+            fprintf(stderr, "%s:%d: malformed job\n", path, lineNumber);
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static void dumpStageStats(PluginInstance& plugin, int worker)
+{
+    if (!plugin.canDo(PROFILER_CAN_DO))
+        return;
+    printf("worker %d\n", worker);
+    printf("%-16s %10s %12s %12s %12s %12s\n", "stage", "blocks", "min", "avg", "max", "p99");
+    StageStats stats;
+    for (int stage = 0; plugin.getStageStats(stage, &stats); stage++)
+        printf("%-16s %10llu %12llu %12.0f %12llu %12llu\n", stats.name, (unsigned long long)stats.count,
+            (unsigned long long)stats.min, stats.avg, (unsigned long long)stats.max, (unsigned long long)stats.p99);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static void printUsage()
+{
+    fprintf(stderr, "usage: FoxRender <plugin library> <job list> [-t threads] [-b block size] [-s silence dB] [-m max tail s]\n"
+                    "                 [-r f32|s24:channels:rate] [-p]\n");
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static bool parseRawFormat(const char* text, RawFormat* format)
+{
+    char type[8];
+    float sampleRate;
+    if (sscanf(text, "%7[^:]:%d:%f", type, &format->numChannels, &sampleRate) != 3 || format->numChannels <= 0 || sampleRate <= 0.0)
+        return false;
+    format->sampleRate = sampleRate;
+    if (strcmp(type, "f32") == 0)
+        format->format = SampleFormat::Float32;
+    else if (strcmp(type, "s24") == 0)
+        format->format = SampleFormat::Int24;
+    else
+        return false;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    int numWorkers = WorkPool::getDefaultNumWorkers();
+    RenderSettings settings;
+    settings.blockSize = DEFAULT_RENDER_BLOCK_SIZE;
+    settings.silenceThresholdDb = DEFAULT_SILENCE_THRESHOLD_DB;
+    settings.maxTailInSeconds = DEFAULT_MAX_TAIL_IN_SECONDS;
+    settings.tailHoldInMs = DEFAULT_TAIL_HOLD_IN_MS;
+    settings.rawFormat.format = SampleFormat::Float32;
+    settings.rawFormat.numChannels = 2;
+    settings.rawFormat.sampleRate = 48000.0;
+    bool profile = false;
+    for (int a = 3; a < argc; a++) {
+        bool hasValue = a + 1 < argc;
+        if (strcmp(argv[a], "-p") == 0)
+            profile = true;
+        else if (strcmp(argv[a], "-t") == 0 && hasValue)
+            numWorkers = atoi(argv[++a]);
+        else if (strcmp(argv[a], "-b") == 0 && hasValue)
+            settings.blockSize = atoi(argv[++a]);
+        else if (strcmp(argv[a], "-s") == 0 && hasValue)
+            settings.silenceThresholdDb = (float)atof(argv[++a]);
+        else if (strcmp(argv[a], "-m") == 0 && hasValue)
+            settings.maxTailInSeconds = (float)atof(argv[++a]);
+        else if (strcmp(argv[a], "-r") == 0 && hasValue && parseRawFormat(argv[a + 1], &settings.rawFormat))
+            a++;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (numWorkers < 1 || settings.blockSize < 1) {
+        printUsage();
+        return 1;
+    }
+
+    vector<RenderJob> jobs;
+    if (!readJobList(argv[2], jobs)) {
+        fprintf(stderr, "cannot read job list %s\n", argv[2]);
+        return 1;
+    }
+    if ((int)jobs.size() < numWorkers)
+        numWorkers = jobs.size() > 0 ? (int)jobs.size() : 1;
+
+    PluginLibrary library;
+    if (!library.open(argv[1])) {
+        fprintf(stderr, "cannot load plugin %s\n", argv[1]);
+        return 1;
+    }
+
+    // One plugin instance per worker, nothing shared between them while rendering
+    vector<unique_ptr<Renderer>> renderers;
+    for (int w = 0; w < numWorkers; w++) {
+        renderers.emplace_back(new Renderer());
+        if (!renderers.back()->init(library, settings)) {
+            fprintf(stderr, "cannot instantiate plugin %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    WorkPool pool(numWorkers);
+    for (int j = 0; j < (int)jobs.size(); j++)
+        pool.submit(j);
+
+    mutex printLock;
+    int numFailed = 0;
+    double secondsRendered = 0.0;
+    auto start = chrono::steady_clock::now();
+    pool.run([&](int worker, int j) {
+        auto jobStart = chrono::steady_clock::now();
+        string error;
+        int64_t frames = renderers[worker]->render(jobs[j], error);
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - jobStart).count();
+        double seconds = frames > 0 ? frames / renderers[worker]->getPlugin().getSampleRate() : 0.0;
+
+        lock_guard<mutex> guard(printLock);
+        if (frames < 0) {
+            fprintf(stderr, "failed: %s\n", error.c_str());
+            numFailed++;
+            return;
+        }
+        secondsRendered += seconds;
+        printf("%s -> %s  %.1f s  %.1fx realtime\n", jobs[j].inputPath.c_str(), jobs[j].outputPath.c_str(),
+            seconds, elapsed > 0.0 ? seconds / elapsed : 0.0);
+    });
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("%d files, %d failed, %.1f s of audio in %.1f s on %d threads (%.1fx realtime)\n", (int)jobs.size(), numFailed,
+        secondsRendered, elapsed, numWorkers, elapsed > 0.0 ? secondsRendered / elapsed : 0.0);
+
+    if (profile)
+        for (int w = 0; w < numWorkers; w++)
+            dumpStageStats(renderers[w]->getPlugin(), w);
+
+    // Instances must be closed before their library is unloaded
+    renderers.clear();
+    return numFailed > 0 ? 1 : 0;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,308 @@
+//-------------------------------------------------------------------------------------------------------
+//  PluginHost.cpp
+//  Minimal VST 2.4 host used by the offline tools.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "PluginHost.h"
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#define HOST_VST_VERSION 2400
+
+/*--------------------------------------------------------------------*/
+// The plugins only ask for the host version; everything else is answered with "unsupported"
+static VstIntPtr VSTCALLBACK hostCallback(AEffect* effect, VstInt32 opcode, VstInt32 index, VstIntPtr value, void* ptr, float opt)
+{
+    switch (opcode) {
+    case audioMasterVersion:
+        return HOST_VST_VERSION;
+    case audioMasterGetVendorString:
+        strncpy((char*)ptr, "Fox Suite", kVstMaxVendorStrLen);
+        return 1;
+    case audioMasterGetProductString:
+        strncpy((char*)ptr, "FoxRender", kVstMaxProductStrLen);
+        return 1;
+    default:
+        return 0;
+    }
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  LIBRARY  ---------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+PluginLibrary::PluginLibrary()
+{
+    _module = nullptr;
+    _entry = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+PluginLibrary::~PluginLibrary()
+{
+    close();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool PluginLibrary::open(const char* path)
+{
+    close();
+#ifdef _WIN32
+    HMODULE module = LoadLibraryA(path);
+    if (module == nullptr)
+        return false;
+    _module = module;
+    _entry = (PluginEntryProc)GetProcAddress(module, "VSTPluginMain");
+    if (_entry == nullptr)
+        _entry = (PluginEntryProc)GetProcAddress(module, "main");
+#else
+    _module = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (_module == nullptr)
+        return false;
+    _entry = (PluginEntryProc)dlsym(_module, "VSTPluginMain");
+    if (_entry == nullptr)
+        _entry = (PluginEntryProc)dlsym(_module, "main");
+#endif
+    if (_entry == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginLibrary::close()
+{
+    if (_module != nullptr) {
+#ifdef _WIN32
+        FreeLibrary((HMODULE)_module);
+#else
+        dlclose(_module);
+#endif
+    }
+    _module = nullptr;
+    _entry = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+AEffect* PluginLibrary::createInstance()
+{
+    if (_entry == nullptr)
+        return nullptr;
+    AEffect* effect = _entry(hostCallback);
+    if (effect == nullptr || effect->magic != kEffectMagic)
+        return nullptr;
+    return effect;
+}
+/*--------------------------------------------------------------------*/
+
+/* ------------------------------------------------------------------------------------------------------------
+  ------------------------------------------  INSTANCE  --------------------------------------------------------
+  ------------------------------------------------------------------------------------------------------------ */
+/*--------------------------------------------------------------------*/
+PluginInstance::PluginInstance()
+{
+    _effect = nullptr;
+    _sampleRate = 0.0;
+    _blockSize = 0;
+    _active = false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+PluginInstance::~PluginInstance()
+{
+    close();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool PluginInstance::open(PluginLibrary& library, float sampleRate, int blockSize)
+{
+    if (!create(library))
+        return false;
+
+    _sampleRate = sampleRate;
+    _blockSize = blockSize;
+    _effect->dispatcher(_effect, effSetSampleRate, 0, 0, nullptr, _sampleRate);
+    _effect->dispatcher(_effect, effSetBlockSize, 0, _blockSize, nullptr, 0.0);
+    resume();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool PluginInstance::create(PluginLibrary& library)
+{
+    close();
+    _effect = library.createInstance();
+    if (_effect == nullptr)
+        return false;
+
+    _effect->dispatcher(_effect, effOpen, 0, 0, nullptr, 0.0);
+    _sampleRate = 0.0;
+    _blockSize = 0;
+    _active = false;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// effClose makes the plugin delete itself
+void PluginInstance::close()
+{
+    if (_effect == nullptr)
+        return;
+    suspend();
+    _effect->dispatcher(_effect, effClose, 0, 0, nullptr, 0.0);
+    _effect = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::suspend()
+{
+    if (_active)
+        _effect->dispatcher(_effect, effMainsChanged, 0, 0, nullptr, 0.0);
+    _active = false;
+}
+
+void PluginInstance::resume()
+{
+    if (!_active)
+        _effect->dispatcher(_effect, effMainsChanged, 0, 1, nullptr, 0.0);
+    _active = true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::setSampleRate(float sampleRate)
+{
+    if (sampleRate == _sampleRate)
+        return;
+    bool wasActive = _active;
+    suspend();
+    _sampleRate = sampleRate;
+    _effect->dispatcher(_effect, effSetSampleRate, 0, 0, nullptr, _sampleRate);
+    if (wasActive)
+        resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::setBlockSize(int blockSize)
+{
+    if (blockSize == _blockSize)
+        return;
+    bool wasActive = _active;
+    suspend();
+    _blockSize = blockSize;
+    _effect->dispatcher(_effect, effSetBlockSize, 0, _blockSize, nullptr, 0.0);
+    if (wasActive)
+        resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::reset()
+{
+    suspend();
+    resume();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool PluginInstance::setReleaseOnSuspend(bool releaseOnSuspend)
+{
+    if (!canDo(RELEASE_ON_SUSPEND_CAN_DO))
+        return false;
+    _effect->dispatcher(_effect, effVendorSpecific, RELEASE_ON_SUSPEND_VENDOR_OPCODE, releaseOnSuspend ? 1 : 0, nullptr, 0.0);
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::setProgram(int program)
+{
+    _effect->dispatcher(_effect, effSetProgram, 0, program, nullptr, 0.0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::setParameter(int index, float value)
+{
+    if (index >= 0 && index < _effect->numParams)
+        _effect->setParameter(_effect, index, value);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::beginSetProgram()
+{
+    _effect->dispatcher(_effect, effBeginSetProgram, 0, 0, nullptr, 0.0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::endSetProgram()
+{
+    _effect->dispatcher(_effect, effEndSetProgram, 0, 0, nullptr, 0.0);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+float PluginInstance::getParameter(int index)
+{
+    return _effect->getParameter(_effect, index);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Bank chunks, 0 when the plugin keeps no chunk
+int PluginInstance::getChunk(void** data)
+{
+    *data = nullptr;
+    if ((_effect->flags & effFlagsProgramChunks) == 0)
+        return 0;
+    return (int)_effect->dispatcher(_effect, effGetChunk, 0, 0, data, 0.0);
+}
+
+bool PluginInstance::setChunk(void* data, int byteSize)
+{
+    if ((_effect->flags & effFlagsProgramChunks) == 0)
+        return false;
+    return _effect->dispatcher(_effect, effSetChunk, 0, byteSize, data, 0.0) == 1;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void PluginInstance::process(float** inputs, float** outputs, int numSamples)
+{
+    _effect->processReplacing(_effect, inputs, outputs, numSamples);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool PluginInstance::canDo(const char* text)
+{
+    return _effect->dispatcher(_effect, effCanDo, 0, 0, (void*)text, 0.0) > 0;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Statistics of plugins built with FOX_STAGE_PROFILING
+bool PluginInstance::getStageStats(int stage, StageStats* stats)
+{
+    return _effect->dispatcher(_effect, effVendorSpecific, PROFILER_VENDOR_OPCODE, stage, stats, 0.0) == 1;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,88 @@
+//-------------------------------------------------------------------------------------------------------
+//  PluginHost.h
+//  Minimal VST 2.4 host used by the offline tools: loads a plugin library once and creates
+//  independent instances of it, driven through the plugin's dispatcher like a DAW would.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include "aeffectx.h"
+#include "StageProfiler.h"
+#include "HostRequests.h"
+
+typedef AEffect* (*PluginEntryProc)(audioMasterCallback audioMaster);
+
+//-------------------------------------------------------------------------------------------------------
+class PluginLibrary {
+
+	void* _module;
+	PluginEntryProc _entry;
+
+public:
+
+	PluginLibrary();
+	~PluginLibrary();
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() { return _entry != nullptr; }
+
+	// New plugin instance, nullptr on failure
+	AEffect* createInstance();
+};
+
+//-------------------------------------------------------------------------------------------------------
+class PluginInstance {
+
+	AEffect* _effect;
+	float _sampleRate;
+	int _blockSize;
+	bool _active;
+
+public:
+
+	PluginInstance();
+	~PluginInstance();
+
+	// Creates the instance and resumes it at the given rate and block size
+	bool open(PluginLibrary& library, float sampleRate, int blockSize);
+	// Creates the instance only: rate, block size and resume are up to the caller
+	bool create(PluginLibrary& library);
+	void close();
+
+	// Changing rate or block size suspends an active plugin and resumes it after, as hosts do
+	void setSampleRate(float sampleRate);
+	void setBlockSize(int blockSize);
+	float getSampleRate() { return _sampleRate; }
+
+	void suspend();
+	void resume();
+
+	// Suspend and resume: the plugin reports a pending latency change, and clears its state when it
+	// releases its DSP objects on suspend
+	void reset();
+	// Ask a Fox Suite plugin to free its DSP objects on every suspend; false when it can't
+	bool setReleaseOnSuspend(bool releaseOnSuspend);
+	// Latency reported by the plugin, in samples
+	int getInitialDelay() { return _effect->initialDelay; }
+
+	void setProgram(int program);
+	void setParameter(int index, float value);
+	// Brackets a batch of parameter changes, plugins that support it recompute once at the end
+	void beginSetProgram();
+	void endSetProgram();
+	float getParameter(int index);
+	// Whole state, as a host saves it in a session; the data belongs to the plugin
+	int getChunk(void** data);
+	bool setChunk(void* data, int byteSize);
+	int getUniqueID() { return _effect->uniqueID; }
+	int getNumParameters() { return _effect->numParams; }
+	int getNumPrograms() { return _effect->numPrograms; }
+	int getNumInputs() { return _effect->numInputs; }
+	int getNumOutputs() { return _effect->numOutputs; }
+
+	void process(float** inputs, float** outputs, int numSamples);
+
+	bool canDo(const char* text);
+	bool getStageStats(int stage, StageStats* stats);
+};
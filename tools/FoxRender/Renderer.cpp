@@ -0,0 +1,184 @@
+//-------------------------------------------------------------------------------------------------------
+//  Renderer.cpp
+//  Renders files through one plugin instance.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "Renderer.h"
+#include <math.h>
+#include <string.h>
+
+#define DEFAULT_RENDER_SAMPLE_RATE 44100.0
+
+/*--------------------------------------------------------------------*/
+bool Renderer::openPlugin()
+{
+    if (!_plugin.open(*_library, DEFAULT_RENDER_SAMPLE_RATE, _settings.blockSize))
+        return false;
+    _resetsOnSuspend = _plugin.setReleaseOnSuspend(true);
+    _hasRendered = false;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool Renderer::init(PluginLibrary& library, const RenderSettings& settings)
+{
+    _library = &library;
+    _settings = settings;
+    if (!openPlugin())
+        return false;
+
+    // Every job starts from the state the plugin had when created
+    _initialParameters.resize(_plugin.getNumParameters());
+    for (int p = 0; p < _plugin.getNumParameters(); p++)
+        _initialParameters[p] = _plugin.getParameter(p);
+
+    _inputs.assign(_plugin.getNumInputs(), std::vector<float>(_settings.blockSize, 0.0));
+    _outputs.assign(_plugin.getNumOutputs(), std::vector<float>(_settings.blockSize, 0.0));
+    _inputPointers.resize(_inputs.size());
+    _outputPointers.resize(_outputs.size());
+    _writePointers.resize(_outputs.size());
+    for (size_t c = 0; c < _inputs.size(); c++)
+        _inputPointers[c] = _inputs[c].data();
+    for (size_t c = 0; c < _outputs.size(); c++)
+        _outputPointers[c] = _outputs[c].data();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void Renderer::applyJobParameters(const RenderJob& job)
+{
+    _plugin.beginSetProgram();
+    if (job.program >= 0)
+        _plugin.setProgram(job.program);
+    else
+        for (int p = 0; p < (int)_initialParameters.size(); p++)
+            _plugin.setParameter(p, _initialParameters[p]);
+
+    for (const std::pair<int, float>& parameter : job.parameters)
+        _plugin.setParameter(parameter.first, parameter.second);
+    _plugin.endSetProgram();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Bring the plugin to a cleared state with the job's rate and parameters. setSampleRate does
+// nothing at an unchanged rate, so the tail of the previous job would carry over: a plugin that
+// frees its DSP objects on suspend is cleared by a suspend/resume, any other one is replaced by a
+// new instance. The resume also reports the latency of the job's parameters.
+bool Renderer::resetPlugin(float sampleRate, const RenderJob& job)
+{
+    if (_hasRendered && !_resetsOnSuspend && !openPlugin())
+        return false;
+    _plugin.setSampleRate(sampleRate);
+    applyJobParameters(job);
+    _plugin.reset();
+    _hasRendered = true;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Process the planar inputs, returns the output peak
+float Renderer::processBlock(int numFrames)
+{
+    _plugin.process(_inputPointers.data(), _outputPointers.data(), numFrames);
+
+    float peak = 0.0;
+    for (const std::vector<float>& output : _outputs)
+        for (int i = 0; i < numFrames; i++)
+            peak = fmax(peak, fabs(output[i]));
+    return peak;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Write a processed block, dropping the first framesToSkip frames of the job: they are the
+// plugin's latency, so the output lines up with the input
+bool Renderer::writeBlock(AudioFileWriter& writer, int numFrames, int64_t* framesToSkip, int64_t* framesWritten)
+{
+    int skip = *framesToSkip < numFrames ? (int)*framesToSkip : numFrames;
+    *framesToSkip -= skip;
+    if (skip == numFrames)
+        return true;
+    for (size_t c = 0; c < _outputs.size(); c++)
+        _writePointers[c] = _outputPointers[c] + skip;
+    if (!writer.write(_writePointers.data(), numFrames - skip))
+        return false;
+    *framesWritten += numFrames - skip;
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static bool isRawPath(const std::string& path)
+{
+    return path.size() > 4 && path.compare(path.size() - 4, 4, ".raw") == 0;
+}
+
+bool Renderer::openInput(AudioFileReader& reader, const std::string& path)
+{
+    if (isRawPath(path))
+        return reader.openRaw(path.c_str(), _settings.rawFormat);
+    return reader.openWav(path.c_str());
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int64_t Renderer::render(const RenderJob& job, std::string& error)
+{
+    AudioFileReader reader;
+    if (!openInput(reader, job.inputPath)) {
+        error = "cannot read " + job.inputPath;
+        return -1;
+    }
+    AudioFileWriter writer;
+    if (!writer.open(job.outputPath.c_str(), (int)_outputs.size(), reader.getSampleRate(), isRawPath(job.outputPath))) {
+        error = "cannot write " + job.outputPath;
+        return -1;
+    }
+
+    if (!resetPlugin(reader.getSampleRate(), job)) {
+        error = "cannot instantiate the plugin for " + job.inputPath;
+        return -1;
+    }
+    int64_t latency = _plugin.getInitialDelay();
+    int64_t framesToSkip = latency;
+
+    // --- Input, de-interleaved by the reader straight into the plugin's input buffers
+    int64_t framesWritten = 0;
+    int numFrames;
+    while ((numFrames = reader.read(_inputPointers.data(), (int)_inputs.size(), _settings.blockSize)) > 0) {
+        processBlock(numFrames);
+        if (!writeBlock(writer, numFrames, &framesToSkip, &framesWritten)) {
+            error = "write failed on " + job.outputPath;
+            return -1;
+        }
+    }
+
+    // --- Tail: feed silence until the output stays below the threshold for the hold time, and at
+    // least for the latency so the end of the input comes out
+    for (std::vector<float>& input : _inputs)
+        memset(input.data(), 0, input.size() * sizeof(float));
+    float threshold = pow(10.0, _settings.silenceThresholdDb / 20.0);
+    int64_t maxTailFrames = latency + (int64_t)(_settings.maxTailInSeconds * reader.getSampleRate());
+    int64_t holdFrames = (int64_t)(_settings.tailHoldInMs * 0.001 * reader.getSampleRate());
+    int64_t quietFrames = 0;
+    for (int64_t tailFrames = 0; tailFrames < maxTailFrames && (tailFrames < latency || quietFrames < holdFrames); tailFrames += _settings.blockSize) {
+        float peak = processBlock(_settings.blockSize);
+        quietFrames = peak < threshold ? quietFrames + _settings.blockSize : 0;
+        if (!writeBlock(writer, _settings.blockSize, &framesToSkip, &framesWritten)) {
+            error = "write failed on " + job.outputPath;
+            return -1;
+        }
+    }
+
+    if (!writer.close()) {
+        error = "write failed on " + job.outputPath;
+        return -1;
+    }
+    return framesWritten;
+}
+/*--------------------------------------------------------------------*/
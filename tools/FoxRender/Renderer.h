@@ -0,0 +1,68 @@
+//-------------------------------------------------------------------------------------------------------
+//  Renderer.h
+//  Renders files through one plugin instance: the input is streamed through processReplacing in
+//  large blocks, then silence is fed until the tail decays below a threshold. Every job starts
+//  from a cleared plugin, and the output is shifted back by the latency the plugin reports.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include "PluginHost.h"
+#include "AudioFile.h"
+
+#define DEFAULT_RENDER_BLOCK_SIZE 8192
+#define DEFAULT_SILENCE_THRESHOLD_DB -96.0
+#define DEFAULT_MAX_TAIL_IN_SECONDS 30.0
+#define DEFAULT_TAIL_HOLD_IN_MS 500.0           // the tail must stay below the threshold this long
+
+// One file to render, with the program and parameter values to apply first
+struct RenderJob {
+	std::string inputPath;
+	std::string outputPath;
+	int program;                                        // -1 keeps the plugin's initial program
+	std::vector<std::pair<int, float>> parameters;      // index, normalized value
+};
+
+struct RenderSettings {
+	int blockSize;
+	float silenceThresholdDb;
+	float maxTailInSeconds;
+	float tailHoldInMs;
+	RawFormat rawFormat;        // layout of ".raw" inputs
+};
+
+//-------------------------------------------------------------------------------------------------------
+class Renderer {
+
+	PluginLibrary* _library;
+	PluginInstance _plugin;
+	RenderSettings _settings;
+	std::vector<float> _initialParameters;
+	// The plugin frees its DSP objects on suspend, so a suspend/resume clears it
+	bool _resetsOnSuspend;
+	// The instance has processed audio since it was opened
+	bool _hasRendered;
+
+	// Planar buffers shared by processReplacing and the file reader/writer
+	std::vector<std::vector<float>> _inputs, _outputs;
+	std::vector<float*> _inputPointers, _outputPointers, _writePointers;
+
+	bool openPlugin();
+	bool resetPlugin(float sampleRate, const RenderJob& job);
+	void applyJobParameters(const RenderJob& job);
+	float processBlock(int numFrames);
+	bool writeBlock(AudioFileWriter& writer, int numFrames, int64_t* framesToSkip, int64_t* framesWritten);
+	bool openInput(AudioFileReader& reader, const std::string& path);
+
+public:
+
+	bool init(PluginLibrary& library, const RenderSettings& settings);
+
+	// Returns the number of frames written, or -1 (with a message in error) on failure
+	int64_t render(const RenderJob& job, std::string& error);
+
+	PluginInstance& getPlugin() { return _plugin; }
+};
@@ -0,0 +1,82 @@
+//-------------------------------------------------------------------------------------------------------
+//  WorkPool.cpp
+//  Work-stealing pool for batches of independent jobs.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "WorkPool.h"
+#include <thread>
+
+/*--------------------------------------------------------------------*/
+WorkPool::WorkPool(int numWorkers) : _queues(numWorkers > 0 ? numWorkers : 1)
+{
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+int WorkPool::getDefaultNumWorkers()
+{
+    int numCores = (int)std::thread::hardware_concurrency();
+    return numCores > 0 ? numCores : 1;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void WorkPool::submit(int job)
+{
+    size_t total = 0;
+    for (WorkerQueue& queue : _queues)
+        total += queue.jobs.size();
+    WorkerQueue& queue = _queues[total % _queues.size()];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.jobs.push_back(job);
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool WorkPool::popOwn(int worker, int* job)
+{
+    WorkerQueue& queue = _queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.jobs.empty())
+        return false;
+    *job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// Victims are visited starting from the next worker, so thieves spread over the queues
+bool WorkPool::steal(int worker, int* job)
+{
+    int numWorkers = (int)_queues.size();
+    for (int i = 1; i < numWorkers; i++) {
+        WorkerQueue& queue = _queues[(worker + i) % numWorkers];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.jobs.empty()) {
+            *job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// No job is added while running, so a worker that finds every queue empty is done
+void WorkPool::run(std::function<void(int worker, int job)> work)
+{
+    std::vector<std::thread> threads;
+    for (int w = 0; w < (int)_queues.size(); w++) {
+        threads.emplace_back([this, w, &work]() {
+            int job;
+            while (popOwn(w, &job) || steal(w, &job))
+                work(w, job);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,42 @@
+//-------------------------------------------------------------------------------------------------------
+//  WorkPool.h
+//  Work-stealing pool for batches of independent jobs. Jobs are dealt round-robin to per-worker
+//  queues; a worker takes from the back of its own queue and, once it is empty, steals from the
+//  front of the others, so long and short files even out without a central queue.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+//-------------------------------------------------------------------------------------------------------
+class WorkPool {
+
+	struct WorkerQueue {
+		std::mutex lock;
+		std::deque<int> jobs;
+	};
+
+	std::vector<WorkerQueue> _queues;
+
+	bool popOwn(int worker, int* job);
+	bool steal(int worker, int* job);
+
+public:
+
+	WorkPool(int numWorkers);
+
+	int getNumWorkers() { return (int)_queues.size(); }
+
+	// Queue job indices before run()
+	void submit(int job);
+
+	// Start one thread per worker and return when every job is done.
+	// work(worker, job) runs on the worker's thread; a worker's jobs never overlap.
+	void run(std::function<void(int worker, int job)> work);
+
+	static int getDefaultNumWorkers();
+};
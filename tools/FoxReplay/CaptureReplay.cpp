@@ -0,0 +1,224 @@
+//-------------------------------------------------------------------------------------------------------
+//  CaptureReplay.cpp
+//  Replays a plugin capture into a fresh instance and compares the output.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include "CaptureReplay.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "StateChunk.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------*/
+static bool readChannels(FILE* file, vector<vector<float>>& channels, int numFrames)
+{
+    for (vector<float>& channel : channels) {
+        if ((int)channel.size() < numFrames)
+            channel.resize(numFrames);
+        if (fread(channel.data(), sizeof(float), numFrames, file) != (size_t)numFrames)
+            return false;
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+static void pointersTo(vector<vector<float>>& channels, vector<float*>& pointers)
+{
+    pointers.resize(channels.size());
+    for (size_t c = 0; c < channels.size(); c++)
+        pointers[c] = channels[c].data();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+// The chunk is copied: the plugin owns the one getChunk returns
+bool setStateSeed(PluginInstance& plugin, int slot, uint32_t seed, const float* parameters)
+{
+    void* data;
+    int size = plugin.getChunk(&data);
+    if (size < (int)sizeof(StateChunkHeader))
+        return false;
+    vector<uint8_t> chunk((uint8_t*)data, (uint8_t*)data + size);
+
+    StateChunkHeader header;
+    memcpy(&header, chunk.data(), sizeof(header));
+    size_t parametersOffset = sizeof(header);
+    size_t seedsOffset = parametersOffset + header.numParameters * sizeof(float);
+    if (slot < 0 || (uint32_t)slot >= header.numSeeds || seedsOffset + header.numSeeds * sizeof(uint32_t) > chunk.size()
+        || header.numParameters > (uint32_t)plugin.getNumParameters())
+        return false;
+
+    memcpy(chunk.data() + parametersOffset, parameters, header.numParameters * sizeof(float));
+    memcpy(chunk.data() + seedsOffset + slot * sizeof(uint32_t), &seed, sizeof(seed));
+    return plugin.setChunk(chunk.data(), (int)chunk.size());
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+CaptureReplay::CaptureReplay()
+{
+    _file = nullptr;
+    memset(&_header, 0, sizeof(_header));
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+CaptureReplay::~CaptureReplay()
+{
+    close();
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool CaptureReplay::open(const char* path)
+{
+    close();
+    _file = fopen(path, "rb");
+    if (_file == nullptr)
+        return false;
+    if (fread(&_header, sizeof(_header), 1, _file) != 1 || memcmp(_header.magic, CAPTURE_MAGIC, 4) != 0
+        || _header.version != CAPTURE_VERSION || _header.numParameters < 0 || _header.numParameters > CAPTURE_MAX_PARAMETERS
+        || _header.numInputs > CAPTURE_MAX_CHANNELS || _header.numOutputs > CAPTURE_MAX_CHANNELS) {
+        close();
+        return false;
+    }
+    _initialParameters.resize(_header.numParameters);
+    if (fread(_initialParameters.data(), sizeof(float), _header.numParameters, _file) != (size_t)_header.numParameters) {
+        close();
+        return false;
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+void CaptureReplay::close()
+{
+    if (_file != nullptr)
+        fclose(_file);
+    _file = nullptr;
+}
+/*--------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------*/
+bool CaptureReplay::run(PluginLibrary& library, AudioFileWriter* writer, ReplayResult* result)
+{
+    memset(result, 0, sizeof(*result));
+    result->sampleRate = _header.sampleRate;
+    result->complete = true;
+
+    PluginInstance plugin;
+    if (_file == nullptr || !plugin.create(library))
+        return false;
+    if (plugin.getNumInputs() != _header.numInputs || plugin.getNumOutputs() != _header.numOutputs || plugin.getNumParameters() != _header.numParameters)
+        return false;
+
+    // The capture starts from a freshly created instance, which is what we have here
+    for (int p = 0; p < _header.numParameters; p++)
+        if (plugin.getParameter(p) != _initialParameters[p])
+            printf("warning: parameter %d starts at %g, captured %g\n", p, plugin.getParameter(p), _initialParameters[p]);
+    vector<float> parameters = _initialParameters;
+
+    vector<vector<float>> inputs(_header.numInputs), outputs(_header.numOutputs), captured(_header.numOutputs);
+    vector<float*> inputPointers, outputPointers;
+    int lastFrames = 0;
+
+    CaptureRecord record;
+    while (result->complete && fread(&record, sizeof(record), 1, _file) == 1) {
+        switch (record.type) {
+        case Capture_parameter:
+            plugin.setParameter(record.index, record.value);
+            if (record.index >= 0 && record.index < _header.numParameters)
+                parameters[record.index] = record.value;
+            break;
+
+        case Capture_sampleRate:
+            result->sampleRate = record.value;
+            plugin.setSampleRate(record.value);
+            break;
+
+        case Capture_blockSize:
+            plugin.setBlockSize(record.index);
+            break;
+
+        case Capture_suspend:
+            plugin.suspend();
+            break;
+
+        case Capture_resume:
+            plugin.resume();
+            break;
+
+        case Capture_releaseOnSuspend:
+            plugin.setReleaseOnSuspend(record.index != 0);
+            break;
+
+        case Capture_seed: {
+            uint32_t seed;
+            memcpy(&seed, &record.value, sizeof(seed));
+            if (!setStateSeed(plugin, record.index, seed, parameters.data()))
+                printf("warning: cannot restore delay seed %d at sample %llu\n", record.index, (unsigned long long)record.position);
+            break;
+        }
+
+        case Capture_input: {
+            int numFrames = (int)record.numFrames;
+            if (!readChannels(_file, inputs, numFrames)) {
+                result->complete = false;
+                break;
+            }
+            for (vector<float>& output : outputs)
+                if ((int)output.size() < numFrames)
+                    output.resize(numFrames);
+            pointersTo(inputs, inputPointers);
+            pointersTo(outputs, outputPointers);
+
+            auto start = chrono::steady_clock::now();
+            plugin.process(inputPointers.data(), outputPointers.data(), numFrames);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            // Share of the block's real-time budget spent processing it
+            double load = seconds * result->sampleRate / (numFrames > 0 ? numFrames : 1);
+            result->processSeconds += seconds;
+            result->maxLoad = fmax(result->maxLoad, load);
+            result->numLateBlocks += load > 1.0 ? 1 : 0;
+            result->numBlocks++;
+            result->numSamples += numFrames;
+            lastFrames = numFrames;
+            if (writer != nullptr)
+                writer->write(outputPointers.data(), numFrames);
+            break;
+        }
+
+        case Capture_output: {
+            if (!readChannels(_file, captured, (int)record.numFrames)) {
+                result->complete = false;
+                break;
+            }
+            bool match = (int)record.numFrames == lastFrames;
+            for (int c = 0; c < _header.numOutputs && match; c++) {
+                match = memcmp(captured[c].data(), outputs[c].data(), record.numFrames * sizeof(float)) == 0;
+                for (uint32_t i = 0; i < record.numFrames; i++)
+                    result->maxDifference = fmax(result->maxDifference, fabs(captured[c][i] - outputs[c][i]));
+            }
+            if (!match && result->numMismatches++ == 0)
+                result->firstMismatch = record.position;
+            break;
+        }
+
+        case Capture_overrun:
+            result->truncated = true;
+            break;
+
+        default:
+            result->complete = false;
+            break;
+        }
+    }
+    return true;
+}
+/*--------------------------------------------------------------------*/
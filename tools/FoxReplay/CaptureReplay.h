@@ -0,0 +1,57 @@
+//-------------------------------------------------------------------------------------------------------
+//  CaptureReplay.h
+//  Feeds a capture written by a FOX_CAPTURE build (see CaptureLog.h) into a fresh instance of the
+//  plugin. The instance is only created: every host call that follows, from the sample rate to the
+//  first resume, comes from the capture, in the captured order and before the captured block.
+//  Every input block goes through processReplacing with the captured size and its output is
+//  compared bit for bit with the captured one.
+//
+//-------------------------------------------------------------------------------------------------------
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "PluginHost.h"
+#include "AudioFile.h"
+#include "CaptureLog.h"
+
+// What a replay found
+struct ReplayResult {
+	uint64_t numBlocks, numSamples;
+	uint64_t numMismatches, firstMismatch;      // blocks whose output differs, sample of the first
+	float maxDifference;
+	uint64_t numLateBlocks;                     // blocks that took longer than their real-time budget
+	double processSeconds, maxLoad;
+	float sampleRate;                           // rate at the end of the capture
+	bool complete;                              // false when the file is cut short
+	bool truncated;                             // the capture overran its buffer and stopped early
+
+	bool isBitExact() const { return numMismatches == 0 && complete; }
+};
+
+//-------------------------------------------------------------------------------------------------------
+class CaptureReplay {
+
+	FILE* _file;
+	CaptureHeader _header;
+	std::vector<float> _initialParameters;
+
+public:
+
+	CaptureReplay();
+	~CaptureReplay();
+
+	// Reads the header, false if the file is not a capture of this version
+	bool open(const char* path);
+	void close();
+	const CaptureHeader& getHeader() { return _header; }
+
+	// Replays the whole capture into a new instance, writing its output when writer is not null.
+	// False if the library's plugin does not match the captured one.
+	bool run(PluginLibrary& library, AudioFileWriter* writer, ReplayResult* result);
+};
+
+// Restores a delay seed the way a host restores a session: with a chunk of the instance's state in
+// which the seed and the parameters are replaced. parameters holds the normalized values last set.
+bool setStateSeed(PluginInstance& plugin, int slot, uint32_t seed, const float* parameters);
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------------
+//  FoxReplay.cpp
+//  Replays a capture written by a FOX_CAPTURE build (see CaptureLog.h) into a fresh instance of
+//  the plugin: every captured host call is made again before the block it preceded and every
+//  captured input block goes through processReplacing with the captured block size. The output is
+//  compared bit for bit with the captured one, and the time spent in each block is compared with
+//  the block's real-time budget.
+//
+//  FoxReplay <plugin library> <capture file> [-o output.wav|.raw]
+//
+//-------------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CaptureReplay.h"
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    if (argc != 3 && !(argc == 5 && strcmp(argv[3], "-o") == 0)) {
+        fprintf(stderr, "usage: FoxReplay <plugin library> <capture file> [-o output.wav|.raw]\n");
+        return 1;
+    }
+    const char* outputPath = argc == 5 ? argv[4] : nullptr;
+
+    // A capture-enabled build must not record the replay itself
+#ifdef _WIN32
+    _putenv("FOX_CAPTURE_DIR=");
+    _putenv("FOX_CAPTURE_PATH=");
+#else
+    unsetenv("FOX_CAPTURE_DIR");
+    unsetenv("FOX_CAPTURE_PATH");
+#endif
+
+    CaptureReplay replay;
+    if (!replay.open(argv[2])) {
+        fprintf(stderr, "%s is not a capture of version %d\n", argv[2], CAPTURE_VERSION);
+        return 1;
+    }
+    const CaptureHeader& header = replay.getHeader();
+
+    PluginLibrary library;
+    if (!library.open(argv[1])) {
+        fprintf(stderr, "cannot load plugin %s\n", argv[1]);
+        return 1;
+    }
+
+    AudioFileWriter writer;
+    if (outputPath != nullptr) {
+        size_t length = strlen(outputPath);
+        bool asRaw = length > 4 && strcmp(outputPath + length - 4, ".raw") == 0;
+        if (!writer.open(outputPath, header.numOutputs, header.sampleRate, asRaw)) {
+            fprintf(stderr, "cannot write %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    ReplayResult result;
+    if (!replay.run(library, outputPath != nullptr ? &writer : nullptr, &result)) {
+        fprintf(stderr, "%s does not match the %s capture\n", argv[1], header.pluginName);
+        return 1;
+    }
+    if (outputPath != nullptr)
+        writer.close();
+
+    printf("%s capture: %llu blocks, %llu samples at %g Hz\n", header.pluginName, (unsigned long long)result.numBlocks,
+        (unsigned long long)result.numSamples, result.sampleRate);
+    if (!result.complete)
+        printf("capture file is cut short, replayed up to sample %llu\n", (unsigned long long)result.numSamples);
+    if (result.truncated)
+        printf("capture overran its buffer at sample %llu, later blocks were not recorded\n", (unsigned long long)result.numSamples);
+    if (result.numMismatches == 0)
+        printf("output: bit-exact\n");
+    else
+        printf("output: %llu blocks differ, first at sample %llu, max difference %g\n", (unsigned long long)result.numMismatches,
+            (unsigned long long)result.firstMismatch, result.maxDifference);
+    printf("cpu: %.1fx realtime on average, peak block load %.0f%%, %llu blocks over budget\n",
+        result.processSeconds > 0.0 ? result.numSamples / result.sampleRate / result.processSeconds : 0.0, result.maxLoad * 100.0,
+        (unsigned long long)result.numLateBlocks);
+    return result.isBitExact() ? 0 : 2;
+}
+/*--------------------------------------------------------------------*/